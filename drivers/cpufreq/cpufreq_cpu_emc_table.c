@@ -18,6 +18,12 @@
 #include <linux/debugfs.h>
 #include <linux/mm.h>
 #include <linux/vmalloc.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 
 #include "cpufreq_cpu_emc_table.h"
@@ -131,3 +137,447 @@ struct dentry *tegra_debugfs_create_cpu_emc_map(struct dentry *parent,
 	return debugfs_create_file("cpu_emc_map", S_IRUGO, parent,
 		mapping, &cpu_emc_map_fops);
 }
+
+#ifdef CONFIG_PERF_EVENTS
+
+/* ARMv8 PMUv3 common event: cycles with no operation issued, backend */
+#define ARMV8_PMUV3_STALL_BACKEND	0x24
+
+#define LEARN_PERIOD_MS_DEFAULT		100
+#define LEARN_STALL_HIGH_DEFAULT	350	/* per mille of cycles */
+#define LEARN_STALL_LOW_DEFAULT		120
+#define LEARN_STEP_PCT_DEFAULT		20
+#define LEARN_MIN_PCT_DEFAULT		50
+#define LEARN_PERIOD_MS_MIN		10
+#define LEARN_MIN_CYCLES		1000000ULL
+
+struct cpu_emc_learn_bin {
+	uint32_t floor_khz;
+	uint32_t stall_avg;	/* per mille, moving average */
+	u64 acc_cycles;
+	u64 acc_stall;
+	u64 nr_up;
+	u64 nr_down;
+};
+
+struct cpu_emc_learn_cpu {
+	struct perf_event *cycles;
+	struct perf_event *stall;
+	u64 last_cycles;
+	u64 last_stall;
+};
+
+struct cpu_emc_learn {
+	struct cpu_emc_mapping *mapping;
+	struct cpu_emc_learn_bin *bins;
+	int nr_bins;
+	uint32_t max_khz;
+	void (*refresh)(void);
+
+	struct cpu_emc_learn_cpu __percpu *pcpu;
+	struct delayed_work work;
+	struct mutex lock;	/* enable, counters and bin state */
+	bool enabled;
+
+	u32 period_ms;
+	u32 stall_high;
+	u32 stall_low;
+	u32 step_pct;
+	u32 min_pct;
+
+	struct dentry *dir;
+};
+
+static uint32_t learn_static_khz(struct cpu_emc_learn *learn, int bin)
+{
+	uint32_t khz = learn->mapping[bin].emc_freq_khz;
+
+	return khz == UINT_MAX ? learn->max_khz : min(khz, learn->max_khz);
+}
+
+static unsigned long learn_period(struct cpu_emc_learn *learn)
+{
+	return msecs_to_jiffies(max_t(u32, learn->period_ms,
+				      LEARN_PERIOD_MS_MIN));
+}
+
+/* index of the mapping entry that applies to cpu_freq, -1 below the table */
+static int learn_find_bin(struct cpu_emc_learn *learn, uint32_t cpu_freq)
+{
+	int i;
+
+	for (i = 0; i < learn->nr_bins; i++)
+		if (cpu_freq < learn->mapping[i].cpu_freq_khz)
+			break;
+	return i - 1;
+}
+
+unsigned long
+tegra_cpu_to_emc_freq_learned(uint32_t cpu_freq,
+	struct cpu_emc_mapping *mapping, struct cpu_emc_learn *learn)
+{
+	int bin;
+
+	if (!learn || !READ_ONCE(learn->enabled) || learn->mapping != mapping)
+		return tegra_cpu_to_emc_freq(cpu_freq, mapping);
+
+	bin = learn_find_bin(learn, cpu_freq);
+	if (bin < 0)
+		return 0;
+
+	return READ_ONCE(learn->bins[bin].floor_khz);
+}
+
+static struct perf_event *learn_create_counter(int cpu, u32 type, u64 config)
+{
+	struct perf_event_attr attr = {
+		.type		= type,
+		.config		= config,
+		.size		= sizeof(struct perf_event_attr),
+		.disabled	= 0,
+	};
+
+	return perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+}
+
+static u64 learn_read_counter(struct perf_event *event)
+{
+	u64 enabled, running;
+
+	return event ? perf_event_read_value(event, &enabled, &running) : 0;
+}
+
+static void learn_release_counters(struct cpu_emc_learn *learn)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpu_emc_learn_cpu *c = per_cpu_ptr(learn->pcpu, cpu);
+
+		if (c->cycles)
+			perf_event_release_kernel(c->cycles);
+		if (c->stall)
+			perf_event_release_kernel(c->stall);
+		c->cycles = NULL;
+		c->stall = NULL;
+	}
+}
+
+static int learn_create_counters(struct cpu_emc_learn *learn)
+{
+	struct perf_event *ev;
+	int cpu, nr = 0;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct cpu_emc_learn_cpu *c = per_cpu_ptr(learn->pcpu, cpu);
+
+		ev = learn_create_counter(cpu, PERF_TYPE_HARDWARE,
+					  PERF_COUNT_HW_CPU_CYCLES);
+		if (IS_ERR(ev))
+			continue;
+		c->cycles = ev;
+
+		ev = learn_create_counter(cpu, PERF_TYPE_RAW,
+					  ARMV8_PMUV3_STALL_BACKEND);
+		if (IS_ERR(ev)) {
+			perf_event_release_kernel(c->cycles);
+			c->cycles = NULL;
+			continue;
+		}
+		c->stall = ev;
+
+		c->last_cycles = learn_read_counter(c->cycles);
+		c->last_stall = learn_read_counter(c->stall);
+		nr++;
+	}
+	put_online_cpus();
+
+	if (!nr) {
+		learn_release_counters(learn);
+		return -ENODEV;
+	}
+	return 0;
+}
+
+static void learn_reset_bins(struct cpu_emc_learn *learn)
+{
+	int i;
+
+	for (i = 0; i < learn->nr_bins; i++) {
+		struct cpu_emc_learn_bin *b = &learn->bins[i];
+
+		WRITE_ONCE(b->floor_khz, learn_static_khz(learn, i));
+		b->stall_avg = 0;
+		b->acc_cycles = 0;
+		b->acc_stall = 0;
+	}
+}
+
+/* Move one bin's floor according to its stall average. */
+static bool learn_adjust_bin(struct cpu_emc_learn *learn, int i)
+{
+	struct cpu_emc_learn_bin *b = &learn->bins[i];
+	uint32_t floor = b->floor_khz, lo, step;
+
+	step = max_t(uint32_t, floor / 100 * learn->step_pct,
+		     learn->max_khz / 32);
+
+	if (b->stall_avg > learn->stall_high) {
+		floor = min(learn->max_khz, floor + step);
+		b->nr_up += floor != b->floor_khz;
+	} else if (b->stall_avg < learn->stall_low) {
+		lo = learn_static_khz(learn, i) / 100 * learn->min_pct;
+		floor = floor > lo + step ? floor - step : lo;
+		b->nr_down += floor != b->floor_khz;
+	}
+
+	if (floor == b->floor_khz)
+		return false;
+
+	WRITE_ONCE(b->floor_khz, floor);
+	return true;
+}
+
+static void learn_work_fn(struct work_struct *work)
+{
+	struct cpu_emc_learn *learn = container_of(to_delayed_work(work),
+		struct cpu_emc_learn, work);
+	bool changed = false;
+	int cpu, i;
+
+	mutex_lock(&learn->lock);
+	if (!learn->enabled) {
+		mutex_unlock(&learn->lock);
+		return;
+	}
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct cpu_emc_learn_cpu *c = per_cpu_ptr(learn->pcpu, cpu);
+		u64 cycles, stall;
+
+		if (!c->cycles)
+			continue;
+
+		cycles = learn_read_counter(c->cycles);
+		stall = learn_read_counter(c->stall);
+
+		i = learn_find_bin(learn, cpufreq_quick_get(cpu));
+		if (i >= 0 && cycles > c->last_cycles &&
+		    stall >= c->last_stall) {
+			learn->bins[i].acc_cycles += cycles - c->last_cycles;
+			learn->bins[i].acc_stall += stall - c->last_stall;
+		}
+		c->last_cycles = cycles;
+		c->last_stall = stall;
+	}
+	put_online_cpus();
+
+	for (i = 0; i < learn->nr_bins; i++) {
+		struct cpu_emc_learn_bin *b = &learn->bins[i];
+		u64 ratio;
+
+		/* wait for enough samples at this frequency */
+		if (b->acc_cycles < LEARN_MIN_CYCLES)
+			continue;
+
+		ratio = div64_u64(b->acc_stall * 1000, b->acc_cycles);
+		b->stall_avg = (b->stall_avg * 3 + min_t(u64, ratio, 1000)) / 4;
+		b->acc_cycles = 0;
+		b->acc_stall = 0;
+
+		changed |= learn_adjust_bin(learn, i);
+	}
+
+	schedule_delayed_work(&learn->work, learn_period(learn));
+	mutex_unlock(&learn->lock);
+
+	if (changed && learn->refresh)
+		learn->refresh();
+}
+
+static int learn_set_enabled(struct cpu_emc_learn *learn, bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&learn->lock);
+	if (enable == learn->enabled)
+		goto out;
+
+	if (enable) {
+		ret = learn_create_counters(learn);
+		if (ret) {
+			pr_warn("cpufreq: no PMU counters for cpu-emc learning, using static table\n");
+			goto out;
+		}
+		learn_reset_bins(learn);
+		learn->enabled = true;
+		schedule_delayed_work(&learn->work, learn_period(learn));
+	} else {
+		learn->enabled = false;
+	}
+out:
+	mutex_unlock(&learn->lock);
+
+	if (!ret && !enable) {
+		cancel_delayed_work_sync(&learn->work);
+		mutex_lock(&learn->lock);
+		if (!learn->enabled)
+			learn_release_counters(learn);
+		mutex_unlock(&learn->lock);
+	}
+	if (!ret && learn->refresh)
+		learn->refresh();
+
+	return ret;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int learn_enable_get(void *data, u64 *val)
+{
+	struct cpu_emc_learn *learn = data;
+
+	*val = learn->enabled;
+	return 0;
+}
+
+static int learn_enable_set(void *data, u64 val)
+{
+	return learn_set_enabled(data, !!val);
+}
+DEFINE_SIMPLE_ATTRIBUTE(learn_enable_fops, learn_enable_get,
+			learn_enable_set, "%llu\n");
+
+static int learn_table_show(struct seq_file *s, void *data)
+{
+	struct cpu_emc_learn *learn = s->private;
+	int i;
+
+	seq_printf(s, "%s\n", learn->enabled ? "learned" : "static");
+	seq_puts(s, "cpufreq  static_emc  learned_emc  stall  up  down\n");
+
+	mutex_lock(&learn->lock);
+	for (i = 0; i < learn->nr_bins; i++) {
+		struct cpu_emc_learn_bin *b = &learn->bins[i];
+
+		seq_printf(s, "%7u %11u %12u %6u %3llu %5llu\n",
+			   learn->mapping[i].cpu_freq_khz,
+			   learn_static_khz(learn, i), b->floor_khz,
+			   b->stall_avg, b->nr_up, b->nr_down);
+	}
+	mutex_unlock(&learn->lock);
+
+	return 0;
+}
+
+static int learn_table_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, learn_table_show, inode->i_private);
+}
+
+static const struct file_operations learn_table_fops = {
+	.open		= learn_table_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void learn_debugfs_init(struct cpu_emc_learn *learn,
+			       struct dentry *parent)
+{
+	struct dentry *dir;
+
+	if (!parent)
+		return;
+
+	dir = debugfs_create_dir("cpu_emc_learn", parent);
+	if (!dir)
+		return;
+
+	if (!debugfs_create_file("enable", S_IRUGO | S_IWUSR, dir, learn,
+				 &learn_enable_fops) ||
+	    !debugfs_create_file("table", S_IRUGO, dir, learn,
+				 &learn_table_fops) ||
+	    !debugfs_create_u32("period_ms", S_IRUGO | S_IWUSR, dir,
+				&learn->period_ms) ||
+	    !debugfs_create_u32("stall_high", S_IRUGO | S_IWUSR, dir,
+				&learn->stall_high) ||
+	    !debugfs_create_u32("stall_low", S_IRUGO | S_IWUSR, dir,
+				&learn->stall_low) ||
+	    !debugfs_create_u32("step_pct", S_IRUGO | S_IWUSR, dir,
+				&learn->step_pct) ||
+	    !debugfs_create_u32("min_pct", S_IRUGO | S_IWUSR, dir,
+				&learn->min_pct)) {
+		debugfs_remove_recursive(dir);
+		return;
+	}
+
+	learn->dir = dir;
+}
+#else
+static inline void learn_debugfs_init(struct cpu_emc_learn *learn,
+				      struct dentry *parent)
+{
+}
+#endif
+
+struct cpu_emc_learn *
+tegra_cpu_emc_learn_create(struct cpu_emc_mapping *mapping,
+	void (*refresh)(void), struct dentry *parent)
+{
+	struct cpu_emc_learn *learn;
+	int nr = 0;
+
+	if (!mapping)
+		return NULL;
+
+	while (mapping[nr].cpu_freq_khz)
+		nr++;
+	if (!nr)
+		return NULL;
+
+	learn = kzalloc(sizeof(*learn), GFP_KERNEL);
+	if (!learn)
+		return NULL;
+
+	learn->bins = kcalloc(nr, sizeof(*learn->bins), GFP_KERNEL);
+	learn->pcpu = alloc_percpu(struct cpu_emc_learn_cpu);
+	if (!learn->bins || !learn->pcpu) {
+		free_percpu(learn->pcpu);
+		kfree(learn->bins);
+		kfree(learn);
+		return NULL;
+	}
+
+	learn->mapping = mapping;
+	learn->nr_bins = nr;
+	learn->max_khz = tegra_bwmgr_get_max_emc_rate() / 1000;
+	learn->refresh = refresh;
+	learn->period_ms = LEARN_PERIOD_MS_DEFAULT;
+	learn->stall_high = LEARN_STALL_HIGH_DEFAULT;
+	learn->stall_low = LEARN_STALL_LOW_DEFAULT;
+	learn->step_pct = LEARN_STEP_PCT_DEFAULT;
+	learn->min_pct = LEARN_MIN_PCT_DEFAULT;
+	mutex_init(&learn->lock);
+	INIT_DELAYED_WORK(&learn->work, learn_work_fn);
+	learn_reset_bins(learn);
+
+	learn_debugfs_init(learn, parent);
+
+	return learn;
+}
+
+void tegra_cpu_emc_learn_destroy(struct cpu_emc_learn *learn)
+{
+	if (!learn)
+		return;
+
+	debugfs_remove_recursive(learn->dir);
+	learn->refresh = NULL;
+	learn_set_enabled(learn, false);
+	free_percpu(learn->pcpu);
+	kfree(learn->bins);
+	kfree(learn);
+}
+#endif
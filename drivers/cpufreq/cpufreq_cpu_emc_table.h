@@ -31,4 +31,41 @@ tegra_cpu_to_emc_freq(uint32_t, struct cpu_emc_mapping *);
 extern struct dentry * tegra_debugfs_create_cpu_emc_map(struct dentry *,
 	struct cpu_emc_mapping *);
 
+/*
+ * Runtime-learned EMC floors. The learner watches backend stall rates per
+ * CPU frequency bin of the mapping and moves each bin's EMC floor up for
+ * memory-bound and down for compute-bound load. refresh() is called when a
+ * floor changes so the cpufreq driver can re-apply it. When the learner is
+ * disabled or unavailable, the static mapping is used.
+ */
+struct cpu_emc_learn;
+
+#ifdef CONFIG_PERF_EVENTS
+extern struct cpu_emc_learn *
+tegra_cpu_emc_learn_create(struct cpu_emc_mapping *, void (*refresh)(void),
+	struct dentry *);
+extern void tegra_cpu_emc_learn_destroy(struct cpu_emc_learn *);
+extern unsigned long
+tegra_cpu_to_emc_freq_learned(uint32_t, struct cpu_emc_mapping *,
+	struct cpu_emc_learn *);
+#else
+static inline struct cpu_emc_learn *
+tegra_cpu_emc_learn_create(struct cpu_emc_mapping *mapping,
+	void (*refresh)(void), struct dentry *parent)
+{
+	return NULL;
+}
+
+static inline void tegra_cpu_emc_learn_destroy(struct cpu_emc_learn *learn)
+{
+}
+
+static inline unsigned long
+tegra_cpu_to_emc_freq_learned(uint32_t cpu_freq,
+	struct cpu_emc_mapping *mapping, struct cpu_emc_learn *learn)
+{
+	return tegra_cpu_to_emc_freq(cpu_freq, mapping);
+}
+#endif
+
 #endif
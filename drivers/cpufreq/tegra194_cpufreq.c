@@ -55,6 +55,7 @@
 					cl < MAX_CLUSTERS; cl++)
 
 static struct cpu_emc_mapping *cpu_emc_map_ptr;
+static struct cpu_emc_learn *cpu_emc_learn;
 static uint8_t tegra_hypervisor_mode;
 
 static int cpufreq_single_policy;
@@ -242,7 +243,8 @@ static void set_cpufreq_to_emcfreq(enum cluster cl, uint32_t cluster_freq)
 {
 	unsigned long emc_freq;
 
-	emc_freq = tegra_cpu_to_emc_freq(cluster_freq, cpu_emc_map_ptr);
+	emc_freq = tegra_cpu_to_emc_freq_learned(cluster_freq, cpu_emc_map_ptr,
+						 cpu_emc_learn);
 
 	tegra_bwmgr_set_emc(tfreq_data.pcluster[cl].bwmgr,
 		emc_freq * KHZ_TO_HZ, TEGRA_BWMGR_SET_EMC_FLOOR);
@@ -250,6 +252,23 @@ static void set_cpufreq_to_emcfreq(enum cluster cl, uint32_t cluster_freq)
 		cl, emc_freq, cluster_freq);
 }
 
+/* Re-apply emc floors after the learned cpu-emc mapping changed */
+static void tegra194_cpu_emc_refresh(void)
+{
+	enum cluster cl;
+	unsigned int cpu;
+
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		if (!tfreq_data.pcluster[cl].bwmgr)
+			continue;
+		cpu = cpumask_any_and(&tfreq_data.pcluster[cl].cpu_mask,
+				      cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			continue;
+		set_cpufreq_to_emcfreq(cl, cpufreq_quick_get(cpu));
+	}
+}
+
 static struct cpufreq_frequency_table *get_freqtable(uint8_t cpu)
 {
 	enum cluster cur_cl = get_cpu_cluster(cpu);
@@ -646,6 +665,11 @@ err_out:
 	return -EINVAL;
 }
 
+static struct dentry *tegra_cpufreq_debugfs_dir(void)
+{
+	return tegra_cpufreq_debugfs_root;
+}
+
 static int __init tegra_cpufreq_debug_init(void)
 {
 	struct dentry *dir;
@@ -697,6 +721,11 @@ static void __exit tegra_cpufreq_debug_exit(void)
 {
 	debugfs_remove_recursive(tegra_cpufreq_debugfs_root);
 }
+#else
+static inline struct dentry *tegra_cpufreq_debugfs_dir(void)
+{
+	return NULL;
+}
 #endif
 
 static int tegra194_cpufreq_init(struct cpufreq_policy *policy)
@@ -1138,6 +1167,10 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 
 	cpufreq_register_notifier(&tegra_boundaries_cpufreq_nb,
 					CPUFREQ_POLICY_NOTIFIER);
+
+	cpu_emc_learn = tegra_cpu_emc_learn_create(cpu_emc_map_ptr,
+					tegra194_cpu_emc_refresh,
+					tegra_cpufreq_debugfs_dir());
 	goto err_out;
 err_free_res:
 	free_allocated_res_init();
@@ -1149,6 +1182,9 @@ err_out:
 
 static int __exit tegra194_cpufreq_remove(struct platform_device *pdev)
 {
+	tegra_cpu_emc_learn_destroy(cpu_emc_learn);
+	cpu_emc_learn = NULL;
+
 	cpufreq_unregister_notifier(&tegra_boundaries_cpufreq_nb,
 					CPUFREQ_POLICY_NOTIFIER);
 
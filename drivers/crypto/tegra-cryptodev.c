@@ -73,6 +73,8 @@ struct tegra_crypto_ctx {
 	struct crypto_shash *shash_tfm[6];
 	struct crypto_rng *rng;
 	struct crypto_rng *rng_drbg;
+	/* non-CBC tfms cached across TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ */
+	struct crypto_skcipher *batch_tfm[TEGRA_CRYPTO_MAX];
 	u8 seed[TEGRA_CRYPTO_RNG_SEED_SIZE];
 	int use_ssk;
 	bool skip_exit;
@@ -201,6 +203,10 @@ static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 		tfm_index = 0;
 	}
 out:
+	for (i = 0; i < TEGRA_CRYPTO_MAX; i++) {
+		if (ctx->batch_tfm[i])
+			crypto_free_skcipher(ctx->batch_tfm[i]);
+	}
 	kfree(ctx);
 	filp->private_data = NULL;
 
@@ -217,53 +223,20 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
-static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
+static int tegra_crypt_do_req(struct tegra_crypto_ctx *ctx,
+				struct crypto_skcipher *tfm,
+				struct skcipher_request *req,
+				unsigned long *xbuf[NBUFS],
 				struct tegra_crypt_req *crypt_req)
 {
-	struct crypto_skcipher *tfm;
-	struct skcipher_request *req = NULL;
 	struct scatterlist in_sg;
 	struct scatterlist out_sg;
-	unsigned long *xbuf[NBUFS];
 	int ret = 0, size = 0;
 	unsigned long total = 0;
 	const u8 *key = NULL;
 	struct tegra_crypto_completion tcrypt_complete;
-	char aes_algo[5][10] = {"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)",
-				"xts(aes)"};
 	const char *algo;
 
-	if (crypt_req->op != TEGRA_CRYPTO_CBC) {
-		if (crypt_req->op >= TEGRA_CRYPTO_MAX)
-			return -EINVAL;
-
-		crypt_req->op = array_index_nospec(crypt_req->op,
-							TEGRA_CRYPTO_MAX);
-
-		tfm = crypto_alloc_skcipher(aes_algo[crypt_req->op],
-			CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
-		if (IS_ERR(tfm)) {
-			pr_err("Failed to load transform for %s: %ld\n",
-				aes_algo[crypt_req->op], PTR_ERR(tfm));
-			ret = PTR_ERR(tfm);
-			goto out;
-		}
-
-		ctx->aes_tfm[crypt_req->op] = tfm;
-		filp->private_data = ctx;
-	} else {
-		tfm = ctx->aes_tfm[TEGRA_CRYPTO_CBC];
-		ctx->skip_exit = crypt_req->skip_exit;
-		filp->private_data = ctx;
-	}
-
-	req = skcipher_request_alloc(tfm, GFP_KERNEL);
-	if (!req) {
-		pr_err("%s: Failed to allocate request\n", __func__);
-		ret = -ENOMEM;
-		goto free_tfm;
-	}
-
 	if (((crypt_req->keylen &
 		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_128_SIZE) &&
 		((crypt_req->keylen &
@@ -272,9 +245,8 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_256_SIZE) &&
 		((crypt_req->keylen &
 		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_512_SIZE)) {
-		ret = -EINVAL;
 		pr_err("crypt_req keylen invalid");
-		goto process_req_out;
+		return -EINVAL;
 	}
 
 	crypto_skcipher_clear_flags(tfm, ~0);
@@ -286,29 +258,20 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		algo = crypto_tfm_alg_driver_name(crypto_skcipher_tfm(tfm));
 		if (!algo) {
 			pr_err("Not a avilable algo");
-			ret = -EINVAL;
-			goto process_req_out;
+			return -EINVAL;
 		}
 
 		/* Null key is only allowed in SE driver */
-		if (!strstr(algo, "tegra")) {
-			ret = -EINVAL;
-			goto process_req_out;
-		}
+		if (!strstr(algo, "tegra"))
+			return -EINVAL;
 
 		ret = crypto_skcipher_setkey(tfm, key, crypt_req->keylen);
 		if (ret < 0) {
 			pr_err("setkey failed");
-			goto process_req_out;
+			return ret;
 		}
 	}
 
-	ret = alloc_bufs(xbuf);
-	if (ret < 0) {
-		pr_err("alloc_bufs failed");
-		goto process_req_out;
-	}
-
 	init_completion(&tcrypt_complete.restart);
 
 	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
@@ -322,7 +285,7 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		if (ret) {
 			ret = -EFAULT;
 			pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
-			goto process_req_buf_out;
+			return ret;
 		}
 		sg_init_one(&in_sg, xbuf[0], size);
 		sg_init_one(&out_sg, xbuf[1], size);
@@ -353,16 +316,14 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 			ret = wait_for_completion_timeout(&tcrypt_complete.restart,
 						msecs_to_jiffies(5000));
 			if (ret == 0)
-				goto process_req_buf_out;
+				return -ETIMEDOUT;
 
-			if (tcrypt_complete.req_err < 0) {
-				ret = tcrypt_complete.req_err;
-				goto process_req_buf_out;
-			}
+			if (tcrypt_complete.req_err < 0)
+				return tcrypt_complete.req_err;
 		} else if (ret < 0) {
 			pr_debug("%scrypt failed (%d)\n",
 				crypt_req->encrypt ? "en" : "de", ret);
-			goto process_req_buf_out;
+			return ret;
 		}
 
 		ret = copy_to_user((void __user *)crypt_req->result,
@@ -371,7 +332,7 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 			ret = -EFAULT;
 			pr_debug("%s: copy_to_user failed (%d)\n", __func__,
 					ret);
-			goto process_req_buf_out;
+			return ret;
 		}
 
 		total -= size;
@@ -379,7 +340,58 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		crypt_req->plaintext += size;
 	}
 
-process_req_buf_out:
+	return ret;
+}
+
+static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
+				struct tegra_crypt_req *crypt_req)
+{
+	struct crypto_skcipher *tfm;
+	struct skcipher_request *req = NULL;
+	unsigned long *xbuf[NBUFS];
+	int ret = 0;
+	char aes_algo[5][10] = {"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)",
+				"xts(aes)"};
+
+	if (crypt_req->op != TEGRA_CRYPTO_CBC) {
+		if (crypt_req->op >= TEGRA_CRYPTO_MAX)
+			return -EINVAL;
+
+		crypt_req->op = array_index_nospec(crypt_req->op,
+							TEGRA_CRYPTO_MAX);
+
+		tfm = crypto_alloc_skcipher(aes_algo[crypt_req->op],
+			CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("Failed to load transform for %s: %ld\n",
+				aes_algo[crypt_req->op], PTR_ERR(tfm));
+			ret = PTR_ERR(tfm);
+			goto out;
+		}
+
+		ctx->aes_tfm[crypt_req->op] = tfm;
+		filp->private_data = ctx;
+	} else {
+		tfm = ctx->aes_tfm[TEGRA_CRYPTO_CBC];
+		ctx->skip_exit = crypt_req->skip_exit;
+		filp->private_data = ctx;
+	}
+
+	req = skcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!req) {
+		pr_err("%s: Failed to allocate request\n", __func__);
+		ret = -ENOMEM;
+		goto free_tfm;
+	}
+
+	ret = alloc_bufs(xbuf);
+	if (ret < 0) {
+		pr_err("alloc_bufs failed");
+		goto process_req_out;
+	}
+
+	ret = tegra_crypt_do_req(ctx, tfm, req, xbuf, crypt_req);
+
 	free_bufs(xbuf);
 process_req_out:
 	skcipher_request_free(req);
@@ -390,6 +402,166 @@ out:
 	return ret;
 }
 
+static struct crypto_skcipher *tegra_crypt_batch_get_tfm(
+	struct tegra_crypto_ctx *ctx, unsigned int op)
+{
+	struct crypto_skcipher *tfm;
+	char aes_algo[5][10] = {"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)",
+				"xts(aes)"};
+
+	if (op == TEGRA_CRYPTO_CBC)
+		return ctx->aes_tfm[TEGRA_CRYPTO_CBC];
+
+	/* Transforms are kept until release so that later requests in the
+	 * same or a following batch skip the algorithm lookup and setup.
+	 */
+	if (ctx->batch_tfm[op])
+		return ctx->batch_tfm[op];
+
+	tfm = crypto_alloc_skcipher(aes_algo[op],
+		CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("Failed to load transform for %s: %ld\n",
+			aes_algo[op], PTR_ERR(tfm));
+		return tfm;
+	}
+
+	ctx->batch_tfm[op] = tfm;
+
+	return tfm;
+}
+
+#ifdef CONFIG_COMPAT
+static int tegra_crypt_req_from_32(struct tegra_crypt_req *crypt_req,
+				   const struct tegra_crypt_req_32 *crypt_req_32)
+{
+	int i;
+
+	if (crypt_req_32->keylen > TEGRA_CRYPTO_MAX_KEY_SIZE) {
+		pr_err("key length %d exceeds max value %d\n",
+			crypt_req_32->keylen, TEGRA_CRYPTO_MAX_KEY_SIZE);
+		return -EINVAL;
+	}
+	crypt_req->op = crypt_req_32->op;
+	crypt_req->encrypt = crypt_req_32->encrypt;
+	crypt_req->skip_key = crypt_req_32->skip_key;
+	crypt_req->skip_iv = crypt_req_32->skip_iv;
+	crypt_req->skip_exit = false;
+	for (i = 0; i < crypt_req_32->keylen; i++)
+		crypt_req->key[i] = crypt_req_32->key[i];
+	crypt_req->keylen = crypt_req_32->keylen;
+	for (i = 0; i < TEGRA_CRYPTO_IV_SIZE; i++)
+		crypt_req->iv[i] = crypt_req_32->iv[i];
+	crypt_req->ivlen = crypt_req_32->ivlen;
+	crypt_req->plaintext =
+		(u8 __user *)(void *)(__u64)(crypt_req_32->plaintext);
+	crypt_req->plaintext_sz = crypt_req_32->plaintext_sz;
+	crypt_req->result =
+		(u8 __user *)(void *)(__u64)(crypt_req_32->result);
+
+	return 0;
+}
+#endif
+
+static int tegra_crypt_batch_get_req(void __user *reqs, unsigned int i,
+				     bool compat,
+				     struct tegra_crypt_req *crypt_req)
+{
+#ifdef CONFIG_COMPAT
+	struct tegra_crypt_req_32 crypt_req_32;
+
+	if (compat) {
+		if (copy_from_user(&crypt_req_32,
+				(struct tegra_crypt_req_32 __user *)reqs + i,
+				sizeof(crypt_req_32)))
+			return -EFAULT;
+
+		return tegra_crypt_req_from_32(crypt_req, &crypt_req_32);
+	}
+#endif
+	if (copy_from_user(crypt_req, (struct tegra_crypt_req __user *)reqs + i,
+			sizeof(*crypt_req)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int process_crypt_batch_req(struct file *filp,
+				struct tegra_crypto_ctx *ctx,
+				void __user *reqs, int __user *statuses,
+				unsigned int nreqs, bool compat)
+{
+	struct tegra_crypt_req crypt_req;
+	struct crypto_skcipher *tfm;
+	struct skcipher_request *req[TEGRA_CRYPTO_MAX] = { NULL };
+	unsigned long *xbuf[NBUFS];
+	unsigned int i, op;
+	int ret, status;
+
+	if (!nreqs || nreqs > TEGRA_CRYPTO_MAX_BATCH_REQS) {
+		pr_err("%s: invalid number of requests %u\n", __func__,
+			nreqs);
+		return -EINVAL;
+	}
+
+	/* Bounce buffers are shared by every request in the batch */
+	ret = alloc_bufs(xbuf);
+	if (ret < 0) {
+		pr_err("alloc_bufs failed");
+		return ret;
+	}
+
+	for (i = 0; i < nreqs; i++) {
+		status = tegra_crypt_batch_get_req(reqs, i, compat, &crypt_req);
+		if (status == -EFAULT) {
+			ret = -EFAULT;
+			break;
+		}
+		if (status)
+			goto put_status;
+
+		if (crypt_req.op >= TEGRA_CRYPTO_MAX) {
+			status = -EINVAL;
+			goto put_status;
+		}
+		op = array_index_nospec(crypt_req.op, TEGRA_CRYPTO_MAX);
+
+		if (op == TEGRA_CRYPTO_CBC)
+			ctx->skip_exit = crypt_req.skip_exit;
+
+		tfm = tegra_crypt_batch_get_tfm(ctx, op);
+		if (IS_ERR(tfm)) {
+			status = PTR_ERR(tfm);
+			goto put_status;
+		}
+
+		if (!req[op]) {
+			req[op] = skcipher_request_alloc(tfm, GFP_KERNEL);
+			if (!req[op]) {
+				pr_err("%s: Failed to allocate request\n",
+					__func__);
+				status = -ENOMEM;
+				goto put_status;
+			}
+		}
+
+		status = tegra_crypt_do_req(ctx, tfm, req[op], xbuf,
+					    &crypt_req);
+put_status:
+		if (put_user(status, &statuses[i])) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	for (op = 0; op < TEGRA_CRYPTO_MAX; op++)
+		skcipher_request_free(req[op]);
+	free_bufs(xbuf);
+	filp->private_data = ctx;
+
+	return ret;
+}
+
 static int wait_async_op(struct tegra_crypto_completion *tr, int ret)
 {
 	if (ret == -EINPROGRESS || ret == -EBUSY) {
@@ -1452,6 +1624,7 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 	struct tegra_se_pka1_ecc_request pka1_ecc_req;
 	struct tegra_pka1_eddsa_request pka1_eddsa_req;
 	struct tegra_crypt_req crypt_req;
+	struct tegra_crypt_batch_req crypt_batch_req;
 	struct tegra_rng_req rng_req;
 	struct tegra_sha_req sha_req;
 	struct tegra_sha_req_shash sha_req_shash;
@@ -1459,6 +1632,7 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 	struct tegra_rsa_req_ahash rsa_req_ah;
 #ifdef CONFIG_COMPAT
 	struct tegra_crypt_req_32 crypt_req_32;
+	struct tegra_crypt_batch_req_32 crypt_batch_req_32;
 	struct tegra_rng_req_32 rng_req_32;
 	struct tegra_sha_req_32 sha_req_32;
 	int i = 0;
@@ -1479,29 +1653,24 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 			pr_err("%s: copy_from_user fail(%d)\n", __func__, ret);
 			return -EFAULT;
 		}
-		if (crypt_req_32.keylen > TEGRA_CRYPTO_MAX_KEY_SIZE) {
-			pr_err("key length %d exceeds max value %d\n",
-				crypt_req_32.keylen, TEGRA_CRYPTO_MAX_KEY_SIZE);
-			return -EINVAL;
-		}
-		crypt_req.op = crypt_req_32.op;
-		crypt_req.encrypt = crypt_req_32.encrypt;
-		crypt_req.skip_key = crypt_req_32.skip_key;
-		crypt_req.skip_iv = crypt_req_32.skip_iv;
-		for (i = 0; i < crypt_req_32.keylen; i++)
-			crypt_req.key[i] = crypt_req_32.key[i];
-		crypt_req.keylen = crypt_req_32.keylen;
-		for (i = 0; i < TEGRA_CRYPTO_IV_SIZE; i++)
-			crypt_req.iv[i] = crypt_req_32.iv[i];
-		crypt_req.ivlen = crypt_req_32.ivlen;
-		crypt_req.plaintext =
-			(u8 __user *)(void *)(__u64)(crypt_req_32.plaintext);
-		crypt_req.plaintext_sz = crypt_req_32.plaintext_sz;
-		crypt_req.result =
-			(u8 __user *)(void *)(__u64)(crypt_req_32.result);
+		ret = tegra_crypt_req_from_32(&crypt_req, &crypt_req_32);
+		if (ret)
+			return ret;
 
 		ret = process_crypt_req(filp, ctx, &crypt_req);
 		break;
+
+	case TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ_32:
+		if (copy_from_user(&crypt_batch_req_32, (void __user *)arg,
+			sizeof(crypt_batch_req_32))) {
+			pr_err("%s: copy_from_user fail\n", __func__);
+			return -EFAULT;
+		}
+		ret = process_crypt_batch_req(filp, ctx,
+			(void __user *)(void *)(__u64)crypt_batch_req_32.reqs,
+			(int __user *)(void *)(__u64)crypt_batch_req_32.status,
+			crypt_batch_req_32.nreqs, true);
+		break;
 #endif
 	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ:
 		ret = copy_from_user(&crypt_req, (void __user *)arg,
@@ -1513,6 +1682,18 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ret = process_crypt_req(filp, ctx, &crypt_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ:
+		if (copy_from_user(&crypt_batch_req, (void __user *)arg,
+			sizeof(crypt_batch_req))) {
+			pr_err("%s: copy_from_user fail\n", __func__);
+			return -EFAULT;
+		}
+		ret = process_crypt_batch_req(filp, ctx,
+			(void __user *)crypt_batch_req.reqs,
+			(int __user *)crypt_batch_req.status,
+			crypt_batch_req.nreqs, false);
+		break;
+
 #ifdef CONFIG_COMPAT
 	case TEGRA_CRYPTO_IOCTL_SET_SEED_32:
 		if (copy_from_user(&rng_req_32, (void __user *)arg,
@@ -46,6 +46,7 @@
 #include <linux/completion.h>
 #include <linux/interrupt.h>
 #include <linux/kthread.h>
+#include <linux/wait.h>
 
 #define TEGRA_HV_VSE_SHA_MAX_LL_NUM 26
 #define TEGRA_HV_VSE_SHA_MAX_LL_NUM_1 24
@@ -121,7 +122,10 @@ struct tegra_virtual_se_dev {
 	struct mutex mtx;
 	int req_cnt;
 	struct ablkcipher_request *reqs[TEGRA_HV_VSE_MAX_TASKS_PER_SUBMIT];
+	/* Number of commands in flight with the SE server */
 	atomic_t ivc_count;
+	/* Woken whenever an in-flight command completes */
+	wait_queue_head_t ivc_wq;
 	int gather_buf_sz;
 	/* Engine id */
 	unsigned int engine_id;
@@ -551,6 +555,31 @@ static int tegra_hv_vse_send_ivc(
 	return 0;
 }
 
+/*
+ * Reserve one of the TEGRA_HV_VSE_NUM_SERVER_REQ command slots the SE
+ * server provides per engine. Responses are matched to their requests by
+ * the tag in the IVC header, so callers only need a slot, not exclusive
+ * use of the engine, to have a command outstanding.
+ */
+static int tegra_hv_vse_get_ivc_slot(struct tegra_virtual_se_dev *se_dev)
+{
+	if (!wait_event_timeout(se_dev->ivc_wq,
+			atomic_add_unless(&se_dev->ivc_count, 1,
+				TEGRA_HV_VSE_NUM_SERVER_REQ),
+			TEGRA_HV_VSE_TIMEOUT)) {
+		dev_err(se_dev->dev, "%s timeout\n", __func__);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static void tegra_hv_vse_put_ivc_slot(struct tegra_virtual_se_dev *se_dev)
+{
+	atomic_dec(&se_dev->ivc_count);
+	wake_up(&se_dev->ivc_wq);
+}
+
 static int tegra_hv_vse_prepare_ivc_linked_list(
 	struct tegra_virtual_se_dev *se_dev, struct scatterlist *sg,
 	u32 total_len, int max_ll_len, int block_size,
@@ -711,7 +740,14 @@ static int tegra_hv_vse_send_sha_data(struct tegra_virtual_se_dev *se_dev,
 	vse_thread_start = true;
 	init_completion(&priv->alg_complete);
 
-	mutex_lock(&se_dev->server_lock);
+	/*
+	 * Only this request waits for the response; SHA commands from other
+	 * requests can be issued while it is outstanding.
+	 */
+	err = tegra_hv_vse_get_ivc_slot(se_dev);
+	if (err)
+		goto free;
+
 	/* Return error if engine is in suspended state */
 	if (atomic_read(&se_dev->se_suspended)) {
 		err = -ENODEV;
@@ -730,7 +766,8 @@ static int tegra_hv_vse_send_sha_data(struct tegra_virtual_se_dev *se_dev,
 		err = -ETIMEDOUT;
 	}
 exit:
-	mutex_unlock(&se_dev->server_lock);
+	tegra_hv_vse_put_ivc_slot(se_dev);
+free:
 	devm_kfree(se_dev->dev, priv);
 
 	return err;
@@ -2025,17 +2062,17 @@ static void tegra_hv_vse_process_new_req(struct tegra_virtual_se_dev *se_dev)
 	for (i = 0; i < se_dev->req_cnt; i++)
 		priv->reqs[i] = se_dev->reqs[i];
 
-	while (atomic_read(&se_dev->ivc_count) >=
-			TEGRA_HV_VSE_NUM_SERVER_REQ)
-		usleep_range(8, 10);
+	wait_event(se_dev->ivc_wq,
+		atomic_add_unless(&se_dev->ivc_count, 1,
+			TEGRA_HV_VSE_NUM_SERVER_REQ));
 
-	atomic_add(1, &se_dev->ivc_count);
 	vse_thread_start = true;
 	err = tegra_hv_vse_send_ivc(se_dev, pivck, ivc_req_msg,
 			sizeof(struct tegra_virtual_se_ivc_msg_t));
 	if (err) {
 		dev_err(se_dev->dev,
 			"\n %s send ivc failed %d\n", __func__, err);
+		tegra_hv_vse_put_ivc_slot(se_dev);
 		goto exit;
 	}
 	goto exit_return;
@@ -3667,7 +3704,7 @@ static int tegra_vse_kthread(void *unused)
 				priv->rx_status =
 					(s8)ivc_resp_msg->d[0].rx.status;
 				priv->call_back_vse(priv);
-				atomic_sub(1, &se_dev->ivc_count);
+				tegra_hv_vse_put_ivc_slot(se_dev);
 				devm_kfree(se_dev->dev, priv);
 				break;
 			case VIRTUAL_SE_KEY_SLOT:
@@ -3775,6 +3812,8 @@ static int tegra_hv_vse_probe(struct platform_device *pdev)
 	se_dev->engine_id = engine_id;
 	mutex_init(&se_dev->mtx);
 	mutex_init(&se_dev->server_lock);
+	init_waitqueue_head(&se_dev->ivc_wq);
+	atomic_set(&se_dev->ivc_count, 0);
 	platform_set_drvdata(pdev, se_dev);
 
 	/* Set Engine suspended state to false*/
@@ -3817,7 +3856,6 @@ static int tegra_hv_vse_probe(struct platform_device *pdev)
 				"cmac alg register failed. Err %d\n", err);
 			goto exit;
 		}
-		atomic_set(&se_dev->ivc_count, 0);
 	}
 
 	if (engine_id == VIRTUAL_SE_SHA) {
@@ -3865,14 +3903,13 @@ static void tegra_hv_vse_shutdown(struct platform_device *pdev)
 	/* Set engine to suspend state */
 	atomic_set(&se_dev->se_suspended, 1);
 
-	if (se_dev->engine_id == VIRTUAL_SE_AES1) {
-		/* Make sure to complete pending async requests */
+	/* Make sure to complete pending async requests */
+	if (se_dev->engine_id == VIRTUAL_SE_AES1)
 		flush_workqueue(se_dev->vse_work_q);
 
-		/* Make sure that there are no pending tasks with SE server */
-		while (atomic_read(&se_dev->ivc_count) != 0)
-			usleep_range(8, 10);
-	}
+	/* Make sure that there are no pending tasks with SE server */
+	while (atomic_read(&se_dev->ivc_count) != 0)
+		usleep_range(8, 10);
 
 	/* Wait for  SE server to be free*/
 	while (mutex_is_locked(&se_dev->server_lock))
@@ -29,6 +29,9 @@
 #include <linux/types.h>
 #include <linux/errno.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <soc/tegra/chip-id.h>
 #include <crypto/akcipher.h>
 #include <crypto/hash.h>
@@ -68,6 +71,9 @@
 
 #define ECDSA_USE_SHAMIRS_TRICK		1
 
+/* Number of Montgomery precomputation results kept per SE */
+#define PKA1_PRECOMP_CACHE_ENTRIES	8
+
 enum tegra_se_pka_mod_type {
 	MOD_MULT,
 	MOD_ADD,
@@ -126,6 +132,36 @@ static char *rng1_cmd[] = {
 	"RNG1_CMD_ZEROIZE"
 };
 
+enum tegra_se_pka1_stat_type {
+	PKA1_STAT_RSA,
+	PKA1_STAT_ECC,
+	PKA1_STAT_MOD,
+	PKA1_STAT_MAX,
+};
+
+static const char * const pka1_stat_names[] = {
+	"rsa",
+	"ecc",
+	"mod",
+};
+
+struct tegra_se_pka1_stats {
+	u64 ops[PKA1_STAT_MAX];
+	u64 busy_ns[PKA1_STAT_MAX];
+	u64 precomp_hits;
+	u64 precomp_misses;
+};
+
+/* Montgomery values (M, R2) computed by the PKA1 for one modulus */
+struct tegra_se_pka1_precomp_entry {
+	struct list_head node;
+	u32 op_mode;
+	u32 size;	/* modulus length in bytes, 0 if entry is unused */
+	u32 modulus[MAX_PKA1_SIZE / WORD_SIZE_BYTES];
+	u32 m[MAX_PKA1_SIZE / WORD_SIZE_BYTES];
+	u32 r2[MAX_PKA1_SIZE / WORD_SIZE_BYTES];
+};
+
 struct tegra_se_elp_chipdata {
 	bool use_key_slot;
 	bool rng1_supported;
@@ -144,6 +180,10 @@ struct tegra_se_elp_dev {
 	u32 *rdata;
 	/* Mutex lock to protect HW */
 	struct mutex hw_lock;
+	/* LRU list of precomp entries, protected by hw_lock */
+	struct list_head precomp_cache;
+	struct tegra_se_pka1_stats stats;
+	struct dentry *debugfs_root;
 };
 
 static struct tegra_se_elp_dev *elp_dev;
@@ -1966,11 +2006,109 @@ static int tegra_se_pka1_get_precomp(struct tegra_se_pka1_rsa_context *ctx,
 	return ret;
 }
 
+static int tegra_se_pka1_init_precomp_cache(struct tegra_se_elp_dev *se_dev)
+{
+	struct tegra_se_pka1_precomp_entry *entries;
+	int i;
+
+	INIT_LIST_HEAD(&se_dev->precomp_cache);
+
+	entries = devm_kcalloc(se_dev->dev, PKA1_PRECOMP_CACHE_ENTRIES,
+			       sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < PKA1_PRECOMP_CACHE_ENTRIES; i++)
+		list_add_tail(&entries[i].node, &se_dev->precomp_cache);
+
+	return 0;
+}
+
+/*
+ * M and R2 only depend on the modulus, and when key slots are in use they
+ * are loaded from memory rather than taken from the PKA1 banks. Look them
+ * up in a small LRU cache so that repeated operations on the same curve or
+ * RSA key skip the three precomputation runs. Must be called with hw_lock
+ * and the PKA1 mutex held.
+ */
+static int tegra_se_pka1_cached_precomp(struct tegra_se_pka1_rsa_context *ctx,
+				struct tegra_se_pka1_ecc_request *ecc_req)
+{
+	struct tegra_se_pka1_precomp_entry *entry;
+	struct tegra_se_elp_dev *se_dev;
+	u32 op_mode, size, type = ECC_INVALID;
+	u32 *MOD, *M, *R2;
+	int ret;
+
+	if (ctx) {
+		se_dev = ctx->se_dev;
+		op_mode = ctx->op_mode;
+		size = ctx->modlen;
+		MOD = ctx->modulus;
+		M = ctx->m;
+		R2 = ctx->r2;
+	} else {
+		se_dev = ecc_req->se_dev;
+		op_mode = ecc_req->op_mode;
+		size = ecc_req->size;
+		type = ecc_req->type;
+		MOD = ecc_req->modulus;
+		M = ecc_req->m;
+		R2 = ecc_req->r2;
+	}
+
+	if (!se_dev->chipdata->use_key_slot ||
+	    op_mode == SE_ELP_OP_MODE_ECC521 || type == C25519_POINT_MUL ||
+	    type == ED25519_POINT_MUL || type == ED25519_SHAMIR_TRICK ||
+	    !size || size > MAX_PKA1_SIZE)
+		return tegra_se_pka1_get_precomp(ctx, ecc_req, NULL);
+
+	list_for_each_entry(entry, &se_dev->precomp_cache, node) {
+		if (entry->op_mode != op_mode || entry->size != size ||
+		    memcmp(entry->modulus, MOD, size))
+			continue;
+
+		memcpy(M, entry->m, size);
+		memcpy(R2, entry->r2, size);
+		list_move(&entry->node, &se_dev->precomp_cache);
+		se_dev->stats.precomp_hits++;
+
+		return 0;
+	}
+
+	ret = tegra_se_pka1_get_precomp(ctx, ecc_req, NULL);
+	if (ret)
+		return ret;
+
+	se_dev->stats.precomp_misses++;
+
+	/* Recycle the least recently used entry */
+	entry = list_last_entry(&se_dev->precomp_cache,
+				struct tegra_se_pka1_precomp_entry, node);
+	entry->op_mode = op_mode;
+	entry->size = size;
+	memcpy(entry->modulus, MOD, size);
+	memcpy(entry->m, M, size);
+	memcpy(entry->r2, R2, size);
+	list_move(&entry->node, &se_dev->precomp_cache);
+
+	return 0;
+}
+
+static void tegra_se_pka1_account(struct tegra_se_elp_dev *se_dev,
+				  enum tegra_se_pka1_stat_type type,
+				  u64 start_ns)
+{
+	se_dev->stats.ops[type]++;
+	se_dev->stats.busy_ns[type] += ktime_get_ns() - start_ns;
+}
+
 static int tegra_se_pka1_rsa_op(struct akcipher_request *req)
 {
 	struct crypto_akcipher *tfm;
 	struct tegra_se_pka1_rsa_context *ctx;
 	struct tegra_se_elp_dev *se_dev = elp_dev;
+	u64 start_ns = ktime_get_ns();
 	int ret;
 	u32 i, nwords, cnt;
 	u32 *MSG;
@@ -2039,6 +2177,8 @@ static int tegra_se_pka1_rsa_op(struct akcipher_request *req)
 		dev_err(ctx->se_dev->dev, "sg_copy_from_buffer fail\n");
 		ret = -ERANGE;
 	}
+
+	tegra_se_pka1_account(se_dev, PKA1_STAT_RSA, start_ns);
 exit:
 	clk_disable_unprepare(se_dev->c);
 
@@ -2048,6 +2188,7 @@ exit:
 int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req)
 {
 	struct tegra_se_elp_dev *se_dev;
+	u64 start_ns;
 	int ret;
 
 	if (!req) {
@@ -2066,6 +2207,7 @@ int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req)
 
 	se_dev = req->se_dev;
 	mutex_lock(&se_dev->hw_lock);
+	start_ns = ktime_get_ns();
 	ret = clk_prepare_enable(se_dev->c);
 	if (ret) {
 		dev_err(se_dev->dev, "clk_enable failed\n");
@@ -2078,11 +2220,13 @@ int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req)
 		goto clk_dis;
 	}
 
-	ret = tegra_se_pka1_get_precomp(NULL, req, NULL);
+	ret = tegra_se_pka1_cached_precomp(NULL, req);
 	if (ret)
 		goto exit;
 
 	ret = tegra_se_pka1_ecc_do(req);
+	if (!ret)
+		tegra_se_pka1_account(se_dev, PKA1_STAT_ECC, start_ns);
 exit:
 	tegra_se_release_pka1_mutex(se_dev);
 clk_dis:
@@ -2098,6 +2242,7 @@ EXPORT_SYMBOL(tegra_se_pka1_ecc_op);
 static int tegra_se_pka1_mod_op(struct tegra_se_pka1_mod_request *req)
 {
 	struct tegra_se_elp_dev *se_dev;
+	u64 start_ns;
 	int ret;
 
 	if (!req) {
@@ -2111,6 +2256,7 @@ static int tegra_se_pka1_mod_op(struct tegra_se_pka1_mod_request *req)
 
 	se_dev = req->se_dev;
 	mutex_lock(&se_dev->hw_lock);
+	start_ns = ktime_get_ns();
 	ret = clk_prepare_enable(se_dev->c);
 	if (ret) {
 		dev_err(se_dev->dev, "clk_enable failed\n");
@@ -2128,6 +2274,8 @@ static int tegra_se_pka1_mod_op(struct tegra_se_pka1_mod_request *req)
 		goto exit;
 
 	ret = tegra_se_pka1_mod_do(req);
+	if (!ret)
+		tegra_se_pka1_account(se_dev, PKA1_STAT_MOD, start_ns);
 exit:
 	tegra_se_release_pka1_mutex(se_dev);
 clk_dis:
@@ -3602,7 +3750,7 @@ static int tegra_se_pka1_rsa_setkey(struct crypto_akcipher *tfm,
 		goto rel_mutex;
 	}
 
-	ret = tegra_se_pka1_get_precomp(ctx, NULL, NULL);
+	ret = tegra_se_pka1_cached_precomp(ctx, NULL);
 	if (ret)
 		goto rel_mutex;
 
@@ -4437,6 +4585,62 @@ static struct akcipher_alg ecdsa_alg = {
 	},
 };
 
+static int tegra_se_pka1_stats_show(struct seq_file *s, void *data)
+{
+	struct tegra_se_elp_dev *se_dev = s->private;
+	struct tegra_se_pka1_stats stats;
+	u64 rate;
+	int i;
+
+	/*
+	 * An RSA tfm keeps hw_lock from setkey until exit, so take an
+	 * unlocked snapshot rather than blocking the reader on it.
+	 */
+	stats = se_dev->stats;
+
+	seq_printf(s, "%-6s %12s %14s %10s\n", "algo", "ops", "busy_ns",
+		   "ops/s");
+	for (i = 0; i < PKA1_STAT_MAX; i++) {
+		rate = stats.busy_ns[i] ?
+			div64_u64(stats.ops[i] * NSEC_PER_SEC,
+				  stats.busy_ns[i]) : 0;
+		seq_printf(s, "%-6s %12llu %14llu %10llu\n",
+			   pka1_stat_names[i], stats.ops[i],
+			   stats.busy_ns[i], rate);
+	}
+	seq_printf(s, "precomp cache hits %llu misses %llu\n",
+		   stats.precomp_hits, stats.precomp_misses);
+
+	return 0;
+}
+
+static int tegra_se_pka1_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_pka1_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_pka1_stats_fops = {
+	.open = tegra_se_pka1_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void tegra_se_elp_debugfs_init(struct tegra_se_elp_dev *se_dev)
+{
+	se_dev->debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+	if (IS_ERR_OR_NULL(se_dev->debugfs_root)) {
+		se_dev->debugfs_root = NULL;
+		return;
+	}
+
+	if (!debugfs_create_file("pka1_stats", 0444, se_dev->debugfs_root,
+				 se_dev, &tegra_se_pka1_stats_fops)) {
+		debugfs_remove_recursive(se_dev->debugfs_root);
+		se_dev->debugfs_root = NULL;
+	}
+}
+
 static struct tegra_se_elp_chipdata tegra18_se_chipdata = {
 	.use_key_slot = true,
 	.rng1_supported = true,
@@ -4525,6 +4729,12 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 
 	elp_dev = se_dev;
 
+	err = tegra_se_pka1_init_precomp_cache(se_dev);
+	if (err) {
+		dev_err(se_dev->dev, "precomp cache init failed\n");
+		goto clk_dis;
+	}
+
 	err = tegra_se_pka1_init_key_slot(se_dev);
 	if (err) {
 		dev_err(se_dev->dev, "tegra_se_pka_init_key_slot failed\n");
@@ -4592,6 +4802,8 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 
 	clk_disable_unprepare(se_dev->c);
 
+	tegra_se_elp_debugfs_init(se_dev);
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 	return 0;
 
@@ -4623,6 +4835,7 @@ static int tegra_se_elp_remove(struct platform_device *pdev)
 	crypto_unregister_akcipher(&eddsa_alg);
 	crypto_unregister_akcipher(&pka1_rsa_algs[0]);
 	crypto_unregister_kpp(&ecdh_algs[0]);
+	debugfs_remove_recursive(se_dev->debugfs_root);
 	mutex_destroy(&se_dev->hw_lock);
 
 	return 0;
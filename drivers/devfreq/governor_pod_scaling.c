@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/clk/tegra.h>
 #include <linux/module.h>
+#include <linux/nvhost.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/nvhost_podgov.h>
@@ -74,6 +75,10 @@ struct podgov_info_rec {
 	int			p_bias;
 	unsigned int		p_user;
 	unsigned int		p_freq_request;
+	unsigned int		p_queue_depth;
+	unsigned int		p_queue_words;
+	u32			queue_boosts;
+	struct nvhost_queue_hint *queue_hint;
 
 	unsigned long		cycles_norm;
 	unsigned long		cycles_avg;
@@ -368,6 +373,49 @@ static int freqlist_up(struct podgov_info_rec *podgov, unsigned long target,
 	return podgov->freqlist[pos];
 }
 
+/*******************************************************************************
+ * queue_boost(df, ds, freq)
+ *
+ * Raise the estimated frequency when the device reports more pending work
+ * than p_queue_depth. Each job (or p_queue_words gather words) above the
+ * threshold moves the frequency one step up from the current one. Busy time
+ * only catches up with a burst after it has been running for a while; the
+ * queue shows it as soon as it is submitted.
+ ******************************************************************************/
+
+static unsigned long queue_boost(struct devfreq *df,
+				 struct devfreq_dev_status *ds,
+				 unsigned long freq)
+{
+	struct podgov_info_rec *pg = df->data;
+	struct nvhost_queue_hint *hint = pg->queue_hint;
+	unsigned long target;
+	int jobs, words, depth;
+
+	if (!hint || !pg->p_queue_depth)
+		return freq;
+
+	jobs = atomic_read(&hint->jobs);
+	words = atomic_read(&hint->words);
+	depth = jobs;
+	if (pg->p_queue_words)
+		depth += words / pg->p_queue_words;
+
+	if (depth <= pg->p_queue_depth)
+		return freq;
+
+	target = freqlist_up(pg, ds->current_frequency,
+			     depth - pg->p_queue_depth);
+	scaling_limit(df, &target);
+	if (target <= freq)
+		return freq;
+
+	pg->queue_boosts++;
+	trace_podgov_queue_boost(df->dev.parent, jobs, words, freq, target);
+
+	return target;
+}
+
 /*******************************************************************************
  * debugfs interface for controlling 3d clock scaling on the fly
  ******************************************************************************/
@@ -412,7 +460,14 @@ static void nvhost_scale_emc_debug_init(struct devfreq *df)
 	CREATE_PODGOV_FILE(bias);
 	CREATE_PODGOV_FILE(damp);
 	CREATE_PODGOV_FILE(smooth);
+	CREATE_PODGOV_FILE(queue_depth);
+	CREATE_PODGOV_FILE(queue_words);
 #undef CREATE_PODGOV_FILE
+
+	f = debugfs_create_u32("queue_boosts", S_IRUGO, podgov->debugdir,
+			       &podgov->queue_boosts);
+	if (!f)
+		pr_err("podgov: can\'t create file queue_boosts\n");
 }
 
 static void nvhost_scale_emc_debug_deinit(struct devfreq *df)
@@ -597,7 +652,7 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	ds = &df->last_status;
 
 	if (ds->total_time == 0) {
-		*freq = ds->current_frequency;
+		*freq = queue_boost(df, ds, ds->current_frequency);
 		return 0;
 	}
 
@@ -649,11 +704,15 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	*freq = scaling_state_check(df, now);
 
 	if (!(*freq)) {
-		*freq = ds->current_frequency;
+		/* still inside the block window; only queued work can move us */
+		*freq = queue_boost(df, ds, ds->current_frequency);
+		if (*freq != ds->current_frequency)
+			pg->last_scale = now;
 		return 0;
 	}
 
-	if ((*freq = freqlist_up(pg, *freq, 0)) == ds->current_frequency)
+	*freq = queue_boost(df, ds, freqlist_up(pg, *freq, 0));
+	if (*freq == ds->current_frequency)
 		return 0;
 
 	pg->last_scale = now;
@@ -664,6 +723,76 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	return 0;
 }
 
+/*******************************************************************************
+ * Queue hints
+ *
+ * nvhost scaling registers the queue hint of each device it scales before
+ * adding the devfreq device, and removes it after removing it. The
+ * governor looks the hint up by device when it starts, so it never has to
+ * guess what devfreq_dev_status.private_data points at.
+ ******************************************************************************/
+
+struct podgov_queue_hint {
+	struct list_head	node;
+	struct device		*dev;
+	struct nvhost_queue_hint *hint;
+};
+
+static LIST_HEAD(podgov_queue_hints);
+static DEFINE_MUTEX(podgov_queue_hints_lock);
+
+int nvhost_podgov_add_queue_hint(struct device *dev,
+				 struct nvhost_queue_hint *hint)
+{
+	struct podgov_queue_hint *qh;
+
+	qh = kzalloc(sizeof(*qh), GFP_KERNEL);
+	if (!qh)
+		return -ENOMEM;
+
+	qh->dev = dev;
+	qh->hint = hint;
+
+	mutex_lock(&podgov_queue_hints_lock);
+	list_add(&qh->node, &podgov_queue_hints);
+	mutex_unlock(&podgov_queue_hints_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(nvhost_podgov_add_queue_hint);
+
+void nvhost_podgov_remove_queue_hint(struct device *dev)
+{
+	struct podgov_queue_hint *qh, *tmp;
+
+	mutex_lock(&podgov_queue_hints_lock);
+	list_for_each_entry_safe(qh, tmp, &podgov_queue_hints, node) {
+		if (qh->dev != dev)
+			continue;
+		list_del(&qh->node);
+		kfree(qh);
+	}
+	mutex_unlock(&podgov_queue_hints_lock);
+}
+EXPORT_SYMBOL(nvhost_podgov_remove_queue_hint);
+
+static struct nvhost_queue_hint *podgov_find_queue_hint(struct device *dev)
+{
+	struct podgov_queue_hint *qh;
+	struct nvhost_queue_hint *hint = NULL;
+
+	mutex_lock(&podgov_queue_hints_lock);
+	list_for_each_entry(qh, &podgov_queue_hints, node) {
+		if (qh->dev == dev) {
+			hint = qh->hint;
+			break;
+		}
+	}
+	mutex_unlock(&podgov_queue_hints_lock);
+
+	return hint;
+}
+
 /*******************************************************************************
  * nvhost_pod_init(struct devfreq *df)
  *
@@ -706,6 +835,9 @@ static int nvhost_pod_init(struct devfreq *df)
 	podgov->p_smooth = 10;
 	podgov->p_damp = 7;
 	podgov->p_block_window = 50000;
+	podgov->p_queue_depth = 2;
+	podgov->p_queue_words = 4096;
+	podgov->queue_hint = podgov_find_queue_hint(df->dev.parent);
 
 	podgov->adjustment_type = ADJUSTMENT_DEVICE_REQ;
 	podgov->p_user = 0;
@@ -383,6 +383,7 @@ static void deskew_setup(struct tegra_csi_channel *chan,
 		deskew_ctx->deskew_lanes = 0;
 		for (i = 0; i < csi_lanes; ++i)
 			deskew_ctx->deskew_lanes |= csi_lane_start << i;
+		deskew_ctx->deskew_rate = pix_clk_hz;
 		nvcsi_deskew_setup(deskew_ctx);
 	}
 
@@ -413,6 +414,9 @@ static int tegra_csi_s_stream(struct v4l2_subdev *subdev, int enable)
 		atomic_set(&chan->is_streaming, enable);
 		return 0;
 	}
+	/* a background recalibration must not outlive the stream */
+	if (!enable)
+		nvcsi_deskew_cancel(tegra_chan->deskew_ctx);
 	for (i = 0; i < tegra_chan->valid_ports; i++) {
 		if (enable) {
 				ret = tegra_csi_start_streaming(chan, i);
@@ -428,6 +432,7 @@ static int tegra_csi_s_stream(struct v4l2_subdev *subdev, int enable)
 	return ret;
 start_fail:
 	update_video_source(csi, 0, chan->pg_mode);
+	nvcsi_deskew_cancel(tegra_chan->deskew_ctx);
 	/* Reverse sequence to stop streaming on all valid_ports
 	 * i is the current failing port, need to stop ports 0 ~ (i-1)
 	 */
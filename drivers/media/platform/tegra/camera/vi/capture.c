@@ -112,6 +112,9 @@ static void vi_capture_ivc_status_callback(const void *ivc_resp,
 					buffer_index,
 					capture->progress_status_buffer_depth,
 					PROGRESS_STATUS_DONE);
+		} else if (capture->status_cb != NULL) {
+			capture->status_cb(capture->status_cb_priv,
+					buffer_index);
 		} else {
 			/*
 			 * Only fire completions if not using
@@ -1037,6 +1040,28 @@ int vi_capture_status(struct tegra_vi_channel *chan,
 	return 0;
 }
 
+int vi_capture_set_status_callback(struct tegra_vi_channel *chan,
+		vi_capture_status_cb status_cb, void *priv)
+{
+	struct vi_capture *capture = chan->capture_data;
+
+	if (capture == NULL) {
+		dev_err(chan->dev,
+			"%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	/*
+	 * Status indications are delivered to the callback instead of
+	 * completing capture_resp, so vi_capture_status() must not be
+	 * used on this channel afterwards.
+	 */
+	capture->status_cb_priv = priv;
+	capture->status_cb = status_cb;
+
+	return 0;
+}
+
 int vi_capture_set_progress_status_notifier(struct tegra_vi_channel *chan,
 		struct vi_capture_progress_status_req *req)
 {
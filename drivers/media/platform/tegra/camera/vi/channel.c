@@ -773,6 +773,10 @@ static void tegra_channel_buffer_queue(struct vb2_buffer *vb)
 
 	/* Wake up kthread for capture */
 	wake_up_interruptible(&chan->start_wait);
+
+	/* Let chips without a capture kthread submit the buffer directly */
+	if (chan->vi->fops->vi_buffer_queued)
+		chan->vi->fops->vi_buffer_queued(chan);
 }
 
 
@@ -2322,6 +2326,7 @@ int tegra_channel_init(struct tegra_channel *chan)
 	init_waitqueue_head(&chan->dequeue_wait);
 	spin_lock_init(&chan->dequeue_lock);
 	mutex_init(&chan->stop_kthread_lock);
+	mutex_init(&chan->capture_submit_lock);
 	atomic_set(&chan->is_streaming, DISABLE);
 	spin_lock_init(&chan->capture_state_lock);
 	spin_lock_init(&chan->buffer_lock);
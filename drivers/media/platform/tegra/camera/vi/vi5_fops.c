@@ -10,11 +10,12 @@
  * published by the Free Software Foundation.
  */
 
-#include <linux/freezer.h>
-#include <linux/kthread.h>
+#include <linux/math64.h>
 #include <linux/nvhost.h>
 #include <linux/tegra-powergate.h>
 #include <linux/semaphore.h>
+#include <linux/workqueue.h>
+#include <asm/arch_timer.h>
 #include <media/tegra_camera_platform.h>
 #include <media/mc_common.h>
 #include <media/tegra-v4l2-camera.h>
@@ -89,15 +90,43 @@ static void vi5_init_video_formats(struct tegra_channel *chan)
 		chan->video_formats[i] = &vi5_video_formats[i];
 }
 
+static void vi5_get_capture_latency(struct tegra_channel *chan, u32 *val)
+{
+	struct tegra_channel_latency lat;
+
+	mutex_lock(&chan->capture_submit_lock);
+	lat = chan->capture_latency;
+	mutex_unlock(&chan->capture_submit_lock);
+
+	val[VI_CAPTURE_LATENCY_FRAMES] = (u32)lat.frames;
+	val[VI_CAPTURE_LATENCY_LAST_US] =
+		(u32)div_u64(lat.last_ns, NSEC_PER_USEC);
+	val[VI_CAPTURE_LATENCY_MIN_US] =
+		(u32)div_u64(lat.min_ns, NSEC_PER_USEC);
+	val[VI_CAPTURE_LATENCY_MAX_US] =
+		(u32)div_u64(lat.max_ns, NSEC_PER_USEC);
+	val[VI_CAPTURE_LATENCY_AVG_US] = (lat.frames == 0) ? 0 :
+		(u32)div64_u64(lat.total_ns, lat.frames * NSEC_PER_USEC);
+}
+
 static int tegra_vi5_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct tegra_channel *chan = container_of(ctrl->handler,
 				struct tegra_channel, ctrl_handler);
 	struct v4l2_subdev *sd = chan->subdev_on_csi;
-	struct camera_common_data *s_data =
-				to_camera_common_data(sd->dev);
-	struct tegracam_ctrl_handler *handler = s_data->tegracam_ctrl_hdl;
-	struct tegracam_sensor_data *sensor_data = &handler->sensor_data;
+	struct camera_common_data *s_data;
+	struct tegracam_ctrl_handler *handler;
+	struct tegracam_sensor_data *sensor_data;
+
+	/* Not backed by a sensor, valid in TPG mode too */
+	if (ctrl->id == TEGRA_CAMERA_CID_VI_CAPTURE_LATENCY) {
+		vi5_get_capture_latency(chan, ctrl->p_new.p_u32);
+		return 0;
+	}
+
+	s_data = to_camera_common_data(sd->dev);
+	handler = s_data->tegracam_ctrl_hdl;
+	sensor_data = &handler->sensor_data;
 
 	/* TODO: Support reading blobs for multiple devices */
 	switch (ctrl->id) {
@@ -203,6 +232,20 @@ static const struct v4l2_ctrl_config vi5_custom_ctrls[] = {
 		.step = 1,
 		.dims = { SENSOR_CTRL_BLOB_SIZE },
 	},
+	{
+		.ops = &vi5_ctrl_ops,
+		.id = TEGRA_CAMERA_CID_VI_CAPTURE_LATENCY,
+		.name = "Capture latency",
+		.type = V4L2_CTRL_TYPE_U32,
+		.flags = V4L2_CTRL_FLAG_READ_ONLY |
+			V4L2_CTRL_FLAG_HAS_PAYLOAD |
+			V4L2_CTRL_FLAG_VOLATILE,
+		.min = 0,
+		.max = 0xFFFFFFFF,
+		.def = 0,
+		.step = 1,
+		.dims = { VI_CAPTURE_LATENCY_CID_SIZE },
+	},
 };
 
 static int vi5_add_ctrls(struct tegra_channel *chan)
@@ -357,12 +400,17 @@ static void vi5_capture_enqueue(struct tegra_channel *chan,
 	chan->capture_descr_index = ((chan->capture_descr_index + 1)
 		% chan->capture_queue_depth);
 
-	/* Move buffer into dequeue queue */
+	/*
+	 * Move buffer into dequeue queue. The status indication for this
+	 * request cannot be handled before we drop capture_submit_lock.
+	 */
 	spin_lock(&chan->dequeue_lock);
 	list_add_tail(&buf->queue, &chan->dequeue);
 	spin_unlock(&chan->dequeue_lock);
 
-	wake_up_interruptible(&chan->dequeue_wait);
+	/* Arm the watchdog unless an older request already did */
+	schedule_delayed_work(&chan->capture_timeout_work,
+		msecs_to_jiffies(CAPTURE_TIMEOUT_MS));
 
 	return;
 
@@ -370,12 +418,43 @@ uncorr_err:
 	spin_lock_irqsave(&chan->capture_state_lock, flags);
 	chan->capture_state = CAPTURE_ERROR;
 	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+
+	schedule_work(&chan->error_work);
+}
+
+static u64 vi5_tsc_now_ns(void)
+{
+	/* RCE reports SOF/EOF timestamps in TSC nanoseconds */
+	u64 tsc_res_ns = (1000000000000ULL /
+		(u64)arch_timer_get_cntfrq()) / 1000;
+
+	return arch_counter_get_cntvct() * tsc_res_ns;
+}
+
+static void vi5_capture_account_latency(struct tegra_channel *chan,
+	u64 sof_ns)
+{
+	struct tegra_channel_latency *lat = &chan->capture_latency;
+	u64 now_ns = vi5_tsc_now_ns();
+	u64 delta;
+
+	if (sof_ns == 0 || now_ns < sof_ns)
+		return;
+
+	delta = now_ns - sof_ns;
+
+	lat->last_ns = delta;
+	if (lat->frames == 0 || delta < lat->min_ns)
+		lat->min_ns = delta;
+	if (delta > lat->max_ns)
+		lat->max_ns = delta;
+	lat->total_ns += delta;
+	lat->frames += 1;
 }
 
 static void vi5_capture_dequeue(struct tegra_channel *chan,
 	struct tegra_channel_buffer *buf)
 {
-	int err = 0;
 	unsigned long flags;
 	struct tegra_mc_vi *vi = chan->vi;
 	struct vb2_v4l2_buffer *vb = &buf->buf;
@@ -386,18 +465,8 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 	if (buf->vb2_state != VB2_BUF_STATE_ACTIVE)
 		goto rel_buf;
 
-	/* Dequeue a frame and check its capture status */
-	err = vi_capture_status(chan->tegra_vi_channel, CAPTURE_TIMEOUT_MS);
-	if (err) {
-		if (err == -ETIMEDOUT) {
-			dev_err(vi->dev,
-				"uncorr_err: request timed out after %d ms\n",
-				CAPTURE_TIMEOUT_MS);
-		} else {
-			dev_err(vi->dev, "uncorr_err: request err %d\n", err);
-		}
-		goto uncorr_err;
-	} else if (descr->status.status != CAPTURE_STATUS_SUCCESS) {
+	/* Check the capture status reported for this frame */
+	if (descr->status.status != CAPTURE_STATUS_SUCCESS) {
 		if ((descr->status.flags
 				& CAPTURE_STATUS_FLAG_CHANNEL_IN_ERROR) != 0) {
 			chan->queue_error = true;
@@ -431,6 +500,8 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 	ts = ns_to_timespec((s64)descr->status.eof_timestamp);
 	trace_tegra_channel_capture_frame("eof", ts);
 
+	vi5_capture_account_latency(chan, descr->status.sof_timestamp);
+
 done:
 	spin_lock_irqsave(&chan->capture_state_lock, flags);
 	if (chan->capture_state != CAPTURE_ERROR) {
@@ -439,19 +510,164 @@ done:
 	}
 	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 
-	wake_up_interruptible(&chan->start_wait);
+rel_buf:
+	vi5_release_buffer(chan, buf);
+}
 
-	goto rel_buf;
+/*
+ * Dispatch queued buffers until the descriptor ring is full.
+ * Must be called with capture_submit_lock held.
+ */
+static void vi5_capture_submit_locked(struct tegra_channel *chan)
+{
+	struct tegra_channel_buffer *buf;
+	unsigned long flags;
+
+	while (chan->capture_submit_enabled) {
+		spin_lock_irqsave(&chan->capture_state_lock, flags);
+		if ((chan->capture_state == CAPTURE_ERROR)
+				|| !(chan->capture_reqs_enqueued
+				< chan->capture_queue_depth)) {
+			spin_unlock_irqrestore(&chan->capture_state_lock,
+				flags);
+			break;
+		}
+		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+
+		buf = dequeue_buffer(chan, false);
+		if (!buf)
+			break;
+
+		buf->vb2_state = VB2_BUF_STATE_ACTIVE;
+
+		vi5_capture_enqueue(chan, buf);
+	}
+}
+
+static void vi5_buffer_queued(struct tegra_channel *chan)
+{
+	mutex_lock(&chan->capture_submit_lock);
+	vi5_capture_submit_locked(chan);
+	mutex_unlock(&chan->capture_submit_lock);
+}
+
+/*
+ * Runs from the capture IVC worker for every CAPTURE_STATUS_IND on this
+ * channel; requests complete in submission order.
+ */
+static void vi5_capture_status_callback(void *priv, uint32_t buffer_index)
+{
+	struct tegra_channel *chan = priv;
+	struct tegra_channel_buffer *buf;
+
+	mutex_lock(&chan->capture_submit_lock);
+
+	/* Error recovery owns the dequeue list until it resets the state */
+	if (!chan->capture_submit_enabled ||
+			chan->capture_state == CAPTURE_ERROR)
+		goto done;
+
+	buf = dequeue_dequeue_buffer(chan);
+	if (!buf) {
+		dev_warn(chan->vi->dev,
+			"status for idle capture descriptor %u\n",
+			buffer_index);
+		goto done;
+	}
+
+	if (buf->capture_descr_index != buffer_index)
+		dev_warn(chan->vi->dev,
+			"status for capture descriptor %u, expected %u\n",
+			buffer_index, buf->capture_descr_index);
+
+	vi5_capture_dequeue(chan, buf);
+
+	/* Restart the watchdog for the next outstanding request */
+	if (list_empty(&chan->dequeue))
+		cancel_delayed_work(&chan->capture_timeout_work);
+	else
+		mod_delayed_work(system_wq, &chan->capture_timeout_work,
+			msecs_to_jiffies(CAPTURE_TIMEOUT_MS));
+
+	/* Reuse the freed descriptor for a buffer held back by depth */
+	vi5_capture_submit_locked(chan);
+
+done:
+	mutex_unlock(&chan->capture_submit_lock);
+}
+
+static void vi5_capture_timeout_worker(struct work_struct *work)
+{
+	struct tegra_channel *chan = container_of(to_delayed_work(work),
+		struct tegra_channel, capture_timeout_work);
+	unsigned long flags;
+
+	mutex_lock(&chan->capture_submit_lock);
+
+	if (!chan->capture_submit_enabled || list_empty(&chan->dequeue))
+		goto done;
 
-uncorr_err:
 	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	if (chan->capture_state == CAPTURE_ERROR) {
+		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+		goto done;
+	}
 	chan->capture_state = CAPTURE_ERROR;
 	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 
-	buf->vb2_state = VB2_BUF_STATE_ERROR;
+	dev_err(chan->vi->dev,
+		"uncorr_err: request timed out after %d ms\n",
+		CAPTURE_TIMEOUT_MS);
 
-rel_buf:
-	vi5_release_buffer(chan, buf);
+	schedule_work(&chan->error_work);
+
+done:
+	mutex_unlock(&chan->capture_submit_lock);
+}
+
+static void vi5_capture_error_worker(struct work_struct *work)
+{
+	struct tegra_channel *chan = container_of(work,
+		struct tegra_channel, error_work);
+	int err = 0;
+
+	mutex_lock(&chan->capture_submit_lock);
+	if (!chan->capture_submit_enabled ||
+			chan->capture_state != CAPTURE_ERROR) {
+		mutex_unlock(&chan->capture_submit_lock);
+		return;
+	}
+	mutex_unlock(&chan->capture_submit_lock);
+
+	err = tegra_channel_error_recover(chan, false);
+	if (err) {
+		dev_err(chan->vi->dev, "fatal: error recovery failed\n");
+		return;
+	}
+
+	/* Resubmit whatever userspace queued while we were resetting */
+	mutex_lock(&chan->capture_submit_lock);
+	vi5_capture_submit_locked(chan);
+	mutex_unlock(&chan->capture_submit_lock);
+}
+
+static int vi5_channel_open(struct tegra_channel *chan)
+{
+	int err = 0;
+
+	chan->tegra_vi_channel = vi_channel_open_ex(chan->id, false);
+	if (IS_ERR(chan->tegra_vi_channel))
+		return PTR_ERR(chan->tegra_vi_channel);
+
+	/* Complete buffers straight from the capture status indication */
+	err = vi_capture_set_status_callback(chan->tegra_vi_channel,
+		vi5_capture_status_callback, chan);
+	if (err) {
+		vi_channel_close_ex(chan->id, chan->tegra_vi_channel);
+		return err;
+	}
+
+	return 0;
 }
 
 static int vi5_channel_error_recover(struct tegra_channel *chan,
@@ -503,11 +719,9 @@ static int vi5_channel_error_recover(struct tegra_channel *chan,
 		V4L2_SYNC_EVENT_SUBDEV_ERROR_RECOVER);
 
 	/* restart vi channel */
-	chan->tegra_vi_channel = vi_channel_open_ex(chan->id, false);
-	if (IS_ERR(chan->tegra_vi_channel)) {
-		err = PTR_ERR(chan);
+	err = vi5_channel_open(chan);
+	if (err)
 		goto done;
-	}
 
 	err = tegra_channel_capture_setup(chan);
 	if (err < 0)
@@ -525,150 +739,30 @@ done:
 	return err;
 }
 
-static int tegra_channel_kthread_capture_enqueue(void *data)
-{
-	struct tegra_channel *chan = data;
-	struct tegra_channel_buffer *buf;
-	unsigned long flags;
-
-	set_freezable();
-
-	while (1) {
-		try_to_freeze();
-
-		wait_event_interruptible(chan->start_wait,
-			(kthread_should_stop() || !list_empty(&chan->capture)));
-
-		while (!(kthread_should_stop() || list_empty(&chan->capture))) {
-			spin_lock_irqsave(&chan->capture_state_lock, flags);
-			if ((chan->capture_state == CAPTURE_ERROR)
-					|| !(chan->capture_reqs_enqueued
-					< chan->capture_queue_depth)) {
-				spin_unlock_irqrestore(
-					&chan->capture_state_lock, flags);
-				break;
-			}
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-
-			buf = dequeue_buffer(chan, false);
-			if (!buf)
-				break;
-
-			buf->vb2_state = VB2_BUF_STATE_ACTIVE;
-
-			vi5_capture_enqueue(chan, buf);
-		}
-
-		if (kthread_should_stop())
-			break;
-	}
-
-	return 0;
-}
-
-static int tegra_channel_kthread_capture_dequeue(void *data)
-{
-	int err = 0;
-	unsigned long flags;
-	struct tegra_channel *chan = data;
-	struct tegra_channel_buffer *buf;
-
-	set_freezable();
-
-	while (1) {
-		try_to_freeze();
-
-		wait_event_interruptible(chan->dequeue_wait,
-			(kthread_should_stop()
-				|| !list_empty(&chan->dequeue)
-				|| (chan->capture_state == CAPTURE_ERROR)));
-
-		while (!(kthread_should_stop() || list_empty(&chan->dequeue)
-				|| (chan->capture_state == CAPTURE_ERROR))) {
-
-			buf = dequeue_dequeue_buffer(chan);
-			if (!buf)
-				break;
-
-			vi5_capture_dequeue(chan, buf);
-		}
-
-		spin_lock_irqsave(&chan->capture_state_lock, flags);
-		if (chan->capture_state == CAPTURE_ERROR) {
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-			err = tegra_channel_error_recover(chan, false);
-			if (err) {
-				dev_err(chan->vi->dev,
-					"fatal: error recovery failed\n");
-				break;
-			}
-		} else
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-		if (kthread_should_stop())
-			break;
-	}
-
-	return 0;
-}
-
-static int vi5_channel_start_kthreads(struct tegra_channel *chan)
+static void vi5_capture_start(struct tegra_channel *chan)
 {
-	int err = 0;
+	memset(&chan->capture_latency, 0, sizeof(chan->capture_latency));
 
-	/* Start the kthread for capture enqueue */
-	if (chan->kthread_capture_start) {
-		dev_err(chan->vi->dev, "enqueue kthread already initialized\n");
-		err = -1;
-		goto done;
-	}
-	chan->kthread_capture_start = kthread_run(
-		tegra_channel_kthread_capture_enqueue, chan, chan->video->name);
-	if (IS_ERR(chan->kthread_capture_start)) {
-		dev_err(&chan->video->dev,
-			"failed to run kthread for capture enqueue\n");
-		err = PTR_ERR(chan->kthread_capture_start);
-		goto done;
-	}
-
-	/* Start the kthread for capture dequeue */
-	if (chan->kthread_capture_dequeue) {
-		dev_err(chan->vi->dev, "dequeue kthread already initialized\n");
-		err = -1;
-		goto done;
-	}
-	chan->kthread_capture_dequeue = kthread_run(
-		tegra_channel_kthread_capture_dequeue, chan, chan->video->name);
-	if (IS_ERR(chan->kthread_capture_dequeue)) {
-		dev_err(&chan->video->dev,
-			"failed to run kthread for capture dequeue\n");
-		err = PTR_ERR(chan->kthread_capture_dequeue);
-		goto done;
-	}
+	INIT_WORK(&chan->error_work, vi5_capture_error_worker);
+	INIT_DELAYED_WORK(&chan->capture_timeout_work,
+		vi5_capture_timeout_worker);
 
-done:
-	return err;
+	/* Dispatch the buffers vb2 queued before streaming started */
+	mutex_lock(&chan->capture_submit_lock);
+	chan->capture_submit_enabled = true;
+	vi5_capture_submit_locked(chan);
+	mutex_unlock(&chan->capture_submit_lock);
 }
 
-static void vi5_channel_stop_kthreads(struct tegra_channel *chan)
+static void vi5_capture_stop(struct tegra_channel *chan)
 {
-	mutex_lock(&chan->stop_kthread_lock);
-
-	/* Stop the kthread for capture enqueue */
-	if (chan->kthread_capture_start) {
-		kthread_stop(chan->kthread_capture_start);
-		chan->kthread_capture_start = NULL;
-	}
+	mutex_lock(&chan->capture_submit_lock);
+	chan->capture_submit_enabled = false;
+	mutex_unlock(&chan->capture_submit_lock);
 
-	/* Stop the kthread for capture dequeue */
-	if (chan->kthread_capture_dequeue) {
-		kthread_stop(chan->kthread_capture_dequeue);
-		chan->kthread_capture_dequeue = NULL;
-	}
-
-	mutex_unlock(&chan->stop_kthread_lock);
+	/* Neither worker re-arms anything once submission is disabled */
+	cancel_delayed_work_sync(&chan->capture_timeout_work);
+	cancel_work_sync(&chan->error_work);
 }
 
 static int vi5_channel_start_streaming(struct vb2_queue *vq, u32 count)
@@ -695,11 +789,9 @@ static int vi5_channel_start_streaming(struct vb2_queue *vq, u32 count)
 
 	/* Skip in bypass mode */
 	if (!chan->bypass) {
-		chan->tegra_vi_channel = vi_channel_open_ex(chan->id, false);
-		if (IS_ERR(chan->tegra_vi_channel)) {
-			ret = PTR_ERR(chan);
+		ret = vi5_channel_open(chan);
+		if (ret)
 			goto err_open_ex;
-		}
 
 		spin_lock_irqsave(&chan->capture_state_lock, flags);
 		chan->capture_state = CAPTURE_IDLE;
@@ -773,9 +865,7 @@ static int vi5_channel_start_streaming(struct vb2_queue *vq, u32 count)
 		chan->sequence = 0;
 		tegra_channel_init_ring_buffer(chan);
 
-		ret = vi5_channel_start_kthreads(chan);
-		if (ret != 0)
-			goto err_start_kthreads;
+		vi5_capture_start(chan);
 	}
 
 	/* csi stream/sensor devices should be streamon post vi channel setup */
@@ -793,13 +883,11 @@ err_write_blobs:
 	tegra_channel_set_stream(chan, false);
 
 err_set_stream:
-	if (!chan->bypass)
-		vi5_channel_stop_kthreads(chan);
-
-err_start_kthreads:
-	if (!chan->bypass)
+	if (!chan->bypass) {
+		vi5_capture_stop(chan);
 		vi_capture_release(chan->tegra_vi_channel,
 			CAPTURE_CHANNEL_RESET_FLAG_IMMEDIATE);
+	}
 
 err_setup:
 	if (!chan->bypass)
@@ -823,7 +911,7 @@ static int vi5_channel_stop_streaming(struct vb2_queue *vq)
 	long err;
 
 	if (!chan->bypass)
-		vi5_channel_stop_kthreads(chan);
+		vi5_capture_stop(chan);
 
 	/* csi stream/sensor(s) devices to be closed before vi channel */
 	tegra_channel_set_stream(chan, false);
@@ -936,4 +1024,5 @@ struct tegra_vi_fops vi5_fops = {
 	.vi_error_recover = vi5_channel_error_recover,
 	.vi_add_ctrls = vi5_add_ctrls,
 	.vi_init_video_formats = vi5_init_video_formats,
+	.vi_buffer_queued = vi5_buffer_queued,
 };
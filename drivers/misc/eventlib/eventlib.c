@@ -24,28 +24,55 @@
 #include <linux/mm.h>
 #include <linux/fs.h>
 #include <linux/crc32.h>
+#include <linux/rculist.h>
+#include <linux/smp.h>
+#include <linux/cpumask.h>
+#include <linux/bitops.h>
+#include <linux/sizes.h>
 
 #include <linux/keventlib.h>
 
 #include "eventlib.h"
+#include "eventlib_init.h"
 
-#define KEVENTLIB_VERSION		"0.2"
+#define KEVENTLIB_VERSION		"0.3"
 
 #define EVENTLIB_SYSFS_DIR_NAME		"eventlib"
 #define EVENTLIB_SYSFS_TEST_FILE_NAME	"test"
 #define EVENTLIB_SYSFS_EVENTS_FILE_NAME	"events"
 #define EVENTLIB_SYSFS_SCHEMA_FILE_NAME	"schema"
+#define EVENTLIB_SYSFS_STATS_FILE_NAME	"stats"
 
 #define EVENTLIB_TEST_SHM_SIZE		(PAGE_SIZE)
 
 #define EVENTLIB_MAX_PROVIDERS		256
 #define EVENTLIB_TEST_DATA_SIZE		0x10
 
+/* Smallest trace sub-buffer worth splitting a provider's memory into */
+#define EVENTLIB_MIN_SUBBUF_SIZE	SZ_4K
+
+#define EVENTLIB_STATS_SIZE		(PAGE_SIZE)
+
+/*
+ * Writer side of one trace sub-buffer. Each CPU writes to sub-buffer
+ * (cpu % nr_buffers) and claims it with an atomic test-and-set. When
+ * there are more CPUs than sub-buffers, a writer that finds it taken by
+ * the other CPU sharing it spins until it is released, so no event is
+ * lost; contended counts how often that happened.
+ */
+struct eventlib_subbuf {
+	unsigned long busy;
+
+	atomic64_t written;
+	atomic64_t contended;
+};
+
 struct eventlib_provider_info {
 	struct kobject *kobj;
 
 	struct bin_attribute attr;
 	struct bin_attribute attr_schema;
+	struct bin_attribute attr_stats;
 
 	void *data;
 	size_t data_size;
@@ -60,6 +87,9 @@ struct eventlib_provider_info {
 
 	char *schema;
 	size_t schema_size;
+
+	struct eventlib_subbuf subbuf[EVENTLIB_TBUFS_MAX];
+	unsigned int nr_buffers;
 };
 
 static struct eventlib_module {
@@ -87,14 +117,38 @@ struct eventlib_test_sample {
 
 static int is_initialized;
 
+/*
+ * The mmap layout has room for at most EVENTLIB_TBUFS_MAX sub-buffers,
+ * which existing readers rely on, so CPUs share sub-buffers beyond that
+ * and keventlib_write() serializes the CPUs sharing one.
+ */
+static unsigned int keventlib_nr_buffers(size_t size)
+{
+	unsigned int nr;
+
+	nr = min_t(unsigned int, num_possible_cpus(), EVENTLIB_TBUFS_MAX);
+	nr = min_t(size_t, nr, size / EVENTLIB_MIN_SUBBUF_SIZE);
+
+	return max(nr, 1U);
+}
+
 static int keventlib_init(struct eventlib_provider_info *info)
 {
 	int ret;
+	unsigned int i;
 	struct eventlib_ctx *el_ctx = &info->el_ctx;
 
 	info->w2r = info->data;
 	info->w2r_size = info->data_size;
 
+	info->nr_buffers = keventlib_nr_buffers(info->data_size);
+
+	for (i = 0; i < EVENTLIB_TBUFS_MAX; i++) {
+		info->subbuf[i].busy = 0;
+		atomic64_set(&info->subbuf[i].written, 0);
+		atomic64_set(&info->subbuf[i].contended, 0);
+	}
+
 	pr_debug("w2r: %p, size: %#zx\n", info->w2r, info->w2r_size);
 
 	memset(el_ctx, 0, sizeof(*el_ctx));
@@ -105,6 +159,7 @@ static int keventlib_init(struct eventlib_provider_info *info)
 	el_ctx->r2w_shm = NULL;
 	el_ctx->r2w_shm_size = 0;
 	el_ctx->flags = 0;
+	el_ctx->num_buffers = info->nr_buffers;
 
 	ret = eventlib_init(el_ctx);
 	if (ret)
@@ -163,6 +218,42 @@ sysfs_schema_read(struct file *filp, struct kobject *kobj,
 	return len;
 }
 
+static ssize_t
+sysfs_stats_read(struct file *filp, struct kobject *kobj,
+		 struct bin_attribute *attr,
+		 char *buf, loff_t off, size_t len)
+{
+	char *p;
+	ssize_t size = 0;
+	unsigned int i;
+	struct eventlib_provider_info *info =
+		container_of(attr, struct eventlib_provider_info, attr_stats);
+
+	p = kzalloc(EVENTLIB_STATS_SIZE, GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+
+	for (i = 0; i < info->nr_buffers; i++) {
+		struct eventlib_subbuf *sb = &info->subbuf[i];
+
+		size += scnprintf(p + size, EVENTLIB_STATS_SIZE - size,
+				  "buffer %u: written %lld contended %lld\n", i,
+				  (long long)atomic64_read(&sb->written),
+				  (long long)atomic64_read(&sb->contended));
+	}
+
+	if (off >= size) {
+		len = 0;
+	} else {
+		len = min_t(size_t, len, size - off);
+		memcpy(buf, p + off, len);
+	}
+
+	kfree(p);
+
+	return len;
+}
+
 static int
 create_sysfs_entry(struct eventlib_provider_info *info,
 		   const char *name)
@@ -213,12 +304,30 @@ create_sysfs_entry(struct eventlib_provider_info *info,
 		}
 	}
 
+	sysfs_bin_attr_init(&info->attr_stats);
+
+	info->attr_stats.attr.name = EVENTLIB_SYSFS_STATS_FILE_NAME;
+	info->attr_stats.attr.mode = 0444;
+	info->attr_stats.mmap = NULL;
+	info->attr_stats.read = sysfs_stats_read;
+	info->attr_stats.write = NULL;
+	info->attr_stats.size = EVENTLIB_STATS_SIZE;
+
+	ret = sysfs_create_bin_file(info->kobj, &info->attr_stats);
+	if (ret) {
+		pr_err("Unable to create sysfs file: %s\n",
+		       info->attr_stats.attr.name);
+		kobject_put(info->kobj);
+		return ret;
+	}
+
 	return 0;
 }
 
 static void remove_sysfs_entry(struct eventlib_provider_info *info)
 {
 	sysfs_remove_bin_file(info->kobj, &info->attr);
+	sysfs_remove_bin_file(info->kobj, &info->attr_stats);
 	if (info->schema)
 		sysfs_remove_bin_file(info->kobj, &info->attr_schema);
 
@@ -307,7 +416,7 @@ provider_init(struct eventlib_provider_info *info,
 
 	info->id = id;
 
-	list_add_tail(&info->list, &ctx.providers);
+	list_add_tail_rcu(&info->list, &ctx.providers);
 	atomic_inc(&ctx.nr_providers);
 
 	spin_unlock(&ctx.lock);
@@ -337,7 +446,7 @@ find_provider_info(int id)
 {
 	struct eventlib_provider_info *info;
 
-	list_for_each_entry(info, &ctx.providers, list) {
+	list_for_each_entry_rcu(info, &ctx.providers, list) {
 		if (id == info->id)
 			return info;
 	}
@@ -353,8 +462,17 @@ __free_provider(struct work_struct *work)
 
 	struct eventlib_provider_info *info = wd->provider;
 
+	/* no new mappings of the buffer once its sysfs entry is gone */
 	remove_sysfs_entry(info);
 
+	/* wait for keventlib_write() calls still using the buffer */
+	synchronize_rcu();
+
+	eventlib_close(&info->el_ctx);
+
+	free_pages((unsigned long)info->data,
+		   get_order(info->data_size));
+
 	if (info->schema)
 		kfree(info->schema);
 
@@ -369,12 +487,7 @@ static void free_provider(struct eventlib_provider_info *info)
 {
 	struct eventlib_work_data *wd;
 
-	eventlib_close(&info->el_ctx);
-
-	free_pages((unsigned long)info->data,
-		   get_order(info->data_size));
-
-	list_del(&info->list);
+	list_del_rcu(&info->list);
 
 	wd = kmalloc(sizeof(*wd), GFP_ATOMIC);
 	if (!wd)
@@ -398,11 +511,14 @@ static void unregister_all_providers(void)
 int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 {
 	int err = 0;
+	unsigned int idx;
+	unsigned long flags;
+	struct eventlib_subbuf *sb;
 	struct eventlib_provider_info *info;
 
 	pr_debug("%s: size: %#zx\n", __func__, size);
 
-	spin_lock(&ctx.lock);
+	rcu_read_lock();
 
 	info = find_provider_info(id);
 	if (!info) {
@@ -415,10 +531,26 @@ int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 		goto err_out;
 	}
 
-	eventlib_write(&info->el_ctx, 0, type, ts, data, size);
+	local_irq_save(flags);
+
+	idx = smp_processor_id() % info->nr_buffers;
+	sb = &info->subbuf[idx];
+
+	if (test_and_set_bit_lock(0, &sb->busy)) {
+		/* held by another CPU with interrupts off, wait it out */
+		atomic64_inc(&sb->contended);
+		while (test_and_set_bit_lock(0, &sb->busy))
+			cpu_relax();
+	}
+
+	eventlib_write(&info->el_ctx, idx, type, ts, data, size);
+	atomic64_inc(&sb->written);
+	clear_bit_unlock(0, &sb->busy);
+
+	local_irq_restore(flags);
 
 err_out:
-	spin_unlock(&ctx.lock);
+	rcu_read_unlock();
 	return err;
 }
 EXPORT_SYMBOL(keventlib_write);
@@ -28,6 +28,10 @@
 #define QUADD_UNW_TYPES_SIZE \
 	DIV_ROUND_UP(QUADD_MAX_STACK_DEPTH * 4, sizeof(u32) * BITS_PER_BYTE)
 
+/* worst case: a 64-bit zigzag varint takes 10 bytes */
+#define QUADD_PACKED_CC_SIZE \
+	ALIGN(QUADD_MAX_STACK_DEPTH * 10, sizeof(u32))
+
 struct quadd_hrt_ctx;
 
 struct quadd_unw_methods {
@@ -48,6 +52,9 @@ struct quadd_callchain {
 
 	u32 types[QUADD_UNW_TYPES_SIZE];
 
+	u32 packed_size;
+	u8 packed[QUADD_PACKED_CC_SIZE];
+
 	unsigned int cs_64:1;
 
 	struct quadd_unw_methods um;
@@ -27,6 +27,7 @@
 #include <linux/circ_buf.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/smp.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -40,9 +41,16 @@ struct quadd_ring_buffer {
 
 	size_t max_fill_count;
 	size_t nr_skipped_samples;
+	size_t nr_skipped_bytes;
 
 	struct quadd_mmap_area *mmap;
 
+	/*
+	 * Each ring is filled by its own CPU with interrupts disabled, so
+	 * writes need no lock. Only rings with remote writers (shared)
+	 * serialize the writers on the lock.
+	 */
+	bool shared;
 	raw_spinlock_t lock;
 };
 
@@ -100,10 +108,17 @@ write_sample(struct quadd_ring_buffer *rb,
 	     const struct quadd_iovec *vec, int vec_count)
 {
 	int i;
+	char *buf;
 	size_t len = 0, c;
-	struct quadd_ring_buffer_hdr hdr, *rb_hdr = rb->rb_hdr;
+	struct quadd_ring_buffer_hdr hdr, *rb_hdr;
 
-	if (!rb_hdr)
+	/*
+	 * rb_reset() clears both pointers without waiting for lockless
+	 * writers, so either of them may be gone.
+	 */
+	rb_hdr = smp_load_acquire(&rb->rb_hdr);
+	buf = READ_ONCE(rb->buf);
+	if (!rb_hdr || !buf)
 		return -EIO;
 
 	if (vec) {
@@ -125,11 +140,11 @@ write_sample(struct quadd_ring_buffer *rb,
 		return -ENOSPC;
 	}
 
-	rb_write(&hdr, rb->buf, sample, sizeof(*sample));
+	rb_write(&hdr, buf, sample, sizeof(*sample));
 
 	if (vec) {
 		for (i = 0; i < vec_count; i++)
-			rb_write(&hdr, rb->buf, vec[i].base, vec[i].len);
+			rb_write(&hdr, buf, vec[i].base, vec[i].len);
 	}
 
 	c = CIRC_CNT(hdr.pos_write, hdr.pos_read, hdr.size);
@@ -180,6 +195,8 @@ put_sample(struct quadd_record_data *data,
 	   struct quadd_iovec *vec,
 	   int vec_count, int cpu_id)
 {
+	int i;
+	bool locked;
 	ssize_t err = 0;
 	unsigned long flags;
 	struct comm_cpu_context *cc;
@@ -189,24 +206,46 @@ put_sample(struct quadd_record_data *data,
 	if (!atomic_read(&comm_ctx.active))
 		return -EIO;
 
-	cc = cpu_id < 0 ? this_cpu_ptr(&cpu_ctx) :
-		&per_cpu(cpu_ctx, cpu_id);
+	local_irq_save(flags);
+
+	if (cpu_id < 0)
+		cpu_id = smp_processor_id();
 
+	cc = &per_cpu(cpu_ctx, cpu_id);
 	rb = &cc->rb;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	/*
+	 * The only writes to a foreign non-shared ring are the headers
+	 * put by quadd_hrt_start() before sampling is enabled, so taking
+	 * the lock here is enough for them as well.
+	 */
+	locked = rb->shared || cpu_id != smp_processor_id();
+	if (locked)
+		raw_spin_lock(&rb->lock);
 
 	err = write_sample(rb, data, vec, vec_count);
 	if (err < 0) {
 		pr_err_once("%s: error: write sample\n", __func__);
 		rb->nr_skipped_samples++;
 
-		rb_hdr = rb->rb_hdr;
-		if (rb_hdr)
+		rb_hdr = READ_ONCE(rb->rb_hdr);
+		if (rb_hdr) {
+			size_t len = sizeof(*data);
+
+			for (i = 0; vec && i < vec_count; i++)
+				len += vec[i].len;
+
+			rb->nr_skipped_bytes += len;
+
 			rb_hdr->skipped_samples++;
+			rb_hdr->skipped_bytes += len;
+		}
 	}
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+	if (locked)
+		raw_spin_unlock(&rb->lock);
+
+	local_irq_restore(flags);
 
 	return err;
 }
@@ -326,6 +365,7 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	rb->max_fill_count = 0;
 	rb->nr_skipped_samples = 0;
+	rb->nr_skipped_bytes = 0;
 
 	mmap_hdr = mmap->data;
 
@@ -335,7 +375,6 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	mmap_hdr->samples_version = QUADD_SAMPLES_VERSION;
 
 	rb_hdr = (struct quadd_ring_buffer_hdr *)(mmap_hdr + 1);
-	rb->rb_hdr = rb_hdr;
 
 	rb_hdr->size = size;
 	rb_hdr->pos_read = 0;
@@ -343,9 +382,13 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	rb_hdr->max_fill_count = 0;
 	rb_hdr->skipped_samples = 0;
+	rb_hdr->skipped_bytes = 0;
 
 	rb_hdr->state = QUADD_RB_STATE_ACTIVE;
 
+	/* publish the header last, lockless writers start from it */
+	smp_store_release(&rb->rb_hdr, rb_hdr);
+
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
 
 	pr_debug("[cpu: %d] init_mmap_hdr: vma: %#lx - %#lx, data: %p - %p\n",
@@ -372,8 +415,9 @@ static void rb_stop(void)
 		if (!rb_hdr)
 			continue;
 
-		pr_info("[%d] skipped samples/max filling: %zu/%zu\n",
-			cpu_id, rb->nr_skipped_samples, rb->max_fill_count);
+		pr_info("[%d] skipped samples/bytes/max filling: %zu/%zu/%zu\n",
+			cpu_id, rb->nr_skipped_samples, rb->nr_skipped_bytes,
+			rb->max_fill_count);
 
 		rb_hdr->state = QUADD_RB_STATE_STOPPED;
 	}
@@ -389,8 +433,8 @@ static void rb_reset(struct quadd_ring_buffer *rb)
 	raw_spin_lock_irqsave(&rb->lock, flags);
 
 	rb->mmap = NULL;
-	rb->buf = NULL;
-	rb->rb_hdr = NULL;
+	WRITE_ONCE(rb->rb_hdr, NULL);
+	WRITE_ONCE(rb->buf, NULL);
 
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
 }
@@ -796,6 +840,7 @@ static void mmap_open(struct vm_area_struct *vma)
 
 static void mmap_close(struct vm_area_struct *vma)
 {
+	bool is_rb = false;
 	struct quadd_mmap_area *mmap;
 
 	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
@@ -813,8 +858,10 @@ static void mmap_close(struct vm_area_struct *vma)
 
 	if (mmap->type == QUADD_MMAP_TYPE_EXTABS)
 		comm_ctx.control->delete_mmap(mmap);
-	else if (mmap->type == QUADD_MMAP_TYPE_RB)
+	else if (mmap->type == QUADD_MMAP_TYPE_RB) {
 		rb_reset(mmap->rb);
+		is_rb = true;
+	}
 	else
 		pr_warn("warning: mmap area is uninitialized\n");
 
@@ -823,6 +870,14 @@ static void mmap_close(struct vm_area_struct *vma)
 out:
 	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
 
+	/*
+	 * The owner CPU writes to its ring without the lock, with interrupts
+	 * disabled. Once every CPU has taken an IPI, nobody can still hold
+	 * the old buffer pointer.
+	 */
+	if (is_rb)
+		kick_all_cpus_sync();
+
 	if (mmap) {
 		vfree(mmap->data);
 		kfree(mmap);
@@ -977,7 +1032,9 @@ static int comm_init(void)
 
 		rb->max_fill_count = 0;
 		rb->nr_skipped_samples = 0;
+		rb->nr_skipped_bytes = 0;
 
+		rb->shared = cpu_id == QUADD_GLOBAL_RB_CPU;
 		raw_spin_lock_init(&rb->lock);
 	}
 
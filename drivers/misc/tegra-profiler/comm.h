@@ -30,6 +30,13 @@ struct quadd_ring_buffer;
 struct quadd_pmu_setup_for_cpu;
 struct quadd_comm_cap_for_cpu;
 
+/*
+ * Records that do not belong to a particular CPU (comm, mmap, memory
+ * activity, power rate, uncore) all go to this CPU's ring buffer. It is
+ * the only ring with more than one writer.
+ */
+#define QUADD_GLOBAL_RB_CPU	0
+
 struct quadd_iovec {
 	void *base;
 	size_t len;
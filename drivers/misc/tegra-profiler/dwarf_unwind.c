@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 
 #include <asm/unaligned.h>
 
@@ -111,6 +113,9 @@ struct regs_state {
 
 #define DW_MAX_RS_STACK_DEPTH	8
 
+#define DW_ROW_CACHE_SIZE	128	/* must be a power of 2 */
+#define DW_ROW_MAX_SAVED	14
+
 struct stackframe {
 	unsigned long pc;
 	unsigned long vregs[QUADD_NUM_REGS];
@@ -124,17 +129,44 @@ struct stackframe {
 	int is_sched;
 };
 
+/*
+ * Decoded CFI row for one return address: the CFA rule and the
+ * CFA-relative slots of the saved registers. Rows that need anything
+ * else (expressions, register-to-register rules) are not cached.
+ */
+struct dw_cached_row {
+	struct quadd_mmap_area *mmap;
+	unsigned long vm_start;
+	unsigned long pc;
+	unsigned int gen;
+
+	u8 is_eh;
+	u8 mode;
+	u8 nr_saved;
+
+	int cfa_register;
+	long cfa_offset;
+
+	u8 regnum[DW_ROW_MAX_SAVED];
+	s32 offset[DW_ROW_MAX_SAVED];
+};
+
 struct dwarf_cpu_context {
 	struct regs_state rs_stack[DW_MAX_RS_STACK_DEPTH];
 	int depth;
 
 	struct stackframe sf;
 	int dw_ptr_size;
+
+	struct dw_cached_row rows[DW_ROW_CACHE_SIZE];
 };
 
 struct quadd_dwarf_context {
 	struct dwarf_cpu_context __percpu *cpu_ctx;
 	atomic_t started;
+
+	/* bumped whenever an unwind tables mmap goes away */
+	atomic_t row_cache_gen;
 };
 
 struct dw_cie {
@@ -1831,55 +1863,14 @@ static long def_cfa(struct stackframe *sf, struct regs_state *rs)
 }
 
 static long
-unwind_frame(struct ex_region_info *ri,
-	     struct stackframe *sf,
-	     struct vm_area_struct *vma_sp,
-	     int is_eh,
-	     struct task_struct *task)
+apply_frame_rules(struct stackframe *sf, struct vm_area_struct *vma_sp)
 {
 	int i, num_regs;
 	long err;
-	unsigned char *insn_end;
 	unsigned long addr, return_addr, val, user_reg_size;
-	struct dw_fde fde;
-	struct dw_cie cie;
-	unsigned long pc = sf->pc;
-	struct regs_state *rs, *rs_initial;
+	struct regs_state *rs = &sf->rs;
 	int mode = sf->mode;
 
-	err = dwarf_decode(ri, sf, &cie, &fde, pc, is_eh, task);
-	if (err < 0)
-		return err;
-
-	sf->pc = fde.initial_location;
-
-	rs = &sf->rs;
-	rs_initial = &sf->rs_initial;
-
-	rs->cfa_register = -1;
-	rs_initial->cfa_register = -1;
-
-	rules_cleanup(rs, mode);
-
-	if (cie.initial_insn) {
-		insn_end = cie.initial_insn + cie.initial_insn_len;
-		err = dwarf_cfa_exec_insns(ri, cie.initial_insn,
-					   insn_end, &cie, sf, pc, is_eh);
-		if (err)
-			return err;
-	}
-
-	memcpy(rs_initial, rs, sizeof(*rs));
-
-	if (fde.instructions) {
-		insn_end = fde.instructions + fde.insn_length;
-		err = dwarf_cfa_exec_insns(ri, fde.instructions,
-					   insn_end, fde.cie, sf, pc, is_eh);
-		if (err)
-			return err;
-	}
-
-	pr_debug("mode: %s\n", (mode == DW_MODE_ARM32) ? "arm32" : "arm64");
 	pr_debug("initial cfa: %#lx\n", sf->cfa);
 
 	user_reg_size = get_user_reg_size(mode);
@@ -1888,9 +1879,6 @@ unwind_frame(struct ex_region_info *ri,
 	if (err < 0)
 		return err;
 
-	pr_debug("pc: %#lx, exec pc: %#lx, lr: %#lx\n",
-		 pc, sf->pc, sf->vregs[regnum_lr(mode)]);
-
 	pr_debug("sp: %#lx, fp: %#lx, fp_thumb: %#lx\n",
 		 sf->vregs[regnum_sp(mode)],
 		 sf->vregs[regnum_fp(mode)],
@@ -1975,6 +1963,150 @@ unwind_frame(struct ex_region_info *ri,
 	return 0;
 }
 
+static inline struct dw_cached_row *
+row_cache_slot(struct dwarf_cpu_context *cpu_ctx,
+	       struct ex_region_info *ri, unsigned long pc)
+{
+	unsigned int idx = hash_long(pc ^ ri->vm_start,
+				     ilog2(DW_ROW_CACHE_SIZE));
+
+	return &cpu_ctx->rows[idx];
+}
+
+static int
+row_cache_lookup(struct dwarf_cpu_context *cpu_ctx,
+		 struct ex_region_info *ri,
+		 struct stackframe *sf,
+		 int *is_eh)
+{
+	int i;
+	struct regs_state *rs = &sf->rs;
+	struct dw_cached_row *row = row_cache_slot(cpu_ctx, ri, sf->pc);
+
+	if (row->mmap != ri->mmap || row->vm_start != ri->vm_start ||
+	    row->pc != sf->pc || row->mode != sf->mode ||
+	    row->gen != atomic_read(&ctx.row_cache_gen))
+		return 0;
+
+	rules_cleanup(rs, sf->mode);
+
+	rs->cfa_register = row->cfa_register;
+	rs->cfa_offset = row->cfa_offset;
+
+	for (i = 0; i < row->nr_saved; i++)
+		set_rule_offset(rs, row->regnum[i], DW_WHERE_CFAREL,
+				row->offset[i]);
+
+	*is_eh = row->is_eh;
+
+	return 1;
+}
+
+static void
+row_cache_store(struct dwarf_cpu_context *cpu_ctx,
+		struct ex_region_info *ri,
+		struct stackframe *sf,
+		unsigned long pc,
+		int is_eh)
+{
+	int i, num_regs, nr_saved = 0;
+	struct dw_cached_row *row;
+	struct regs_state *rs = &sf->rs;
+	u8 regnum[DW_ROW_MAX_SAVED];
+	s32 offset[DW_ROW_MAX_SAVED];
+
+	num_regs = (sf->mode == DW_MODE_ARM32) ?
+		QUADD_AARCH32_REGISTERS :
+		QUADD_AARCH64_REGISTERS;
+
+	for (i = 0; i < num_regs; i++) {
+		struct reg_info *r = &rs->reg[i];
+
+		if (r->where == DW_WHERE_UNDEF || r->where == DW_WHERE_SAME)
+			continue;
+
+		if (r->where != DW_WHERE_CFAREL ||
+		    nr_saved >= DW_ROW_MAX_SAVED ||
+		    r->loc.offset != (s32)r->loc.offset)
+			return;
+
+		regnum[nr_saved] = i;
+		offset[nr_saved] = r->loc.offset;
+		nr_saved++;
+	}
+
+	row = row_cache_slot(cpu_ctx, ri, pc);
+
+	row->mmap = ri->mmap;
+	row->vm_start = ri->vm_start;
+	row->pc = pc;
+	row->gen = atomic_read(&ctx.row_cache_gen);
+
+	row->is_eh = is_eh;
+	row->mode = sf->mode;
+	row->nr_saved = nr_saved;
+
+	row->cfa_register = rs->cfa_register;
+	row->cfa_offset = rs->cfa_offset;
+
+	memcpy(row->regnum, regnum, nr_saved * sizeof(regnum[0]));
+	memcpy(row->offset, offset, nr_saved * sizeof(offset[0]));
+}
+
+static long
+unwind_frame(struct ex_region_info *ri,
+	     struct stackframe *sf,
+	     struct vm_area_struct *vma_sp,
+	     int is_eh,
+	     struct task_struct *task)
+{
+	long err;
+	unsigned char *insn_end;
+	struct dw_fde fde;
+	struct dw_cie cie;
+	unsigned long pc = sf->pc;
+	struct regs_state *rs, *rs_initial;
+	int mode = sf->mode;
+
+	err = dwarf_decode(ri, sf, &cie, &fde, pc, is_eh, task);
+	if (err < 0)
+		return err;
+
+	sf->pc = fde.initial_location;
+
+	rs = &sf->rs;
+	rs_initial = &sf->rs_initial;
+
+	rs->cfa_register = -1;
+	rs_initial->cfa_register = -1;
+
+	rules_cleanup(rs, mode);
+
+	if (cie.initial_insn) {
+		insn_end = cie.initial_insn + cie.initial_insn_len;
+		err = dwarf_cfa_exec_insns(ri, cie.initial_insn,
+					   insn_end, &cie, sf, pc, is_eh);
+		if (err)
+			return err;
+	}
+
+	memcpy(rs_initial, rs, sizeof(*rs));
+
+	if (fde.instructions) {
+		insn_end = fde.instructions + fde.insn_length;
+		err = dwarf_cfa_exec_insns(ri, fde.instructions,
+					   insn_end, fde.cie, sf, pc, is_eh);
+		if (err)
+			return err;
+	}
+
+	pr_debug("mode: %s\n", (mode == DW_MODE_ARM32) ? "arm32" : "arm64");
+	pr_debug("pc: %#lx, exec pc: %#lx, lr: %#lx\n",
+		 pc, sf->pc, sf->vregs[regnum_lr(mode)]);
+
+	return apply_frame_rules(sf, vma_sp);
+}
+
 static void
 unwind_backtrace(struct quadd_callchain *cc,
 		 struct ex_region_info *ri,
@@ -1986,6 +2118,7 @@ unwind_backtrace(struct quadd_callchain *cc,
 	struct ex_region_info ri_new, *prev_ri = NULL;
 	unsigned int unw_type;
 	int is_eh = 1, mode = sf->mode;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
 
 	cc->urc_dwarf = QUADD_URC_FAILURE;
 	user_reg_size = get_user_reg_size(mode);
@@ -2034,6 +2167,16 @@ unwind_backtrace(struct quadd_callchain *cc,
 			prev_ri = ri = &ri_new;
 		}
 
+		if (row_cache_lookup(cpu_ctx, ri, sf, &is_eh)) {
+			err = apply_frame_rules(sf, vma_sp);
+			if (err < 0) {
+				cc->urc_dwarf = -err;
+				break;
+			}
+
+			goto frame_done;
+		}
+
 		if (!is_fde_entry_exist(ri, sf->pc, &__is_eh,
 					&__is_debug, task)) {
 			pr_debug("eh/debug fde entries are not existed\n");
@@ -2066,6 +2209,9 @@ unwind_backtrace(struct quadd_callchain *cc,
 			}
 		}
 
+		row_cache_store(cpu_ctx, ri, sf, where, is_eh);
+
+frame_done:
 		unw_type = is_eh ? QUADD_UNW_TYPE_DWARF_EH :
 				   QUADD_UNW_TYPE_DWARF_DF;
 
@@ -2230,6 +2376,11 @@ quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 	return cc->nr;
 }
 
+void quadd_dwarf_unwind_flush(void)
+{
+	atomic_inc(&ctx.row_cache_gen);
+}
+
 int quadd_dwarf_unwind_start(void)
 {
 	if (!atomic_cmpxchg(&ctx.started, 0, 1)) {
@@ -2252,5 +2403,6 @@ void quadd_dwarf_unwind_stop(void)
 int quadd_dwarf_unwind_init(void)
 {
 	atomic_set(&ctx.started, 0);
+	atomic_set(&ctx.row_cache_gen, 0);
 	return 0;
 }
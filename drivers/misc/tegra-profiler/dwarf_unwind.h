@@ -28,6 +28,8 @@ unsigned int
 quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 			struct quadd_callchain *cc);
 
+void quadd_dwarf_unwind_flush(void);
+
 int quadd_dwarf_unwind_start(void);
 void quadd_dwarf_unwind_stop(void);
 int quadd_dwarf_unwind_init(void);
@@ -22,6 +22,9 @@
 #include <linux/uaccess.h>
 #include <linux/err.h>
 #include <linux/rcupdate.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -36,6 +39,8 @@
 
 #define QUADD_EXTABS_SIZE	32
 
+#define QUADD_IDX_CACHE_SIZE	64	/* must be a power of 2 */
+
 #define GET_NR_PAGES(a, l) \
 	((PAGE_ALIGN((a) + (l)) - ((a) & PAGE_MASK)) / PAGE_SIZE)
 
@@ -68,6 +73,9 @@ struct quadd_unwind_ctx {
 
 	struct list_head mm_ex_list;
 	raw_spinlock_t mm_ex_list_lock;
+
+	/* bumped whenever an unwind tables mmap goes away */
+	atomic_t idx_cache_gen;
 };
 
 struct unwind_idx {
@@ -103,7 +111,20 @@ struct ex_entry_node {
 	unsigned long vm_end;
 };
 
+/* exidx lookups of the return addresses seen recently on this cpu */
+struct idx_cache_entry {
+	struct quadd_mmap_area *mmap;
+	unsigned long vm_start;
+	unsigned long pc;
+	unsigned int gen;
+
+	const struct unwind_idx *idx;
+	unsigned long lowaddr;
+};
+
 static struct quadd_unwind_ctx ctx;
+static DEFINE_PER_CPU(struct idx_cache_entry [QUADD_IDX_CACHE_SIZE],
+		      idx_cache);
 
 static inline int is_debug_frame(int secid)
 {
@@ -893,6 +914,9 @@ void quadd_unwind_clean_mmap(struct quadd_mmap_area *mmap)
 {
 	mmap_wait_for_close(mmap);
 	clean_mmap(mmap);
+
+	atomic_inc(&ctx.idx_cache_gen);
+	quadd_dwarf_unwind_flush();
 }
 
 static const struct unwind_idx *
@@ -947,6 +971,37 @@ unwind_find_idx(struct ex_region_info *ri, u32 addr, unsigned long *lowaddr)
 	return start;
 }
 
+static const struct unwind_idx *
+unwind_find_idx_cached(struct ex_region_info *ri, unsigned long pc,
+		       unsigned long *lowaddr)
+{
+	const struct unwind_idx *idx;
+	struct idx_cache_entry *entry;
+	unsigned int gen = atomic_read(&ctx.idx_cache_gen);
+
+	entry = this_cpu_ptr(&idx_cache[hash_long(pc ^ ri->vm_start,
+					ilog2(QUADD_IDX_CACHE_SIZE))]);
+
+	if (entry->mmap == ri->mmap && entry->vm_start == ri->vm_start &&
+	    entry->pc == pc && entry->gen == gen) {
+		*lowaddr = entry->lowaddr;
+		return entry->idx;
+	}
+
+	idx = unwind_find_idx(ri, pc, lowaddr);
+	if (IS_ERR_OR_NULL(idx))
+		return idx;
+
+	entry->mmap = ri->mmap;
+	entry->vm_start = ri->vm_start;
+	entry->pc = pc;
+	entry->gen = gen;
+	entry->idx = idx;
+	entry->lowaddr = *lowaddr;
+
+	return idx;
+}
+
 static unsigned long
 unwind_get_byte(struct quadd_mmap_area *mmap,
 		struct unwind_ctrl_block *ctrl, long *err)
@@ -1251,7 +1306,7 @@ unwind_frame(struct quadd_unw_methods um,
 	pr_debug("pc: %#lx, lr: %#lx, sp:%#lx, low/high: %#lx/%#lx, thumb: %d\n",
 		 frame->pc, frame->lr, frame->sp, low, high, thumbflag);
 
-	idx = unwind_find_idx(ri, frame->pc, &min);
+	idx = unwind_find_idx_cached(ri, frame->pc, &min);
 	if (IS_ERR_OR_NULL(idx))
 		return -QUADD_URC_IDX_NOT_FOUND;
 
@@ -1609,6 +1664,8 @@ int quadd_unwind_init(struct quadd_ctx *quadd_ctx)
 	INIT_LIST_HEAD(&ctx.mm_ex_list);
 	raw_spin_lock_init(&ctx.mm_ex_list_lock);
 
+	atomic_set(&ctx.idx_cache_gen, 1);
+
 	return 0;
 }
 
@@ -26,6 +26,7 @@
 #include <linux/version.h>
 #include <linux/rculist.h>
 #include <linux/random.h>
+#include <linux/jhash.h>
 #include <clocksource/arm_arch_timer.h>
 
 #include <asm/cputype.h>
@@ -159,7 +160,7 @@ u64 quadd_get_time(void)
 		get_posix_clock_monotonic_time();
 }
 
-static void
+static ssize_t
 __put_sample(struct quadd_record_data *data,
 	     struct quadd_iovec *vec,
 	     int vec_count, int cpu_id)
@@ -172,6 +173,8 @@ __put_sample(struct quadd_record_data *data,
 		atomic64_inc(&hrt.skipped_samples);
 
 	atomic64_inc(&hrt.counter_samples);
+
+	return err;
 }
 
 void
@@ -185,7 +188,7 @@ void
 quadd_put_sample(struct quadd_record_data *data,
 		 struct quadd_iovec *vec, int vec_count)
 {
-	__put_sample(data, vec, vec_count, 0);
+	__put_sample(data, vec, vec_count, QUADD_GLOBAL_RB_CPU);
 }
 
 static void put_header(int cpuid, bool is_uncore)
@@ -438,16 +441,79 @@ get_stack_offset(struct task_struct *task,
 	return vma->vm_end - sp;
 }
 
+static inline u8 *put_varint(u8 *p, u64 value)
+{
+	while (value >= 0x80) {
+		*p++ = (u8)value | 0x80;
+		value >>= 7;
+	}
+	*p++ = (u8)value;
+
+	return p;
+}
+
+/*
+ * Neighbouring frames usually live in the same module, so the deltas
+ * between them fit in 2-3 bytes instead of 4 or 8.
+ */
+static u32 pack_callchain(struct quadd_callchain *cc, int nr)
+{
+	int i;
+	s64 delta;
+	u64 ip, prev = 0;
+	u8 *p = cc->packed;
+
+	for (i = 0; i < nr; i++) {
+		ip = cc->cs_64 ? cc->ip_64[i] : cc->ip_32[i];
+		delta = (s64)(ip - prev);
+		prev = ip;
+
+		p = put_varint(p, (u64)((delta << 1) ^ (delta >> 63)));
+	}
+
+	while ((p - cc->packed) & (sizeof(u32) - 1))
+		*p++ = 0;
+
+	return p - cc->packed;
+}
+
+static u64 hash_callchain(struct quadd_callchain *cc, int nr)
+{
+	u32 lo, hi, nr_words, nr_types;
+	const u32 *ips = cc->cs_64 ? (u32 *)cc->ip_64 : cc->ip_32;
+
+	nr_words = cc->cs_64 ? nr * 2 : nr;
+	nr_types = DIV_ROUND_UP(nr, 8);
+
+	lo = jhash2(ips, nr_words, cc->cs_64);
+	lo = jhash2(cc->types, nr_types, lo);
+
+	hi = jhash2(ips, nr_words, JHASH_INITVAL + cc->cs_64);
+	hi = jhash2(cc->types, nr_types, hi);
+
+	return ((u64)hi << 32 | lo) ?: 1;
+}
+
+static struct quadd_cc_dedup_entry *
+cc_dedup_slot(struct quadd_cpu_context *cpu_ctx,
+	      struct quadd_callchain *cc, int nr, u64 *hash)
+{
+	*hash = hash_callchain(cc, nr);
+
+	return &cpu_ctx->cc_dedup[*hash & (QUADD_CC_DEDUP_SIZE - 1)];
+}
+
 static void
 read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 {
 	u32 vpid, vtgid;
-	u32 state, extra_data = 0, urcs = 0, ts_delta;
-	u64 ts_start, ts_end;
+	u32 state, extra_data = 0, urcs = 0, ts_delta, cc_id = 0;
+	u64 ts_start, ts_end, cc_hash = 0;
 	int i, vec_idx = 0, bt_size = 0;
 	int nr_events = 0, nr_positive_events = 0;
 	struct pt_regs *user_regs;
-	struct quadd_iovec vec[9];
+	struct quadd_cc_dedup_entry *cc_slot = NULL;
+	struct quadd_iovec vec[11];
 	struct quadd_event_data events[QUADD_MAX_COUNTERS];
 	u32 events_extra[QUADD_MAX_COUNTERS];
 	struct quadd_event_context event_ctx;
@@ -501,14 +567,51 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 			int ip_size = cc->cs_64 ? sizeof(u64) : sizeof(u32);
 			int nr_types = DIV_ROUND_UP(bt_size, 8);
 
-			vec[vec_idx].base = cc->cs_64 ?
-				(void *)cc->ip_64 : (void *)cc->ip_32;
-			vec[vec_idx].len = bt_size * ip_size;
-			vec_idx++;
+			if (hrt.dedup_callchain)
+				cc_slot = cc_dedup_slot(cpu_ctx, cc, bt_size,
+							&cc_hash);
+
+			if (cc_slot && cc_slot->hash == cc_hash) {
+				vec[vec_idx].base = &cc_slot->id;
+				vec[vec_idx].len = sizeof(cc_slot->id);
+				vec_idx++;
+
+				s->flags |= QUADD_SAMPLE_FLAG_CC_REF;
+			} else if (hrt.pack_callchain) {
+				cc->packed_size = pack_callchain(cc, bt_size);
+
+				vec[vec_idx].base = &cc->packed_size;
+				vec[vec_idx].len = sizeof(cc->packed_size);
+				vec_idx++;
+
+				vec[vec_idx].base = cc->packed;
+				vec[vec_idx].len = cc->packed_size;
+				vec_idx++;
+
+				s->flags |= QUADD_SAMPLE_FLAG_CC_PACKED;
+			} else {
+				vec[vec_idx].base = cc->cs_64 ?
+					(void *)cc->ip_64 : (void *)cc->ip_32;
+				vec[vec_idx].len = bt_size * ip_size;
+				vec_idx++;
+			}
 
-			vec[vec_idx].base = cc->types;
-			vec[vec_idx].len = nr_types * sizeof(cc->types[0]);
-			vec_idx++;
+			if (!(s->flags & QUADD_SAMPLE_FLAG_CC_REF)) {
+				vec[vec_idx].base = cc->types;
+				vec[vec_idx].len =
+					nr_types * sizeof(cc->types[0]);
+				vec_idx++;
+			}
+
+			if (cc_slot && !(s->flags & QUADD_SAMPLE_FLAG_CC_REF)) {
+				cc_id = cpu_ctx->cc_next_id++;
+
+				vec[vec_idx].base = &cc_id;
+				vec[vec_idx].len = sizeof(cc_id);
+				vec_idx++;
+
+				s->flags |= QUADD_SAMPLE_FLAG_CC_DEF;
+			}
 
 			if (cc->cs_64)
 				s->flags |= QUADD_SAMPLE_FLAG_IP64;
@@ -589,7 +692,15 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 		s->flags |= QUADD_SAMPLE_FLAG_IS_VPID;
 	}
 
-	quadd_put_sample_this_cpu(&record_data, vec, vec_idx);
+	/*
+	 * Later samples may only refer to a stack whose definition has
+	 * actually made it into the ring buffer.
+	 */
+	if (__put_sample(&record_data, vec, vec_idx, -1) >= 0 &&
+	    (s->flags & QUADD_SAMPLE_FLAG_CC_DEF)) {
+		cc_slot->hash = cc_hash;
+		cc_slot->id = cc_id;
+	}
 }
 
 static enum hrtimer_restart hrtimer_handler(struct hrtimer *hrtimer)
@@ -908,6 +1019,9 @@ static void reset_cpu_ctx(void)
 		cpu_ctx->is_sampling_enabled = 0;
 		cpu_ctx->is_tracing_enabled = 0;
 
+		memset(cpu_ctx->cc_dedup, 0, sizeof(cpu_ctx->cc_dedup));
+		cpu_ctx->cc_next_id = 0;
+
 		t_data->pid = -1;
 		t_data->tgid = -1;
 	}
@@ -1008,6 +1122,10 @@ int quadd_hrt_start(void)
 
 	hrt.get_stack_offset =
 		(extra & QUADD_PARAM_EXTRA_STACK_OFFSET) ? 1 : 0;
+	hrt.pack_callchain =
+		(extra & QUADD_PARAM_EXTRA_PACKED_CALLCHAIN) ? 1 : 0;
+	hrt.dedup_callchain =
+		(extra & QUADD_PARAM_EXTRA_CALLCHAIN_REF) ? 1 : 0;
 
 	for_each_possible_cpu(cpuid) {
 		if (ctx->pmu->get_arch(cpuid))
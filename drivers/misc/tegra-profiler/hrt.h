@@ -30,12 +30,23 @@ struct quadd_thread_data {
 	pid_t tgid;
 };
 
+#define QUADD_CC_DEDUP_SIZE	256	/* must be a power of 2 */
+
+struct quadd_cc_dedup_entry {
+	u64 hash;
+	u32 id;
+};
+
 struct quadd_cpu_context {
 	struct hrtimer hrtimer;
 
 	struct quadd_callchain cc;
 	char mmap_filename[PATH_MAX];
 
+	/* stacks already sent to this cpu's ring buffer */
+	struct quadd_cc_dedup_entry cc_dedup[QUADD_CC_DEDUP_SIZE];
+	u32 cc_next_id;
+
 	struct quadd_thread_data active_thread;
 	unsigned int is_sampling_enabled:1;
 	unsigned int is_tracing_enabled:1;
@@ -78,6 +89,8 @@ struct quadd_hrt_ctx {
 
 	struct quadd_unw_methods um;
 	unsigned int get_stack_offset:1;
+	unsigned int pack_callchain:1;
+	unsigned int dedup_callchain:1;
 };
 
 struct task_struct;
@@ -75,6 +75,10 @@ static int show_capabilities(struct seq_file *f, void *offset)
 		   YES_NO(extra & QUADD_COMM_CAP_EXTRA_ARCH_TIMER));
 	seq_printf(f, "arch timer user access:  %s\n",
 		   YES_NO(extra & QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR));
+	seq_printf(f, "packed callchains:       %s\n",
+		   YES_NO(extra & QUADD_COMM_CAP_EXTRA_PACKED_CALLCHAIN));
+	seq_printf(f, "callchain references:    %s\n",
+		   YES_NO(extra & QUADD_COMM_CAP_EXTRA_CALLCHAIN_REF));
 
 	pmu = ctx->pmu;
 	if (pmu) {
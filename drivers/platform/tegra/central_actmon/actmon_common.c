@@ -28,6 +28,7 @@
 #include <linux/version.h>
 
 #include <linux/platform/tegra/actmon_common.h>
+#include <linux/platform/tegra/actmon_telemetry.h>
 
 /* Global definitions */
 static struct actmon_drv_data *actmon;
@@ -211,6 +212,22 @@ static ssize_t avgactv_show(struct kobject *kobj,
 	return scnprintf(buf, PAGE_SIZE, "%lu\n", val);
 }
 
+/* Load relative to the current device clock, for actmon telemetry */
+static u32 actmon_telem_sample(void *data)
+{
+	struct actmon_dev *dev = data;
+	unsigned long flags, avg, load = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state == ACTMON_ON && dev->cur_freq) {
+		avg = actmon_dev_avg_freq_get(dev);
+		load = min(avg * 1000 / dev->cur_freq, 1000UL);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return load;
+}
+
 #ifdef CONFIG_DEBUG_FS
 
 #define RW_MODE (S_IWUSR | S_IRUGO)
@@ -1083,6 +1100,9 @@ int tegra_actmon_register(struct actmon_drv_data *actmon_data)
 			&actmon->devices[i].avgact_attr.attr);
 		if (ret)
 			dev_err(mon_dev, "Couldn't create avg_actv files\n");
+
+		actmon->devices[i].telem = tegra_actmon_telem_add(dn->name,
+			actmon_telem_sample, &actmon->devices[i]);
 	}
 #ifdef CONFIG_DEBUG_FS
 	ret = actmon_debugfs_init();
@@ -1091,6 +1111,8 @@ int tegra_actmon_register(struct actmon_drv_data *actmon_data)
 		return 0;
 
 	for (i = 0; i < MAX_DEVICES; i++) {
+		tegra_actmon_telem_remove(actmon->devices[i].telem);
+		actmon->devices[i].telem = NULL;
 		if (actmon->devices[i].dn)
 			sysfs_remove_file(actmon->actmon_kobj,
 				&actmon->devices[i].avgact_attr.attr);
@@ -1114,6 +1136,8 @@ int tegra_actmon_remove(struct platform_device *pdev)
 #endif
 
 	for (i = 0; i < MAX_DEVICES; i++) {
+		tegra_actmon_telem_remove(actmon->devices[i].telem);
+		actmon->devices[i].telem = NULL;
 		if (actmon->devices[i].dn)
 			sysfs_remove_file(actmon->actmon_kobj,
 				&actmon->devices[i].avgact_attr.attr);
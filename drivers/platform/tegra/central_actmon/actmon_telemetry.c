@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2020, NVIDIA Corporation. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Activity monitor telemetry
+ *
+ * Central and unit activity monitors register a sample callback here. While
+ * /dev/actmon_telemetry is open, an hrtimer kicks a kthread worker every
+ * period_us which samples all sources into a single read-only page, so
+ * monitoring agents can follow load at high rate without a syscall per
+ * sample. See include/uapi/linux/tegra_actmon_telemetry.h for the layout.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+
+#include <linux/platform/tegra/actmon_telemetry.h>
+#include <uapi/linux/tegra_actmon_telemetry.h>
+
+#define ACTMON_TELEM_MAX_SLOTS		32
+#define ACTMON_TELEM_PERIOD_MIN_US	100
+#define ACTMON_TELEM_PERIOD_MAX_US	1000000
+#define ACTMON_TELEM_AVG_SHIFT		3
+#define ACTMON_TELEM_AVG_FRAC		8
+
+struct actmon_telem_src {
+	struct actmon_telem_source *slot;
+	actmon_telem_sample_t sample;
+	void *data;
+	u32 avg_fp;	/* moving average, ACTMON_TELEM_AVG_FRAC fraction bits */
+};
+
+static unsigned int period_us = 1000;
+module_param(period_us, uint, 0644);
+MODULE_PARM_DESC(period_us, "telemetry sampling period, applied on open");
+
+static DEFINE_MUTEX(telem_lock);
+/*
+ * Serializes starting and stopping the sampler. The sample work takes
+ * telem_lock, so the stop path cannot flush it with telem_lock held.
+ * Lock order: telem_run_lock, then telem_lock.
+ */
+static DEFINE_MUTEX(telem_run_lock);
+static struct actmon_telem_header *telem_page;
+static struct actmon_telem_src *telem_srcs[ACTMON_TELEM_MAX_SLOTS];
+static unsigned int telem_users;
+
+static struct kthread_worker *telem_worker;
+static struct kthread_work telem_work;
+static struct hrtimer telem_timer;
+static ktime_t telem_period;
+
+static inline struct actmon_telem_source *telem_slot(int i)
+{
+	return (void *)telem_page + sizeof(*telem_page) +
+		i * sizeof(struct actmon_telem_source);
+}
+
+/* telem_lock must be held */
+static int actmon_telem_alloc_page(void)
+{
+	if (telem_page)
+		return 0;
+
+	telem_page = vmalloc_user(PAGE_SIZE);
+	if (!telem_page)
+		return -ENOMEM;
+
+	telem_page->magic = ACTMON_TELEM_MAGIC;
+	telem_page->version = ACTMON_TELEM_VERSION;
+	telem_page->hdr_size = sizeof(*telem_page);
+	telem_page->src_size = sizeof(struct actmon_telem_source);
+	telem_page->nr_slots = min_t(u32, ACTMON_TELEM_MAX_SLOTS,
+		(PAGE_SIZE - sizeof(*telem_page)) /
+		sizeof(struct actmon_telem_source));
+	telem_page->period_us = period_us;
+	return 0;
+}
+
+static void actmon_telem_slot_begin(struct actmon_telem_source *slot)
+{
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+	smp_wmb();
+}
+
+static void actmon_telem_slot_end(struct actmon_telem_source *slot)
+{
+	smp_wmb();
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+}
+
+static void actmon_telem_sample_one(struct actmon_telem_src *src, u64 now)
+{
+	struct actmon_telem_source *slot = src->slot;
+	u32 load = src->sample(src->data);
+	int bucket;
+
+	if (load > ACTMON_TELEM_LOAD_MAX)
+		load = ACTMON_TELEM_LOAD_MAX;
+
+	/* avg += (load - avg) / 8, in fixed point */
+	src->avg_fp = src->avg_fp - (src->avg_fp >> ACTMON_TELEM_AVG_SHIFT) +
+		((load << ACTMON_TELEM_AVG_FRAC) >> ACTMON_TELEM_AVG_SHIFT);
+
+	bucket = load * ACTMON_TELEM_HIST_BUCKETS /
+		(ACTMON_TELEM_LOAD_MAX + 1);
+
+	actmon_telem_slot_begin(slot);
+	slot->load = load;
+	slot->load_avg = src->avg_fp >> ACTMON_TELEM_AVG_FRAC;
+	if (load > slot->load_max)
+		slot->load_max = load;
+	slot->samples++;
+	slot->timestamp_ns = now;
+	slot->hist[bucket]++;
+	actmon_telem_slot_end(slot);
+}
+
+static void actmon_telem_work_fn(struct kthread_work *work)
+{
+	u64 now = ktime_get_ns();
+	int i;
+
+	mutex_lock(&telem_lock);
+	for (i = 0; i < ACTMON_TELEM_MAX_SLOTS; i++)
+		if (telem_srcs[i])
+			actmon_telem_sample_one(telem_srcs[i], now);
+	mutex_unlock(&telem_lock);
+}
+
+static enum hrtimer_restart actmon_telem_timer_fn(struct hrtimer *timer)
+{
+	/* sources may sleep, so sampling itself runs on the worker */
+	kthread_queue_work(telem_worker, &telem_work);
+	hrtimer_forward_now(timer, telem_period);
+	return HRTIMER_RESTART;
+}
+
+struct actmon_telem_src *tegra_actmon_telem_add(const char *name,
+		actmon_telem_sample_t sample, void *data)
+{
+	struct actmon_telem_src *src;
+	int i, err;
+
+	src = kzalloc(sizeof(*src), GFP_KERNEL);
+	if (!src)
+		return NULL;
+	src->sample = sample;
+	src->data = data;
+
+	mutex_lock(&telem_lock);
+	err = actmon_telem_alloc_page();
+	if (err)
+		goto err_out;
+
+	for (i = 0; i < telem_page->nr_slots; i++)
+		if (!telem_srcs[i])
+			break;
+	if (i == telem_page->nr_slots) {
+		pr_warn("actmon_telemetry: no free slot for %s\n", name);
+		goto err_out;
+	}
+
+	src->slot = telem_slot(i);
+	actmon_telem_slot_begin(src->slot);
+	memset((void *)src->slot + sizeof(src->slot->seq), 0,
+		sizeof(*src->slot) - sizeof(src->slot->seq));
+	strlcpy(src->slot->name, name, sizeof(src->slot->name));
+	actmon_telem_slot_end(src->slot);
+
+	telem_srcs[i] = src;
+	telem_page->generation++;
+	mutex_unlock(&telem_lock);
+	return src;
+
+err_out:
+	mutex_unlock(&telem_lock);
+	kfree(src);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(tegra_actmon_telem_add);
+
+void tegra_actmon_telem_remove(struct actmon_telem_src *src)
+{
+	int i;
+
+	if (!src)
+		return;
+
+	mutex_lock(&telem_lock);
+	for (i = 0; i < ACTMON_TELEM_MAX_SLOTS; i++) {
+		if (telem_srcs[i] != src)
+			continue;
+
+		telem_srcs[i] = NULL;
+		actmon_telem_slot_begin(src->slot);
+		src->slot->name[0] = '\0';
+		actmon_telem_slot_end(src->slot);
+		telem_page->generation++;
+		break;
+	}
+	mutex_unlock(&telem_lock);
+
+	kfree(src);
+}
+EXPORT_SYMBOL_GPL(tegra_actmon_telem_remove);
+
+static int actmon_telem_open(struct inode *inode, struct file *file)
+{
+	int err;
+
+	if (file->f_mode & FMODE_WRITE)
+		return -EPERM;
+
+	mutex_lock(&telem_run_lock);
+	mutex_lock(&telem_lock);
+	err = actmon_telem_alloc_page();
+	if (err)
+		goto out;
+
+	if (telem_users++ == 0) {
+		period_us = clamp_t(unsigned int, period_us,
+			ACTMON_TELEM_PERIOD_MIN_US,
+			ACTMON_TELEM_PERIOD_MAX_US);
+		telem_page->period_us = period_us;
+		telem_period = ns_to_ktime((u64)period_us * NSEC_PER_USEC);
+		hrtimer_start(&telem_timer, telem_period, HRTIMER_MODE_REL);
+	}
+out:
+	mutex_unlock(&telem_lock);
+	mutex_unlock(&telem_run_lock);
+	return err;
+}
+
+static int actmon_telem_release(struct inode *inode, struct file *file)
+{
+	bool stop;
+
+	mutex_lock(&telem_run_lock);
+	mutex_lock(&telem_lock);
+	stop = --telem_users == 0;
+	mutex_unlock(&telem_lock);
+
+	/* an open racing with us waits for the timer to be stopped */
+	if (stop) {
+		hrtimer_cancel(&telem_timer);
+		kthread_flush_work(&telem_work);
+	}
+	mutex_unlock(&telem_run_lock);
+	return 0;
+}
+
+static int actmon_telem_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > PAGE_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, telem_page, 0);
+}
+
+static const struct file_operations actmon_telem_fops = {
+	.owner		= THIS_MODULE,
+	.open		= actmon_telem_open,
+	.release	= actmon_telem_release,
+	.mmap		= actmon_telem_mmap,
+	.llseek		= noop_llseek,
+};
+
+static struct miscdevice actmon_telem_misc = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "actmon_telemetry",
+	.fops	= &actmon_telem_fops,
+	.mode	= 0444,
+};
+
+static int __init actmon_telem_init(void)
+{
+	int ret;
+
+	telem_worker = kthread_create_worker(0, "actmon_telem");
+	if (IS_ERR(telem_worker)) {
+		ret = PTR_ERR(telem_worker);
+		telem_worker = NULL;
+		return ret;
+	}
+	kthread_init_work(&telem_work, actmon_telem_work_fn);
+
+	hrtimer_init(&telem_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	telem_timer.function = actmon_telem_timer_fn;
+
+	ret = misc_register(&actmon_telem_misc);
+	if (ret) {
+		pr_err("actmon_telemetry: misc_register failed %d\n", ret);
+		kthread_destroy_worker(telem_worker);
+		telem_worker = NULL;
+	}
+	return ret;
+}
+late_initcall(actmon_telem_init);
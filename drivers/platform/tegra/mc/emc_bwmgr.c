@@ -16,6 +16,8 @@
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 #include <linux/platform/tegra/isomgr.h>
 #include <linux/debugfs.h>
@@ -43,6 +45,11 @@ int emc_to_dram_freq_factor;
 #define IS_HANDLE_VALID(x) ((x >= bwmgr.bwmgr_client) && \
 		(x < bwmgr.bwmgr_client + TEGRA_BWMGR_CLIENT_COUNT))
 
+/* defaults for lowering the emc rate, see bwmgr_down_work() */
+#define BWMGR_DOWN_DELAY_MS_DEFAULT	20
+#define BWMGR_DOWN_HYST_PCT_DEFAULT	5
+#define BWMGR_DOWN_STEP_PCT_DEFAULT	50
+
 struct tegra_bwmgr_client {
 	unsigned long bw;
 	unsigned long iso_bw;
@@ -50,6 +57,11 @@ struct tegra_bwmgr_client {
 	unsigned long iso_cap;
 	unsigned long floor;
 	int refcount;
+
+	/* request statistics */
+	atomic_long_t nr_reqs;
+	atomic_long_t nr_unchanged;
+	unsigned long nr_reqs_shown;
 };
 
 /* TODO: Manage client state in a dynamic list */
@@ -63,6 +75,20 @@ static struct {
 	bool status;
 	struct bwmgr_ops *ops;
 	bool override;
+
+	/*
+	 * Raising the rate is applied right away. Lowering it is deferred
+	 * by down_delay_ms so that bursts of release/acquire requests are
+	 * coalesced into a single clock change.
+	 */
+	unsigned long cur_rate;
+	struct delayed_work down_work;
+	u32 down_delay_ms;
+	u32 down_hyst_pct;
+	u32 down_step_pct;
+	u64 nr_rate_changes;
+	u64 nr_down_deferred;
+	unsigned long stats_shown_jiffies;
 } bwmgr;
 
 static struct dram_refresh_alrt {
@@ -215,7 +241,7 @@ static unsigned long tegra_bwmgr_apply_efficiency(
 }
 
 /* call with bwmgr lock held */
-static int bwmgr_update_clk(void)
+static unsigned long bwmgr_calc_rate(void)
 {
 	int i;
 	unsigned long bw = 0;
@@ -228,18 +254,9 @@ static int bwmgr_update_clk(void)
 	unsigned long floor = 0;
 	unsigned long iso_bw_min;
 	u64 iso_client_flags = 0;
-	int ret = 0;
 
 	/* sizeof(iso_client_flags) */
 	BUILD_BUG_ON(TEGRA_BWMGR_CLIENT_COUNT > 64);
-	/* check that lock is held */
-	if (unlikely(bwmgr.task != current)) {
-		pr_err("bwmgr: %s called without lock\n", __func__);
-		return -EINVAL;
-	}
-
-	if (bwmgr.override)
-		return 0;
 
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
 		bw += bwmgr.bwmgr_client[i].bw;
@@ -289,15 +306,132 @@ static int bwmgr_update_clk(void)
 	bw = max(bw, floor);
 	bw = min(bw, min(iso_cap, max(non_iso_cap, iso_bw_min)));
 	debug_info.calc_freq = bw;
+
+	return bw;
+}
+
+/* call with bwmgr lock held */
+static int bwmgr_apply_rate(unsigned long bw)
+{
+	int ret;
+
+	if (bw == bwmgr.cur_rate)
+		return 0;
+
 	debug_info.req_freq = bw;
 
 	ret = clk_set_rate(bwmgr.emc_clk, bw);
-	if (ret)
+	if (ret) {
 		pr_err
 		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
 				bw, ret);
+		return ret;
+	}
 
-	return ret;
+	bwmgr.cur_rate = bw;
+	bwmgr.nr_rate_changes++;
+
+	return 0;
+}
+
+/*
+ * call with bwmgr lock held
+ *
+ * defer_down may only be set when the request cannot have lowered a cap:
+ * keeping the current rate a little longer is fine for bandwidth and floor
+ * requests, but never for a cap.
+ */
+static int bwmgr_update_clk(bool defer_down)
+{
+	unsigned long bw;
+
+	/* check that lock is held */
+	if (unlikely(bwmgr.task != current)) {
+		pr_err("bwmgr: %s called without lock\n", __func__);
+		return -EINVAL;
+	}
+
+	if (bwmgr.override)
+		return 0;
+
+	bw = bwmgr_calc_rate();
+
+	if (defer_down && bwmgr.down_delay_ms && bw < bwmgr.cur_rate) {
+		/* do not push an already pending update further out */
+		if (schedule_delayed_work(&bwmgr.down_work,
+				msecs_to_jiffies(bwmgr.down_delay_ms)))
+			bwmgr.nr_down_deferred++;
+		return 0;
+	}
+
+	return bwmgr_apply_rate(bw);
+}
+
+static void bwmgr_down_work(struct work_struct *work)
+{
+	unsigned long bw, hyst, step;
+
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return;
+	}
+
+	if (bwmgr.override || clk_update_disabled)
+		goto out;
+
+	bw = bwmgr_calc_rate();
+	if (bw >= bwmgr.cur_rate) {
+		bwmgr_apply_rate(bw);
+		goto out;
+	}
+
+	/* not worth a clock change */
+	hyst = bwmgr.cur_rate / 100 * bwmgr.down_hyst_pct;
+	if (bwmgr.cur_rate - bw < hyst)
+		goto out;
+
+	/* limit how far a single update may drop, finish in the next one */
+	if (bwmgr.down_step_pct) {
+		step = bwmgr.cur_rate / 100 * bwmgr.down_step_pct;
+		if (bwmgr.cur_rate - bw > step) {
+			bw = bwmgr.cur_rate - step;
+			schedule_delayed_work(&bwmgr.down_work,
+				msecs_to_jiffies(bwmgr.down_delay_ms));
+		}
+	}
+
+	bwmgr_apply_rate(bw);
+
+out:
+	if (!bwmgr_unlock())
+		pr_err("bwmgr: %s failed\n", __func__);
+}
+
+/*
+ * Lockless check for a request that matches what the client already has.
+ * Such a request cannot change the aggregate, so it does not need the lock.
+ */
+static bool bwmgr_req_unchanged(struct tegra_bwmgr_client *handle,
+		unsigned long val, enum tegra_bwmgr_request_type req)
+{
+	switch (req) {
+	case TEGRA_BWMGR_SET_EMC_FLOOR:
+		return READ_ONCE(handle->floor) == val;
+	case TEGRA_BWMGR_SET_EMC_CAP:
+		if (val == 0)
+			val = bwmgr.emc_max_rate;
+		return READ_ONCE(handle->cap) == val;
+	case TEGRA_BWMGR_SET_EMC_ISO_CAP:
+		if (val == 0)
+			val = bwmgr.emc_max_rate;
+		return READ_ONCE(handle->iso_cap) == val;
+	case TEGRA_BWMGR_SET_EMC_SHARED_BW:
+		return READ_ONCE(handle->bw) == val;
+	case TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO:
+		return READ_ONCE(handle->iso_bw) == val;
+	default:
+		return false;
+	}
 }
 
 struct tegra_bwmgr_client *tegra_bwmgr_register(
@@ -409,6 +543,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 {
 	int ret = 0;
 	bool update_clk = false;
+	bool defer_down = true;
 
 	if (!bwmgr.emc_clk)
 		return 0;
@@ -436,6 +571,19 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_TRACEPOINTS
+	trace_tegra_bwmgr_set_emc(
+			tegra_bwmgr_client_names[handle - bwmgr.bwmgr_client],
+			val, bwmgr_req_to_name(req));
+#endif /* CONFIG_TRACEPOINTS */
+
+	atomic_long_inc(&handle->nr_reqs);
+
+	if (bwmgr_req_unchanged(handle, val, req)) {
+		atomic_long_inc(&handle->nr_unchanged);
+		return 0;
+	}
+
 	if (!bwmgr_lock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
 			__func__,
@@ -443,12 +591,6 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
-#ifdef CONFIG_TRACEPOINTS
-	trace_tegra_bwmgr_set_emc(
-			tegra_bwmgr_client_names[handle - bwmgr.bwmgr_client],
-			val, bwmgr_req_to_name(req));
-#endif /* CONFIG_TRACEPOINTS */
-
 	switch (req) {
 	case TEGRA_BWMGR_SET_EMC_FLOOR:
 		if (handle->floor != val) {
@@ -462,6 +604,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->cap != val) {
+			defer_down = val > handle->cap;
 			handle->cap = val;
 			update_clk = true;
 		}
@@ -472,6 +615,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->iso_cap != val) {
+			defer_down = val > handle->iso_cap;
 			handle->iso_cap = val;
 			update_clk = true;
 		}
@@ -503,7 +647,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 	}
 
 	if (update_clk && !clk_update_disabled)
-		ret = bwmgr_update_clk();
+		ret = bwmgr_update_clk(defer_down);
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
@@ -739,7 +883,7 @@ static int tegra_bwmgr_update_efficiency(unsigned long cur_state,
 		bwmgr.ops->update_efficiency(cur_state);
 
 	if (!clk_update_disabled)
-		ret = bwmgr_update_clk();
+		ret = bwmgr_update_clk(false);
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed.\n", __func__);
@@ -785,6 +929,10 @@ int __init bwmgr_init(void)
 	struct clk *emc_master_clk;
 
 	mutex_init(&bwmgr.lock);
+	INIT_DELAYED_WORK(&bwmgr.down_work, bwmgr_down_work);
+	bwmgr.down_delay_ms = BWMGR_DOWN_DELAY_MS_DEFAULT;
+	bwmgr.down_hyst_pct = BWMGR_DOWN_HYST_PCT_DEFAULT;
+	bwmgr.down_step_pct = BWMGR_DOWN_STEP_PCT_DEFAULT;
 
 	if (tegra_get_chip_id() == TEGRA210)
 		bwmgr.ops = bwmgr_eff_init_t21x();
@@ -863,6 +1011,8 @@ void __exit bwmgr_exit(void)
 {
 	int i;
 
+	cancel_delayed_work_sync(&bwmgr.down_work);
+
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
 
@@ -954,9 +1104,11 @@ static int bwmgr_debugfs_emc_rate_set(void *data, u64 val)
 
 	if (val == 0) {
 		bwmgr.override = false;
-		bwmgr_update_clk();
+		bwmgr_update_clk(false);
 	} else if (bwmgr.emc_clk) {
 		bwmgr.override = true;
+		/* forget the arbitrated rate, re-apply it on release */
+		bwmgr.cur_rate = 0;
 		ret = clk_set_rate(bwmgr.emc_clk, val);
 	}
 
@@ -1073,23 +1225,37 @@ static int bwmgr_debugfs_iso_bw_get(void *data, u64 *val)
 static int bwmgr_clients_info_show(struct seq_file *s, void *data)
 {
 	int i;
+	unsigned long now = jiffies;
+	unsigned long elapsed;
 
 	if (!bwmgr_lock()) {
 		pr_err("bwmgr: %s failed\n", __func__);
 		return -EINVAL;
 	}
-	seq_printf(s, "%15s%15s%15s%15s%15s%15s (Khz)\n", "Client",
-			"Floor", "SharedBw", "SharedIsoBw", "Cap",
-			"IsoCap");
+	elapsed = max(now - bwmgr.stats_shown_jiffies, 1UL);
+	bwmgr.stats_shown_jiffies = now;
+
+	seq_printf(s, "%15s%15s%15s%15s%15s%15s (Khz)%12s%12s%12s\n",
+			"Client", "Floor", "SharedBw", "SharedIsoBw", "Cap",
+			"IsoCap", "Requests", "Unchanged", "Req/s");
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
-		seq_printf(s, "%14s%s%15lu%15lu%15lu%15lu%15lu\n",
+		struct tegra_bwmgr_client *client = &bwmgr.bwmgr_client[i];
+		unsigned long nr_reqs = atomic_long_read(&client->nr_reqs);
+
+		/* request rate since the previous read of this file */
+		seq_printf(s, "%14s%s%15lu%15lu%15lu%15lu%15lu      %12lu%12lu%12lu\n",
 				tegra_bwmgr_client_names[i],
-				bwmgr.bwmgr_client[i].refcount ? "*" : " ",
-				bwmgr.bwmgr_client[i].floor / 1000,
-				bwmgr.bwmgr_client[i].bw / 1000,
-				bwmgr.bwmgr_client[i].iso_bw / 1000,
-				bwmgr.bwmgr_client[i].cap / 1000,
-				bwmgr.bwmgr_client[i].iso_cap / 1000);
+				client->refcount ? "*" : " ",
+				client->floor / 1000,
+				client->bw / 1000,
+				client->iso_bw / 1000,
+				client->cap / 1000,
+				client->iso_cap / 1000,
+				nr_reqs,
+				atomic_long_read(&client->nr_unchanged),
+				(nr_reqs - client->nr_reqs_shown) * HZ /
+					elapsed);
+		client->nr_reqs_shown = nr_reqs;
 	}
 	seq_printf(s, "Total BW requested                              : %lu (Khz)\n",
 				 debug_info.bw / 1000);
@@ -1113,6 +1279,10 @@ static int bwmgr_clients_info_show(struct seq_file *s, void *data)
 				 debug_info.req_freq / 1000);
 	seq_printf(s, "EMC current rate                                : %lu (Khz)\n",
 				 tegra_bwmgr_get_emc_rate() / 1000);
+	seq_printf(s, "EMC rate changes                                : %llu\n",
+				 bwmgr.nr_rate_changes);
+	seq_printf(s, "EMC rate decreases deferred                     : %llu\n",
+				 bwmgr.nr_down_deferred);
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed\n", __func__);
 		return -EINVAL;
@@ -1150,6 +1320,15 @@ static void bwmgr_debugfs_init(void)
 		debugfs_create_bool(
 			"clk_update_disabled", S_IRWXU, debugfs_dir,
 			&clk_update_disabled);
+		debugfs_create_u32(
+			"down_delay_ms", S_IRUSR | S_IWUSR, debugfs_dir,
+			&bwmgr.down_delay_ms);
+		debugfs_create_u32(
+			"down_hysteresis_pct", S_IRUSR | S_IWUSR, debugfs_dir,
+			&bwmgr.down_hyst_pct);
+		debugfs_create_u32(
+			"down_step_pct", S_IRUSR | S_IWUSR, debugfs_dir,
+			&bwmgr.down_step_pct);
 		debugfs_node_emc_min = debugfs_create_u64(
 			"emc_min_rate", S_IRUSR, debugfs_dir,
 			(u64 *) &bwmgr.emc_min_rate);
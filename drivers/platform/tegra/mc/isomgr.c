@@ -31,6 +31,13 @@
 #include <linux/kref.h>
 #include <linux/sched.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_buf.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
 #include <soc/tegra/chip-id.h>
 #include <asm/processor.h>
 #include <asm/current.h>
@@ -38,6 +45,7 @@
 #include <linux/platform/tegra/isomgr.h>
 
 #include <linux/platform/tegra/emc_bwmgr.h>
+#include <linux/platform/tegra/latency_allowance.h>
 #ifdef CONFIG_COMMON_CLK
 #include <linux/platform/tegra/bwmgr_mc.h>
 #else
@@ -82,6 +90,9 @@ do { \
 /* To allow test code take over control */
 static bool test_mode;
 
+/* Admission replay in progress, keep update_mc_clock() off the clocks */
+static bool replay_active;
+
 char *cname[] = {
 	"disp_0",
 	"disp_1",
@@ -181,6 +192,9 @@ static void update_mc_clock(void)
 	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++)
 		isomgr.lt_mf = max(isomgr.lt_mf, isomgr_clients[i].real_mf);
 
+	if (replay_active)
+		return;
+
 	/* request the floor freq to satisfy LT */
 	if (isomgr.lt_mf_rq != isomgr.lt_mf) {
 #ifdef CONFIG_COMMON_CLK
@@ -329,6 +343,26 @@ static bool is_client_valid(enum tegra_iso_client client)
 	return true;
 }
 
+/* call with isomgr_lock held. */
+static bool isomgr_do_register(struct isomgr_client *cp,
+			enum tegra_iso_client client, s32 dedi_bw,
+			tegra_isomgr_renegotiate renegotiate, void *priv)
+{
+	if (isomgr.ops->isomgr_plat_register &&
+	    !isomgr.ops->isomgr_plat_register(dedi_bw, client))
+		return false;
+
+	purge_isomgr_client(cp);
+	cp->magic = ISOMGR_MAGIC;
+	kref_init(&cp->kref);
+	cp->dedi_bw = dedi_bw;
+	cp->renegotiate = renegotiate;
+	cp->priv = priv;
+	isomgr.dedi_bw += dedi_bw;
+
+	return true;
+}
+
 static tegra_isomgr_handle __tegra_isomgr_register(
 			enum tegra_iso_client client, u32 udedi_bw,
 			tegra_isomgr_renegotiate renegotiate, void *priv)
@@ -354,19 +388,9 @@ static tegra_isomgr_handle __tegra_isomgr_register(
 	if (unlikely(OBJ_REF_READ(&cp->kref.refcount)))
 		goto fail_unlock;
 
-	if (isomgr.ops->isomgr_plat_register) {
-		ret = isomgr.ops->isomgr_plat_register(dedi_bw, client);
-		if (!ret)
-			goto fail_unlock;
-	}
-
-	purge_isomgr_client(cp);
-	cp->magic = ISOMGR_MAGIC;
-	kref_init(&cp->kref);
-	cp->dedi_bw = dedi_bw;
-	cp->renegotiate = renegotiate;
-	cp->priv = priv;
-	isomgr.dedi_bw += dedi_bw;
+	ret = isomgr_do_register(cp, client, dedi_bw, renegotiate, priv);
+	if (!ret)
+		goto fail_unlock;
 
 	if (!isomgr_unlock()) {
 		pr_err("isomgr: %s failed for %s\n",
@@ -457,12 +481,44 @@ void tegra_isomgr_unregister(tegra_isomgr_handle handle)
 }
 EXPORT_SYMBOL(tegra_isomgr_unregister);
 
-static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
+/*
+ * call with isomgr_lock held and a reference on cp.
+ * returns dvfs latency thresh in usec, 0 if the reservation is refused.
+ */
+static u32 isomgr_do_reserve(struct isomgr_client *cp, int client,
 			 u32 ubw, u32 ult)
 {
 	s32 bw = ubw;
-	bool ret = 0;
-	u32 mf, dvfs_latency = 0;
+	u32 mf, dvfs_latency;
+
+	if (unlikely(cp->realize))
+		return 0;
+
+	if (unlikely(!cp->renegotiate && bw > cp->dedi_bw))
+		return 0;
+
+	if (isomgr.ops->isomgr_plat_reserve &&
+	    !isomgr.ops->isomgr_plat_reserve(cp, bw,
+			(enum tegra_iso_client)client))
+		return 0;
+
+	/* Look up MC's min freq that could satisfy requested BW and LT */
+	mf = mc_min_freq(ubw, ult);
+	/* Look up MC's dvfs latency at min freq */
+	dvfs_latency = mc_dvfs_latency(mf);
+
+	cp->lti = ult;		/* remember client spec'd LT (usec) */
+	cp->lto = dvfs_latency;	/* remember MC calculated LT (usec) */
+	cp->rsvd_mf = mf;	/* remember associated min freq */
+	cp->rsvd_bw = bw;
+
+	return dvfs_latency;
+}
+
+static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
+			 u32 ubw, u32 ult)
+{
+	u32 dvfs_latency = 0;
 	struct isomgr_client *cp = (struct isomgr_client *) handle;
 	int client = cp - &isomgr_clients[0];
 
@@ -488,29 +544,8 @@ static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
 
 	trace_tegra_isomgr_reserve(handle, ubw, ult, cname[client], "enter");
 
-	if (unlikely(cp->realize))
-		goto out;
-
-	if (unlikely(!cp->renegotiate && bw > cp->dedi_bw))
-		goto out;
-
-	if (isomgr.ops->isomgr_plat_reserve) {
-		ret = isomgr.ops->isomgr_plat_reserve(cp, bw,
-				(enum tegra_iso_client)client);
-		if (!ret)
-			goto out;
-	}
-
-	/* Look up MC's min freq that could satisfy requested BW and LT */
-	mf = mc_min_freq(ubw, ult);
-	/* Look up MC's dvfs latency at min freq */
-	dvfs_latency = mc_dvfs_latency(mf);
+	dvfs_latency = isomgr_do_reserve(cp, client, ubw, ult);
 
-	cp->lti = ult;		/* remember client spec'd LT (usec) */
-	cp->lto = dvfs_latency;	/* remember MC calculated LT (usec) */
-	cp->rsvd_mf = mf;	/* remember associated min freq */
-	cp->rsvd_bw = bw;
-out:
 	kref_put(&cp->kref, unregister_iso_client);
 	if (!isomgr_unlock()) {
 		pr_err("isomgr: %s failed for %s\n",
@@ -553,10 +588,25 @@ u32 tegra_isomgr_reserve(tegra_isomgr_handle handle,
 }
 EXPORT_SYMBOL(tegra_isomgr_reserve);
 
+/*
+ * call with isomgr_lock held and a reference on cp.
+ * returns dvfs latency thresh in usec, 0 if the realize failed.
+ */
+static u32 isomgr_do_realize(struct isomgr_client *cp)
+{
+	if (isomgr.ops->isomgr_plat_realize &&
+	    !isomgr.ops->isomgr_plat_realize(cp))
+		return 0;
+
+	cp->realize = false;
+	update_mc_clock();
+
+	return (u32)cp->lto;
+}
+
 static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 {
 	u32 dvfs_latency = 0;
-	bool ret = 0;
 	struct isomgr_client *cp = (struct isomgr_client *) handle;
 	int client = cp - &isomgr_clients[0];
 
@@ -582,17 +632,8 @@ static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 
 	trace_tegra_isomgr_realize(handle, cname[client], "enter");
 
-	if (isomgr.ops->isomgr_plat_realize) {
-		ret = isomgr.ops->isomgr_plat_realize(cp);
-		if (!ret)
-			goto out;
-	}
-
-	dvfs_latency = (u32)cp->lto;
-	cp->realize = false;
-	update_mc_clock();
+	dvfs_latency = isomgr_do_realize(cp);
 
-out:
 	kref_put(&cp->kref, unregister_iso_client);
 	if (!isomgr_unlock()) {
 		pr_err("isomgr: %s failed for %s\n",
@@ -972,6 +1013,324 @@ static void isomgr_create_sysfs(void)
 static inline void isomgr_create_sysfs(void) {};
 #endif /* CONFIG_TEGRA_ISOMGR_SYSFS */
 
+#ifdef CONFIG_TEGRA_ISOMGR_REPLAY
+/*
+ * Admission replay
+ *
+ * A script of client operations written to debugfs isomgr/replay is run
+ * through the same admission paths as real clients, with the clock
+ * updates suppressed, and the resulting decisions are reported back when
+ * the file is read.  The isomgr state is saved before and restored after
+ * each script, so a replay never changes what real clients see.  Real
+ * clients block on the isomgr lock while a replay runs.
+ *
+ * One operation per line, bandwidth in KB/sec, latency in usec:
+ *	reset				start from an empty pool
+ *	register <client> <dedi_bw> [reneg]
+ *	reserve <client> <bw> <lt>
+ *	realize <client>
+ *	unregister <client>
+ *	disp_la <la_id> <emc_khz> <bw_mbps>	la/ptsa check, no programming
+ */
+
+#define REPLAY_SCRIPT_MAX	SZ_64K
+#define REPLAY_REPORT_MAX	SZ_128K
+
+struct isomgr_replay_state {
+	struct isomgr_client clients[TEGRA_ISO_CLIENT_COUNT];
+	s32 lt_mf;
+	s32 avail_bw;
+	s32 dedi_bw;
+	s32 sleep_bw;
+};
+
+static DEFINE_MUTEX(replay_lock);
+static char *replay_report;
+static size_t replay_report_len;
+
+static void isomgr_replay_renegotiate(void *priv, u32 avail_bw)
+{
+}
+
+/* copies the admission state only, never the kobjects or completions */
+static void isomgr_replay_copy_client(struct isomgr_client *dst,
+				      struct isomgr_client *src)
+{
+	dst->magic = src->magic;
+	OBJ_REF_SET(&dst->kref.refcount, OBJ_REF_READ(&src->kref.refcount));
+	dst->dedi_bw = src->dedi_bw;
+	dst->rsvd_bw = src->rsvd_bw;
+	dst->real_bw = src->real_bw;
+	dst->lti = src->lti;
+	dst->lto = src->lto;
+	dst->rsvd_mf = src->rsvd_mf;
+	dst->real_mf = src->real_mf;
+	dst->renegotiate = src->renegotiate;
+	dst->realize = src->realize;
+	dst->sleep_bw = src->sleep_bw;
+	dst->margin_bw = src->margin_bw;
+	dst->priv = src->priv;
+}
+
+/* call with isomgr_lock held. */
+static void isomgr_replay_save(struct isomgr_replay_state *st)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++)
+		isomgr_replay_copy_client(&st->clients[i], &isomgr_clients[i]);
+	st->lt_mf = isomgr.lt_mf;
+	st->avail_bw = isomgr.avail_bw;
+	st->dedi_bw = isomgr.dedi_bw;
+	st->sleep_bw = isomgr.sleep_bw;
+}
+
+/* call with isomgr_lock held. */
+static void isomgr_replay_restore(struct isomgr_replay_state *st)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++)
+		isomgr_replay_copy_client(&isomgr_clients[i], &st->clients[i]);
+	isomgr.lt_mf = st->lt_mf;
+	isomgr.avail_bw = st->avail_bw;
+	isomgr.dedi_bw = st->dedi_bw;
+	isomgr.sleep_bw = st->sleep_bw;
+}
+
+/* call with isomgr_lock held. */
+static void isomgr_replay_reset(void)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++)
+		purge_isomgr_client(&isomgr_clients[i]);
+	isomgr.lt_mf = 0;
+	isomgr.avail_bw = isomgr.max_iso_bw;
+	isomgr.dedi_bw = 0;
+	isomgr.sleep_bw = 0;
+}
+
+static int isomgr_replay_client(const char *name)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++) {
+		if (client_valid[i] && !strcmp(cname[i], name))
+			return i;
+	}
+
+	return -EINVAL;
+}
+
+/* call with isomgr_lock held. returns true if the operation was admitted */
+static bool isomgr_replay_op(struct seq_buf *s, char *line)
+{
+	char op[16], name[32], extra[8] = "";
+	struct isomgr_client *cp;
+	u32 a = 0, b = 0, c = 0;
+	u32 lto = 0;
+	bool ok = false;
+	int client, pos = 0;
+
+	if (sscanf(line, "%15s %n", op, &pos) < 1)
+		return false;
+
+	if (!strcmp(op, "reset")) {
+		isomgr_replay_reset();
+		seq_buf_printf(s, "reset\n");
+		return true;
+	}
+
+	if (!strcmp(op, "disp_la")) {
+		struct dc_to_la_params disp_params = { 0 };
+		int ret;
+
+		if (sscanf(line + pos, "%u %u %u", &a, &b, &c) != 3 ||
+		    a >= TEGRA_LA_MAX_ID)
+			goto bad_line;
+
+		ret = tegra_check_disp_latency_allowance(a,
+				(unsigned long)b * 1000, c, disp_params);
+		seq_buf_printf(s, "%-10s %-18u %10u %6u -> %-4s\n",
+				op, a, b, c, ret ? "fail" : "ok");
+		return !ret;
+	}
+
+	if (sscanf(line + pos, "%31s %u %u", name, &a, &b) < 1)
+		goto bad_line;
+
+	client = isomgr_replay_client(name);
+	if (client < 0)
+		goto bad_line;
+	cp = &isomgr_clients[client];
+
+	if (!strcmp(op, "register")) {
+		if (sscanf(line + pos, "%31s %u %7s", name, &a, extra) < 2)
+			goto bad_line;
+		if (!OBJ_REF_READ(&cp->kref.refcount))
+			ok = isomgr_do_register(cp, client, a,
+				strcmp(extra, "reneg") ? NULL :
+				isomgr_replay_renegotiate, NULL);
+	} else if (!strcmp(op, "reserve")) {
+		if (sscanf(line + pos, "%31s %u %u", name, &a, &b) != 3)
+			goto bad_line;
+		/*
+		 * No cached-result shortcuts here: every op is admitted
+		 * against the bandwidth available at this point of the trace.
+		 */
+		if (OBJ_REF_READ(&cp->kref.refcount))
+			lto = isomgr_do_reserve(cp, client, a, b);
+		ok = lto != 0;
+	} else if (!strcmp(op, "realize")) {
+		if (OBJ_REF_READ(&cp->kref.refcount))
+			lto = isomgr_do_realize(cp);
+		ok = lto != 0;
+	} else if (!strcmp(op, "unregister")) {
+		ok = OBJ_REF_READ(&cp->kref.refcount) && !cp->realize;
+		if (ok)
+			kref_put(&cp->kref, unregister_iso_client);
+	} else {
+		goto bad_line;
+	}
+
+	seq_buf_printf(s,
+		"%-10s %-18s %10u %6u -> %-4s lto=%uus rsvd_mf=%dKHz real_mf=%dKHz avail_bw=%dKB lt_mf=%dKHz\n",
+		op, name, a, b, ok ? "ok" : "fail", lto, cp->rsvd_mf,
+		cp->real_mf, isomgr.avail_bw, isomgr.lt_mf);
+	return ok;
+
+bad_line:
+	seq_buf_printf(s, "invalid: %s\n", line);
+	return false;
+}
+
+static void isomgr_replay_run(struct seq_buf *s, char *script)
+{
+	struct isomgr_replay_state *st;
+	unsigned int nr_ops = 0, nr_ok = 0;
+	u64 t, total_ns = 0, max_ns = 0;
+	char *line;
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st) {
+		seq_buf_printf(s, "out of memory\n");
+		return;
+	}
+
+	if (!isomgr_lock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		kfree(st);
+		return;
+	}
+
+	isomgr_replay_save(st);
+	replay_active = true;
+
+	while ((line = strsep(&script, "\n")) != NULL) {
+		line = strim(line);
+		if (*line == '\0' || *line == '#')
+			continue;
+
+		t = ktime_get_ns();
+		if (isomgr_replay_op(s, line))
+			nr_ok++;
+		t = ktime_get_ns() - t;
+
+		total_ns += t;
+		max_ns = max(max_ns, t);
+		nr_ops++;
+	}
+
+	/* lt_mf is the emc floor isomgr would request from bwmgr */
+	seq_buf_printf(s, "final: avail_bw=%dKB dedi_bw=%dKB lt_mf=%dKHz\n",
+		isomgr.avail_bw, isomgr.dedi_bw, isomgr.lt_mf);
+
+	replay_active = false;
+	isomgr_replay_restore(st);
+
+	if (!isomgr_unlock())
+		pr_err("isomgr: %s failed\n", __func__);
+
+	seq_buf_printf(s, "ops=%u admitted=%u rejected=%u total=%lluns max=%lluns\n",
+		nr_ops, nr_ok, nr_ops - nr_ok, total_ns, max_ns);
+
+	kfree(st);
+}
+
+static ssize_t isomgr_replay_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_buf s;
+	char *script, *report;
+
+	if (count == 0 || count > REPLAY_SCRIPT_MAX)
+		return -EINVAL;
+
+	script = memdup_user_nul(buf, count);
+	if (IS_ERR(script))
+		return PTR_ERR(script);
+
+	report = vzalloc(REPLAY_REPORT_MAX);
+	if (!report) {
+		kfree(script);
+		return -ENOMEM;
+	}
+
+	seq_buf_init(&s, report, REPLAY_REPORT_MAX);
+	isomgr_replay_run(&s, script);
+	kfree(script);
+
+	mutex_lock(&replay_lock);
+	vfree(replay_report);
+	replay_report = report;
+	replay_report_len = seq_buf_used(&s);
+	mutex_unlock(&replay_lock);
+
+	return count;
+}
+
+static int isomgr_replay_show(struct seq_file *m, void *data)
+{
+	mutex_lock(&replay_lock);
+	if (replay_report)
+		seq_write(m, replay_report, replay_report_len);
+	mutex_unlock(&replay_lock);
+
+	return 0;
+}
+
+static int isomgr_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, isomgr_replay_show, inode->i_private);
+}
+
+static const struct file_operations fops_isomgr_replay = {
+	.open = isomgr_replay_open,
+	.read = seq_read,
+	.write = isomgr_replay_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void isomgr_replay_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("isomgr", NULL);
+	if (IS_ERR_OR_NULL(dir)) {
+		pr_err("isomgr: error creating debugfs dir\n");
+		return;
+	}
+
+	if (!debugfs_create_file("replay", S_IRUSR | S_IWUSR, dir, NULL,
+				 &fops_isomgr_replay))
+		pr_err("isomgr: error creating replay node\n");
+}
+#else
+static inline void isomgr_replay_init(void) {};
+#endif /* CONFIG_TEGRA_ISOMGR_REPLAY */
+
 int __init isomgr_init(void)
 {
 	int i;
@@ -1037,6 +1396,7 @@ int __init isomgr_init(void)
 	}
 
 	isomgr_create_sysfs();
+	isomgr_replay_init();
 	return 0;
 }
 #ifdef CONFIG_COMMON_CLK
@@ -18,7 +18,9 @@
 
 #include <linux/tegra-capture-ivc.h>
 
+#include <linux/atomic.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
@@ -26,6 +28,8 @@
 #include <linux/tegra-ivc.h>
 #include <linux/tegra-ivc-bus.h>
 #include <linux/nospec.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 #include <asm/barrier.h>
 
@@ -43,10 +47,34 @@
 /* Temporay csi channel-id */
 #define CSI_TEMP_CHANNEL_ID 65
 
+/* Status indications buffered per capture channel before the reader stalls */
+#define CHAN_QUEUE_DEPTH 16
+
+struct tegra_capture_ivc;
+
 struct tegra_capture_ivc_cb_ctx {
 	struct list_head node;
 	tegra_capture_ivc_cb_func cb_func;
 	const void *priv_context;
+
+	/* Per-channel completion context, capture IVC channel only */
+	struct tegra_capture_ivc *civc;
+	struct work_struct work;
+	spinlock_t queue_lock;
+	struct CAPTURE_MSG *queue;
+	unsigned int queue_head;
+	unsigned int queue_count;
+	bool rx_stalled;
+};
+
+/* Updated from the writers, the reader and the channel contexts */
+struct tegra_capture_ivc_stats {
+	atomic64_t tx_msgs;
+	atomic64_t tx_waits;
+	atomic64_t rx_msgs;
+	atomic64_t rx_deferred;
+	atomic64_t rx_stalls;
+	atomic_t chan_queue_max;
 };
 
 struct tegra_capture_ivc {
@@ -58,6 +86,9 @@ struct tegra_capture_ivc {
 	struct tegra_capture_ivc_cb_ctx cb_ctx[TOTAL_CHANNELS];
 	spinlock_t avl_ctx_list_lock;
 	struct list_head avl_ctx_list;
+	struct workqueue_struct *cb_wq;
+	struct tegra_capture_ivc_stats stats;
+	struct dentry *debugfs_root;
 };
 
 /*
@@ -97,10 +128,15 @@ static int tegra_capture_ivc_tx(struct tegra_capture_ivc *civc,
 	if (unlikely(ret))
 		return ret;
 
+	if (!tegra_ivc_can_write(&chan->ivc))
+		atomic64_inc(&civc->stats.tx_waits);
+
 	ret = wait_event_interruptible(civc->write_q,
 				tegra_ivc_can_write(&chan->ivc));
 	if (likely(ret == 0))
 		ret = tegra_ivc_write(&chan->ivc, req, len);
+	if (likely(ret >= 0))
+		atomic64_inc(&civc->stats.tx_msgs);
 
 	mutex_unlock(&civc->ivc_wr_lock);
 
@@ -282,6 +318,12 @@ int tegra_capture_ivc_register_capture_cb(
 		goto fail;
 	}
 
+	/* Drop anything left over from the previous owner */
+	spin_lock(&civc->cb_ctx[chan_id].queue_lock);
+	civc->cb_ctx[chan_id].queue_head = 0;
+	civc->cb_ctx[chan_id].queue_count = 0;
+	spin_unlock(&civc->cb_ctx[chan_id].queue_lock);
+
 	civc->cb_ctx[chan_id].cb_func = capture_status_ind_cb;
 	civc->cb_ctx[chan_id].priv_context = priv_context;
 	mutex_unlock(&civc->cb_ctx_lock);
@@ -366,12 +408,91 @@ int tegra_capture_ivc_unregister_capture_cb(uint32_t chan_id)
 
 	mutex_unlock(&civc->cb_ctx_lock);
 
+	/* No status callback runs for this channel once we return */
+	if (civc->cb_wq != NULL)
+		flush_work(&civc->cb_ctx[chan_id].work);
+
 	tegra_ivc_channel_runtime_put(civc->chan);
 
 	return 0;
 }
 EXPORT_SYMBOL(tegra_capture_ivc_unregister_capture_cb);
 
+static void tegra_capture_ivc_chan_worker(struct work_struct *work)
+{
+	struct tegra_capture_ivc_cb_ctx *cb_ctx = container_of(work,
+					struct tegra_capture_ivc_cb_ctx, work);
+	struct tegra_capture_ivc *civc = cb_ctx->civc;
+	struct CAPTURE_MSG msg;
+	tegra_capture_ivc_cb_func cb_func;
+	bool kick_reader;
+
+	for (;;) {
+		spin_lock(&cb_ctx->queue_lock);
+		if (cb_ctx->queue_count == 0) {
+			spin_unlock(&cb_ctx->queue_lock);
+			break;
+		}
+
+		msg = cb_ctx->queue[cb_ctx->queue_head];
+		cb_ctx->queue_head = (cb_ctx->queue_head + 1) %
+					CHAN_QUEUE_DEPTH;
+		cb_ctx->queue_count--;
+
+		/* The reader left the IVC frame in place; let it retry */
+		kick_reader = cb_ctx->rx_stalled;
+		cb_ctx->rx_stalled = false;
+		spin_unlock(&cb_ctx->queue_lock);
+
+		if (kick_reader)
+			schedule_work(&civc->work);
+
+		cb_func = READ_ONCE(cb_ctx->cb_func);
+		if (likely(cb_func != NULL))
+			cb_func(&msg, cb_ctx->priv_context);
+	}
+}
+
+/*
+ * Hand a capture status message to its channel's completion context, so
+ * that a slow client does not hold up the other channels. Returns false,
+ * leaving the frame unread, if that channel is too far behind.
+ */
+static bool tegra_capture_ivc_defer(struct tegra_capture_ivc *civc,
+		struct tegra_capture_ivc_cb_ctx *cb_ctx, const void *frame)
+{
+	size_t len = min_t(size_t, civc->chan->ivc.frame_size,
+				sizeof(struct CAPTURE_MSG));
+	unsigned int tail, count;
+	int max, old;
+
+	spin_lock(&cb_ctx->queue_lock);
+	if (cb_ctx->queue_count == CHAN_QUEUE_DEPTH) {
+		cb_ctx->rx_stalled = true;
+		spin_unlock(&cb_ctx->queue_lock);
+		atomic64_inc(&civc->stats.rx_stalls);
+		return false;
+	}
+
+	tail = (cb_ctx->queue_head + cb_ctx->queue_count) % CHAN_QUEUE_DEPTH;
+	memcpy(&cb_ctx->queue[tail], frame, len);
+	count = ++cb_ctx->queue_count;
+	spin_unlock(&cb_ctx->queue_lock);
+
+	max = atomic_read(&civc->stats.chan_queue_max);
+	while ((int)count > max) {
+		old = atomic_cmpxchg(&civc->stats.chan_queue_max, max, count);
+		if (old == max)
+			break;
+		max = old;
+	}
+
+	atomic64_inc(&civc->stats.rx_deferred);
+	queue_work(civc->cb_wq, &cb_ctx->work);
+
+	return true;
+}
+
 static void tegra_capture_ivc_worker(struct work_struct *work)
 {
 	struct tegra_capture_ivc *civc = container_of(work,
@@ -397,6 +518,14 @@ static void tegra_capture_ivc_worker(struct work_struct *work)
 			goto skip;
 		}
 
+		/* Status indications complete in per-channel contexts */
+		if (civc->cb_wq != NULL && id < NUM_CAPTURE_CHANNELS) {
+			if (!tegra_capture_ivc_defer(civc, &civc->cb_ctx[id],
+					msg))
+				break;
+			goto skip;
+		}
+
 		/* WAR: Skip the callback if channel-id is 65, and msg-id is
 		 * greater than CAPTURE_CHANNEL_ISP_RELEASE_RESP. Channel id
 		 * 65 is used for csi and it is specific to v4l2.
@@ -413,6 +542,7 @@ static void tegra_capture_ivc_worker(struct work_struct *work)
 				civc->cb_ctx[id].priv_context);
 		}
 skip:
+		atomic64_inc(&civc->stats.rx_msgs);
 		tegra_ivc_read_advance(&chan->ivc);
 	}
 }
@@ -426,6 +556,69 @@ static void tegra_capture_ivc_notify(struct tegra_ivc_channel *chan)
 	schedule_work(&civc->work);
 }
 
+static int tegra_capture_ivc_stats_show(struct seq_file *file, void *data)
+{
+	struct tegra_capture_ivc *civc = file->private;
+	struct tegra_capture_ivc_stats *stats = &civc->stats;
+
+	seq_printf(file, "tx msgs: %lld\n",
+		(long long)atomic64_read(&stats->tx_msgs));
+	seq_printf(file, "tx waits for space: %lld\n",
+		(long long)atomic64_read(&stats->tx_waits));
+	seq_printf(file, "rx msgs: %lld\n",
+		(long long)atomic64_read(&stats->rx_msgs));
+	seq_printf(file, "rx deferred: %lld\n",
+		(long long)atomic64_read(&stats->rx_deferred));
+	seq_printf(file, "rx stalls on full channel: %lld\n",
+		(long long)atomic64_read(&stats->rx_stalls));
+	seq_printf(file, "channel queue max: %d/%u\n",
+		atomic_read(&stats->chan_queue_max), CHAN_QUEUE_DEPTH);
+
+	return 0;
+}
+
+static int tegra_capture_ivc_stats_open(struct inode *inode,
+					struct file *file)
+{
+	return single_open(file, tegra_capture_ivc_stats_show,
+			inode->i_private);
+}
+
+static const struct file_operations tegra_capture_ivc_stats_fops = {
+	.open = tegra_capture_ivc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int tegra_capture_ivc_init_chan_queues(struct tegra_capture_ivc *civc)
+{
+	struct device *dev = &civc->chan->dev;
+	struct CAPTURE_MSG *queues;
+	uint32_t i;
+
+	queues = devm_kcalloc(dev, NUM_CAPTURE_CHANNELS * CHAN_QUEUE_DEPTH,
+			sizeof(*queues), GFP_KERNEL);
+	if (unlikely(queues == NULL))
+		return -ENOMEM;
+
+	civc->cb_wq = alloc_workqueue("%s", WQ_HIGHPRI | WQ_UNBOUND, 0,
+			dev_name(dev));
+	if (unlikely(civc->cb_wq == NULL))
+		return -ENOMEM;
+
+	for (i = 0; i < NUM_CAPTURE_CHANNELS; i++) {
+		struct tegra_capture_ivc_cb_ctx *cb_ctx = &civc->cb_ctx[i];
+
+		cb_ctx->civc = civc;
+		INIT_WORK(&cb_ctx->work, tegra_capture_ivc_chan_worker);
+		spin_lock_init(&cb_ctx->queue_lock);
+		cb_ctx->queue = &queues[i * CHAN_QUEUE_DEPTH];
+	}
+
+	return 0;
+}
+
 #define NV(x) "nvidia," #x
 
 static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
@@ -475,12 +668,22 @@ static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 	} else if (!strcmp("capture", service)) {
 		if (WARN_ON(__scivc_capture != NULL))
 			return -EEXIST;
+		ret = tegra_capture_ivc_init_chan_queues(civc);
+		if (unlikely(ret)) {
+			dev_err(dev, "failed to init completion contexts\n");
+			return ret;
+		}
 		__scivc_capture = civc;
 	} else {
 		dev_err(dev, "Unknown ivc channel %s\n", service);
 		return -EINVAL;
 	}
 
+	civc->debugfs_root = debugfs_create_dir(dev_name(dev), NULL);
+	if (!IS_ERR_OR_NULL(civc->debugfs_root))
+		debugfs_create_file("stats", S_IRUGO, civc->debugfs_root,
+				civc, &tegra_capture_ivc_stats_fops);
+
 	return 0;
 }
 
@@ -488,8 +691,13 @@ static void tegra_capture_ivc_remove(struct tegra_ivc_channel *chan)
 {
 	struct tegra_capture_ivc *civc = tegra_ivc_channel_get_drvdata(chan);
 
+	debugfs_remove_recursive(civc->debugfs_root);
+
 	cancel_work_sync(&civc->work);
 
+	if (civc->cb_wq != NULL)
+		destroy_workqueue(civc->cb_wq);
+
 	if (__scivc_control == civc)
 		__scivc_control = NULL;
 	else if (__scivc_capture == civc)
@@ -19,19 +19,26 @@
 #include <linux/completion.h>
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
+#include <linux/fs.h>
 #include <linux/io.h>
 #include <linux/ioport.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_reserved_mem.h>
+#include <linux/poll.h>
 #include <linux/printk.h>
 #include <linux/seq_buf.h>
 #include <linux/slab.h>
 #include <linux/tegra-camera-rtcpu.h>
 #include <linux/tegra-rtcpu-trace.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
 #include <linux/workqueue.h>
 #include <linux/platform_device.h>
 #include <linux/nvhost.h>
@@ -50,6 +57,8 @@
 #define NV(p) "nvidia," #p
 
 #define WORK_INTERVAL_DEFAULT		100
+#define WORK_INTERVAL_IDLE_SHIFT	3
+#define RAW_WATERMARK_DEFAULT		64
 #define EXCEPTION_STR_LENGTH		2048
 
 /*
@@ -61,6 +70,9 @@ struct tegra_rtcpu_trace {
 	struct device_node *of_node;
 	struct mutex lock;
 
+	/* held by the creator, raw stream files and their mappings */
+	struct kref ref;
+
 	/* memory */
 	void *trace_memory;
 	u32 trace_memory_size;
@@ -86,11 +98,22 @@ struct tegra_rtcpu_trace {
 	/* worker */
 	struct delayed_work work;
 	unsigned long work_interval_jiffies;
+	unsigned long work_idle_jiffies;
 
 	/* statistics */
 	u32 n_exceptions;
 	u64 n_events;
 
+	/* raw event stream */
+	struct miscdevice raw_misc;
+	char raw_name[32];
+	wait_queue_head_t raw_wq;
+	unsigned long raw_busy;
+	u64 raw_read_seq;
+	u64 raw_dropped;
+	u32 raw_watermark;
+	bool raw_dead;
+
 	/* copy of the latest exception and event */
 	char last_exception_str[EXCEPTION_STR_LENGTH];
 	struct camrtc_event_struct copy_last_event;
@@ -1011,12 +1034,48 @@ static void rtcpu_trace_event(struct tegra_rtcpu_trace *tracer,
 	}
 }
 
+/*
+ * With a raw reader attached the events are decoded in userspace, so
+ * only the work that has no tracepoint equivalent is done here: the
+ * VI/ISP task records for eventlib and the RTCPU log forwarding.
+ */
+static void rtcpu_trace_raw_event(struct tegra_rtcpu_trace *tracer,
+	struct camrtc_event_struct *event)
+{
+	switch (CAMRTC_EVENT_TYPE_FROM_ID(event->header.id)) {
+	case CAMRTC_EVENT_TYPE_ARRAY:
+#ifdef CONFIG_EVENTLIB
+		switch (CAMRTC_EVENT_MODULE_FROM_ID(event->header.id)) {
+#if defined(camrtc_trace_vi_frame_begin) && \
+	defined(camrtc_trace_vi_frame_end)
+		case CAMRTC_EVENT_MODULE_VI:
+			rtcpu_trace_vi_event(tracer, event);
+			break;
+#endif
+		case CAMRTC_EVENT_MODULE_ISP:
+			rtcpu_trace_isp_event(tracer, event);
+			break;
+		default:
+			break;
+		}
+#endif
+		break;
+	case CAMRTC_EVENT_TYPE_STRING:
+		if (likely(tracer->enable_printk))
+			trace_rtcpu_log(tracer, event);
+		break;
+	default:
+		break;
+	}
+}
+
 static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 {
 	const struct camrtc_trace_memory_header *header = tracer->trace_memory;
 	u32 old_next = tracer->event_last_idx;
 	u32 new_next = header->event_next_idx;
 	struct camrtc_event_struct *event, *last_event;
+	bool raw;
 
 	while (old_next == new_next)
 		return;
@@ -1035,11 +1094,17 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 				CAMRTC_TRACE_EVENT_SIZE,
 				tracer->event_entries);
 
+	/* a raw reader gets the events as-is, skip the tracepoints */
+	raw = test_bit(0, &tracer->raw_busy);
+
 	/* pull events */
 	while (old_next != new_next) {
 		event = &tracer->events[old_next];
 		last_event = event;
-		rtcpu_trace_event(tracer, event);
+		if (raw)
+			rtcpu_trace_raw_event(tracer, event);
+		else
+			rtcpu_trace_event(tracer, event);
 		tracer->n_events++;
 
 		if (++old_next == tracer->event_entries)
@@ -1048,6 +1113,10 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 
 	tracer->event_last_idx = new_next;
 	tracer->copy_last_event = *last_event;
+
+	if (raw && tracer->n_events - tracer->raw_read_seq >=
+			tracer->raw_watermark)
+		wake_up_interruptible(&tracer->raw_wq);
 }
 
 void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
@@ -1057,6 +1126,12 @@ void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
 
 	mutex_lock(&tracer->lock);
 
+	/* a raw reader can outlive tegra_rtcpu_trace_destroy() */
+	if (unlikely(tracer->raw_dead)) {
+		mutex_unlock(&tracer->lock);
+		return;
+	}
+
 	/* invalidate the cache line for the pointers */
 	dma_sync_single_for_cpu(tracer->dev, tracer->dma_handle_pointers,
 	    CAMRTC_TRACE_NEXT_IDX_SIZE, DMA_FROM_DEVICE);
@@ -1072,13 +1147,339 @@ EXPORT_SYMBOL(tegra_rtcpu_trace_flush);
 static void rtcpu_trace_worker(struct work_struct *work)
 {
 	struct tegra_rtcpu_trace *tracer;
+	unsigned long max_idle;
+	u64 n_events;
 
 	tracer = container_of(work, struct tegra_rtcpu_trace, work.work);
 
+	n_events = READ_ONCE(tracer->n_events);
+
 	tegra_rtcpu_trace_flush(tracer);
 
+	/*
+	 * There is no doorbell for the trace buffer, so back off while the
+	 * RTCPU is quiet and return to the configured interval as soon as
+	 * events show up again.
+	 */
+	max_idle = tracer->work_interval_jiffies << WORK_INTERVAL_IDLE_SHIFT;
+
+	if (READ_ONCE(tracer->n_events) != n_events) {
+		tracer->work_idle_jiffies = tracer->work_interval_jiffies;
+	} else {
+		tracer->work_idle_jiffies = min(tracer->work_idle_jiffies * 2,
+						max_idle);
+
+		/* hand a partial batch below the watermark to the reader */
+		if (READ_ONCE(tracer->n_events) !=
+				READ_ONCE(tracer->raw_read_seq))
+			wake_up_interruptible(&tracer->raw_wq);
+	}
+
 	/* reschedule */
-	schedule_delayed_work(&tracer->work, tracer->work_interval_jiffies);
+	schedule_delayed_work(&tracer->work, tracer->work_idle_jiffies);
+}
+
+/*
+ * Raw event stream
+ *
+ * The file position is a byte offset into the stream of events produced
+ * since the tracer was created, in units of CAMRTC_TRACE_EVENT_SIZE.
+ * read() copies whole events and advances it; readers that mmap() the
+ * trace memory can consume events in place and only lseek() past them.
+ */
+
+static struct tegra_rtcpu_trace *rtcpu_trace_raw_tracer(struct file *file)
+{
+	return container_of(file->private_data, struct tegra_rtcpu_trace,
+			raw_misc);
+}
+
+/* Called with tracer->lock held */
+static u64 rtcpu_trace_raw_clamp(struct tegra_rtcpu_trace *tracer, u64 seq)
+{
+	u64 oldest = 0;
+
+	if (tracer->n_events >= tracer->event_entries)
+		oldest = tracer->n_events - (tracer->event_entries - 1);
+
+	if (seq < oldest) {
+		tracer->raw_dropped += oldest - seq;
+		seq = oldest;
+	}
+
+	return min(seq, tracer->n_events);
+}
+
+/* Called with tracer->lock held */
+static u32 rtcpu_trace_raw_index(struct tegra_rtcpu_trace *tracer, u64 seq)
+{
+	u32 behind = tracer->n_events - seq;
+
+	return (tracer->event_last_idx + tracer->event_entries - behind) %
+		tracer->event_entries;
+}
+
+static void rtcpu_trace_free(struct kref *ref)
+{
+	struct tegra_rtcpu_trace *tracer =
+		container_of(ref, struct tegra_rtcpu_trace, ref);
+
+	dma_free_coherent(tracer->dev, tracer->trace_memory_size,
+			tracer->trace_memory, tracer->dma_handle);
+	put_device(tracer->dev);
+	kfree(tracer);
+}
+
+static int rtcpu_trace_raw_open(struct inode *inode, struct file *file)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+
+	if (test_and_set_bit(0, &tracer->raw_busy))
+		return -EBUSY;
+
+	/* the file may outlive tegra_rtcpu_trace_destroy() */
+	kref_get(&tracer->ref);
+
+	mutex_lock(&tracer->lock);
+	tracer->raw_read_seq = tracer->n_events;
+	file->f_pos = tracer->raw_read_seq * CAMRTC_TRACE_EVENT_SIZE;
+	mutex_unlock(&tracer->lock);
+
+	/* get back to the base interval right away */
+	tracer->work_idle_jiffies = tracer->work_interval_jiffies;
+	mod_delayed_work(system_wq, &tracer->work, 0);
+
+	return 0;
+}
+
+static int rtcpu_trace_raw_release(struct inode *inode, struct file *file)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+
+	clear_bit(0, &tracer->raw_busy);
+	kref_put(&tracer->ref, rtcpu_trace_free);
+
+	return 0;
+}
+
+static ssize_t rtcpu_trace_raw_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+	u64 seq = *ppos / CAMRTC_TRACE_EVENT_SIZE;
+	ssize_t copied = 0;
+	u32 idx, n;
+	int ret;
+
+	if (count < CAMRTC_TRACE_EVENT_SIZE)
+		return -EINVAL;
+
+	for (;;) {
+		/* pick up whatever the RTCPU wrote since the last tick */
+		tegra_rtcpu_trace_flush(tracer);
+
+		mutex_lock(&tracer->lock);
+		if (tracer->raw_dead) {
+			mutex_unlock(&tracer->lock);
+			return -ENODEV;
+		}
+		seq = rtcpu_trace_raw_clamp(tracer, seq);
+		if (seq != tracer->n_events)
+			break;
+		mutex_unlock(&tracer->lock);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(tracer->raw_wq,
+				READ_ONCE(tracer->n_events) != seq ||
+				READ_ONCE(tracer->raw_dead));
+		if (ret)
+			return ret;
+	}
+
+	n = min_t(u64, tracer->n_events - seq,
+		count / CAMRTC_TRACE_EVENT_SIZE);
+
+	while (n > 0) {
+		u32 chunk;
+
+		idx = rtcpu_trace_raw_index(tracer, seq);
+		chunk = min(n, tracer->event_entries - idx);
+
+		if (copy_to_user(buf + copied, &tracer->events[idx],
+				chunk * CAMRTC_TRACE_EVENT_SIZE)) {
+			if (copied == 0)
+				copied = -EFAULT;
+			break;
+		}
+
+		copied += chunk * CAMRTC_TRACE_EVENT_SIZE;
+		seq += chunk;
+		n -= chunk;
+	}
+
+	tracer->raw_read_seq = seq;
+	*ppos = seq * CAMRTC_TRACE_EVENT_SIZE;
+
+	mutex_unlock(&tracer->lock);
+
+	return copied;
+}
+
+static loff_t rtcpu_trace_raw_llseek(struct file *file, loff_t offset,
+	int whence)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+	loff_t pos;
+
+	mutex_lock(&tracer->lock);
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = file->f_pos + offset;
+		break;
+	case SEEK_END:
+		pos = tracer->n_events * CAMRTC_TRACE_EVENT_SIZE + offset;
+		break;
+	default:
+		pos = -EINVAL;
+		break;
+	}
+
+	if (pos >= 0 && pos % CAMRTC_TRACE_EVENT_SIZE == 0) {
+		tracer->raw_read_seq = rtcpu_trace_raw_clamp(tracer,
+				pos / CAMRTC_TRACE_EVENT_SIZE);
+		pos = tracer->raw_read_seq * CAMRTC_TRACE_EVENT_SIZE;
+		file->f_pos = pos;
+	} else if (pos >= 0) {
+		pos = -EINVAL;
+	}
+
+	mutex_unlock(&tracer->lock);
+
+	return pos;
+}
+
+static unsigned int rtcpu_trace_raw_poll(struct file *file,
+	struct poll_table_struct *wait)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+
+	poll_wait(file, &tracer->raw_wq, wait);
+
+	if (READ_ONCE(tracer->raw_dead))
+		return POLLERR | POLLHUP;
+
+	if (READ_ONCE(tracer->n_events) != READ_ONCE(tracer->raw_read_seq))
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+/* a mapping keeps the trace memory allocated until it is unmapped */
+static void rtcpu_trace_raw_vm_open(struct vm_area_struct *vma)
+{
+	struct tegra_rtcpu_trace *tracer = vma->vm_private_data;
+
+	kref_get(&tracer->ref);
+}
+
+static void rtcpu_trace_raw_vm_close(struct vm_area_struct *vma)
+{
+	struct tegra_rtcpu_trace *tracer = vma->vm_private_data;
+
+	kref_put(&tracer->ref, rtcpu_trace_free);
+}
+
+static const struct vm_operations_struct rtcpu_trace_raw_vm_ops = {
+	.open = rtcpu_trace_raw_vm_open,
+	.close = rtcpu_trace_raw_vm_close,
+};
+
+static int rtcpu_trace_raw_mmap(struct file *file,
+	struct vm_area_struct *vma)
+{
+	struct tegra_rtcpu_trace *tracer = rtcpu_trace_raw_tracer(file);
+	int ret;
+
+	/* the ring belongs to the RTCPU, userspace only gets to look */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (READ_ONCE(tracer->raw_dead))
+		return -ENODEV;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	ret = dma_mmap_coherent(tracer->dev, vma, tracer->trace_memory,
+			tracer->dma_handle, tracer->trace_memory_size);
+	if (ret)
+		return ret;
+
+	vma->vm_private_data = tracer;
+	vma->vm_ops = &rtcpu_trace_raw_vm_ops;
+	rtcpu_trace_raw_vm_open(vma);
+
+	return 0;
+}
+
+static const struct file_operations rtcpu_trace_raw_fops = {
+	.owner = THIS_MODULE,
+	.open = rtcpu_trace_raw_open,
+	.release = rtcpu_trace_raw_release,
+	.read = rtcpu_trace_raw_read,
+	.llseek = rtcpu_trace_raw_llseek,
+	.poll = rtcpu_trace_raw_poll,
+	.mmap = rtcpu_trace_raw_mmap,
+};
+
+static void rtcpu_trace_raw_init(struct tegra_rtcpu_trace *tracer)
+{
+	int ret;
+
+	init_waitqueue_head(&tracer->raw_wq);
+
+	tracer->raw_watermark = RAW_WATERMARK_DEFAULT;
+	of_property_read_u32(tracer->of_node, NV(raw-watermark),
+			&tracer->raw_watermark);
+	tracer->raw_watermark = clamp_t(u32, tracer->raw_watermark, 1,
+			tracer->event_entries / 2);
+
+	snprintf(tracer->raw_name, sizeof(tracer->raw_name),
+		"camrtc-trace-%s", dev_name(tracer->dev));
+
+	tracer->raw_misc.minor = MISC_DYNAMIC_MINOR;
+	tracer->raw_misc.name = tracer->raw_name;
+	tracer->raw_misc.fops = &rtcpu_trace_raw_fops;
+	tracer->raw_misc.parent = tracer->dev;
+
+	ret = misc_register(&tracer->raw_misc);
+	if (ret) {
+		dev_warn(tracer->dev, "raw trace device not available: %d\n",
+			ret);
+		tracer->raw_misc.name = NULL;
+	}
+}
+
+/*
+ * No new readers once the device is gone. Readers still holding it open
+ * are woken up and fail from now on, but keep the tracer and the trace
+ * memory alive through their references.
+ */
+static void rtcpu_trace_raw_deinit(struct tegra_rtcpu_trace *tracer)
+{
+	if (tracer->raw_misc.name != NULL)
+		misc_deregister(&tracer->raw_misc);
+
+	mutex_lock(&tracer->lock);
+	tracer->raw_dead = true;
+	mutex_unlock(&tracer->lock);
+
+	wake_up_interruptible_all(&tracer->raw_wq);
 }
 
 /*
@@ -1103,6 +1504,9 @@ static int rtcpu_trace_debugfs_stats_read(
 
 	seq_printf(file, "Exceptions: %u\nEvents: %llu\n",
 			tracer->n_exceptions, tracer->n_events);
+	seq_printf(file, "Raw reader: %s\nRaw dropped: %llu\n",
+			test_bit(0, &tracer->raw_busy) ? "yes" : "no",
+			tracer->raw_dropped);
 
 	return 0;
 }
@@ -1221,6 +1625,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 
 	tracer->dev = dev;
 	mutex_init(&tracer->lock);
+	kref_init(&tracer->ref);
 
 	/* Get the trace memory */
 	ret = rtcpu_trace_setup_memory(tracer);
@@ -1229,6 +1634,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 		kfree(tracer);
 		return NULL;
 	}
+	get_device(dev);
 
 	/* Initialize the trace memory */
 	rtcpu_trace_init_memory(tracer);
@@ -1266,7 +1672,11 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 				&tracer->log_prefix);
 
 	INIT_DELAYED_WORK(&tracer->work, rtcpu_trace_worker);
-	tracer->work_interval_jiffies = msecs_to_jiffies(param);
+	tracer->work_interval_jiffies = max(msecs_to_jiffies(param), 1UL);
+	tracer->work_idle_jiffies = tracer->work_interval_jiffies;
+
+	/* Raw event stream */
+	rtcpu_trace_raw_init(tracer);
 
 	/* Done with initialization */
 	schedule_delayed_work(&tracer->work, 0);
@@ -1295,15 +1705,14 @@ void tegra_rtcpu_trace_destroy(struct tegra_rtcpu_trace *tracer)
 {
 	if (IS_ERR_OR_NULL(tracer))
 		return;
-	platform_device_put(tracer->isp_platform_device);
-	platform_device_put(tracer->vi_platform_device);
-	of_node_put(tracer->of_node);
+	rtcpu_trace_raw_deinit(tracer);
 	cancel_delayed_work_sync(&tracer->work);
 	flush_delayed_work(&tracer->work);
 	rtcpu_trace_debugfs_deinit(tracer);
-	dma_free_coherent(tracer->dev, tracer->trace_memory_size,
-			tracer->trace_memory, tracer->dma_handle);
-	kfree(tracer);
+	platform_device_put(tracer->isp_platform_device);
+	platform_device_put(tracer->vi_platform_device);
+	of_node_put(tracer->of_node);
+	kref_put(&tracer->ref, rtcpu_trace_free);
 }
 EXPORT_SYMBOL(tegra_rtcpu_trace_destroy);
 
@@ -32,6 +32,9 @@
 #define MAX_DOUT_DEFAULT		0
 #define UP_COMPENSATION_DEFAULT		20
 #define DOWN_COMPENSATION_DEFAULT	20
+#define BUDGET_DEFAULT			false
+
+#define BUDGET_UNIT			1000
 
 static struct pid_thermal_gov_params pm_default = {
 	.max_err_temp		= MAX_ERR_TEMP_DEFAULT,
@@ -41,6 +44,7 @@ static struct pid_thermal_gov_params pm_default = {
 	.max_dout		= MAX_DOUT_DEFAULT,
 	.up_compensation	= UP_COMPENSATION_DEFAULT,
 	.down_compensation	= DOWN_COMPENSATION_DEFAULT,
+	.budget			= BUDGET_DEFAULT,
 };
 
 struct pid_thermal_gov_attribute {
@@ -279,6 +283,36 @@ static struct pid_thermal_gov_attribute down_compensation_attr =
 	__ATTR(down_compensation, 0644,
 	       down_compensation_show, down_compensation_store);
 
+static ssize_t budget_show(struct kobject *kobj, struct attribute *attr,
+			   char *buf)
+{
+	struct pid_thermal_governor *gov = kobj_to_gov(kobj);
+
+	if (!gov)
+		return -ENODEV;
+
+	return sprintf(buf, "%d\n", gov->pm.budget);
+}
+
+static ssize_t budget_store(struct kobject *kobj, struct attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct pid_thermal_governor *gov = kobj_to_gov(kobj);
+	int val;
+
+	if (!gov)
+		return -ENODEV;
+
+	if (!sscanf(buf, "%d\n", &val))
+		return -EINVAL;
+
+	gov->pm.budget = !!val;
+	return count;
+}
+
+static struct pid_thermal_gov_attribute budget_attr =
+	__ATTR(budget, 0644, budget_show, budget_store);
+
 static struct attribute *pid_thermal_gov_default_attrs[] = {
 	&max_err_temp_attr.attr,
 	&max_err_gain_attr.attr,
@@ -287,6 +321,7 @@ static struct attribute *pid_thermal_gov_default_attrs[] = {
 	&max_dout_attr.attr,
 	&up_compensation_attr.attr,
 	&down_compensation_attr.attr,
+	&budget_attr.attr,
 	NULL,
 };
 
@@ -378,25 +413,18 @@ static void pid_thermal_gov_update_passive(struct thermal_zone_device *tz,
 		tz->passive--;
 }
 
-static unsigned long
-pid_thermal_gov_get_target(struct thermal_zone_device *tz,
-			   struct thermal_cooling_device *cdev,
-			   enum thermal_trip_type trip_type,
-			   int trip_temp)
+/*
+ * pid_thermal_gov_get_err(tz, trip_temp, max_err)
+ *
+ * Returns the controller output for a trip, in [0, max_err].
+ */
+static s64 pid_thermal_gov_get_err(struct thermal_zone_device *tz,
+				   int trip_temp, s64 max_err)
 {
 	struct pid_thermal_governor *gov = tz_to_gov(tz);
 	int last_temperature = tz->passive ? tz->last_temperature : trip_temp;
 	int passive_delay = tz->passive ? tz->passive_delay : MSEC_PER_SEC;
-	s64 proportional, derivative, sum_err, max_err;
-	unsigned long max_state, cur_state, target, compensation;
-
-	if (cdev->ops->get_max_state(cdev, &max_state) < 0)
-		return 0;
-
-	if (cdev->ops->get_cur_state(cdev, &cur_state) < 0)
-		return 0;
-
-	max_err = (s64)gov->pm.max_err_temp * (s64)gov->pm.max_err_gain;
+	s64 proportional, derivative, sum_err;
 
 	/* Calculate proportional term */
 	proportional = (s64)tz->temperature - (s64)trip_temp;
@@ -416,11 +444,16 @@ pid_thermal_gov_get_target(struct thermal_zone_device *tz,
 	}
 
 	sum_err = max_t(s64, proportional + derivative, 0);
-	sum_err = min_t(s64, sum_err, max_err);
-	sum_err = sum_err * max_state + max_err - 1;
-	target = (unsigned long)div64_s64(sum_err, max_err);
+	return min_t(s64, sum_err, max_err);
+}
+
+static unsigned long
+pid_thermal_gov_compensate(struct pid_thermal_governor *gov,
+			   unsigned long target, unsigned long cur_state,
+			   unsigned long max_state)
+{
+	unsigned long compensation;
 
-	/* Apply compensation */
 	if (target == cur_state)
 		return target;
 
@@ -438,8 +471,90 @@ pid_thermal_gov_get_target(struct thermal_zone_device *tz,
 	return target;
 }
 
+static unsigned long
+pid_thermal_gov_get_target(struct thermal_zone_device *tz,
+			   struct thermal_cooling_device *cdev,
+			   enum thermal_trip_type trip_type,
+			   int trip_temp)
+{
+	struct pid_thermal_governor *gov = tz_to_gov(tz);
+	s64 sum_err, max_err;
+	unsigned long max_state, cur_state, target;
+
+	if (cdev->ops->get_max_state(cdev, &max_state) < 0)
+		return 0;
+
+	if (cdev->ops->get_cur_state(cdev, &cur_state) < 0)
+		return 0;
+
+	max_err = (s64)gov->pm.max_err_temp * (s64)gov->pm.max_err_gain;
+	sum_err = pid_thermal_gov_get_err(tz, trip_temp, max_err);
+	sum_err = sum_err * max_state + max_err - 1;
+	target = (unsigned long)div64_s64(sum_err, max_err);
+
+	return pid_thermal_gov_compensate(gov, target, cur_state, max_state);
+}
+
+/*
+ * pid_thermal_gov_get_budget_target(tz, instance, trip, trip_temp)
+ *
+ * Budget mode: the controller output is read as the throttling needed from
+ * the trip as a whole, in units of one fully throttled device. It is handed
+ * out in order of increasing instance weight; devices of equal weight share
+ * their part evenly. So a low priority device (e.g. DLA) absorbs a small
+ * overshoot alone, and a high priority one (e.g. CPU) is only touched once
+ * everything below it is at max state.
+ */
+static unsigned long
+pid_thermal_gov_get_budget_target(struct thermal_zone_device *tz,
+				  struct thermal_instance *instance,
+				  int trip, int trip_temp)
+{
+	struct pid_thermal_governor *gov = tz_to_gov(tz);
+	struct thermal_cooling_device *cdev = instance->cdev;
+	struct thermal_instance *pos;
+	unsigned long max_state, cur_state, target;
+	int nr = 0, nr_below = 0, nr_same = 0;
+	s64 sum_err, max_err, need, share;
+
+	if (cdev->ops->get_max_state(cdev, &max_state) < 0)
+		return 0;
+
+	if (cdev->ops->get_cur_state(cdev, &cur_state) < 0)
+		return 0;
+
+	list_for_each_entry(pos, &tz->thermal_instances, tz_node) {
+		if (pos->trip != trip || pos->upper == pos->lower)
+			continue;
+		nr++;
+		if (pos->weight < instance->weight)
+			nr_below++;
+		else if (pos->weight == instance->weight)
+			nr_same++;
+	}
+	if (!nr_same)
+		return 0;
+
+	max_err = (s64)gov->pm.max_err_temp * (s64)gov->pm.max_err_gain;
+	sum_err = pid_thermal_gov_get_err(tz, trip_temp, max_err);
+
+	/* whole-trip need, less what the lower priority devices absorb */
+	need = div64_s64(sum_err * nr * BUDGET_UNIT, max_err);
+	need -= (s64)nr_below * BUDGET_UNIT;
+	if (need <= 0)
+		share = 0;
+	else
+		share = min_t(s64, div64_s64(need, nr_same), BUDGET_UNIT);
+
+	target = (unsigned long)DIV_ROUND_UP_ULL((u64)share * max_state,
+						 BUDGET_UNIT);
+
+	return pid_thermal_gov_compensate(gov, target, cur_state, max_state);
+}
+
 static int pid_thermal_gov_throttle(struct thermal_zone_device *tz, int trip)
 {
+	struct pid_thermal_governor *gov = tz_to_gov(tz);
 	struct thermal_instance *instance;
 	enum thermal_trip_type trip_type;
 	int trip_temp, hyst = 0;
@@ -460,6 +575,11 @@ static int pid_thermal_gov_throttle(struct thermal_zone_device *tz, int trip)
 
 		if (instance->upper == instance->lower) {
 			target = instance->upper;
+		} else if (gov->pm.budget) {
+			target = pid_thermal_gov_get_budget_target(tz, instance,
+							trip, trip_temp);
+			target = min(max(target, instance->lower),
+				     instance->upper);
 		} else {
 			target = pid_thermal_gov_get_target(tz, instance->cdev,
 							trip_type, trip_temp);
@@ -516,6 +636,8 @@ static int pid_thermal_gov_of_parse(struct thermal_zone_params *tzp,
 		gpm->up_compensation = val;
 	if (!of_property_read_u32(np, "down_compensation", &val))
 		gpm->down_compensation = val;
+	if (of_property_read_bool(np, "budget"))
+		gpm->budget = true;
 
 	tzp->governor_params = gpm;
 	return 0;
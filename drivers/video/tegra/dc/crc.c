@@ -16,10 +16,19 @@
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/atomic.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
 
 #include "dc.h"
 #include "dc_priv_defs.h"
@@ -30,6 +39,27 @@
 #define TEGRA_DC_FLIP_BUF_CAPACITY 1024 /* in units of number of elements */
 #define TEGRA_DC_CRC_BUF_CAPACITY 1024 /* in units of number of elements */
 #define CRC_COMPLETE_TIMEOUT msecs_to_jiffies(1000)
+#define TEGRA_DC_CRC_STREAM_DEF_ENTRIES 240 /* 1 sec at 240 Hz */
+
+/*
+ * tegra_dc_crc_stream - Per-frame CRCs shared with userspace
+ * @dc        - The head the stream belongs to
+ * @hdr       - Start of the vmalloc_user() area mapped by userspace
+ * @entries   - The ring, right after @hdr
+ * @size      - Size of the mapping in bytes
+ * @mask      - num_entries - 1
+ * @poll_head - hdr->head when poll() last reported POLLIN
+ * @wq        - Woken up on every frame end
+ */
+struct tegra_dc_crc_stream {
+	struct tegra_dc *dc;
+	struct tegra_dc_ext_crc_stream_header *hdr;
+	struct tegra_dc_ext_crc_stream_entry *entries;
+	size_t size;
+	u32 mask;
+	u64 poll_head;
+	wait_queue_head_t wq;
+};
 
 static inline size_t _get_bytes_per_ele(struct tegra_dc_ring_buf *buf)
 {
@@ -703,11 +733,217 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 	return ret;
 }
 
+/* Called with dc->lock held, from the frame end interrupt */
+static void tegra_dc_crc_stream_push(struct tegra_dc *dc,
+				     struct tegra_dc_crc_buf_ele *ele,
+				     u64 timestamp_ns, u32 frame_cnt)
+{
+	struct tegra_dc_crc_stream *stream = dc->crc_stream;
+	struct tegra_dc_ext_crc_stream_entry *e;
+	u64 head;
+	int i;
+
+	if (!stream)
+		return;
+
+	head = stream->hdr->head;
+	e = &stream->entries[head & stream->mask];
+
+	/* Invalidate the entry first, so readers can detect the overwrite */
+	WRITE_ONCE(e->seq, U64_MAX);
+	smp_wmb();
+
+	e->timestamp_ns = timestamp_ns;
+	e->frame_cnt = frame_cnt;
+
+	/* matching_flips are filled in order, the last one is the newest */
+	e->flip_id = 0;
+	for (i = 0; i < DC_N_WINDOWS && ele->matching_flips[i].valid; i++)
+		e->flip_id = ele->matching_flips[i].id;
+
+	e->valid = 0;
+	e->rg = ele->rg.crc;
+	if (ele->rg.valid)
+		e->valid |= TEGRA_DC_EXT_CRC_STREAM_VALID_RG;
+	e->comp = ele->comp.crc;
+	if (ele->comp.valid)
+		e->valid |= TEGRA_DC_EXT_CRC_STREAM_VALID_COMP;
+	e->out = ele->sor.crc;
+	if (ele->sor.valid)
+		e->valid |= TEGRA_DC_EXT_CRC_STREAM_VALID_OR;
+	for (i = 0; i < TEGRA_DC_EXT_MAX_REGIONS; i++) {
+		e->regional[i] = ele->regional[i].crc;
+		if (ele->regional[i].valid)
+			e->valid |= BIT(TEGRA_DC_EXT_CRC_STREAM_VALID_REGION_SHIFT
+					+ i);
+	}
+
+	smp_wmb();
+	WRITE_ONCE(e->seq, head);
+	smp_wmb();
+	WRITE_ONCE(stream->hdr->head, head + 1);
+
+	wake_up_interruptible(&stream->wq);
+}
+
+/* Called with dc->lock held, from the frame end interrupt */
+static void tegra_dc_crc_stream_drop(struct tegra_dc *dc)
+{
+	struct tegra_dc_crc_stream *stream = dc->crc_stream;
+
+	if (!stream)
+		return;
+
+	WRITE_ONCE(stream->hdr->dropped, stream->hdr->dropped + 1);
+}
+
+static unsigned int tegra_dc_crc_stream_poll(struct file *filp,
+					     poll_table *wait)
+{
+	struct tegra_dc_crc_stream *stream = filp->private_data;
+	u64 head;
+
+	poll_wait(filp, &stream->wq, wait);
+
+	head = READ_ONCE(stream->hdr->head);
+	if (head == stream->poll_head)
+		return 0;
+
+	stream->poll_head = head;
+	return POLLIN | POLLRDNORM;
+}
+
+static int tegra_dc_crc_stream_mmap(struct file *filp,
+				    struct vm_area_struct *vma)
+{
+	struct tegra_dc_crc_stream *stream = filp->private_data;
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > stream->size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, stream->hdr, 0);
+}
+
+static int tegra_dc_crc_stream_release(struct inode *inode, struct file *filp)
+{
+	struct tegra_dc_crc_stream *stream = filp->private_data;
+	struct tegra_dc *dc = stream->dc;
+
+	mutex_lock(&dc->lock);
+	if (dc->crc_stream == stream)
+		dc->crc_stream = NULL;
+	mutex_unlock(&dc->lock);
+
+	vfree(stream->hdr);
+	kfree(stream);
+	return 0;
+}
+
+static const struct file_operations tegra_dc_crc_stream_fops = {
+	.owner		= THIS_MODULE,
+	.release	= tegra_dc_crc_stream_release,
+	.poll		= tegra_dc_crc_stream_poll,
+	.mmap		= tegra_dc_crc_stream_mmap,
+	.llseek		= noop_llseek,
+};
+
+/* Create a CRC stream and its file. On success, the caller owns arg->fd and
+ * @file and either fd_install()s them or releases both.
+ */
+long tegra_dc_crc_stream_open(struct tegra_dc *dc,
+			      struct tegra_dc_ext_crc_stream_arg *arg,
+			      struct file **file)
+{
+	struct tegra_dc_crc_stream *stream;
+	struct tegra_dc_ext_crc_stream_header *hdr;
+	u32 num_entries = arg->num_entries;
+	int fd, ret;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	if (!num_entries)
+		num_entries = TEGRA_DC_CRC_STREAM_DEF_ENTRIES;
+	num_entries = roundup_pow_of_two(min_t(u32, num_entries,
+				TEGRA_DC_EXT_CRC_STREAM_MAX_ENTRIES));
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream)
+		return -ENOMEM;
+
+	stream->dc = dc;
+	stream->mask = num_entries - 1;
+	stream->size = PAGE_ALIGN(sizeof(*hdr) +
+			num_entries * sizeof(*stream->entries));
+	init_waitqueue_head(&stream->wq);
+
+	hdr = vmalloc_user(stream->size);
+	if (!hdr) {
+		ret = -ENOMEM;
+		goto free_stream;
+	}
+
+	hdr->magic = TEGRA_DC_EXT_CRC_STREAM_MAGIC;
+	hdr->version = TEGRA_DC_EXT_CRC_STREAM_VERSION;
+	hdr->hdr_size = sizeof(*hdr);
+	hdr->entry_size = sizeof(*stream->entries);
+	hdr->num_entries = num_entries;
+	stream->hdr = hdr;
+	stream->entries = (void *)hdr + sizeof(*hdr);
+	/* No entry has been written yet */
+	memset(stream->entries, 0xff, num_entries * sizeof(*stream->entries));
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto free_hdr;
+	}
+
+	*file = anon_inode_getfile("tegra-dc-crc-stream",
+				   &tegra_dc_crc_stream_fops, stream, O_RDONLY);
+	if (IS_ERR(*file)) {
+		ret = PTR_ERR(*file);
+		goto put_fd;
+	}
+
+	mutex_lock(&dc->lock);
+	if (dc->crc_stream) {
+		mutex_unlock(&dc->lock);
+		/* The release callback frees the stream */
+		fput(*file);
+		put_unused_fd(fd);
+		return -EBUSY;
+	}
+	dc->crc_stream = stream;
+	mutex_unlock(&dc->lock);
+
+	arg->fd = fd;
+	arg->size = stream->size;
+	return 0;
+
+put_fd:
+	put_unused_fd(fd);
+free_hdr:
+	vfree(hdr);
+free_stream:
+	kfree(stream);
+	return ret;
+}
+
 int tegra_dc_crc_process(struct tegra_dc *dc)
 {
 	int ret = 0, matched = 0;
 	struct tegra_dc_crc_buf_ele crc_ele;
 	struct tegra_dc_flip_buf_ele *flip_ele;
+	u64 timestamp_ns = ktime_get_ns();
+	u32 frame_cnt = tegra_dc_get_frame_cnt(dc);
 
 	memset(&crc_ele, 0, sizeof(crc_ele));
 
@@ -717,14 +953,18 @@ int tegra_dc_crc_process(struct tegra_dc *dc)
 	else if (tegra_dc_is_nvdisplay())
 		ret = tegra_nvdisp_crc_collect(dc, &crc_ele);
 
-	if (ret)
+	if (ret) {
+		tegra_dc_crc_stream_drop(dc);
 		return ret;
+	}
 
 	mutex_lock(&dc->flip_buf.lock);
 
 	/* Before doing any work, check if there are flips to match */
 	if (!dc->flip_buf.size) {
 		mutex_unlock(&dc->flip_buf.lock);
+		tegra_dc_crc_stream_push(dc, &crc_ele, timestamp_ns,
+					 frame_cnt);
 		return 0;
 	}
 
@@ -755,6 +995,8 @@ int tegra_dc_crc_process(struct tegra_dc *dc)
 	}
 
 	mutex_unlock(&dc->flip_buf.lock);
+
+	tegra_dc_crc_stream_push(dc, &crc_ele, timestamp_ns, frame_cnt);
 	return ret;
 }
 
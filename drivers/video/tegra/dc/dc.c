@@ -2834,6 +2834,17 @@ static int dbg_flip_stats_show(struct seq_file *m, void *unused)
 		atomic64_read(&dc->flip_stats.flips_skipped));
 	seq_printf(m, "Flips completed: %ld\n",
 		atomic64_read(&dc->flip_stats.flips_cmpltd));
+	seq_printf(m, "Flips latched: %ld\n",
+		atomic64_read(&dc->flip_stats.flips_latched));
+
+	mutex_lock(&dc->msrmnt_info.lock);
+	seq_printf(m, "Pre-fence wait (us): %llu, max %llu\n",
+		div_u64(dc->msrmnt_info.fence_wait_ns, NSEC_PER_USEC),
+		div_u64(dc->msrmnt_info.fence_wait_max_ns, NSEC_PER_USEC));
+	seq_printf(m, "Flip latency (us): %llu, max %llu\n",
+		div_u64(dc->msrmnt_info.flip_latency_ns, NSEC_PER_USEC),
+		div_u64(dc->msrmnt_info.flip_latency_max_ns, NSEC_PER_USEC));
+	mutex_unlock(&dc->msrmnt_info.lock);
 
 	return 0;
 }
@@ -6777,6 +6788,7 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	atomic64_set(&dc->flip_stats.flips_queued, 0);
 	atomic64_set(&dc->flip_stats.flips_skipped, 0);
 	atomic64_set(&dc->flip_stats.flips_cmpltd, 0);
+	atomic64_set(&dc->flip_stats.flips_latched, 0);
 
 	tegra_dc_create_debugfs(dc);
 
@@ -34,6 +34,7 @@
 #include <video/tegra_dc_ext_kernel.h>
 #include <uapi/video/tegra_dc_ext.h>
 #include "dc_extras.h"
+#include "nvdisp/nvdisp_bw_calc.h"
 
 #define DEFAULT_FPGA_FREQ_KHZ	160000
 
@@ -1157,13 +1158,6 @@ struct tegra_dp_out {
  * On T18x, isohub is the only memclient that's relevant to display.
  * The following structs keep track of its isoclient info.
  */
-struct nvdisp_bandwidth_config {
-	u32 iso_bw;		/* KB/s */
-	u32 total_bw;		/* KB/s */
-	u32 emc_la_floor;	/* Hz */
-	u32 hubclk;		/* Hz */
-};
-
 struct nvdisp_isoclient_bw_info {
 	tegra_isomgr_handle		isomgr_handle;
 	struct tegra_bwmgr_client	*bwmgr_handle;
@@ -1203,5 +1197,9 @@ long tegra_dc_crc_enable(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_disable(struct tegra_dc *dc,
 			  struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
+struct file;
+long tegra_dc_crc_stream_open(struct tegra_dc *dc,
+			      struct tegra_dc_ext_crc_stream_arg *arg,
+			      struct file **file);
 
 #endif
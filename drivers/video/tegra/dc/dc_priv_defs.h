@@ -257,6 +257,7 @@ struct tegra_dc_flip_stats {
 	atomic64_t flips_skipped;
 	atomic64_t flips_queued;
 	atomic64_t flips_cmpltd;
+	atomic64_t flips_latched;
 };
 
 /*
@@ -388,6 +389,8 @@ struct tegra_dc_ring_buf {
  *                Should always be a sum of reference counts of each region
  * @legacy      - Keep account of whether legacy sysfs API is activated
  */
+struct tegra_dc_crc_stream;
+
 struct tegra_dc_crc_ref_cnt {
 	atomic_t global;
 	atomic_t rg;
@@ -407,6 +410,11 @@ struct tegra_dc_crc_ref_cnt {
  * @enabled : stores the status that indicates whether measurement info
  *		has to be collected or not.
  * @line_num : the scanline at which the latency value is being read.
+ * @fence_wait_ns : time the last flip waited for its pre-fences.
+ * @fence_wait_max_ns : highest @fence_wait_ns seen.
+ * @flip_latency_ns : time from the last flip ioctl until its windows
+ *		were programmed.
+ * @flip_latency_max_ns : highest @flip_latency_ns seen.
  * @lock : used to sequentialize operations on
  *		tegra_dc_latency_measurement_data.
  */
@@ -415,6 +423,10 @@ struct tegra_dc_latency_measurement_data {
 	u32 offset;
 	bool enabled;
 	u16 line_num;
+	u64 fence_wait_ns;
+	u64 fence_wait_max_ns;
+	u64 flip_latency_ns;
+	u64 flip_latency_max_ns;
 	struct mutex lock;
 };
 
@@ -665,6 +677,7 @@ struct tegra_dc {
 	struct tegra_dc_ring_buf crc_buf; /* Buffer to save HW generated CRCs */
 	struct tegra_dc_crc_ref_cnt crc_ref_cnt;
 	bool crc_initialized;
+	struct tegra_dc_crc_stream *crc_stream; /* protected by lock */
 	struct tegra_dc_latency_measurement_data msrmnt_info;
 
 #if defined(CONFIG_TEGRA_DC_FAKE_PANEL_SUPPORT)
@@ -26,6 +26,9 @@
 #include <linux/export.h>
 #include <linux/delay.h>
 #include <linux/fb.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <linux/version.h>
 #include <linux/string.h>
 #include <linux/nospec.h>
@@ -54,6 +57,7 @@
 
 #define TEGRA_DC_TS_MAX_DELAY_US 1000000
 #define TEGRA_DC_TS_SLACK_US 2000
+#define TEGRA_DC_EXT_PRE_FENCE_TIMEOUT_MS 5000
 
 /* Compatibility for kthread refactoring */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
@@ -113,6 +117,9 @@ struct tegra_dc_ext_flip_win {
 	u32					syncpt_max;
 #ifdef CONFIG_TEGRA_GRHOST_SYNC
 	struct sync_fence			*pre_syncpt_fence;
+	struct sync_fence_waiter		pre_fence_waiter;
+	bool					pre_fence_armed;
+	struct tegra_dc_ext_flip_data		*flip;
 #endif
 	bool					user_nvdisp_win_csc;
 	struct tegra_dc_ext_nvdisp_win_csc		nvdisp_win_csc;
@@ -120,9 +127,17 @@ struct tegra_dc_ext_flip_win {
 
 struct tegra_dc_ext_flip_data {
 	struct tegra_dc_ext		*ext;
-	struct kthread_work		work;
+	int				work_index;
+	struct list_head		flip_node;
+	/* pre-fences still outstanding, plus one held while arming */
+	atomic_t			fences_pending;
+	bool				fences_ready;
+	struct hrtimer			fence_timer;
+	u64				queued_ns;
+	u64				ready_ns;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
 	struct list_head		timestamp_node;
+	bool has_timestamp;
 	int act_window_num;
 	u16 dirty_rect[4];
 	bool dirty_rect_valid;
@@ -154,6 +169,7 @@ struct tegra_dc_ext_scanline_data {
 
 static int tegra_dc_ext_set_vblank(struct tegra_dc_ext *ext, bool enable);
 static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win);
+static void tegra_dc_ext_flush_flips(struct tegra_dc_ext_win *win);
 static void tegra_dc_flip_trace(struct tegra_dc_ext_flip_data *data,
 				display_syncpt_notifier trace_fn);
 
@@ -239,7 +255,7 @@ static int tegra_dc_ext_put_window(struct tegra_dc_ext_user *user,
 	mutex_lock(&win->lock);
 
 	if (win->user == user) {
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 		win->user = NULL;
 		win->enabled = false;
 	} else {
@@ -333,7 +349,7 @@ int tegra_dc_ext_disable(struct tegra_dc_ext *ext)
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 	}
 
 	tegra_dc_en_dis_latency_msrmnt_mode(ext->dc, false);
@@ -357,6 +373,9 @@ int tegra_dc_ext_disable(struct tegra_dc_ext *ext)
 		}
 	}
 
+	/* Nothing is scanned out anymore, drop the cached mappings */
+	tegra_dc_ext_pin_cache_flush(&ext->pin_cache);
+
 	return windows;
 }
 
@@ -585,17 +604,18 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 		dev_err(&ext->dc->ndev->dev,
 				"Window atrributes are invalid.\n");
 
-#ifdef CONFIG_TEGRA_GRHOST_SYNC
-	if (flip_win->pre_syncpt_fence) {
-		sync_fence_wait(flip_win->pre_syncpt_fence, 5000);
-		sync_fence_put(flip_win->pre_syncpt_fence);
-	} else
-#endif
+	/*
+	 * Pre-fences given as sync fds have already signaled (or timed out)
+	 * by the time the flip is programmed, see tegra_dc_ext_flip_arm().
+	 * Only raw syncpoint thresholds from the legacy flip ioctl are still
+	 * waited for here.
+	 */
 	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
 		nvhost_syncpt_wait_timeout_ext(ext->dc->ndev,
 				flip_win->attr.pre_syncpt_id,
 				flip_win->attr.pre_syncpt_val,
-				msecs_to_jiffies(5000), NULL, NULL);
+				msecs_to_jiffies(TEGRA_DC_EXT_PRE_FENCE_TIMEOUT_MS),
+				NULL, NULL);
 	}
 
 	if (err < 0)
@@ -884,14 +904,8 @@ static void tegra_dc_ext_unpin_handles(struct tegra_dc_dmabuf *unpin_handles[],
 {
 	int i;
 
-	for (i = 0; i < nr_unpin; i++) {
-		dma_buf_unmap_attachment(unpin_handles[i]->attach,
-			unpin_handles[i]->sgt, DMA_TO_DEVICE);
-		dma_buf_detach(unpin_handles[i]->buf,
-			       unpin_handles[i]->attach);
-		dma_buf_put(unpin_handles[i]->buf);
-		kfree(unpin_handles[i]);
-	}
+	for (i = 0; i < nr_unpin; i++)
+		tegra_dc_ext_unpin_dmabuf(unpin_handles[i]);
 }
 
 static void tegra_dc_flip_trace(struct tegra_dc_ext_flip_data *data,
@@ -972,6 +986,9 @@ static void tegra_dc_update_postcomp(struct tegra_dc *dc,
  * @flip_data: pointer the current tegra_dc_ext_flip_data that has all
  * the relevant info regarding the windows used in the cuurent flip.
  *
+ * Records how long the flip waited for its pre-fences and how long it took
+ * from the flip ioctl until the windows were programmed.
+ *
  * Currently supports nvdisplay only. Gets the first enabled window and
  * stores the corresponding buff handle and offset. If there are more than
  * one window enabled, returns and doesn't store the buff handle.
@@ -985,9 +1002,18 @@ static void tegra_dc_ext_store_latency_msrmnt_info(struct tegra_dc *dc,
 	int nr_windows_enabled = 0;
 	int nr_wins = flip_data->act_window_num;
 	struct tegra_dc_ext_flip_win *flip_win = flip_data->win;
+	u64 fence_wait_ns = flip_data->ready_ns - flip_data->queued_ns;
+	u64 flip_ns = ktime_get_ns() - flip_data->queued_ns;
 
 	mutex_lock(&dc->msrmnt_info.lock);
 
+	dc->msrmnt_info.fence_wait_ns = fence_wait_ns;
+	dc->msrmnt_info.flip_latency_ns = flip_ns;
+	if (fence_wait_ns > dc->msrmnt_info.fence_wait_max_ns)
+		dc->msrmnt_info.fence_wait_max_ns = fence_wait_ns;
+	if (flip_ns > dc->msrmnt_info.flip_latency_max_ns)
+		dc->msrmnt_info.flip_latency_max_ns = flip_ns;
+
 	if (!dc->msrmnt_info.enabled) {
 		mutex_unlock(&dc->msrmnt_info.lock);
 		return;
@@ -1016,10 +1042,8 @@ static void tegra_dc_ext_store_latency_msrmnt_info(struct tegra_dc *dc,
 	mutex_unlock(&dc->msrmnt_info.lock);
 }
 
-static void tegra_dc_ext_flip_worker(struct kthread_work *work)
+static void tegra_dc_ext_program_flip(struct tegra_dc_ext_flip_data *data)
 {
-	struct tegra_dc_ext_flip_data *data =
-		container_of(work, struct tegra_dc_ext_flip_data, work);
 	int win_num = data->act_window_num;
 	struct tegra_dc_ext *ext = data->ext;
 	struct tegra_dc_win *wins[DC_N_WINDOWS];
@@ -1308,6 +1332,261 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	kfree(blank_win);
 }
 
+static void tegra_dc_ext_flip_ready(struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_win *ext_win = &data->ext->win[data->work_index];
+	unsigned long flags;
+
+	spin_lock_irqsave(&ext_win->flip_lock, flags);
+	if (!data->fences_ready) {
+		data->fences_ready = true;
+		data->ready_ns = ktime_get_ns();
+	}
+	spin_unlock_irqrestore(&ext_win->flip_lock, flags);
+
+	kthread_queue_work(&ext_win->flip_worker, &ext_win->flip_kick);
+}
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+static void tegra_dc_ext_pre_fence_signaled(struct sync_fence *fence,
+					    struct sync_fence_waiter *waiter)
+{
+	struct tegra_dc_ext_flip_win *flip_win = container_of(waiter,
+			struct tegra_dc_ext_flip_win, pre_fence_waiter);
+	struct tegra_dc_ext_flip_data *data = flip_win->flip;
+
+	if (atomic_dec_and_test(&data->fences_pending))
+		tegra_dc_ext_flip_ready(data);
+}
+#endif
+
+static enum hrtimer_restart tegra_dc_ext_pre_fence_timeout(
+						struct hrtimer *timer)
+{
+	struct tegra_dc_ext_flip_data *data =
+		container_of(timer, struct tegra_dc_ext_flip_data, fence_timer);
+
+	dev_warn_ratelimited(&data->ext->dc->ndev->dev,
+		"flip pre-fence timed out, flipping anyway\n");
+	tegra_dc_ext_flip_ready(data);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Queue the flip on its window and arm callbacks on its pre-fences instead
+ * of blocking the flip kthread on them. The flip becomes ready once all of
+ * them signaled or TEGRA_DC_EXT_PRE_FENCE_TIMEOUT_MS elapsed, and the flip
+ * kthread then programs ready flips in submission order.
+ */
+static void tegra_dc_ext_flip_arm(struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_win *ext_win = &data->ext->win[data->work_index];
+	unsigned long flags;
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	int i;
+#endif
+
+	atomic_set(&data->fences_pending, 1);
+	data->queued_ns = ktime_get_ns();
+
+	spin_lock_irqsave(&ext_win->flip_lock, flags);
+	list_add_tail(&data->flip_node, &ext_win->flip_queue);
+	spin_unlock_irqrestore(&ext_win->flip_lock, flags);
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (!flip_win->pre_syncpt_fence)
+			continue;
+
+		flip_win->flip = data;
+		sync_fence_waiter_init(&flip_win->pre_fence_waiter,
+				       tegra_dc_ext_pre_fence_signaled);
+		atomic_inc(&data->fences_pending);
+		/* Signaled or errored fences are not waited for */
+		if (sync_fence_wait_async(flip_win->pre_syncpt_fence,
+					  &flip_win->pre_fence_waiter))
+			atomic_dec(&data->fences_pending);
+		else
+			flip_win->pre_fence_armed = true;
+	}
+
+	if (atomic_read(&data->fences_pending) > 1)
+		hrtimer_start(&data->fence_timer,
+			ns_to_ktime(TEGRA_DC_EXT_PRE_FENCE_TIMEOUT_MS *
+				    NSEC_PER_MSEC),
+			HRTIMER_MODE_REL);
+#endif
+
+	if (atomic_dec_and_test(&data->fences_pending))
+		tegra_dc_ext_flip_ready(data);
+}
+
+/* Cancel outstanding fence callbacks and drop the pre-fences */
+static void tegra_dc_ext_flip_disarm(struct tegra_dc_ext_flip_data *data)
+{
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	int i;
+#endif
+
+	hrtimer_cancel(&data->fence_timer);
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (!flip_win->pre_syncpt_fence)
+			continue;
+
+		if (flip_win->pre_fence_armed)
+			sync_fence_cancel_async(flip_win->pre_syncpt_fence,
+						&flip_win->pre_fence_waiter);
+		sync_fence_put(flip_win->pre_syncpt_fence);
+		flip_win->pre_syncpt_fence = NULL;
+		flip_win->pre_fence_armed = false;
+		/* pre_syncpt_fd shares storage with the raw syncpt id */
+		flip_win->attr.pre_syncpt_id = NVSYNCPT_INVALID;
+	}
+#endif
+}
+
+/*
+ * A ready flip asking for TEGRA_DC_EXT_FLIP_HEAD_FLAG_LATE_LATCH replaces
+ * the older, not yet programmed flip ahead of it, provided it updates the
+ * same windows and the older flip carries no state that only it programs.
+ * Called with the window's flip_lock held.
+ */
+static bool tegra_dc_ext_flip_can_latch(struct tegra_dc_ext_flip_data *old,
+					struct tegra_dc_ext_flip_data *new)
+{
+	int i, j;
+
+	if (!(new->flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_LATE_LATCH) ||
+		!new->fences_ready)
+		return false;
+
+	if (old->has_timestamp || old->imp_dirty || old->hdr_cache_dirty ||
+		old->avi_cache_dirty || old->cmu_update_needed ||
+		old->output_colorspace_update_needed ||
+		old->output_range_update_needed ||
+		old->background_color_update_needed)
+		return false;
+
+	if (old->act_window_num != new->act_window_num)
+		return false;
+
+	for (i = 0; i < old->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &old->win[i];
+
+		if (flip_win->user_nvdisp_win_csc ||
+			(flip_win->attr.flags &
+			 (TEGRA_DC_EXT_FLIP_FLAG_UPDATE_CSC |
+			  TEGRA_DC_EXT_FLIP_FLAG_CURSOR)))
+			return false;
+
+		for (j = 0; j < new->act_window_num; j++)
+			if (new->win[j].attr.index == flip_win->attr.index)
+				break;
+		if (j == new->act_window_num)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Drop a flip superseded by a late-latching one. Its release syncpoints are
+ * covered by the newer flip, which completes to a higher threshold.
+ */
+static void tegra_dc_ext_flip_drop(struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext *ext = data->ext;
+	struct tegra_dc *dc = ext->dc;
+	struct tegra_dc_dmabuf *unpin_handles[DC_N_WINDOWS *
+					       TEGRA_DC_NUM_PLANES];
+	int i, j, nr_unpin = 0;
+
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int index = flip_win->attr.index;
+
+		if (index < 0 || !test_bit(index, &dc->valid_windows))
+			continue;
+
+		atomic_dec(&ext->win[index].nr_pending_flips);
+
+		for (j = 0; j < TEGRA_DC_NUM_PLANES; j++)
+			if (flip_win->handle[j])
+				unpin_handles[nr_unpin++] = flip_win->handle[j];
+	}
+
+	if (data->flip_buf_ele)
+		data->flip_buf_ele->state = TEGRA_DC_FLIP_STATE_SKIPPED;
+
+	trace_dc_flip_dropped(dc->enabled, true);
+	atomic64_inc(&dc->flip_stats.flips_skipped);
+	atomic64_inc(&dc->flip_stats.flips_latched);
+
+	tegra_dc_ext_unpin_handles(unpin_handles, nr_unpin);
+	kfree(data);
+}
+
+static void tegra_dc_ext_flip_worker(struct kthread_work *work)
+{
+	struct tegra_dc_ext_win *ext_win =
+		container_of(work, struct tegra_dc_ext_win, flip_kick);
+	struct tegra_dc_ext_flip_data *data, *next;
+	unsigned long flags;
+	bool latched;
+
+	for (;;) {
+		spin_lock_irqsave(&ext_win->flip_lock, flags);
+		data = list_first_entry_or_null(&ext_win->flip_queue,
+				struct tegra_dc_ext_flip_data, flip_node);
+		if (!data || !data->fences_ready) {
+			spin_unlock_irqrestore(&ext_win->flip_lock, flags);
+			break;
+		}
+		list_del(&data->flip_node);
+		next = list_first_entry_or_null(&ext_win->flip_queue,
+				struct tegra_dc_ext_flip_data, flip_node);
+		latched = next && tegra_dc_ext_flip_can_latch(data, next);
+		spin_unlock_irqrestore(&ext_win->flip_lock, flags);
+
+		tegra_dc_ext_flip_disarm(data);
+		if (latched)
+			tegra_dc_ext_flip_drop(data);
+		else
+			tegra_dc_ext_program_flip(data);
+
+		wake_up(&ext_win->flip_wq);
+	}
+}
+
+static bool tegra_dc_ext_flip_queue_empty(struct tegra_dc_ext_win *win)
+{
+	unsigned long flags;
+	bool empty;
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	empty = list_empty(&win->flip_queue);
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	return empty;
+}
+
+/*
+ * Wait until all flips queued on the window have been programmed or
+ * dropped. Each of them becomes ready within the pre-fence timeout.
+ */
+static void tegra_dc_ext_flush_flips(struct tegra_dc_ext_win *win)
+{
+	wait_event(win->flip_wq, tegra_dc_ext_flip_queue_empty(win));
+	kthread_flush_worker(&win->flip_worker);
+}
+
 static int lock_windows_for_flip(struct tegra_dc_ext_user *user,
 			struct tegra_dc_ext_flip_windowattr *win_attr,
 			int win_num)
@@ -1898,7 +2177,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (!data)
 		return -ENOMEM;
 
-	kthread_init_work(&data->work, &tegra_dc_ext_flip_worker);
+	hrtimer_init(&data->fence_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->fence_timer.function = tegra_dc_ext_pre_fence_timeout;
 	data->ext = ext;
 	data->act_window_num = win_num;
 
@@ -2014,6 +2294,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (trace_flip_rcvd_syncpt_upd_enabled())
 		tegra_dc_flip_trace(data, trace_flip_rcvd_syncpt_upd);
 
+	data->has_timestamp = has_timestamp;
+
 	/* Avoid queueing timestamps on Android, to disable skipping flips */
 #ifndef CONFIG_ANDROID
 	if (has_timestamp) {
@@ -2045,7 +2327,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		data->flip_buf_ele = in_q_ptr;
 	}
 
-	kthread_queue_work(&ext->win[work_index].flip_worker, &data->work);
+	data->work_index = work_index;
+	tegra_dc_ext_flip_arm(data);
 
 	unlock_windows_for_flip(user, win, win_num);
 
@@ -2062,15 +2345,12 @@ fail_pin:
 			if (!data->win[i].handle[j])
 				continue;
 
-			dma_buf_unmap_attachment(data->win[i].handle[j]->attach,
-				data->win[i].handle[j]->sgt, DMA_TO_DEVICE);
-			dma_buf_detach(data->win[i].handle[j]->buf,
-				data->win[i].handle[j]->attach);
-			dma_buf_put(data->win[i].handle[j]->buf);
-			kfree(data->win[i].handle[j]);
+			tegra_dc_ext_unpin_dmabuf(data->win[i].handle[j]);
 		}
 	}
 
+	tegra_dc_ext_flip_disarm(data);
+
 	/* Release the COMMON channel in case of failure. */
 	if (data->imp_dirty)
 		tegra_dc_release_common_channel(ext->dc);
@@ -3568,6 +3848,33 @@ free_and_ret:
 		return ret;
 	}
 
+	case TEGRA_DC_EXT_CRC_STREAM:
+	{
+		struct tegra_dc_ext_crc_stream_arg args;
+		struct tegra_dc *dc = user->ext->dc;
+		struct file *file;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		if (memcmp(args.magic, "TCRC", 4) ||
+			memchr_inv(args.reserved, 0, sizeof(args.reserved)))
+			return -EINVAL;
+
+		ret = tegra_dc_crc_stream_open(dc, &args, &file);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(user_arg, &args, sizeof(args))) {
+			fput(file);
+			put_unused_fd(args.fd);
+			return -EFAULT;
+		}
+
+		fd_install(args.fd, file);
+		return 0;
+	}
+
 	default:
 		return -EINVAL;
 	}
@@ -3680,6 +3987,11 @@ static int tegra_dc_ext_setup_windows(struct tegra_dc_ext *ext)
 		mutex_init(&win->lock);
 		mutex_init(&win->queue_lock);
 		INIT_LIST_HEAD(&win->timestamp_queue);
+
+		spin_lock_init(&win->flip_lock);
+		INIT_LIST_HEAD(&win->flip_queue);
+		kthread_init_work(&win->flip_kick, tegra_dc_ext_flip_worker);
+		init_waitqueue_head(&win->flip_wq);
 	}
 
 	return 0;
@@ -3740,6 +4052,7 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 	}
 
 	ext->dc = dc;
+	tegra_dc_ext_pin_cache_init(&ext->pin_cache, ext->dev->parent);
 
 	ret = tegra_dc_ext_setup_windows(ext);
 	if (ret)
@@ -3777,15 +4090,25 @@ cleanup_alloc:
 
 void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 {
+	struct tegra_dc_dmabuf *cursor_handle;
 	int i;
 
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 		kthread_stop(win->flip_kthread);
+		/* the pins point into ext->pin_cache, drop them first */
+		tegra_dc_ext_unpin_window(win);
 	}
 
+	mutex_lock(&ext->cursor.lock);
+	cursor_handle = ext->cursor.cur_handle;
+	ext->cursor.cur_handle = NULL;
+	mutex_unlock(&ext->cursor.lock);
+	if (cursor_handle)
+		tegra_dc_ext_unpin_dmabuf(cursor_handle);
+
 	/* Remove scanline work */
 	kthread_flush_worker(&ext->scanline_worker);
 	ext->scanline_task = NULL;
@@ -3795,6 +4118,8 @@ void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 	nvhost_syncpt_set_min_eq_max_ext(ext->dc->ndev,
 					ext->dc->vpulse3_syncpt);
 
+	tegra_dc_ext_pin_cache_destroy(&ext->pin_cache);
+
 	device_del(ext->dev);
 	cdev_del(&ext->cdev);
 
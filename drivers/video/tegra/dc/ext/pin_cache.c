@@ -0,0 +1,220 @@
+/*
+ * pin_cache.c: Cache of pinned surfaces for tegradc ext interface.
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Swapchains flip through the same few buffers over and over, so instead
+ * of attaching and mapping every surface on each flip and unmapping it once
+ * the flip retires, keep the mapping around after the last user is gone.
+ *
+ * Idle mappings sit on an LRU list and are evicted once they exceed
+ * pin_cache_kb or pin_cache_entries. Mappings on which the cache holds the
+ * only reference left, i.e. user space released the buffer, are evicted on
+ * the next pin or unpin of the head.
+ */
+
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+
+#include "tegra_dc_ext_priv.h"
+
+static unsigned int pin_cache_kb = 128 * 1024;
+module_param(pin_cache_kb, uint, 0644);
+MODULE_PARM_DESC(pin_cache_kb, "idle surfaces kept pinned per head, in KB");
+
+static unsigned int pin_cache_entries = 32;
+module_param(pin_cache_entries, uint, 0644);
+MODULE_PARM_DESC(pin_cache_entries, "idle surfaces kept pinned per head");
+
+void tegra_dc_ext_pin_cache_init(struct tegra_dc_ext_pin_cache *cache,
+				 struct device *dev)
+{
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+	cache->dev = dev;
+	cache->nr_idle = 0;
+	cache->idle_bytes = 0;
+}
+
+static void tegra_dc_ext_pin_free(struct tegra_dc_ext_pin *pin)
+{
+	dma_buf_unmap_attachment(pin->attach, pin->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(pin->buf, pin->attach);
+	dma_buf_put(pin->buf);
+	kfree(pin);
+}
+
+/* cache->lock must be held, pin must be idle */
+static void tegra_dc_ext_pin_evict(struct tegra_dc_ext_pin_cache *cache,
+				   struct tegra_dc_ext_pin *pin)
+{
+	list_del(&pin->node);
+	cache->nr_idle--;
+	cache->idle_bytes -= pin->buf->size;
+	tegra_dc_ext_pin_free(pin);
+}
+
+/* cache->lock must be held */
+static void tegra_dc_ext_pin_cache_reap(struct tegra_dc_ext_pin_cache *cache)
+{
+	struct tegra_dc_ext_pin *pin, *tmp;
+
+	/* Buffers nobody but us references anymore are gone for good */
+	list_for_each_entry_safe(pin, tmp, &cache->lru, node)
+		if (!pin->users && file_count(pin->buf->file) == 1)
+			tegra_dc_ext_pin_evict(cache, pin);
+}
+
+/* cache->lock must be held */
+static void tegra_dc_ext_pin_cache_trim(struct tegra_dc_ext_pin_cache *cache)
+{
+	struct tegra_dc_ext_pin *pin, *tmp;
+
+	tegra_dc_ext_pin_cache_reap(cache);
+
+	list_for_each_entry_safe(pin, tmp, &cache->lru, node) {
+		if (cache->nr_idle <= pin_cache_entries &&
+			cache->idle_bytes <= (size_t)pin_cache_kb * SZ_1K)
+			break;
+		if (!pin->users)
+			tegra_dc_ext_pin_evict(cache, pin);
+	}
+}
+
+static struct tegra_dc_ext_pin *tegra_dc_ext_pin_create(
+		struct tegra_dc_ext_pin_cache *cache, struct dma_buf *buf)
+{
+	struct tegra_dc_ext_pin *pin;
+	int err = -ENOMEM;
+
+	pin = kzalloc(sizeof(*pin), GFP_KERNEL);
+	if (!pin)
+		return ERR_PTR(-ENOMEM);
+
+	pin->attach = dma_buf_attach(buf, cache->dev);
+	if (IS_ERR_OR_NULL(pin->attach))
+		goto attach_fail;
+
+	pin->sgt = dma_buf_map_attachment(pin->attach, DMA_TO_DEVICE);
+	if (IS_ERR_OR_NULL(pin->sgt))
+		goto sgt_fail;
+
+	if (!device_is_iommuable(cache->dev) && sg_nents(pin->sgt->sgl) > 1) {
+		dev_err(cache->dev,
+			"Cannot use non-contiguous buffer w/ IOMMU disabled\n");
+		err = -EINVAL;
+		goto iommu_fail;
+	}
+
+	pin->addr = sg_dma_address(pin->sgt->sgl);
+	if (!pin->addr)
+		pin->addr = sg_phys(pin->sgt->sgl);
+
+	pin->cache = cache;
+	pin->buf = buf;
+	return pin;
+
+iommu_fail:
+	dma_buf_unmap_attachment(pin->attach, pin->sgt, DMA_TO_DEVICE);
+sgt_fail:
+	dma_buf_detach(buf, pin->attach);
+attach_fail:
+	kfree(pin);
+	return ERR_PTR(err);
+}
+
+/*
+ * Pin buf for scanout, reusing a cached mapping when there is one. Consumes
+ * the caller's reference on buf.
+ */
+struct tegra_dc_ext_pin *tegra_dc_ext_pin_cache_get(
+		struct tegra_dc_ext_pin_cache *cache, struct dma_buf *buf)
+{
+	struct tegra_dc_ext_pin *pin;
+
+	mutex_lock(&cache->lock);
+
+	tegra_dc_ext_pin_cache_reap(cache);
+
+	list_for_each_entry(pin, &cache->lru, node) {
+		if (pin->buf != buf)
+			continue;
+
+		if (!pin->users++) {
+			cache->nr_idle--;
+			cache->idle_bytes -= buf->size;
+		}
+		list_move_tail(&pin->node, &cache->lru);
+		mutex_unlock(&cache->lock);
+
+		dma_buf_put(buf);
+		/* The mapping is reused, but CPU writes still need flushing */
+		dma_sync_sg_for_device(cache->dev, pin->sgt->sgl,
+				       pin->sgt->nents, DMA_TO_DEVICE);
+		return pin;
+	}
+
+	pin = tegra_dc_ext_pin_create(cache, buf);
+	if (!IS_ERR(pin)) {
+		pin->users = 1;
+		list_add_tail(&pin->node, &cache->lru);
+	}
+
+	mutex_unlock(&cache->lock);
+
+	if (IS_ERR(pin))
+		dma_buf_put(buf);
+	return pin;
+}
+
+void tegra_dc_ext_pin_cache_put(struct tegra_dc_ext_pin *pin)
+{
+	struct tegra_dc_ext_pin_cache *cache = pin->cache;
+
+	mutex_lock(&cache->lock);
+	if (!--pin->users) {
+		cache->nr_idle++;
+		cache->idle_bytes += pin->buf->size;
+		tegra_dc_ext_pin_cache_trim(cache);
+	}
+	mutex_unlock(&cache->lock);
+}
+
+/* Unpin all surfaces that are not on screen or queued for a flip */
+void tegra_dc_ext_pin_cache_flush(struct tegra_dc_ext_pin_cache *cache)
+{
+	struct tegra_dc_ext_pin *pin, *tmp;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(pin, tmp, &cache->lru, node)
+		if (!pin->users)
+			tegra_dc_ext_pin_evict(cache, pin);
+	mutex_unlock(&cache->lock);
+}
+
+/* All surfaces must have been unpinned, the cache goes away with its head */
+void tegra_dc_ext_pin_cache_destroy(struct tegra_dc_ext_pin_cache *cache)
+{
+	tegra_dc_ext_pin_cache_flush(cache);
+	WARN_ON(!list_empty(&cache->lru));
+}
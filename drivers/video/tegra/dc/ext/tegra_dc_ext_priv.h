@@ -25,6 +25,8 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <uapi/video/tegra_dc_ext.h>
 
 #include "../dc.h"
@@ -35,10 +37,31 @@ struct tegra_dc_ext_user {
 	struct tegra_dc_ext	*ext;
 };
 
+/* A surface mapped for scanout, shared by all flips that use it */
+struct tegra_dc_ext_pin {
+	struct tegra_dc_ext_pin_cache	*cache;
+	struct list_head		node;
+	struct dma_buf			*buf;
+	struct dma_buf_attachment	*attach;
+	struct sg_table			*sgt;
+	dma_addr_t			addr;
+	int				users;
+};
+
+struct tegra_dc_ext_pin_cache {
+	struct mutex		lock;
+	/* All pins, least recently used first */
+	struct list_head	lru;
+	struct device		*dev;
+	unsigned int		nr_idle;
+	size_t			idle_bytes;
+};
+
 struct tegra_dc_dmabuf {
 	struct dma_buf *buf;
 	struct dma_buf_attachment *attach;
 	struct sg_table *sgt;
+	struct tegra_dc_ext_pin *pin;
 };
 
 enum {
@@ -70,6 +93,12 @@ struct tegra_dc_ext_win {
 
 	struct list_head	timestamp_queue;
 
+	/* Flips in submission order, programmed once their pre-fences signal */
+	spinlock_t		flip_lock;
+	struct list_head	flip_queue;
+	struct kthread_work	flip_kick;
+	wait_queue_head_t	flip_wq;
+
 	bool			enabled;
 };
 
@@ -87,6 +116,8 @@ struct tegra_dc_ext {
 		struct mutex			lock;
 	} cursor;
 
+	struct tegra_dc_ext_pin_cache	pin_cache;
+
 	bool				enabled;
 	bool				vblank_enabled;
 
@@ -148,6 +179,16 @@ extern struct class *tegra_dc_ext_class;
 extern int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
 				   struct tegra_dc_dmabuf **handle,
 				   dma_addr_t *phys_addr);
+extern void tegra_dc_ext_unpin_dmabuf(struct tegra_dc_dmabuf *handle);
+
+extern void tegra_dc_ext_pin_cache_init(struct tegra_dc_ext_pin_cache *cache,
+					struct device *dev);
+extern struct tegra_dc_ext_pin *tegra_dc_ext_pin_cache_get(
+		struct tegra_dc_ext_pin_cache *cache, struct dma_buf *buf);
+extern void tegra_dc_ext_pin_cache_put(struct tegra_dc_ext_pin *pin);
+extern void tegra_dc_ext_pin_cache_flush(struct tegra_dc_ext_pin_cache *cache);
+extern void tegra_dc_ext_pin_cache_destroy(
+		struct tegra_dc_ext_pin_cache *cache);
 
 extern int tegra_dc_ext_cpy_caps_from_user(void __user *user_arg,
 				struct tegra_dc_ext_caps **caps_ptr,
@@ -30,7 +30,8 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 fd,
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_dmabuf *dc_dmabuf;
-	dma_addr_t dma_addr;
+	struct tegra_dc_ext_pin *pin;
+	struct dma_buf *buf;
 
 	*dc_buf = NULL;
 	*phys_addr = -1;
@@ -41,47 +42,34 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 fd,
 	if (!dc_dmabuf)
 		return -ENOMEM;
 
-	dc_dmabuf->buf = dma_buf_get(fd);
-	if (IS_ERR_OR_NULL(dc_dmabuf->buf))
+	buf = dma_buf_get(fd);
+	if (IS_ERR_OR_NULL(buf))
 		goto buf_fail;
 
-	dc_dmabuf->attach = dma_buf_attach(dc_dmabuf->buf, ext->dev->parent);
-	if (IS_ERR_OR_NULL(dc_dmabuf->attach))
-		goto attach_fail;
-
-	dc_dmabuf->sgt = dma_buf_map_attachment(dc_dmabuf->attach,
-						DMA_TO_DEVICE);
-	if (IS_ERR_OR_NULL(dc_dmabuf->sgt))
-		goto sgt_fail;
-
-	if (!device_is_iommuable(ext->dev->parent) &&
-			sg_nents(dc_dmabuf->sgt->sgl) > 1) {
-		dev_err(ext->dev->parent,
-			"Cannot use non-contiguous buffer w/ IOMMU disabled\n");
-		goto iommu_fail;
-	}
+	pin = tegra_dc_ext_pin_cache_get(&ext->pin_cache, buf);
+	if (IS_ERR(pin))
+		goto buf_fail;
 
-	dma_addr = sg_dma_address(dc_dmabuf->sgt->sgl);
-	if (dma_addr)
-		*phys_addr = dma_addr;
-	else
-		*phys_addr = sg_phys(dc_dmabuf->sgt->sgl);
+	dc_dmabuf->pin = pin;
+	dc_dmabuf->buf = pin->buf;
+	dc_dmabuf->attach = pin->attach;
+	dc_dmabuf->sgt = pin->sgt;
+	*phys_addr = pin->addr;
 
 	*dc_buf = dc_dmabuf;
 
 	return 0;
-iommu_fail:
-	dma_buf_unmap_attachment(dc_dmabuf->attach, dc_dmabuf->sgt,
-		DMA_TO_DEVICE);
-sgt_fail:
-	dma_buf_detach(dc_dmabuf->buf, dc_dmabuf->attach);
-attach_fail:
-	dma_buf_put(dc_dmabuf->buf);
 buf_fail:
 	kfree(dc_dmabuf);
 	return -ENOMEM;
 }
 
+void tegra_dc_ext_unpin_dmabuf(struct tegra_dc_dmabuf *dc_buf)
+{
+	tegra_dc_ext_pin_cache_put(dc_buf->pin);
+	kfree(dc_buf);
+}
+
 int tegra_dc_ext_cpy_caps_from_user(void __user *user_arg,
 				struct tegra_dc_ext_caps **caps_ptr,
 				u32 *nr_elements_ptr)
@@ -23,6 +23,7 @@
 #include "dc.h"
 #include "dc_priv.h"
 #include "nvdisp.h"
+#include "nvdisp_bw_calc.h"
 #include "dc_common.h"
 
 #ifdef CONFIG_TEGRA_ISOMGR
@@ -44,13 +45,10 @@ static int tegra_nvdisp_set_latency_allowance(u32 bw, u32 emc_freq)
 	/* Zero out this struct since it's ignored by the LA/PTSA driver. */
 	memset(&disp_params, 0, sizeof(disp_params));
 
-	/* Our bw is in KB/s, but LA takes MB/s. Round up to the next MB/s. */
-	if (bw != U32_MAX)
-		bw = bw / 1000 + 1;
-
+	/* Our bw is in KB/s, but LA takes MB/s. */
 	return tegra_set_disp_latency_allowance(TEGRA_LA_NVDISPLAYR,
 					emc_freq,
-					bw,
+					nvdisp_bw_to_la_mbps(bw),
 					disp_params);
 }
 
@@ -147,98 +145,64 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 	/*
 	 * This function is responsible for updating the ISO bw, EMC floor,
 	 * LA/PTSA, and hubclk values both before and after the current window
-	 * update. In the two below cases, let X represent the current frame
-	 * configuration and X' represent the new proposed frame configuration.
-	 *
-	 * A) Before the window update actually occurs, display needs to ensure
-	 *    that the four aforementioned values are compatible with both X and
-	 *    X'. This is due to the fact that any updates to these values take
-	 *    effect immediately and aren't latched to any kind of frame
-	 *    boundary. In order to update these values appropriately, display
-	 *    will simply program the max across both X and X'.
-	 * B) After the window update occurs and the new state has promoted,
-	 *    display can program all the new values associated with X' as long
-	 *    as they don't violate the ISO bw requirements that are currently
-	 *    in place.
+	 * update. See nvdisp_bw_merge() for how the values to program are
+	 * picked.
 	 */
 
 	struct nvdisp_bandwidth_config *cur_config = &ihub_bw_info.cur_config;
-	u32 final_iso_bw = 0;
-	u32 final_total_bw = 0;
-	u32 final_emc = 0;
-	u32 final_hubclk = 0;
+	struct nvdisp_bandwidth_config new_config = {
+		.iso_bw = new_iso_bw,
+		.total_bw = new_total_bw,
+		.emc_la_floor = new_emc,
+		.hubclk = new_hubclk,
+	};
+	struct nvdisp_bandwidth_config final;
+	struct nvdisp_bw_state state;
+	u32 max_pending_bw = 0;
 	int ret = 0;
 
 	if (IS_ERR_OR_NULL(ihub_bw_info.isomgr_handle) ||
 				IS_ERR_OR_NULL(ihub_bw_info.bwmgr_handle))
 		return -EINVAL;
 
-	final_iso_bw = cur_config->iso_bw;
-	final_total_bw = cur_config->total_bw;
-	final_emc = cur_config->emc_la_floor;
-	final_hubclk = cur_config->hubclk;
+	state.cur = *cur_config;
+	state.reserved_bw = ihub_bw_info.reserved_bw;
+	state.emc_at_res_bw = ihub_bw_info.emc_at_res_bw;
+	state.hubclk_at_res_bw = ihub_bw_info.hubclk_at_res_bw;
 
-	if (before_win_update) { /* Case A */
-		bool update_bw = false;
+	if (!before_win_update)
+		max_pending_bw = tegra_nvdisp_get_max_pending_bw(dc);
 
+	if (nvdisp_bw_merge(&state, &new_config, before_win_update,
+				max_pending_bw, &final)) {
 		/*
-		 * ISO clients can only realize exactly what they have already
-		 * reserved. The ISO bw that display has currently reserved is
-		 * always guaranteed to be at least the bw needed for the
-		 * proposed configuration since we aggregate bw reservations
-		 * during PROPOSE.
+		 * Client's latency tolerance is ignored by isomgr. Pass in a
+		 * dummy value of 1000 usec.
 		 */
-		if (new_iso_bw > cur_config->iso_bw) {
-			final_iso_bw = ihub_bw_info.reserved_bw;
-			update_bw = true;
+		if (!tegra_isomgr_reserve(ihub_bw_info.isomgr_handle,
+					new_iso_bw,
+					1000)) {
+			pr_err("%s: failed to reserve %u KB/s\n",
+				__func__, new_iso_bw);
+			return -EINVAL;
 		}
 
-		final_emc = max(final_emc, new_emc);
-		if (update_bw)
-			final_emc = max(final_emc, ihub_bw_info.emc_at_res_bw);
-
-		final_hubclk = max(final_hubclk, new_hubclk);
-		if (update_bw)
-			final_hubclk =
-			max(final_hubclk, ihub_bw_info.hubclk_at_res_bw);
-	} else { /* Case B */
-		u32 max_bw = tegra_nvdisp_get_max_pending_bw(dc);
-		if (new_iso_bw >= max_bw &&
-					new_iso_bw < cur_config->iso_bw) {
-			/*
-			 * Client's latency tolerance is ignored by isomgr. Pass
-			 * in a dummy value of 1000 usec.
-			 */
-			if (!tegra_isomgr_reserve(ihub_bw_info.isomgr_handle,
-						new_iso_bw,
-						1000)) {
-				pr_err("%s: failed to reserve %u KB/s\n",
-					__func__, new_iso_bw);
-				return -EINVAL;
-			}
-
-			ihub_bw_info.reserved_bw = new_iso_bw;
-			ihub_bw_info.emc_at_res_bw = new_emc;
-			ihub_bw_info.hubclk_at_res_bw = new_hubclk;
-			cur_config->total_bw = new_total_bw;
-
-			final_iso_bw = new_iso_bw;
-			final_total_bw = new_total_bw;
-			final_emc = new_emc;
-			final_hubclk = new_hubclk;
-		}
+		ihub_bw_info.reserved_bw = new_iso_bw;
+		ihub_bw_info.emc_at_res_bw = new_emc;
+		ihub_bw_info.hubclk_at_res_bw = new_hubclk;
+		cur_config->total_bw = new_total_bw;
 	}
 
 	ret = tegra_nvdisp_program_final_bw_settings(cur_config,
-						final_iso_bw,
-						final_total_bw,
-						final_emc,
-						final_hubclk,
+						final.iso_bw,
+						final.total_bw,
+						final.emc_la_floor,
+						final.hubclk,
 						before_win_update);
 
-	trace_display_imp_bw_programmed(dc->ctrl_num, final_iso_bw,
-					final_total_bw, final_emc,
-					final_hubclk);
+	trace_display_imp_bw_programmed(dc->ctrl_num, final.iso_bw,
+					final.total_bw, final.emc_la_floor,
+					final.hubclk);
 
 	return ret;
 }
@@ -529,12 +493,15 @@ static int tegra_nvdisp_bandwidth_register_max_config(
 
 		/*
 		 * Check that our dedicated request doesn't exceed the total ISO
-		 * bw. Both operands are in KB/s.
+		 * bw and that the required EMC floor doesn't exceed the max EMC
+		 * rate allowed.
 		 */
-		if (cfg->iso_bw > total_iso_bw) {
-			ret = -E2BIG;
+		cfg_dram_freq = cfg->emc_la_floor * emc_to_dram_factor;
+		ret = nvdisp_bw_check_limits(cfg, total_iso_bw,
+				tegra_bwmgr_round_rate(cfg_dram_freq),
+				max_emc_rate);
+		if (ret)
 			continue;
-		}
 
 		/* Make sure isomgr registration succeeds. */
 		isomgr_handle = tegra_isomgr_register(iso_client,
@@ -546,17 +513,6 @@ static int tegra_nvdisp_bandwidth_register_max_config(
 			continue;
 		}
 
-		/*
-		 * Check that the required EMC floor doesn't exceed the max EMC
-		 * rate allowed.
-		 */
-		cfg_dram_freq = cfg->emc_la_floor * emc_to_dram_factor;
-		if (tegra_bwmgr_round_rate(cfg_dram_freq) > max_emc_rate) {
-			tegra_isomgr_unregister(isomgr_handle);
-			ret = -E2BIG;
-			continue;
-		}
-
 		ihub_bw_info.isomgr_handle = isomgr_handle;
 		ihub_bw_info.max_config = *cfg;
 		found_max_cfg = true;
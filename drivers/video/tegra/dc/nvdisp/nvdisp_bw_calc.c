@@ -0,0 +1,269 @@
+/*
+ * drivers/video/tegra/dc/nvdisp/nvdisp_bw_calc.c
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Keep this file free of kernel-only dependencies, see nvdisp_bw_calc.h */
+
+#ifdef __KERNEL__
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#else
+#include <errno.h>
+#endif
+
+#include "nvdisp_bw_calc.h"
+
+#ifndef __KERNEL__
+#define U32_MAX		((u32)~0U)
+#define max(a, b)	((a) > (b) ? (a) : (b))
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+#endif
+
+/*
+ * The window-level model below only feeds tools/nvdisp-bw. The kernel takes
+ * its per-config values from user space, so it is not built into it.
+ */
+#ifndef __KERNEL__
+
+static inline u32 nvdisp_bw_clamp_u32(u64 val)
+{
+	return val > U32_MAX ? U32_MAX : (u32)val;
+}
+
+/*
+ * Peak fetch bandwidth of one window in KB/s:
+ * pclk * bytes per pixel * H downscale * V downscale. Upscaling does not
+ * fetch more than the source, so only downscaling factors are applied.
+ */
+u32 nvdisp_bw_calc_win(u32 pclk_khz, const struct nvdisp_bw_win *win)
+{
+	u64 bw;
+
+	if (!win->in_w || !win->in_h || !win->out_w || !win->out_h)
+		return 0;
+
+	bw = (u64)pclk_khz * win->bpp / 8;
+	if (win->in_w > win->out_w)
+		bw = div_u64(bw * win->in_w, win->out_w);
+	if (win->in_h > win->out_h)
+		bw = div_u64(bw * win->in_h, win->out_h);
+
+	return nvdisp_bw_clamp_u32(bw);
+}
+
+/* Source pixels per second the hub must fetch for one window */
+static u64 nvdisp_bw_win_pix_rate(u32 pclk_khz,
+				  const struct nvdisp_bw_win *win)
+{
+	u64 rate;
+
+	if (!win->in_w || !win->in_h || !win->out_w || !win->out_h)
+		return 0;
+
+	rate = (u64)pclk_khz * 1000;
+	if (win->in_w > win->out_w)
+		rate = div_u64(rate * win->in_w, win->out_w);
+	if (win->in_h > win->out_h)
+		rate = div_u64(rate * win->in_h, win->out_h);
+
+	return rate;
+}
+
+static bool nvdisp_bw_line_in_win(u32 line, const struct nvdisp_bw_win *win)
+{
+	return line >= win->out_y && line < win->out_y + win->out_h;
+}
+
+/*
+ * Head bandwidth (KB/s) and hub pixel rate (pixels/s): the worst case over
+ * the first scanline of each window of all the windows overlapping it.
+ */
+int nvdisp_bw_calc_head(const struct nvdisp_bw_head *head, u32 *bw,
+			u64 *pix_rate)
+{
+	u32 win_bw[NVDISP_BW_MAX_WINS];
+	u64 win_rate[NVDISP_BW_MAX_WINS];
+	u64 max_bw = 0, max_rate = 0;
+	u32 i, j;
+
+	if (head->num_wins > NVDISP_BW_MAX_WINS)
+		return -EINVAL;
+
+	for (i = 0; i < head->num_wins; i++) {
+		win_bw[i] = nvdisp_bw_calc_win(head->pclk_khz, &head->wins[i]);
+		win_rate[i] = nvdisp_bw_win_pix_rate(head->pclk_khz,
+						     &head->wins[i]);
+	}
+
+	for (i = 0; i < head->num_wins; i++) {
+		u64 line_bw = 0, line_rate = 0;
+
+		if (!win_bw[i])
+			continue;
+
+		for (j = 0; j < head->num_wins; j++) {
+			if (!nvdisp_bw_line_in_win(head->wins[i].out_y,
+						   &head->wins[j]))
+				continue;
+			line_bw += win_bw[j];
+			line_rate += win_rate[j];
+		}
+
+		max_bw = max(max_bw, line_bw);
+		max_rate = max(max_rate, line_rate);
+	}
+
+	*bw = nvdisp_bw_clamp_u32(max_bw);
+	*pix_rate = max_rate;
+	return 0;
+}
+
+/*
+ * Compute the configuration needed for all heads scanning out at once:
+ * total_bw is what display consumes, iso_bw adds the catchup headroom that
+ * lets the mempools refill after a latency event, emc_la_floor is the EMC
+ * rate that sustains iso_bw and hubclk the rate the hub needs to keep up
+ * with all heads' pixel rates.
+ */
+int nvdisp_bw_calc_config(const struct nvdisp_bw_head *heads, int num_heads,
+			  const struct nvdisp_bw_params *params,
+			  struct nvdisp_bandwidth_config *cfg)
+{
+	u64 total_bw = 0, pix_rate = 0, iso_bw, emc, hubclk;
+	int i, ret;
+
+	if (!params->dram_bytes_per_clk || !params->dram_efficiency_pct ||
+		!params->hub_pixels_per_clk)
+		return -EINVAL;
+
+	for (i = 0; i < num_heads; i++) {
+		u32 head_bw;
+		u64 head_rate;
+
+		ret = nvdisp_bw_calc_head(&heads[i], &head_bw, &head_rate);
+		if (ret)
+			return ret;
+
+		total_bw += head_bw;
+		pix_rate += head_rate;
+	}
+
+	iso_bw = div_u64(total_bw * params->catchup_permille, 1000);
+
+	/* KB/s -> bytes/s, derated by DRAM efficiency, per EMC clock */
+	emc = div_u64(iso_bw * 1000 * 100,
+		      params->dram_bytes_per_clk * params->dram_efficiency_pct);
+
+	hubclk = div_u64(pix_rate * (100 + params->hubclk_margin_pct),
+			 params->hub_pixels_per_clk * 100);
+
+	cfg->total_bw = nvdisp_bw_clamp_u32(total_bw);
+	cfg->iso_bw = nvdisp_bw_clamp_u32(iso_bw);
+	cfg->emc_la_floor = nvdisp_bw_clamp_u32(emc);
+	cfg->hubclk = nvdisp_bw_clamp_u32(hubclk);
+	return 0;
+}
+
+#endif /* !__KERNEL__ */
+
+/* The LA/PTSA driver takes MB/s, round up to the next MB/s */
+u32 nvdisp_bw_to_la_mbps(u32 bw)
+{
+	if (bw == U32_MAX)
+		return bw;
+
+	return bw / 1000 + 1;
+}
+
+/*
+ * Check a configuration against the platform: the dedicated ISO bw must fit
+ * in the total ISO bw (KB/s) and the DRAM rate needed for its EMC floor must
+ * not exceed the max DRAM rate (Hz).
+ */
+int nvdisp_bw_check_limits(const struct nvdisp_bandwidth_config *cfg,
+			   u32 total_iso_bw, u64 dram_hz, u64 max_dram_hz)
+{
+	if (cfg->iso_bw > total_iso_bw)
+		return -E2BIG;
+
+	if (dram_hz > max_dram_hz)
+		return -E2BIG;
+
+	return 0;
+}
+
+/*
+ * Work out what to program around a window update, with X the current and
+ * X' the new proposed configuration.
+ *
+ * A) Before the window update actually occurs, display needs to ensure that
+ *    the ISO bw, EMC floor, LA/PTSA and hubclk are compatible with both X
+ *    and X'. These take effect immediately and aren't latched to any kind of
+ *    frame boundary, so the max across both X and X' is programmed.
+ * B) After the window update occurs and the new state has promoted, all the
+ *    values of X' can be programmed as long as they don't violate the ISO
+ *    bw requirements of other pending updates (max_pending_bw).
+ *
+ * Returns true when X' has to be reserved with isomgr before final_cfg can
+ * be programmed, which only happens in case B when the bw goes down.
+ */
+bool nvdisp_bw_merge(const struct nvdisp_bw_state *state,
+		     const struct nvdisp_bandwidth_config *new_cfg,
+		     bool before_win_update, u32 max_pending_bw,
+		     struct nvdisp_bandwidth_config *final_cfg)
+{
+	*final_cfg = state->cur;
+
+	if (before_win_update) { /* Case A */
+		/*
+		 * ISO clients can only realize exactly what they have already
+		 * reserved. The ISO bw that display has currently reserved is
+		 * always guaranteed to be at least the bw needed for the
+		 * proposed configuration since we aggregate bw reservations
+		 * during PROPOSE.
+		 */
+		bool update_bw = new_cfg->iso_bw > state->cur.iso_bw;
+
+		if (update_bw)
+			final_cfg->iso_bw = state->reserved_bw;
+
+		final_cfg->emc_la_floor = max(final_cfg->emc_la_floor,
+					      new_cfg->emc_la_floor);
+		if (update_bw)
+			final_cfg->emc_la_floor = max(final_cfg->emc_la_floor,
+						      state->emc_at_res_bw);
+
+		final_cfg->hubclk = max(final_cfg->hubclk, new_cfg->hubclk);
+		if (update_bw)
+			final_cfg->hubclk = max(final_cfg->hubclk,
+						state->hubclk_at_res_bw);
+
+		return false;
+	}
+
+	/* Case B */
+	if (new_cfg->iso_bw >= max_pending_bw &&
+			new_cfg->iso_bw < state->cur.iso_bw) {
+		*final_cfg = *new_cfg;
+		return true;
+	}
+
+	return false;
+}
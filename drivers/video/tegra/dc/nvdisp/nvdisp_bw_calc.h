@@ -0,0 +1,96 @@
+/*
+ * drivers/video/tegra/dc/nvdisp/nvdisp_bw_calc.h
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __NVDISP_BW_CALC_H
+#define __NVDISP_BW_CALC_H
+
+/*
+ * ISO bandwidth, EMC floor and hubclk math for nvdisplay. This is plain
+ * arithmetic with no kernel dependencies, so that tools/nvdisp-bw can build
+ * the very same code in user space and evaluate display configurations
+ * offline.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+#endif
+
+struct nvdisp_bandwidth_config {
+	u32 iso_bw;		/* KB/s */
+	u32 total_bw;		/* KB/s */
+	u32 emc_la_floor;	/* Hz */
+	u32 hubclk;		/* Hz */
+};
+
+#ifndef __KERNEL__
+/* Window-level model, tools/nvdisp-bw only */
+#define NVDISP_BW_MAX_WINS	8
+
+/* A window as fetched: sizes are after rotation, in pixels */
+struct nvdisp_bw_win {
+	u32 in_w;
+	u32 in_h;
+	u32 out_w;
+	u32 out_h;
+	u32 out_y;
+	u32 bpp;		/* bits fetched per source pixel, all planes */
+};
+
+struct nvdisp_bw_head {
+	u32 pclk_khz;
+	u32 num_wins;
+	const struct nvdisp_bw_win *wins;
+};
+
+struct nvdisp_bw_params {
+	u32 catchup_permille;	/* ISO bw reserved per 1000 KB/s consumed */
+	u32 dram_bytes_per_clk;	/* DRAM bytes per EMC clock */
+	u32 dram_efficiency_pct;
+	u32 hub_pixels_per_clk;
+	u32 hubclk_margin_pct;
+};
+
+u32 nvdisp_bw_calc_win(u32 pclk_khz, const struct nvdisp_bw_win *win);
+int nvdisp_bw_calc_head(const struct nvdisp_bw_head *head, u32 *bw,
+			u64 *pix_rate);
+int nvdisp_bw_calc_config(const struct nvdisp_bw_head *heads, int num_heads,
+			  const struct nvdisp_bw_params *params,
+			  struct nvdisp_bandwidth_config *cfg);
+#endif /* !__KERNEL__ */
+
+/* What has been reserved and programmed so far */
+struct nvdisp_bw_state {
+	struct nvdisp_bandwidth_config cur;
+	u32 reserved_bw;	/* KB/s */
+	u32 emc_at_res_bw;	/* Hz */
+	u32 hubclk_at_res_bw;	/* Hz */
+};
+
+u32 nvdisp_bw_to_la_mbps(u32 bw);
+int nvdisp_bw_check_limits(const struct nvdisp_bandwidth_config *cfg,
+			   u32 total_iso_bw, u64 dram_hz, u64 max_dram_hz);
+bool nvdisp_bw_merge(const struct nvdisp_bw_state *state,
+		     const struct nvdisp_bandwidth_config *new_cfg,
+		     bool before_win_update, u32 max_pending_bw,
+		     struct nvdisp_bandwidth_config *final_cfg);
+
+#endif /* __NVDISP_BW_CALC_H */
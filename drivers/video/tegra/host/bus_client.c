@@ -59,6 +59,7 @@
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
 #include "nvhost_sync.h"
+#include "nvhost_timeline.h"
 #include "vhost/vhost.h"
 
 static int validate_reg(struct platform_device *ndev, u32 offset, int count)
@@ -1937,6 +1938,33 @@ struct nvhost_channel *nvhost_find_chan_by_clientid(
 	return ch;
 }
 
+/*
+ * Syncpoint pre-fences are what a task waits for, syncpoint post-fences
+ * what it signals. Other fence types have no syncpoint to match on.
+ */
+static void nvhost_timeline_record_fences(struct platform_device *pdev,
+					  u32 task_syncpt_id,
+					  u32 task_syncpt_thresh,
+					  struct nvdev_fence *fences,
+					  u8 num_fences,
+					  enum nvdev_fence_kind kind,
+					  u64 timestamp)
+{
+	u8 i;
+
+	for (i = 0; i < num_fences; i++) {
+		if (fences[i].type != NVDEV_FENCE_TYPE_SYNCPT)
+			continue;
+
+		nvhost_timeline_record(pdev,
+			kind == NVDEV_FENCE_KIND_PRE ?
+				NVHOST_TIMELINE_WAIT : NVHOST_TIMELINE_SIGNAL,
+			task_syncpt_id, task_syncpt_thresh,
+			fences[i].syncpoint_index, fences[i].syncpoint_value,
+			timestamp, 0);
+	}
+}
+
 #ifdef CONFIG_EVENTLIB
 void nvhost_eventlib_log_task(struct platform_device *pdev,
 			      u32 syncpt_id,
@@ -1948,6 +1976,11 @@ void nvhost_eventlib_log_task(struct platform_device *pdev,
 	struct nvhost_task_begin task_begin;
 	struct nvhost_task_end task_end;
 
+	nvhost_timeline_record(pdev, NVHOST_TIMELINE_EXEC, syncpt_id,
+			       syncpt_thresh, 0, 0, timestamp_start,
+			       timestamp_end > timestamp_start ?
+			       timestamp_end - timestamp_start : 0);
+
 	if (!pdata->eventlib_id)
 		return;
 
@@ -1986,6 +2019,9 @@ void nvhost_eventlib_log_submit(struct platform_device *pdev,
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
 	struct nvhost_task_submit task_submit;
 
+	nvhost_timeline_record(pdev, NVHOST_TIMELINE_SUBMIT, syncpt_id,
+			       syncpt_thresh, 0, 0, timestamp, 0);
+
 	if (!pdata->eventlib_id)
 		return;
 
@@ -2016,6 +2052,9 @@ void nvhost_eventlib_log_fences(struct platform_device *pdev,
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
 	u8 i;
 
+	nvhost_timeline_record_fences(pdev, task_syncpt_id, task_syncpt_thresh,
+				      fences, num_fences, kind, timestamp);
+
 	if (!pdata->eventlib_id)
 		return;
 
@@ -2063,10 +2102,14 @@ void nvhost_eventlib_log_fences(struct platform_device *pdev,
 #else
 void nvhost_eventlib_log_task(struct platform_device *pdev,
 			      u32 syncpt_id,
-			      u32 syncpt_thres,
+			      u32 syncpt_thresh,
 			      u64 timestamp_start,
 			      u64 timestamp_end)
 {
+	nvhost_timeline_record(pdev, NVHOST_TIMELINE_EXEC, syncpt_id,
+			       syncpt_thresh, 0, 0, timestamp_start,
+			       timestamp_end > timestamp_start ?
+			       timestamp_end - timestamp_start : 0);
 }
 
 void nvhost_eventlib_log_submit(struct platform_device *pdev,
@@ -2074,6 +2117,8 @@ void nvhost_eventlib_log_submit(struct platform_device *pdev,
 				u32 syncpt_thresh,
 				u64 timestamp)
 {
+	nvhost_timeline_record(pdev, NVHOST_TIMELINE_SUBMIT, syncpt_id,
+			       syncpt_thresh, 0, 0, timestamp, 0);
 }
 
 void nvhost_eventlib_log_fences(struct platform_device *pdev,
@@ -2084,6 +2129,8 @@ void nvhost_eventlib_log_fences(struct platform_device *pdev,
 				enum nvdev_fence_kind kind,
 				u64 timestamp)
 {
+	nvhost_timeline_record_fences(pdev, task_syncpt_id, task_syncpt_thresh,
+				      fences, num_fences, kind, timestamp);
 }
 
 #endif
@@ -31,6 +31,10 @@
 #include <linux/module.h>
 #include <linux/version.h>
 #include <linux/iopoll.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+#include <linux/pm_runtime.h>
 
 #include "dev.h"
 #include "class_ids.h"
@@ -54,12 +58,55 @@
 #include "t194/t194.h"
 #endif
 
+static struct flcn *nvhost_flcn_alloc(struct platform_device *dev);
+static int nvhost_flcn_get_ucode_locked(struct platform_device *dev,
+					struct flcn *v);
 static int nvhost_flcn_init_sw(struct platform_device *dev);
 static int nvhost_flcn_deinit_sw(struct platform_device *dev);
 
 #define FLCN_IDLE_TIMEOUT_DEFAULT	100000	/* 100 milliseconds */
 #define FLCN_IDLE_CHECK_PERIOD		10	/* 10 usec */
 
+/*
+ * The ucode images stay in DMA memory across power gating so that a
+ * resume only has to copy them into IMEM/DMEM. fw_cache_limit_kb caps
+ * the memory they take, when exceeded the least recently booted images
+ * of suspended engines are dropped and read again on their next boot.
+ * The limit is enforced on every cold read and whenever it is written.
+ */
+static unsigned int fw_cache_limit_kb;
+
+static DEFINE_MUTEX(flcn_fw_cache_lock);
+static LIST_HEAD(flcn_fw_cache);
+static size_t flcn_fw_cache_size;
+
+static void flcn_fw_cache_evict(struct flcn *keep);
+
+/* lowering the limit at run time evicts right away */
+static int flcn_fw_cache_limit_set(const char *val,
+				   const struct kernel_param *kp)
+{
+	int err;
+
+	mutex_lock(&flcn_fw_cache_lock);
+	err = param_set_uint(val, kp);
+	if (!err)
+		flcn_fw_cache_evict(NULL);
+	mutex_unlock(&flcn_fw_cache_lock);
+
+	return err;
+}
+
+static const struct kernel_param_ops flcn_fw_cache_limit_ops = {
+	.set = flcn_fw_cache_limit_set,
+	.get = param_get_uint,
+};
+
+module_param_cb(fw_cache_limit_kb, &flcn_fw_cache_limit_ops,
+		&fw_cache_limit_kb, 0644);
+MODULE_PARM_DESC(fw_cache_limit_kb,
+		 "Limit for resident falcon ucode images in KiB, 0 = no limit");
+
 static irqreturn_t flcn_isr(int irq, void *dev_id)
 {
 	struct platform_device *pdev = (struct platform_device *)(dev_id);
@@ -144,6 +191,23 @@ static int nvhost_flcn_dma_wait_idle(struct platform_device *pdev)
 	return ret;
 }
 
+static int nvhost_flcn_dma_wait_room(struct platform_device *pdev)
+{
+	int ret;
+	void __iomem *addr = get_aperture(pdev, 0) + flcn_dmatrfcmd_r();
+	u32 val;
+
+	/* a slot frees up within a 256b transfer, do not sleep for it */
+	ret = readl_poll_timeout(addr, val,
+				(flcn_dmatrfcmd_full_v(val) !=
+				 flcn_dmatrfcmd_full_true_v()),
+				0, FLCN_IDLE_TIMEOUT_DEFAULT);
+	if (ret)
+		nvhost_err(&pdev->dev, "flcn dma queue full =%x\n", val);
+
+	return ret;
+}
+
 static int flcn_dma_pa_to_internal_256b(struct platform_device *pdev,
 					phys_addr_t pa, u32 internal_offset,
 					bool imem)
@@ -152,6 +216,7 @@ static int flcn_dma_pa_to_internal_256b(struct platform_device *pdev,
 	u32 cmd = flcn_dmatrfcmd_size_256b_f();
 	u32 pa_offset =  flcn_dmatrffboffs_offs_f(pa);
 	u32 i_offset = flcn_dmatrfmoffs_offs_f(internal_offset);
+	int ret;
 
 	if (imem)
 		cmd |= flcn_dmatrfcmd_imem_true_f();
@@ -159,12 +224,19 @@ static int flcn_dma_pa_to_internal_256b(struct platform_device *pdev,
 	if (pdata->isolate_contexts)
 		cmd |= flcn_dmatrfcmd_dmactx_f(1);
 
+	/*
+	 * Only wait for a free slot in the transfer queue, the caller
+	 * waits for the queue to drain once all blocks are issued.
+	 */
+	ret = nvhost_flcn_dma_wait_room(pdev);
+	if (ret)
+		return ret;
+
 	host1x_writel(pdev, flcn_dmatrfmoffs_r(), i_offset);
 	host1x_writel(pdev, flcn_dmatrffboffs_r(), pa_offset);
 	host1x_writel(pdev, flcn_dmatrfcmd_r(), cmd);
 
-	return nvhost_flcn_dma_wait_idle(pdev);
-
+	return 0;
 }
 
 int nvhost_flcn_load_image(struct platform_device *pdev,
@@ -198,6 +270,8 @@ int nvhost_flcn_load_image(struct platform_device *pdev,
 			goto err;
 	}
 
+	ret = nvhost_flcn_dma_wait_idle(pdev);
+
 err:
 	if (ret)
 		nvhost_err(&pdev->dev, "flcn_load_image failed: 0x%x\n", ret);
@@ -337,6 +411,84 @@ int flcn_reload_fw(struct platform_device *pdev)
 	return 0;
 }
 
+static void flcn_free_ucode(struct platform_device *dev, struct flcn *v)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
+	DEFINE_DMA_ATTRS(attrs);
+	dma_set_attr(DMA_ATTR_READ_ONLY, &attrs);
+#endif
+
+	if (v->mapped) {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
+		dma_free_attrs(&dev->dev, v->size, v->mapped, v->dma_addr,
+			       &attrs);
+#else
+		dma_free_attrs(&dev->dev, v->size, v->mapped, v->dma_addr,
+			       DMA_ATTR_READ_ONLY);
+#endif
+		v->mapped = NULL;
+		v->dma_addr = 0;
+	}
+	v->valid = false;
+}
+
+static void flcn_fw_cache_touch(struct flcn *v)
+{
+	mutex_lock(&flcn_fw_cache_lock);
+	if (!list_empty(&v->cache_node))
+		list_move_tail(&v->cache_node, &flcn_fw_cache);
+	mutex_unlock(&flcn_fw_cache_lock);
+}
+
+/*
+ * Evict the least recently booted images until the cache fits in
+ * fw_cache_limit_kb, never touching keep, whose lock the caller holds.
+ * Images carrying FCE ucode are never evicted as the engine channels
+ * refer to the FCE copy in place. Busy images are skipped, so the
+ * limit is a target rather than a hard cap. Called with
+ * flcn_fw_cache_lock held.
+ */
+static void flcn_fw_cache_evict(struct flcn *keep)
+{
+	size_t limit = (size_t)fw_cache_limit_kb * SZ_1K;
+	struct flcn *old, *tmp;
+
+	list_for_each_entry_safe(old, tmp, &flcn_fw_cache, cache_node) {
+		if (!limit || flcn_fw_cache_size <= limit)
+			break;
+
+		if (old == keep || old->fce.size)
+			continue;
+
+		if (!mutex_trylock(&old->lock))
+			continue;
+
+		if (pm_runtime_suspended(&old->pdev->dev)) {
+			list_del_init(&old->cache_node);
+			flcn_fw_cache_size -= old->size;
+			flcn_free_ucode(old->pdev, old);
+			old->evictions++;
+			nvhost_dbg_info("evicted %s ucode, cache %zu bytes",
+					dev_name(&old->pdev->dev),
+					flcn_fw_cache_size);
+		}
+		mutex_unlock(&old->lock);
+	}
+}
+
+/*
+ * Account a freshly read image of v, whose lock the caller holds, and
+ * evict older images if that takes the cache over fw_cache_limit_kb.
+ */
+static void flcn_fw_cache_add(struct flcn *v)
+{
+	mutex_lock(&flcn_fw_cache_lock);
+	list_add_tail(&v->cache_node, &flcn_fw_cache);
+	flcn_fw_cache_size += v->size;
+	flcn_fw_cache_evict(v);
+	mutex_unlock(&flcn_fw_cache_lock);
+}
+
 static int flcn_read_ucode(struct platform_device *dev,
 		    const char *fw_name,
 		    struct flcn *v)
@@ -383,6 +535,8 @@ static int flcn_read_ucode(struct platform_device *dev,
 	v->valid = true;
 	release_firmware(ucode_fw);
 
+	flcn_fw_cache_add(v);
+
 	return 0;
 
 clean_up:
@@ -479,20 +633,39 @@ int nvhost_flcn_start(struct platform_device *pdev, u32 bootvec)
 }
 
 
+static void flcn_boot_stats_update(struct flcn_boot_stats *stats,
+				   ktime_t start)
+{
+	u32 us = (u32)ktime_us_delta(ktime_get(), start);
+
+	stats->count++;
+	stats->last_us = us;
+	stats->max_us = max(stats->max_us, us);
+	stats->total_us += us;
+}
+
 int nvhost_flcn_finalize_poweron(struct platform_device *pdev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	ktime_t start = ktime_get();
 	struct flcn *v;
+	bool cold;
 	int err = 0;
 
-	err = nvhost_flcn_init_sw(pdev);
+	v = nvhost_flcn_alloc(pdev);
+	if (!v)
+		return -ENOMEM;
+
+	/* hold the image until it has been copied to the falcon */
+	mutex_lock(&v->lock);
+	cold = !v->valid;
+	err = nvhost_flcn_get_ucode_locked(pdev, v);
 	if (err)
-		return err;
+		goto err_unlock;
 
-	v = get_flcn(pdev);
 	err = nvhost_flcn_wait_mem_scrubbing(pdev);
 	if (err)
-		return err;
+		goto err_unlock;
 
 	/* load transcfg configuration if defined */
 	if (pdata->transcfg_addr)
@@ -500,7 +673,8 @@ int nvhost_flcn_finalize_poweron(struct platform_device *pdev)
 
 	err = nvhost_flcn_load_image(pdev, v->dma_addr, &v->os, 0);
 	if (err)
-		return err;
+		goto err_unlock;
+	mutex_unlock(&v->lock);
 
 	nvhost_flcn_irq_mask_set(pdev);
 	nvhost_flcn_irq_dest_set(pdev);
@@ -509,7 +683,15 @@ int nvhost_flcn_finalize_poweron(struct platform_device *pdev)
 
 	nvhost_flcn_ctxtsw_init(pdev);
 	err = nvhost_flcn_start(pdev, 0);
+	if (err)
+		return err;
 
+	flcn_boot_stats_update(cold ? &v->cold_boot : &v->warm_boot, start);
+
+	return 0;
+
+err_unlock:
+	mutex_unlock(&v->lock);
 	return err;
 }
 
@@ -533,25 +715,42 @@ int nvhost_flcn_common_isr(struct platform_device *pdev)
 	return 0;
 }
 
-static int nvhost_flcn_init_sw(struct platform_device *dev)
+static struct flcn *nvhost_flcn_alloc(struct platform_device *dev)
 {
-	int err = 0;
-	struct nvhost_device_data *pdata = nvhost_get_devdata(dev);
 	struct flcn *v = get_flcn(dev);
 
 	nvhost_dbg_fn("in dev:%p v:%p", dev, v);
 
 	if (v)
-		return 0;
+		return v;
 
 	v = kzalloc(sizeof(*v), GFP_KERNEL);
 	if (!v) {
-		err = -ENOMEM;
-		goto clean_up;
+		nvhost_err(&dev->dev, "failed to allocate falcon data");
+		return NULL;
 	}
 
+	v->pdev = dev;
+	mutex_init(&v->lock);
+	INIT_LIST_HEAD(&v->cache_node);
 	set_flcn(dev, v);
 	nvhost_dbg_fn("primed dev:%p v:%p", dev, v);
+
+	return v;
+}
+
+/* read the ucode unless it is still resident, called with v->lock held */
+static int nvhost_flcn_get_ucode_locked(struct platform_device *dev,
+					struct flcn *v)
+{
+	struct nvhost_device_data *pdata = nvhost_get_devdata(dev);
+	int err;
+
+	if (v->valid) {
+		flcn_fw_cache_touch(v);
+		return 0;
+	}
+
 	err = flcn_read_ucode(dev, pdata->firmware_name, v);
 	if (err || !v->valid)
 		goto clean_up;
@@ -563,30 +762,40 @@ static int nvhost_flcn_init_sw(struct platform_device *dev)
 	return err;
 }
 
+static int nvhost_flcn_init_sw(struct platform_device *dev)
+{
+	struct flcn *v;
+	int err;
+
+	v = nvhost_flcn_alloc(dev);
+	if (!v)
+		return -ENOMEM;
+
+	mutex_lock(&v->lock);
+	err = nvhost_flcn_get_ucode_locked(dev, v);
+	mutex_unlock(&v->lock);
+
+	return err;
+}
+
 static int nvhost_flcn_deinit_sw(struct platform_device *dev)
 {
 	struct flcn *v = get_flcn(dev);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
-	DEFINE_DMA_ATTRS(attrs);
-	dma_set_attr(DMA_ATTR_READ_ONLY, &attrs);
-#endif
 
 	if (!v)
 		return 0;
 
-	if (v->mapped) {
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
-		dma_free_attrs(&dev->dev, v->size, v->mapped, v->dma_addr,
-			       &attrs);
-#else
-		dma_free_attrs(&dev->dev, v->size, v->mapped, v->dma_addr,
-			       DMA_ATTR_READ_ONLY);
-#endif
-		v->mapped = NULL;
-		v->dma_addr = 0;
+	/* unlink under the cache lock, boot_stats_show() may look at v */
+	mutex_lock(&flcn_fw_cache_lock);
+	if (!list_empty(&v->cache_node)) {
+		list_del_init(&v->cache_node);
+		flcn_fw_cache_size -= v->size;
 	}
-	kfree(v);
 	set_flcn(dev, NULL);
+	mutex_unlock(&flcn_fw_cache_lock);
+
+	flcn_free_ucode(dev, v);
+	kfree(v);
 	return 0;
 }
 
@@ -777,6 +986,36 @@ static ssize_t reload_fw_write(struct device *device,
 
 static DEVICE_ATTR(reload_fw, 0200, NULL, reload_fw_write);
 
+static ssize_t boot_stats_show(struct device *device,
+			       struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(device);
+	struct flcn_boot_stats cold = { 0 }, warm = { 0 };
+	u32 evictions = 0;
+	struct flcn *v;
+
+	mutex_lock(&flcn_fw_cache_lock);
+	v = get_flcn(pdev);
+	if (v) {
+		cold = v->cold_boot;
+		warm = v->warm_boot;
+		evictions = v->evictions;
+	}
+	mutex_unlock(&flcn_fw_cache_lock);
+
+	return snprintf(buf, PAGE_SIZE,
+		"cold: boots=%u last_us=%u max_us=%u avg_us=%llu\n"
+		"warm: boots=%u last_us=%u max_us=%u avg_us=%llu\n"
+		"evictions=%u\n",
+		cold.count, cold.last_us, cold.max_us,
+		cold.count ? div_u64(cold.total_us, cold.count) : 0,
+		warm.count, warm.last_us, warm.max_us,
+		warm.count ? div_u64(warm.total_us, warm.count) : 0,
+		evictions);
+}
+
+static DEVICE_ATTR(boot_stats, 0444, boot_stats_show, NULL);
+
 static int flcn_probe(struct platform_device *dev)
 {
 	int err;
@@ -806,6 +1045,10 @@ static int flcn_probe(struct platform_device *dev)
 	if (err)
 		return err;
 
+	err = device_create_file(&dev->dev, &dev_attr_boot_stats);
+	if (err)
+		return err;
+
 	err = nvhost_client_device_get_resources(dev);
 	if (err)
 		return err;
@@ -814,6 +1057,12 @@ static int flcn_probe(struct platform_device *dev)
 
 	nvhost_module_init(dev);
 
+	/*
+	 * The engines do not depend on each other, let the PM core resume
+	 * them in parallel rather than reload the ucode of one at a time.
+	 */
+	device_enable_async_suspend(&dev->dev);
+
 	err = nvhost_client_device_init(dev);
 	if (err) {
 		nvhost_dbg_fn("failed to init client device for %s",
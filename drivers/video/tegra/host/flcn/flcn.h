@@ -22,6 +22,8 @@
 #include <linux/types.h>
 #include <linux/firmware.h>
 #include <linux/platform_device.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
 
 struct ucode_bin_header_v1_flcn {
 	u32 bin_magic;        /* 0x10de */
@@ -69,6 +71,13 @@ struct flcn_os_image {
 	u32 bin_ver_tag;
 };
 
+struct flcn_boot_stats {
+	u32 count;
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+};
+
 struct flcn {
 	bool valid;
 	size_t size;
@@ -82,6 +91,16 @@ struct flcn {
 
 	dma_addr_t fce_dma_addr;
 	u32 *fce_mapped;
+
+	/* ucode image cache, only for images read by flcn_read_ucode() */
+	struct platform_device *pdev;
+	struct mutex lock;		/* protects the image against eviction */
+	struct list_head cache_node;	/* in lru order, oldest first */
+	u32 evictions;
+
+	/* cold: image read from the filesystem, warm: image was resident */
+	struct flcn_boot_stats cold_boot;
+	struct flcn_boot_stats warm_boot;
 };
 
 static inline struct flcn *get_flcn(struct platform_device *dev)
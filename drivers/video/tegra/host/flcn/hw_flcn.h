@@ -230,6 +230,14 @@ static inline u32 flcn_dmatrfcmd_r(void)
 {
 	return 0x00001118;
 }
+static inline u32 flcn_dmatrfcmd_full_v(u32 r)
+{
+	return (r >> 0) & 0x1;
+}
+static inline u32 flcn_dmatrfcmd_full_true_v(void)
+{
+	return 0x00000001;
+}
 static inline u32 flcn_dmatrfcmd_idle_v(u32 r)
 {
 	return (r >> 1) & 0x1;
@@ -21,6 +21,7 @@
 
 struct dentry;
 struct host1x_actmon;
+struct actmon_telem_src;
 
 enum init_e {
 	ACTMON_OFF = 0,
@@ -55,6 +56,8 @@ struct host1x_actmon {
 	int k;
 	int divider;
 	struct platform_device *pdev;
+
+	struct actmon_telem_src *telem;
 };
 
 #endif
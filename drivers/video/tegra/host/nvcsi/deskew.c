@@ -34,6 +34,9 @@
 #include <linux/uaccess.h>
 #include <linux/regulator/consumer.h>
 #include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/jiffies.h>
+#include <linux/thermal.h>
 
 #include <media/mc_common.h>
 
@@ -55,7 +58,52 @@ static int debugfs_deskew_data_stats_high[NVCSI_PHY_CIL_NUM_LANE];
 static unsigned int enabled_deskew_lanes;
 static unsigned int done_deskew_lanes;
 
-static int nvcsi_deskew_apply_helper(unsigned int active_lanes);
+/*
+ * Calibration results are kept per port and reused at stream on while
+ * the lanes and the rate match, the result is younger than
+ * deskew_cache_max_age_ms and the temperature moved less than
+ * deskew_cache_max_temp_delta millicelsius since. A result past either
+ * limit is still restored at stream on, then recalibrated in the
+ * background from the sensor's periodic deskew sequence. If none arrives
+ * the result is dropped and the next stream on calibrates synchronously.
+ */
+struct nvcsi_deskew_cache_entry {
+	bool valid;
+	bool has_temp;
+	unsigned int cil_lanes;
+	u64 rate;
+	unsigned int data_trimmer[4];
+	unsigned int clk_trimmer;
+	unsigned long stamp;
+	int temp;
+	unsigned int hits;
+};
+
+static struct nvcsi_deskew_cache_entry deskew_cache[NVCSI_PHY_NUM_BRICKS * 2];
+
+static bool deskew_cache_enable = true;
+module_param(deskew_cache_enable, bool, 0644);
+MODULE_PARM_DESC(deskew_cache_enable, "Reuse deskew calibration results");
+
+static unsigned int deskew_cache_max_age_ms = 60000;
+module_param(deskew_cache_max_age_ms, uint, 0644);
+MODULE_PARM_DESC(deskew_cache_max_age_ms,
+		 "Age after which a cached deskew result is recalibrated");
+
+static unsigned int deskew_cache_max_temp_delta = 10000;
+module_param(deskew_cache_max_temp_delta, uint, 0644);
+MODULE_PARM_DESC(deskew_cache_max_temp_delta,
+		 "Temperature change in mC after which a result is recalibrated");
+
+static char *deskew_thermal_zone = "AUX-therm";
+module_param(deskew_thermal_zone, charp, 0644);
+MODULE_PARM_DESC(deskew_thermal_zone,
+		 "Thermal zone tracked for deskew results, empty to ignore");
+
+static int nvcsi_deskew_apply_helper(unsigned int active_lanes, u64 rate);
+static void set_trimmer(unsigned int phy_num, unsigned int cila,
+			unsigned int cilb,
+			unsigned int *d, unsigned int c);
 
 static bool is_t19x_or_greater;
 // a regmap for address changes between chips
@@ -178,6 +226,124 @@ static inline void set_done_with_lock(unsigned int done_lanes)
 	mutex_unlock(&deskew_lock);
 }
 
+static int nvcsi_deskew_get_temp(int *temp)
+{
+	struct thermal_zone_device *tz;
+
+	if (!deskew_thermal_zone || !deskew_thermal_zone[0])
+		return -ENODEV;
+
+	tz = thermal_zone_get_zone_by_name(deskew_thermal_zone);
+	if (IS_ERR(tz))
+		return PTR_ERR(tz);
+
+	return thermal_zone_get_temp(tz, temp);
+}
+
+static inline struct nvcsi_deskew_cache_entry *deskew_cache_entry(
+			unsigned int phy_num, unsigned int cil_lanes)
+{
+	// a port spanning both CILs of a brick is kept with CIL A
+	return &deskew_cache[phy_num * 2 +
+		!(cil_lanes & (NVCSI_PHY_0_NVCSI_CIL_A_IO0 |
+			       NVCSI_PHY_0_NVCSI_CIL_A_IO1))];
+}
+
+static void nvcsi_deskew_cache_store(unsigned int phy_num,
+				     unsigned int cil_lanes, u64 rate,
+				     unsigned int *d, unsigned int c)
+{
+	struct nvcsi_deskew_cache_entry *e;
+	bool has_temp;
+	int temp = 0;
+
+	if (!rate)
+		return;
+
+	has_temp = !nvcsi_deskew_get_temp(&temp);
+
+	mutex_lock(&deskew_lock);
+	e = deskew_cache_entry(phy_num, cil_lanes);
+	if (!e->valid || e->cil_lanes != cil_lanes || e->rate != rate)
+		e->hits = 0;
+	e->cil_lanes = cil_lanes;
+	e->rate = rate;
+	memcpy(e->data_trimmer, d, sizeof(e->data_trimmer));
+	e->clk_trimmer = c;
+	e->stamp = jiffies;
+	e->temp = temp;
+	e->has_temp = has_temp;
+	e->valid = true;
+	mutex_unlock(&deskew_lock);
+}
+
+static void nvcsi_deskew_cache_invalidate(unsigned int active_lanes)
+{
+	struct nvcsi_deskew_cache_entry *e;
+	unsigned int phy_num, cil_lanes;
+
+	mutex_lock(&deskew_lock);
+	for (phy_num = 0; phy_num < NVCSI_PHY_NUM_BRICKS; phy_num++) {
+		cil_lanes = (active_lanes >> (phy_num * 4)) & 0xf;
+		if (!cil_lanes)
+			continue;
+		e = deskew_cache_entry(phy_num, cil_lanes);
+		if (e->cil_lanes & cil_lanes)
+			e->valid = false;
+	}
+	mutex_unlock(&deskew_lock);
+}
+
+/*
+ * Program the cached trimmers of the active lanes that have a result for
+ * rate. Returns those lanes, the ones due for recalibration are also
+ * returned in stale_lanes.
+ */
+static unsigned int nvcsi_deskew_cache_apply(unsigned int active_lanes,
+					     u64 rate,
+					     unsigned int *stale_lanes)
+{
+	unsigned long max_age = msecs_to_jiffies(deskew_cache_max_age_ms);
+	struct nvcsi_deskew_cache_entry *e;
+	unsigned int phy_num, cil_lanes, lanes = 0;
+	bool has_temp;
+	int temp = 0;
+
+	*stale_lanes = 0;
+	if (!deskew_cache_enable || !rate)
+		return 0;
+
+	has_temp = !nvcsi_deskew_get_temp(&temp);
+
+	mutex_lock(&deskew_lock);
+	for (phy_num = 0; phy_num < NVCSI_PHY_NUM_BRICKS; phy_num++) {
+		cil_lanes = (active_lanes >> (phy_num * 4)) & 0xf;
+		if (!cil_lanes)
+			continue;
+		e = deskew_cache_entry(phy_num, cil_lanes);
+		if (!e->valid || e->cil_lanes != cil_lanes || e->rate != rate)
+			continue;
+
+		set_trimmer(phy_num,
+			    cil_lanes & (NVCSI_PHY_0_NVCSI_CIL_A_IO0 |
+					 NVCSI_PHY_0_NVCSI_CIL_A_IO1),
+			    cil_lanes & (NVCSI_PHY_0_NVCSI_CIL_B_IO0 |
+					 NVCSI_PHY_0_NVCSI_CIL_B_IO1),
+			    e->data_trimmer, e->clk_trimmer);
+		e->hits++;
+		lanes |= cil_lanes << (phy_num * 4);
+
+		if (time_after(jiffies, e->stamp + max_age) ||
+		    (has_temp && e->has_temp &&
+		     (unsigned int)abs(temp - e->temp) >
+				deskew_cache_max_temp_delta))
+			*stale_lanes |= cil_lanes << (phy_num * 4);
+	}
+	mutex_unlock(&deskew_lock);
+
+	return lanes;
+}
+
 
 static inline void nvcsi_phy_write(unsigned int phy_num,
 				   unsigned int addr_offset, unsigned int val)
@@ -346,13 +512,16 @@ static void nvcsi_deskew_setup_start(unsigned int active_lanes)
 	}
 }
 
-static int wait_cila_done(unsigned int phy_num, unsigned int cila_io_lanes,
+static int wait_cila_done(struct nvcsi_deskew_context *ctx,
+			unsigned int phy_num, unsigned int cila_io_lanes,
 			unsigned long timeout)
 {
 	bool done;
 	unsigned int val;
 
 	while (time_before(jiffies, timeout)) {
+		if (READ_ONCE(ctx->abort))
+			return -ECANCELED;
 		done = true;
 		val = nvcsi_phy_readl(phy_num,
 	NVCSI_CIL_A_DPHY_DESKEW_STATUS_0_OFFSET);
@@ -364,18 +533,25 @@ static int wait_cila_done(unsigned int phy_num, unsigned int cila_io_lanes,
 			return -EINVAL;
 		if (done)
 			return 0;
-		usleep_range(5, 10);
+		// the periodic deskew comes at most once a frame
+		if (ctx->background)
+			usleep_range(1000, 2000);
+		else
+			usleep_range(5, 10);
 	}
 	return -ETIMEDOUT;
 }
 
-static int wait_cilb_done(unsigned int phy_num, unsigned int cilb_io_lanes,
+static int wait_cilb_done(struct nvcsi_deskew_context *ctx,
+			unsigned int phy_num, unsigned int cilb_io_lanes,
 			unsigned long timeout)
 {
 	bool done;
 	unsigned int val;
 
 	while (time_before(jiffies, timeout)) {
+		if (READ_ONCE(ctx->abort))
+			return -ECANCELED;
 		done = true;
 		val = nvcsi_phy_readl(phy_num,
 	NVCSI_CIL_B_DPHY_DESKEW_STATUS_0_OFFSET);
@@ -387,7 +563,11 @@ static int wait_cilb_done(unsigned int phy_num, unsigned int cilb_io_lanes,
 			return -EINVAL;
 		if (done)
 			return 0;
-		usleep_range(5, 10);
+		// the periodic deskew comes at most once a frame
+		if (ctx->background)
+			usleep_range(1000, 2000);
+		else
+			usleep_range(5, 10);
 	}
 	return -ETIMEDOUT;
 }
@@ -398,13 +578,16 @@ static int nvcsi_deskew_thread(void *data)
 	unsigned int phy_num = 0;
 	unsigned int cil_lanes = 0, cila_io_lanes = 0, cilb_io_lanes = 0;
 	struct nvcsi_deskew_context *ctx = data;
-	unsigned int remaining_lanes = ctx->deskew_lanes;
+	unsigned int lanes = ctx->calib_lanes;
+	unsigned int remaining_lanes = lanes;
 	unsigned long timeout = 0;
 
-	timeout = jiffies + msecs_to_jiffies(DESKEW_TIMEOUT_MSEC);
+	timeout = jiffies + msecs_to_jiffies(ctx->background ?
+					     DESKEW_BACKGROUND_TIMEOUT_MSEC :
+					     DESKEW_TIMEOUT_MSEC);
 
 	while (remaining_lanes) {
-		cil_lanes = (ctx->deskew_lanes & (0x000f << (phy_num * 4)))
+		cil_lanes = (lanes & (0x000f << (phy_num * 4)))
 				>> (phy_num * 4);
 		cila_io_lanes =  cil_lanes & (NVCSI_PHY_0_NVCSI_CIL_A_IO0
 			| NVCSI_PHY_0_NVCSI_CIL_A_IO1);
@@ -412,51 +595,71 @@ static int nvcsi_deskew_thread(void *data)
 			| NVCSI_PHY_0_NVCSI_CIL_B_IO1);
 		remaining_lanes &= ~(0xf << (phy_num * 4));
 		if (cila_io_lanes) {
-			ret = wait_cila_done(phy_num, cila_io_lanes, timeout);
+			ret = wait_cila_done(ctx, phy_num, cila_io_lanes,
+					     timeout);
 			if (ret)
 				goto err;
 		}
 		if (cilb_io_lanes) {
-			ret = wait_cilb_done(phy_num, cilb_io_lanes, timeout);
+			ret = wait_cilb_done(ctx, phy_num, cilb_io_lanes,
+					     timeout);
 			if (ret)
 				goto err;
 		}
 		phy_num++;
 	}
 
-	ret = nvcsi_deskew_apply_helper(ctx->deskew_lanes);
+	ret = nvcsi_deskew_apply_helper(lanes, ctx->deskew_rate);
 	if (!ret) {
 		dev_info(mc_csi->dev, "deskew finished for lanes 0x%04x",
-							ctx->deskew_lanes);
-		set_done_with_lock(ctx->deskew_lanes);
+							lanes);
+		set_done_with_lock(lanes);
 	} else {
 		dev_info(mc_csi->dev,
 			"deskew apply helper failed for lanes 0x%04x",
-							ctx->deskew_lanes);
+							lanes);
 		goto err;
 	}
 
 
-	complete(&ctx->thread_done);
+	complete_all(&ctx->thread_done);
 	return 0;
 
 err:
 	if (ret == -ETIMEDOUT)
 		dev_info(mc_csi->dev, "deskew timed out for lanes 0x%04x",
-					ctx->deskew_lanes);
+					lanes);
 	else if (ret == -EINVAL)
 		dev_info(mc_csi->dev, "deskew calib err for lanes 0x%04x",
-					ctx->deskew_lanes);
-	unset_enabled_with_lock(ctx->deskew_lanes);
-	complete(&ctx->thread_done);
+					lanes);
+	else if (ret == -ECANCELED)
+		dev_dbg(mc_csi->dev, "deskew cancelled for lanes 0x%04x",
+					lanes);
+	unset_enabled_with_lock(lanes);
+	// keep the cached result of a superseded calibration
+	if (ret != -ECANCELED)
+		nvcsi_deskew_cache_invalidate(lanes);
+	complete_all(&ctx->thread_done);
 
 	return ret;
 }
 
+void nvcsi_deskew_cancel(struct nvcsi_deskew_context *ctx)
+{
+	if (!ctx || !ctx->deskew_kthread)
+		return;
+
+	WRITE_ONCE(ctx->abort, true);
+	wait_for_completion(&ctx->thread_done);
+	WRITE_ONCE(ctx->abort, false);
+	ctx->deskew_kthread = NULL;
+}
+EXPORT_SYMBOL(nvcsi_deskew_cancel);
+
 int nvcsi_deskew_setup(struct nvcsi_deskew_context *ctx)
 {
 	int ret = 0;
-	unsigned int new_lanes;
+	unsigned int new_lanes, cached_lanes, stale_lanes;
 
 	if (!ctx || !ctx->deskew_lanes)
 		return -EINVAL;
@@ -467,22 +670,46 @@ int nvcsi_deskew_setup(struct nvcsi_deskew_context *ctx)
 		return -EINVAL;
 	}
 
+	// a calibration still running for the previous stream is stale
+	nvcsi_deskew_cancel(ctx);
+
 	mutex_lock(&deskew_lock);
 	done_deskew_lanes &= ~(ctx->deskew_lanes);
 	mutex_unlock(&deskew_lock);
 
-	new_lanes = ctx->deskew_lanes & ~enabled_deskew_lanes;
+	cached_lanes = nvcsi_deskew_cache_apply(ctx->deskew_lanes,
+						ctx->deskew_rate,
+						&stale_lanes);
+	if (cached_lanes) {
+		dev_dbg(mc_csi->dev, "deskew restored for lanes 0x%04x\n",
+							cached_lanes);
+		set_done_with_lock(cached_lanes);
+	}
+
+	/*
+	 * Stream on only waits for lanes without a cached result, lanes
+	 * with an outdated one are recalibrated in the background.
+	 */
+	ctx->calib_lanes = (ctx->deskew_lanes & ~cached_lanes) | stale_lanes;
+	ctx->background = !(ctx->deskew_lanes & ~cached_lanes);
+	ctx->wait_frame = !ctx->background;
+	init_completion(&ctx->thread_done);
+
+	new_lanes = ctx->calib_lanes & ~enabled_deskew_lanes;
 	if (new_lanes) {
 		set_enabled_with_lock(new_lanes);
 		nvcsi_deskew_setup_start(new_lanes);
-		init_completion(&ctx->thread_done);
 		ctx->deskew_kthread = kthread_run(nvcsi_deskew_thread,
 							ctx, "deskew");
 		if (IS_ERR(ctx->deskew_kthread)) {
 			ret = PTR_ERR(ctx->deskew_kthread);
-			complete(&ctx->thread_done);
+			ctx->deskew_kthread = NULL;
+			unset_enabled_with_lock(new_lanes);
+			complete_all(&ctx->thread_done);
 		}
-	}
+	} else
+		complete_all(&ctx->thread_done);
+
 	return ret;
 }
 EXPORT_SYMBOL(nvcsi_deskew_setup);
@@ -708,7 +935,7 @@ int nvcsi_deskew_apply_check(struct nvcsi_deskew_context *ctx)
 {
 	unsigned long timeout = 0, timeleft = 1;
 
-	if (!completion_done(&ctx->thread_done)) {
+	if (!ctx->background && !completion_done(&ctx->thread_done)) {
 		timeout = msecs_to_jiffies(DESKEW_TIMEOUT_MSEC);
 		timeleft = wait_for_completion_timeout(&ctx->thread_done,
 								timeout);
@@ -717,15 +944,17 @@ int nvcsi_deskew_apply_check(struct nvcsi_deskew_context *ctx)
 		return -ETIMEDOUT;
 	if (ctx->deskew_lanes ==
 			(done_deskew_lanes & ctx->deskew_lanes)) {
-		// sleep for a frame to make sure deskew result is reflected
-		usleep_range(35*1000, 36*1000);
+		// sleep for a frame to make sure deskew result is reflected,
+		// cached trimmers are programmed before the stream starts
+		if (ctx->wait_frame)
+			usleep_range(35*1000, 36*1000);
 		return 0;
 	} else
 		return -EINVAL;
 }
 EXPORT_SYMBOL(nvcsi_deskew_apply_check);
 
-static int nvcsi_deskew_apply_helper(unsigned int active_lanes)
+static int nvcsi_deskew_apply_helper(unsigned int active_lanes, u64 rate)
 {
 	unsigned int phy_num = -1;
 	unsigned int cil_lanes = 0, cila_io_lanes = 0, cilb_io_lanes = 0;
@@ -768,6 +997,8 @@ static int nvcsi_deskew_apply_helper(unsigned int active_lanes)
 		/*step 3: Apply trimmer settings */
 		set_trimmer(phy_num, cila_io_lanes, cilb_io_lanes,
 				d_trimmer, clk_trimmer);
+		nvcsi_deskew_cache_store(phy_num, cil_lanes, rate,
+					 d_trimmer, clk_trimmer);
 	}
 	return 0;
 }
@@ -800,3 +1031,25 @@ void deskew_dbgfs_deskew_stats(struct seq_file *s)
 	}
 }
 
+void deskew_dbgfs_cache(struct seq_file *s)
+{
+	struct nvcsi_deskew_cache_entry *e;
+	unsigned int i;
+
+	mutex_lock(&deskew_lock);
+	for (i = 0; i < ARRAY_SIZE(deskew_cache); i++) {
+		e = &deskew_cache[i];
+		if (!e->valid)
+			continue;
+		seq_printf(s, "port %c: lanes 0x%x rate %llu age %u ms",
+			   'A' + i, e->cil_lanes, e->rate,
+			   jiffies_to_msecs(jiffies - e->stamp));
+		if (e->has_temp)
+			seq_printf(s, " temp %d", e->temp);
+		seq_printf(s, " hits %u clk %u data %u %u %u %u\n",
+			   e->hits, e->clk_trimmer,
+			   e->data_trimmer[0], e->data_trimmer[1],
+			   e->data_trimmer[2], e->data_trimmer[3]);
+	}
+	mutex_unlock(&deskew_lock);
+}
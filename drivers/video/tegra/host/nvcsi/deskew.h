@@ -147,9 +147,20 @@
 ////////
 
 #define DESKEW_TIMEOUT_MSEC 100
+// a background recalibration waits for the sensor's periodic deskew
+#define DESKEW_BACKGROUND_TIMEOUT_MSEC 2000
 
 struct nvcsi_deskew_context {
 	unsigned int deskew_lanes;
+	// link rate in Hz, results are only cached when it is known
+	u64 deskew_rate;
+	// lanes calibrated by deskew_kthread
+	unsigned int calib_lanes;
+	// stream on does not wait for deskew_kthread
+	bool background;
+	// trimmers were calibrated, not restored from the cache
+	bool wait_frame;
+	bool abort;
 	struct task_struct *deskew_kthread;
 	struct completion thread_done;
 };
@@ -157,6 +168,7 @@ struct nvcsi_deskew_context {
 #if IS_ENABLED(CONFIG_TEGRA_GRHOST_NVCSI)
 int nvcsi_deskew_apply_check(struct nvcsi_deskew_context *ctx);
 int nvcsi_deskew_setup(struct nvcsi_deskew_context *ctx);
+void nvcsi_deskew_cancel(struct nvcsi_deskew_context *ctx);
 #else
 static int inline nvcsi_deskew_apply_check(struct nvcsi_deskew_context *ctx)
 {
@@ -166,11 +178,15 @@ static int inline nvcsi_deskew_setup(struct nvcsi_deskew_context *ctx)
 {
 	return 0;
 }
+static void inline nvcsi_deskew_cancel(struct nvcsi_deskew_context *ctx)
+{
+}
 #endif
 
 void nvcsi_deskew_platform_setup(struct tegra_csi_device *dev, bool is_t19x);
 
 void deskew_dbgfs_calc_bound(struct seq_file *s, long long input_stats);
 void deskew_dbgfs_deskew_stats(struct seq_file *s);
+void deskew_dbgfs_cache(struct seq_file *s);
 
 #endif
@@ -130,9 +130,24 @@ static long t194_nvcsi_ioctl(struct file *file, unsigned int cmd,
 			return -EINVAL;
 		} else {
 			filepriv->deskew_ctx.deskew_lanes = active_lanes;
+			filepriv->deskew_ctx.deskew_rate = 0;
 			return nvcsi_deskew_setup(&filepriv->deskew_ctx);
 		}
 	}
+	case NVHOST_NVCSI_IOCTL_DESKEW_SETUP_RATE: {
+		struct nvhost_nvcsi_deskew_setup_args args;
+
+		dev_dbg(mc_csi->dev, "ioctl: deskew_setup_rate\n");
+		if (copy_from_user(&args, (const void __user *)arg,
+							sizeof(args)))
+			return -EFAULT;
+		if (args.reserved)
+			return -EINVAL;
+
+		filepriv->deskew_ctx.deskew_lanes = args.lanes;
+		filepriv->deskew_ctx.deskew_rate = args.rate;
+		return nvcsi_deskew_setup(&filepriv->deskew_ctx);
+	}
 	case NVHOST_NVCSI_IOCTL_DESKEW_APPLY: {
 		dev_dbg(mc_csi->dev, "ioctl: deskew_apply\n");
 		ret = nvcsi_deskew_apply_check(&filepriv->deskew_ctx);
@@ -193,6 +208,7 @@ static int t194_nvcsi_open(struct inode *inode, struct file *file)
 		return -ENOMEM;
 
 	filepriv->pdev = pdev;
+	init_completion(&filepriv->deskew_ctx.thread_done);
 
 	file->private_data = filepriv;
 
@@ -203,6 +219,7 @@ static int t194_nvcsi_release(struct inode *inode, struct file *file)
 {
 	struct t194_nvcsi_file_private *filepriv = file->private_data;
 
+	nvcsi_deskew_cancel(&filepriv->deskew_ctx);
 	kfree(filepriv);
 
 	return 0;
@@ -516,6 +533,24 @@ static const struct file_operations dbg_show_ops = {
 	.release	= single_release
 };
 
+static int dbgfs_deskew_cache(struct seq_file *s, void *data)
+{
+	deskew_dbgfs_cache(s);
+	return 0;
+}
+
+static int dbg_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbgfs_deskew_cache, inode->i_private);
+}
+
+static const struct file_operations dbg_cache_ops = {
+	.open		= dbg_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release
+};
+
 static int dbgfs_calc_bound(struct seq_file *s, void *data)
 {
 	deskew_dbgfs_calc_bound(s, input_stats);
@@ -557,6 +592,10 @@ static int nvcsi_deskew_debugfs_init(struct t194_nvcsi *nvcsi)
 				nvcsi->dir, mc_csi, &dbg_calc_ops);
 	if (!val)
 		goto err_debugfs;
+	val = debugfs_create_file("cache", S_IRUGO, nvcsi->dir, mc_csi,
+				&dbg_cache_ops);
+	if (!val)
+		goto err_debugfs;
 	return 0;
 err_debugfs:
 	dev_err(mc_csi->dev, "Fail to create debugfs\n");
@@ -369,6 +369,7 @@ static long nvcsi_ioctl(struct file *file, unsigned int cmd,
 		dev_dbg(mc_csi->dev, "ioctl: deskew_setup\n");
 		priv->deskew_ctx.deskew_lanes = get_user(active_lanes,
 				(long __user *)arg);
+		priv->deskew_ctx.deskew_rate = 0;
 		ret = nvcsi_deskew_setup(&priv->deskew_ctx);
 		return ret;
 		}
@@ -388,11 +389,12 @@ static int nvcsi_open(struct inode *inode, struct file *file)
 	struct platform_device *pdev = pdata->pdev;
 	struct nvcsi_private *priv;
 
-	priv = kmalloc(sizeof(*priv), GFP_KERNEL);
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
 	if (unlikely(priv == NULL))
 		return -ENOMEM;
 
 	priv->pdev = pdev;
+	init_completion(&priv->deskew_ctx.thread_done);
 
 	file->private_data = priv;
 	return nonseekable_open(inode, file);
@@ -402,6 +404,7 @@ static int nvcsi_release(struct inode *inode, struct file *file)
 {
 	struct nvcsi_private *priv = file->private_data;
 
+	nvcsi_deskew_cancel(&priv->deskew_ctx);
 	kfree(priv);
 	return 0;
 }
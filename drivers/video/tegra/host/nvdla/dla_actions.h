@@ -0,0 +1,115 @@
+/*
+ * NVDLA task descriptor action encoding
+ *
+ * Copyright (c) 2016-2020, NVIDIA Corporation.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DLA_ACTIONS_H_
+#define _DLA_ACTIONS_H_
+
+/*
+ * Helpers writing the action lists and address list of a task descriptor.
+ * Free of kernel dependencies, so that tools/nvdla-sw encodes descriptors
+ * exactly like the driver does.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "dla_os_interface.h"
+
+struct dla_mem_addr {
+	uint64_t val;
+};
+
+static inline uint8_t *add_address(uint8_t *mem, uint64_t addr)
+{
+	struct dla_mem_addr *address = (struct dla_mem_addr *)mem;
+
+	address->val = addr;
+
+	return mem + sizeof(struct dla_mem_addr);
+}
+
+static inline uint8_t *add_opcode(uint8_t *mem, uint8_t op)
+{
+	struct dla_action_opcode *opcode = (struct dla_action_opcode *)mem;
+
+	opcode->value = op;
+
+	return mem + sizeof(struct dla_action_opcode);
+}
+
+static inline uint8_t *add_fence_action(uint8_t *mem, uint8_t op,
+					uint64_t addr, uint32_t val)
+{
+	struct dla_action_semaphore *action;
+
+	mem = add_opcode(mem, op);
+
+	action = (struct dla_action_semaphore *)mem;
+	action->address = addr;
+	action->value = val;
+
+	return mem + sizeof(struct dla_action_semaphore);
+}
+
+static inline uint8_t *add_status_action(uint8_t *mem, uint8_t op,
+					 uint64_t addr, uint16_t status)
+{
+	struct dla_action_task_status *action;
+
+	mem = add_opcode(mem, op);
+
+	action = (struct dla_action_task_status *)mem;
+	action->address = addr;
+	action->status = status;
+
+	return mem + sizeof(struct dla_action_task_status);
+}
+
+static inline uint8_t *add_timestamp_action(uint8_t *mem, uint8_t op,
+					    uint64_t addr)
+{
+	struct dla_action_timestamp *action;
+
+	mem = add_opcode(mem, op);
+
+	action = (struct dla_action_timestamp *)mem;
+	action->address = addr;
+
+	return mem + sizeof(struct dla_action_timestamp);
+}
+
+static inline uint8_t *add_gos_action(uint8_t *mem, uint8_t op,
+				      uint8_t index, uint16_t offset,
+				      uint32_t value)
+{
+	struct dla_action_gos *action;
+
+	mem = add_opcode(mem, op);
+
+	action = (struct dla_action_gos *)mem;
+	action->index = index;
+	action->offset = offset;
+	action->value = value;
+
+	return mem + sizeof(struct dla_action_gos);
+}
+
+#endif /* _DLA_ACTIONS_H_ */
@@ -29,6 +29,7 @@
 
 #include "nvdla_buffer.h"
 #include "dla_os_interface.h"
+#include "dla_actions.h"
 #include "dla_fw_version.h"
 
 #define ALIGNED_DMA(x) ((x >> 8) & 0xffffffff)
@@ -74,6 +75,16 @@
  */
 #define MAX_NUM_NVDLA_BUFFERS_PER_TASK	6144
 
+/**
+ * Maximum number of task templates per file descriptor
+ */
+#define MAX_NVDLA_TEMPLATES		16
+
+/**
+ * Maximum number of address list entries a templated task can replace
+ */
+#define MAX_NUM_NVDLA_TEMPLATE_PATCHES	64
+
 /**
  * Trace Buffer Size
  */
@@ -241,6 +252,25 @@ struct nvdla_emu_task {
 	u32 fence_counter;
 };
 
+/**
+ * struct nvdla_task_template:	address list pinned once for many tasks
+ *
+ * @ref			Reference count, held by the registration and by
+ *			every task launched from the template
+ * @buffers		nvhost buffers the addresses are pinned in
+ * @num_addresses	Number of entries in the address list
+ * @dmabufs		dma-bufs of the address list
+ * @addresses		IOVA + offset of each entry, as handed to the engine
+ *
+ */
+struct nvdla_task_template {
+	struct kref ref;
+	struct nvdla_buffers *buffers;
+	u32 num_addresses;
+	struct dma_buf **dmabufs;
+	u64 *addresses;
+};
+
 /**
  * struct nvdla_task:	structure for task info
  *
@@ -257,6 +287,9 @@ struct nvdla_emu_task {
  * @buf_size		Total size of task dma alloc
  * @timeout		max timeout to wait for task completion
  * @op_handle		pointer to handle list of operation descriptor
+ * @tmpl		template the task was launched from, if any. The
+ *			memory handles are then the patched entries, at
+ *			patch_index in the address list
  *
  */
 struct nvdla_task {
@@ -288,6 +321,8 @@ struct nvdla_task {
 	size_t buf_size;
 	int timeout;
 	int pool_index;
+	struct nvdla_task_template *tmpl;
+	u32 patch_index[MAX_NUM_NVDLA_TEMPLATE_PATCHES];
 
 	struct dma_buf *memory_dmabuf[NVDLA_MAX_BUFFERS_PER_TASK];
 	struct dma_buf *prefences_sem_dmabuf[MAX_NUM_NVDLA_PREFENCES];
@@ -299,10 +334,6 @@ struct nvdla_task {
 	struct dma_buf *eof_timestamps_dmabuf[MAX_NUM_NVDLA_OUT_TIMESTAMP];
 };
 
-struct dla_mem_addr {
-	uint64_t val;
-};
-
 extern const struct file_operations tegra_nvdla_ctrl_ops;
 extern struct nvdla_queue_ops nvdla_queue_ops;
 
@@ -418,7 +449,45 @@ int nvdla_free_gcov_region(struct platform_device *pdev, bool update_region);
 int nvdla_emulator_submit(struct nvdla_queue *queue,
 				struct nvdla_emu_task *task);
 void task_free(struct kref *ref);
-int nvdla_get_signal_fences(struct nvdla_queue *queue, void *in_task);
+int nvdla_get_signal_fences(struct nvdla_queue *queue, void *in_task,
+				u32 pending_incrs);
+
+/**
+ * nvdla_queue_submit_batch()	submit tasks with a single engine kick
+ *
+ * @queue		Pointer to the queue
+ * @tasks		Tasks to submit, in order, with descriptors filled
+ * @num_tasks		Number of tasks
+ *
+ * Return		0 on success otherwise negative
+ *
+ * Chains the task descriptors and sends one DLA_CMD_SUBMIT_TASK for the
+ * first of them. MMIO submit mode only. On failure before the tasks are
+ * queued, they are discarded.
+ */
+int nvdla_queue_submit_batch(struct nvdla_queue *queue,
+				struct nvdla_task **tasks, int num_tasks);
+
+/**
+ * nvdla_task_discard()	drop a task that was filled but never queued
+ *
+ * @task		Pointer to the task
+ *
+ * Unpins the task memory and drops the reference taken when its signal
+ * fences were assigned. The caller still holds its own reference.
+ */
+void nvdla_task_discard(struct nvdla_task *task);
+
+struct nvdla_task_template *nvdla_template_create(
+				struct nvdla_buffers *buffers,
+				struct nvdla_mem_handle *handles,
+				u32 num_addresses);
+void nvdla_template_put(struct nvdla_task_template *tmpl);
+
+static inline void nvdla_template_get(struct nvdla_task_template *tmpl)
+{
+	kref_get(&tmpl->ref);
+}
 int nvdla_send_gos_region(struct platform_device *pdev);
 
 #endif /* End of __NVHOST_NVDLA_H__ */
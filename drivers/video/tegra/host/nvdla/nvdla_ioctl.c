@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 
 #include "dev.h"
 #include "bus_client.h"
@@ -46,12 +47,16 @@
  * @pdev		pointer to platform device
  * @queue		pointer to nvdla_queue
  * @buffers		pointer to nvdla_buffer
+ * @templates		registered task templates, id is index + 1
+ * @template_lock	lock for templates
  */
 
 struct nvdla_private {
 	struct platform_device *pdev;
 	struct nvdla_queue *queue;
 	struct nvdla_buffers *buffers;
+	struct nvdla_task_template *templates[MAX_NVDLA_TEMPLATES];
+	struct mutex template_lock;
 };
 
 static int nvdla_get_fw_ver(struct nvdla_private *priv,
@@ -273,6 +278,115 @@ fail_to_get_val_arg:
 	return err;
 }
 
+static int nvdla_register_template(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_template_args *args = (struct nvdla_template_args *)arg;
+	struct platform_device *pdev = priv->pdev;
+	struct nvdla_ioctl_submit_task user_task;
+	struct nvdla_mem_handle *handles;
+	struct nvdla_task_template *tmpl;
+	int err = 0, i;
+
+	nvdla_dbg_fn(pdev, "");
+
+	if (copy_from_user(&user_task, (void __user *)(uintptr_t)args->task,
+			sizeof(user_task))) {
+		err = -EFAULT;
+		goto fail_to_get_task;
+	}
+
+	if (user_task.num_addresses < 1 ||
+		user_task.num_addresses > NVDLA_MAX_BUFFERS_PER_TASK) {
+		nvdla_dbg_err(pdev, "invalid num addresses[%u]",
+				user_task.num_addresses);
+		err = -EINVAL;
+		goto fail_to_get_task;
+	}
+
+	handles = vmalloc(user_task.num_addresses * sizeof(*handles));
+	if (!handles) {
+		err = -ENOMEM;
+		goto fail_to_get_task;
+	}
+
+	if (copy_from_user(handles,
+		(void __user *)(uintptr_t)user_task.address_list,
+		user_task.num_addresses * sizeof(*handles))) {
+		err = -EFAULT;
+		goto fail_to_get_addr_list;
+	}
+
+	tmpl = nvdla_template_create(priv->buffers, handles,
+					user_task.num_addresses);
+	if (IS_ERR(tmpl)) {
+		err = PTR_ERR(tmpl);
+		nvdla_dbg_err(pdev, "failed to create template %d", err);
+		goto fail_to_get_addr_list;
+	}
+
+	mutex_lock(&priv->template_lock);
+	for (i = 0; i < MAX_NVDLA_TEMPLATES; i++)
+		if (!priv->templates[i])
+			break;
+	if (i == MAX_NVDLA_TEMPLATES) {
+		mutex_unlock(&priv->template_lock);
+		nvdla_template_put(tmpl);
+		err = -ENOSPC;
+		goto fail_to_get_addr_list;
+	}
+	priv->templates[i] = tmpl;
+	mutex_unlock(&priv->template_lock);
+
+	args->id = i + 1;
+	nvdla_dbg_info(pdev, "template[%u] with %u addresses registered",
+			args->id, user_task.num_addresses);
+
+fail_to_get_addr_list:
+	vfree(handles);
+fail_to_get_task:
+	return err;
+}
+
+static int nvdla_unregister_template(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_template_args *args = (struct nvdla_template_args *)arg;
+	struct nvdla_task_template *tmpl = NULL;
+
+	nvdla_dbg_fn(priv->pdev, "id[%u]", args->id);
+
+	mutex_lock(&priv->template_lock);
+	if (args->id >= 1 && args->id <= MAX_NVDLA_TEMPLATES) {
+		tmpl = priv->templates[args->id - 1];
+		priv->templates[args->id - 1] = NULL;
+	}
+	mutex_unlock(&priv->template_lock);
+
+	if (!tmpl)
+		return -EINVAL;
+
+	/* tasks in flight keep their own reference */
+	nvdla_template_put(tmpl);
+
+	return 0;
+}
+
+static struct nvdla_task_template *nvdla_get_template(
+				struct nvdla_private *priv, u32 id)
+{
+	struct nvdla_task_template *tmpl = NULL;
+
+	if (id < 1 || id > MAX_NVDLA_TEMPLATES)
+		return NULL;
+
+	mutex_lock(&priv->template_lock);
+	tmpl = priv->templates[id - 1];
+	if (tmpl)
+		nvdla_template_get(tmpl);
+	mutex_unlock(&priv->template_lock);
+
+	return tmpl;
+}
+
 static int nvdla_ping(struct platform_device *pdev,
 			   struct nvdla_ping_args *args)
 {
@@ -670,6 +784,15 @@ static int nvdla_val_task_submit_input(struct nvdla_ioctl_submit_task *in_task)
 			MAX_NUM_NVDLA_OUT_TIMESTAMP);
 		return -EINVAL;
 	}
+	if (in_task->flags & NVDLA_TASK_FLAGS_TEMPLATE) {
+		if (in_task->num_addresses > MAX_NUM_NVDLA_TEMPLATE_PATCHES) {
+			pr_err("num patches[%u] crossing expected[%d]\n",
+				in_task->num_addresses,
+				MAX_NUM_NVDLA_TEMPLATE_PATCHES);
+			return -EINVAL;
+		}
+		return 0;
+	}
 	if (in_task->num_addresses < 1) {
 		pr_err("num addresses[%u] should be min one\n",
 				in_task->num_addresses);
@@ -685,13 +808,51 @@ static int nvdla_val_task_submit_input(struct nvdla_ioctl_submit_task *in_task)
 	return 0;
 }
 
-static int nvdla_fill_task(struct nvdla_queue *queue,
-				struct nvdla_buffers *buffers,
+static int nvdla_get_patches(struct nvdla_private *priv,
+				struct nvdla_ioctl_submit_task *local_task,
+				struct nvdla_task *task)
+{
+	struct nvdla_mem_patch __user *user_patches =
+		(struct nvdla_mem_patch __user *)(uintptr_t)
+			local_task->address_list;
+	struct platform_device *pdev = priv->pdev;
+	struct nvdla_mem_patch patch;
+	int i;
+
+	task->tmpl = nvdla_get_template(priv, local_task->template_id);
+	if (!task->tmpl) {
+		nvdla_dbg_err(pdev, "invalid template[%u]",
+				local_task->template_id);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < task->num_addresses; i++) {
+		if (copy_from_user(&patch, &user_patches[i], sizeof(patch)))
+			return -EFAULT;
+
+		if (patch.index >= task->tmpl->num_addresses ||
+			!patch.handle) {
+			nvdla_dbg_err(pdev, "invalid patch[%d] index[%u]",
+					i, patch.index);
+			return -EINVAL;
+		}
+
+		task->patch_index[i] = patch.index;
+		task->memory_handles[i].handle = patch.handle;
+		task->memory_handles[i].offset = patch.offset;
+	}
+
+	return 0;
+}
+
+static int nvdla_fill_task(struct nvdla_private *priv,
 				struct nvdla_ioctl_submit_task *local_task,
 				struct nvdla_task *task)
 {
 	void *mem;
 	int err = 0;
+	struct nvdla_queue *queue = priv->queue;
+	struct nvdla_buffers *buffers = priv->buffers;
 	struct platform_device *pdev = queue->pool->pdev;
 
 	nvdla_dbg_fn(pdev, "");
@@ -701,6 +862,7 @@ static int nvdla_fill_task(struct nvdla_queue *queue,
 	task->queue = queue;
 	task->buffers = buffers;
 	task->sp = &nvhost_get_host(pdev)->syncpt;
+	task->tmpl = NULL;
 
 	err = nvdla_val_task_submit_input(local_task);
 	if (err) {
@@ -729,11 +891,18 @@ static int nvdla_fill_task(struct nvdla_queue *queue,
 		goto fail_to_get_actions;
 	}
 
-	/* get user addresses list */
-	if (copy_from_user(task->memory_handles,
+	/* get template and the entries this task replaces in it */
+	if (local_task->flags & NVDLA_TASK_FLAGS_TEMPLATE) {
+		err = nvdla_get_patches(priv, local_task, task);
+		if (err) {
+			nvdla_dbg_err(pdev, "failed to get template patches");
+			goto fail_to_get_addr_list;
+		}
+	} else if (copy_from_user(task->memory_handles,
 		(void __user *)local_task->address_list,
 		(task->num_addresses *
 			sizeof(struct nvdla_mem_handle)))) {
+		/* get user addresses list */
 		err = -EFAULT;
 		nvdla_dbg_err(pdev, "failed to copy address list");
 		goto fail_to_get_addr_list;
@@ -936,12 +1105,17 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 			(struct nvdla_submit_args *)arg;
 	struct nvdla_ioctl_submit_task __user *user_tasks;
 	struct nvdla_ioctl_submit_task local_tasks[MAX_TASKS_PER_SUBMIT];
+	struct nvdla_task *batch[MAX_TASKS_PER_SUBMIT];
+	int batch_idx[MAX_TASKS_PER_SUBMIT];
 	struct platform_device *pdev;
+	struct nvhost_device_data *pdata;
+	struct nvdla_device *nvdla_dev;
 	struct nvdla_queue *queue;
 	struct nvdla_buffers *buffers;
-	u32 num_tasks;
+	u32 num_tasks, pending_incrs = 0;
 	struct nvdla_task *task;
-	int err = 0, i = 0;
+	bool single_kick;
+	int err = 0, i = 0, j, num_batched = 0;
 
 	if (!args || !priv)
 		return -EINVAL;
@@ -965,6 +1139,18 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 
 	nvdla_dbg_info(pdev, "num of tasks [%d]", num_tasks);
 
+	/*
+	 * kicking once for a chain of descriptors is MMIO only, channel
+	 * mode builds and waits on a host1x job per task
+	 */
+	pdata = platform_get_drvdata(pdev);
+	nvdla_dev = pdata->private_data;
+	single_kick = !!(args->flags & NVDLA_SUBMIT_FLAGS_SINGLE_KICK);
+	if (single_kick && nvdla_dev->submit_mode != NVDLA_SUBMIT_MODE_MMIO) {
+		nvdla_dbg_err(pdev, "single kick not supported in channel mode");
+		return -EINVAL;
+	}
+
 	/* IOCTL copy descriptors*/
 	if (copy_from_user(local_tasks, (void __user *)user_tasks,
 			(num_tasks * sizeof(*user_tasks)))) {
@@ -985,7 +1171,7 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 		nvdla_dbg_info(pdev, "task[%d] mem allocate done", i + 1);
 
 		/* fill local task param from user args */
-		err = nvdla_fill_task(queue, buffers, local_tasks + i, task);
+		err = nvdla_fill_task(priv, local_tasks + i, task);
 		if (err) {
 			nvdla_dbg_err(pdev, "failed to fill task[%d]", i + 1);
 			kref_put(&task->ref, task_free);
@@ -1006,13 +1192,24 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 		nvdla_dbg_info(pdev, "task[%d] desc filled", i + 1);
 
 		/* get expected signal fences prior to submit */
-		err = nvdla_get_signal_fences(queue, task);
+		err = nvdla_get_signal_fences(queue, task, pending_incrs);
 		if (err) {
 			nvdla_dbg_err(pdev, "fail to get fences%d", i + 1);
 			goto fail_to_get_fences;
 		}
 		nvdla_dbg_info(pdev, "task[%d] got fences", i + 1);
 
+		/*
+		 * batched tasks hand their fences out only once the batch is
+		 * queued, so nothing is waited on that never gets signaled
+		 */
+		if (single_kick) {
+			batch_idx[num_batched] = i;
+			batch[num_batched++] = task;
+			pending_incrs += task->fence_counter;
+			continue;
+		}
+
 		/* update fences to user */
 		err = nvdla_update_signal_fences(task, local_tasks + i);
 		if (err) {
@@ -1030,6 +1227,31 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 		nvdla_dbg_info(pdev, "task[%d] submitted", i + 1);
 		kref_put(&task->ref, task_free);
 	}
+
+	if (num_batched) {
+		/* queued and kicked together once all tasks are ready */
+		err = nvdla_queue_submit_batch(queue, batch, num_batched);
+		if (err) {
+			nvdla_dbg_err(pdev, "fail to submit batch: %d", err);
+			goto fail_to_submit_batch;
+		}
+
+		/* update fences to user */
+		for (j = 0; j < num_batched; j++) {
+			err = nvdla_update_signal_fences(batch[j],
+					local_tasks + batch_idx[j]);
+			if (err) {
+				nvdla_dbg_err(pdev, "fail update postfence%d",
+						batch_idx[j] + 1);
+				break;
+			}
+		}
+
+		for (j = 0; j < num_batched; j++)
+			kref_put(&batch[j]->ref, task_free);
+		if (err)
+			return err;
+	}
 	nvdla_dbg_fn(pdev, "Task submitted, done!");
 
 	return 0;
@@ -1041,6 +1263,12 @@ fail_to_fill_task_desc:
 fail_to_fill_task:
 	/*TODO: traverse list in reverse and delete jobs */
 fail_to_get_task_mem:
+	/* nothing of the batch has been queued nor handed out yet */
+	for (j = 0; j < num_batched; j++)
+		nvdla_task_discard(batch[j]);
+fail_to_submit_batch:
+	for (j = 0; j < num_batched; j++)
+		kref_put(&batch[j]->ref, task_free);
 fail_to_copy_task:
 	return err;
 }
@@ -1097,6 +1325,12 @@ static long nvdla_ioctl(struct file *file, unsigned int cmd,
 	case NVDLA_IOCTL_EMU_TASK_SUBMIT:
 		err = nvdla_emu_task_submit(priv, (void *)buf);
 		break;
+	case NVDLA_IOCTL_REGISTER_TEMPLATE:
+		err = nvdla_register_template(priv, (void *)buf);
+		break;
+	case NVDLA_IOCTL_UNREGISTER_TEMPLATE:
+		err = nvdla_unregister_template(priv, (void *)buf);
+		break;
 	default:
 		nvdla_dbg_err(pdev, "invalid IOCTL CMD");
 		err = -ENOIOCTLCMD;
@@ -1119,7 +1353,7 @@ static int nvdla_open(struct inode *inode, struct file *file)
 	struct nvdla_private *priv;
 	int err = 0, index;
 
-	priv = kmalloc(sizeof(*priv), GFP_KERNEL);
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
 	if (unlikely(priv == NULL)) {
 		err = -ENOMEM;
 		goto err_alloc_priv;
@@ -1127,6 +1361,7 @@ static int nvdla_open(struct inode *inode, struct file *file)
 
 	file->private_data = priv;
 	priv->pdev = pdev;
+	mutex_init(&priv->template_lock);
 
 	nvdla_dbg_fn(pdev, "priv:%p", priv);
 
@@ -1181,11 +1416,17 @@ static int nvdla_release(struct inode *inode, struct file *file)
 {
 	struct nvdla_private *priv = file->private_data;
 	struct platform_device *pdev = priv->pdev;
+	int i;
 
 	nvdla_dbg_fn(pdev, "priv:%p", priv);
 
 	nvdla_queue_abort(priv->queue);
 	nvdla_queue_put(priv->queue);
+
+	for (i = 0; i < MAX_NVDLA_TEMPLATES; i++)
+		if (priv->templates[i])
+			nvdla_template_put(priv->templates[i]);
+
 	nvdla_buffer_release(priv->buffers);
 	nvhost_module_remove_client(pdev, priv);
 
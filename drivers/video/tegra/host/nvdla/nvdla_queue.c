@@ -23,6 +23,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/vmalloc.h>
 #include <trace/events/nvhost.h>
 
 #include "../drivers/staging/android/sync.h"
@@ -129,6 +130,11 @@ void task_free(struct kref *ref)
 
 	nvdla_dbg_info(pdev, "freeing task[%p]", task);
 
+	if (task->tmpl) {
+		nvdla_template_put(task->tmpl);
+		task->tmpl = NULL;
+	}
+
 	nvdla_put_task_mem(task);
 }
 
@@ -250,6 +256,97 @@ static int nvdla_unmap_task_memory(struct nvdla_task *task)
 	return 0;
 }
 
+void nvdla_task_discard(struct nvdla_task *task)
+{
+	nvdla_unmap_task_memory(task);
+	nvdla_task_put(task);
+}
+
+struct nvdla_task_template *nvdla_template_create(
+				struct nvdla_buffers *buffers,
+				struct nvdla_mem_handle *handles,
+				u32 num_addresses)
+{
+	struct nvdla_task_template *tmpl;
+	dma_addr_t *dma_addr;
+	size_t *dma_size;
+	u32 i, num_bufs = 0;
+	int err = -ENOMEM;
+
+	tmpl = kzalloc(sizeof(*tmpl), GFP_KERNEL);
+	if (!tmpl)
+		goto fail_to_alloc_tmpl;
+
+	tmpl->dmabufs = vzalloc(num_addresses * sizeof(*tmpl->dmabufs));
+	tmpl->addresses = vzalloc(num_addresses * sizeof(*tmpl->addresses));
+	dma_addr = vzalloc(num_addresses * sizeof(*dma_addr));
+	dma_size = vzalloc(num_addresses * sizeof(*dma_size));
+	if (!tmpl->dmabufs || !tmpl->addresses || !dma_addr || !dma_size)
+		goto fail_to_alloc;
+
+	for (num_bufs = 0; num_bufs < num_addresses; num_bufs++) {
+		err = -EFAULT;
+		if (!handles[num_bufs].handle)
+			goto fail_to_get_buf;
+
+		tmpl->dmabufs[num_bufs] = dma_buf_get(handles[num_bufs].handle);
+		if (IS_ERR_OR_NULL(tmpl->dmabufs[num_bufs]))
+			goto fail_to_get_buf;
+	}
+
+	/* pin the whole address list at once, it stays pinned until put */
+	err = nvdla_buffer_submit_pin(buffers, tmpl->dmabufs, num_addresses,
+					dma_addr, dma_size, NULL);
+	if (err)
+		goto fail_to_pin;
+
+	for (i = 0; i < num_addresses; i++)
+		tmpl->addresses[i] = dma_addr[i] + handles[i].offset;
+
+	kref_init(&tmpl->ref);
+	tmpl->buffers = buffers;
+	tmpl->num_addresses = num_addresses;
+
+	vfree(dma_size);
+	vfree(dma_addr);
+
+	return tmpl;
+
+fail_to_pin:
+fail_to_get_buf:
+	for (i = 0; i < num_bufs; i++)
+		dma_buf_put(tmpl->dmabufs[i]);
+fail_to_alloc:
+	vfree(dma_size);
+	vfree(dma_addr);
+	vfree(tmpl->addresses);
+	vfree(tmpl->dmabufs);
+	kfree(tmpl);
+fail_to_alloc_tmpl:
+	return ERR_PTR(err);
+}
+
+static void nvdla_template_free(struct kref *ref)
+{
+	struct nvdla_task_template *tmpl =
+		container_of(ref, struct nvdla_task_template, ref);
+	u32 i;
+
+	nvdla_buffer_submit_unpin(tmpl->buffers, tmpl->dmabufs,
+					tmpl->num_addresses);
+	for (i = 0; i < tmpl->num_addresses; i++)
+		dma_buf_put(tmpl->dmabufs[i]);
+
+	vfree(tmpl->addresses);
+	vfree(tmpl->dmabufs);
+	kfree(tmpl);
+}
+
+void nvdla_template_put(struct nvdla_task_template *tmpl)
+{
+	kref_put(&tmpl->ref, nvdla_template_free);
+}
+
 static void nvdla_task_free_locked(struct nvdla_task *task)
 {
 	struct nvdla_queue *queue = task->queue;
@@ -416,76 +513,61 @@ static void nvdla_get_task_desc_memsize_op(size_t *dma_size, size_t *kmem_size)
 	*kmem_size = nvdla_get_max_task_size();
 }
 
-static inline u8 *add_address(u8 *mem, uint64_t addr)
-{
-	struct dla_mem_addr *address = (struct dla_mem_addr *)mem;
-
-	address->val = addr;
-
-	return mem + sizeof(struct dla_mem_addr);
-}
-
-static inline u8 *add_opcode(u8 *mem, uint8_t op)
-{
-	struct dla_action_opcode *opcode = (struct dla_action_opcode *)mem;
-
-	opcode->value = op;
-
-	return mem + sizeof(struct dla_action_opcode);
-}
-
-static u8 *add_fence_action(u8 *mem, uint8_t op, uint64_t addr, uint32_t val)
-{
-	struct dla_action_semaphore *action;
-
-	mem = add_opcode(mem, op);
-
-	action = (struct dla_action_semaphore *)mem;
-	action->address = addr;
-	action->value = val;
-
-	return mem + sizeof(struct dla_action_semaphore);
-}
-
-static u8 *add_status_action(u8 *mem, uint8_t op, uint64_t addr,
-				uint16_t status)
+/*
+ * Copy the address list of the template the task was launched from and
+ * pin only the entries it patches.
+ */
+static int nvdla_map_template_memory(struct nvdla_task *task, u8 *next)
 {
-	struct dla_action_task_status *action;
-
-	mem = add_opcode(mem, op);
-
-	action = (struct dla_action_task_status *)mem;
-	action->address = addr;
-	action->status = status;
+	struct nvdla_task_template *tmpl = task->tmpl;
+	struct platform_device *pdev = task->queue->pool->pdev;
+	struct dla_mem_addr *address = (struct dla_mem_addr *)next;
+	int jj;
+	int err = 0;
 
-	return mem + sizeof(struct dla_action_task_status);
-}
+	memcpy(address, tmpl->addresses,
+		tmpl->num_addresses * sizeof(struct dla_mem_addr));
 
-static u8 *add_timestamp_action(u8 *mem, uint8_t op, uint64_t addr)
-{
-	struct dla_action_timestamp *action;
+	for (jj = 0; jj < task->num_addresses; jj++) {
+		dma_addr_t dma_addr;
+		size_t dma_size;
 
-	mem = add_opcode(mem, op);
+		nvdla_dbg_info(pdev, "patch[%d] index[%u] handle[%u] offset[%u]",
+				jj, task->patch_index[jj],
+				task->memory_handles[jj].handle,
+				task->memory_handles[jj].offset);
 
-	action = (struct dla_action_timestamp *)mem;
-	action->address = addr;
+		task->memory_dmabuf[jj] =
+			dma_buf_get(task->memory_handles[jj].handle);
+		if (IS_ERR_OR_NULL(task->memory_dmabuf[jj])) {
+			err = -EFAULT;
+			nvdla_dbg_err(pdev, "fail to get buf");
+			goto fail_to_pin_mem;
+		}
 
-	return mem + sizeof(struct dla_action_timestamp);
-}
+		err = nvdla_buffer_submit_pin(task->buffers,
+				&task->memory_dmabuf[jj],
+				1, &dma_addr, &dma_size, NULL);
+		if (err) {
+			nvdla_dbg_err(pdev, "fail to pin address list");
+			dma_buf_put(task->memory_dmabuf[jj]);
+			goto fail_to_pin_mem;
+		}
 
-static u8 *add_gos_action(u8 *mem, uint8_t op, uint8_t index, uint16_t offset,
-				uint32_t value)
-{
-	struct dla_action_gos *action;
+		address[task->patch_index[jj]].val =
+			dma_addr + task->memory_handles[jj].offset;
+	}
 
-	mem = add_opcode(mem, op);
+	return 0;
 
-	action = (struct dla_action_gos *)mem;
-	action->index = index;
-	action->offset = offset;
-	action->value = value;
+fail_to_pin_mem:
+	/* unmap only releases what has been pinned */
+	for (; jj < task->num_addresses; jj++) {
+		task->memory_dmabuf[jj] = NULL;
+		task->memory_handles[jj].handle = 0;
+	}
 
-	return mem + sizeof(struct dla_action_gos);
+	return err;
 }
 
 static int nvdla_map_task_memory(struct nvdla_task *task)
@@ -512,6 +594,12 @@ static int nvdla_map_task_memory(struct nvdla_task *task)
 
 	/* send address lists task desc dma to engine */
 	task_desc->address_list = (uint64_t)((u8 *)task->task_desc_pa + offset);
+
+	if (task->tmpl) {
+		task_desc->num_addresses = task->tmpl->num_addresses;
+		return nvdla_map_template_memory(task, next);
+	}
+
 	task_desc->num_addresses = task->num_addresses;
 
 	/* update address list with all dma */
@@ -1434,7 +1522,8 @@ int nvdla_emulator_submit(struct nvdla_queue *queue, struct nvdla_emu_task *task
 	return 0;
 }
 
-int nvdla_get_signal_fences(struct nvdla_queue *queue, void *in_task)
+int nvdla_get_signal_fences(struct nvdla_queue *queue, void *in_task,
+				u32 pending_incrs)
 {
 	struct nvdla_task *task = (struct nvdla_task *)in_task;
 	struct platform_device *pdev = queue->pool->pdev;
@@ -1449,8 +1538,9 @@ int nvdla_get_signal_fences(struct nvdla_queue *queue, void *in_task)
 	if (task->fence_counter == 0)
 		task->fence_counter = 1;
 
+	/* tasks of the same batch not queued yet take their fences first */
 	task_fence = nvhost_syncpt_read_maxval(pdev, queue->syncpt_id) +
-			task->fence_counter;
+			pending_incrs + task->fence_counter;
 
 	/* Update fences signal updates for both prefence and postfence */
 	counter = task->fence_counter - 1;
@@ -1613,6 +1703,116 @@ fail_to_poweron:
 	return err;
 }
 
+int nvdla_queue_submit_batch(struct nvdla_queue *queue,
+				struct nvdla_task **tasks, int num_tasks)
+{
+	struct platform_device *pdev = queue->pool->pdev;
+	struct nvdla_task *task, *last_task;
+	struct nvdla_cmd_data cmd_data;
+	int busy, registered = 0;
+	int i, err = 0;
+	u64 timestamp;
+
+	nvdla_dbg_fn(pdev, "num_tasks[%d]", num_tasks);
+
+	mutex_lock(&queue->list_lock);
+
+	/* pm refcount per task, each is dropped as its task completes */
+	for (busy = 0; busy < num_tasks; busy++) {
+		err = nvhost_module_busy(pdev);
+		if (err) {
+			nvdla_dbg_err(pdev, "failed to poweron, err: %d", err);
+			goto fail_to_poweron;
+		}
+	}
+
+	/* chain all descriptors, the engine walks them from the first one */
+	for (i = 0; i < num_tasks; i++) {
+		task = tasks[i];
+		task->fence = nvhost_syncpt_incr_max(task->sp,
+						queue->syncpt_id,
+						task->fence_counter);
+
+		if (!list_empty(&queue->tasklist)) {
+			last_task = list_last_entry(&queue->tasklist,
+						struct nvdla_task, list);
+			last_task->task_desc->next =
+					(uint64_t)task->task_desc_pa;
+		}
+		list_add_tail(&task->list, &queue->tasklist);
+
+		nvdla_dbg_fn(pdev, "syncpt[%d] fence[%d] task[%p] fence_counter[%u]",
+				queue->syncpt_id, task->fence,
+				task, task->fence_counter);
+	}
+
+	for (registered = 0; registered < num_tasks; registered++) {
+		task = tasks[registered];
+		err = nvhost_intr_register_notifier(pdev, queue->syncpt_id,
+			task->fence, nvdla_queue_update, queue);
+		if (err)
+			goto fail_to_submit;
+	}
+
+	/* Report timestamp in TSC ticks. */
+	timestamp = arch_counter_get_cntvct();
+
+	/* enable INT_ON_COMPLETE and INT_ON_ERROR falcon interrupts */
+	cmd_data.method_id = (DLA_CMD_SUBMIT_TASK & DLA_METHOD_ID_CMD_MASK) |
+			(1 << DLA_INT_ON_COMPLETE_SHIFT) |
+			(1 << DLA_INT_ON_ERROR_SHIFT);
+	cmd_data.method_data = ALIGNED_DMA(tasks[0]->task_desc_pa);
+	cmd_data.wait = true;
+
+	err = nvdla_send_cmd(pdev, &cmd_data);
+	if (err) {
+		nvdla_dbg_err(pdev, "batch of %d tasks submit failed",
+				num_tasks);
+		goto fail_to_submit;
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		task = tasks[i];
+
+		nvhost_eventlib_log_submit(pdev,
+					   queue->syncpt_id,
+					   task->fence,
+					   timestamp);
+
+		nvhost_eventlib_log_fences(pdev,
+					   queue->syncpt_id,
+					   task->fence,
+					   task->prefences,
+					   task->num_prefences,
+					   NVDEV_FENCE_KIND_PRE,
+					   timestamp);
+	}
+
+	mutex_unlock(&queue->list_lock);
+	return 0;
+
+fail_to_submit:
+	/*
+	 * The tasks are queued: release them all by moving the syncpoint to
+	 * the last fence and drop the pm refcounts no notifier will put.
+	 */
+	nvdla_task_syncpt_reset(tasks[num_tasks - 1]->sp, queue->syncpt_id,
+				tasks[num_tasks - 1]->fence);
+	nvhost_module_idle_mult(pdev, num_tasks - registered);
+	mutex_unlock(&queue->list_lock);
+	return err;
+
+fail_to_poweron:
+	if (busy)
+		nvhost_module_idle_mult(pdev, busy);
+	mutex_unlock(&queue->list_lock);
+
+	for (i = 0; i < num_tasks; i++)
+		nvdla_task_discard(tasks[i]);
+
+	return err;
+}
+
 int nvdla_set_queue_state(struct nvdla_queue *queue, int cmd)
 {
 	struct platform_device *pdev = queue->pool->pdev;
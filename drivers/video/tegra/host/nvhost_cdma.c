@@ -21,9 +21,12 @@
 #include "nvhost_cdma.h"
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
+#include "nvhost_scale.h"
+#include "nvhost_timeline.h"
 #include "dev.h"
 #include "debug.h"
 #include "chip_support.h"
+#include <asm/arch_timer.h>
 #include <asm/cacheflush.h>
 #include <nvhost_vm.h>
 
@@ -139,6 +142,17 @@ dma_addr_t nvhost_push_buffer_end(struct push_buffer *pb)
 	return pb->dma_addr + PUSH_BUFFER_SIZE + 4;
 }
 
+static u32 nvhost_job_gather_words(struct nvhost_job *job)
+{
+	u32 words = 0;
+	int i;
+
+	for (i = 0; i < job->num_gathers; i++)
+		words += job->gathers[i].words;
+
+	return words;
+}
+
 /**
  * Add an entry to the sync queue.
  */
@@ -297,6 +311,27 @@ static void stop_cdma_timer_locked(struct nvhost_cdma *cdma)
 	mutex_unlock(&cdma->timeout_lock);
 }
 
+/*
+ * Record when the job completion was seen, keyed like the submit event:
+ * the fence returned to userspace excludes the work done increment.
+ */
+static void nvhost_cdma_timeline_signal(struct nvhost_job *job)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+	u32 thresh;
+
+	if (!job->num_syncpts)
+		return;
+
+	thresh = job->sp[0].fence;
+	if (pdata->push_work_done)
+		thresh--;
+
+	nvhost_timeline_record(job->ch->dev, NVHOST_TIMELINE_SIGNAL,
+			       job->sp[0].id, thresh, job->sp[0].id, thresh,
+			       arch_counter_get_cntvct(), 0);
+}
+
 /**
  * For all sync queue entries that have already finished according to the
  * current sync point registers:
@@ -353,6 +388,11 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 		list_del(&job->list);
 		mutex_unlock(&cdma->sync_queue_lock);
 
+		nvhost_cdma_timeline_signal(job);
+
+		nvhost_scale_job_done(job->ch->dev,
+				      nvhost_job_gather_words(job));
+
 		/* Cancel timeout, when a buffer completes */
 		stop_cdma_timer_locked(cdma);
 
@@ -655,6 +695,8 @@ void nvhost_cdma_end(struct nvhost_cdma *cdma,
 
 	cdma_op().kick(cdma);
 
+	nvhost_scale_job_queued(job->ch->dev, nvhost_job_gather_words(job));
+
 	/* start timer on idle -> active transitions */
 	if (was_idle)
 		cdma_start_timer_locked(cdma, job);
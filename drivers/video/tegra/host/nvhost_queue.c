@@ -20,6 +20,7 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/dma-mapping.h>
 #include <linux/debugfs.h>
 #include <linux/dma-attrs.h>
@@ -70,10 +71,14 @@ static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
 
 	task_pool = queue->task_pool;
 
-	/* Allocate the kernel memory needed for the task */
+	/*
+	 * Allocate the kernel memory needed for the task. It is only
+	 * accessed by the CPU and can get large, don't ask for contiguous
+	 * pages.
+	 */
 	if (queue->task_kmem_size) {
-		task_pool->kmem_addr = kcalloc(num_tasks,
-					queue->task_kmem_size, GFP_KERNEL);
+		task_pool->kmem_addr = vzalloc(num_tasks *
+					       queue->task_kmem_size);
 		if (!task_pool->kmem_addr) {
 			nvhost_err(&pdev->dev,
 				   "failed to allocate task_pool->kmem_addr");
@@ -100,7 +105,7 @@ static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
 	return err;
 
 err_alloc_task_pool:
-	kfree(task_pool->kmem_addr);
+	vfree(task_pool->kmem_addr);
 err_alloc_task_kmem:
 	return err;
 }
@@ -116,7 +121,7 @@ static void nvhost_queue_task_free_pool(struct platform_device *pdev,
 			task_pool->va, task_pool->dma_addr,
 			__DMA_ATTR(task_dma_attrs));
 
-	kfree(task_pool->kmem_addr);
+	vfree(task_pool->kmem_addr);
 	task_pool->max_task_cnt = 0;
 	task_pool->alloc_table = 0;
 }
@@ -26,6 +26,8 @@
 #include <linux/clk/tegra.h>
 #include <soc/tegra/chip-id.h>
 #include <linux/pm_qos.h>
+#include <linux/pm_runtime.h>
+#include <linux/platform/tegra/actmon_telemetry.h>
 #include <trace/events/nvhost.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
@@ -260,6 +262,59 @@ void nvhost_scale_notify_busy(struct platform_device *pdev)
 	nvhost_scale_notify(pdev, true);
 }
 
+static void nvhost_scale_queue_worker(struct work_struct *work)
+{
+	struct nvhost_device_profile *profile =
+		container_of(work, struct nvhost_device_profile, queue_work);
+	struct nvhost_device_data *pdata = platform_get_drvdata(profile->pdev);
+	struct devfreq *devfreq = pdata->power_manager;
+
+	if (!devfreq)
+		return;
+
+	mutex_lock(&devfreq->lock);
+#if defined(CONFIG_PM_DEVFREQ)
+	update_devfreq(devfreq);
+#endif
+	mutex_unlock(&devfreq->lock);
+}
+
+/*
+ * nvhost_scale_job_queued(pdev, words)
+ *
+ * Account a job that was added to the channel's sync queue. When the queue
+ * was empty, let the governor see the new work right away instead of at the
+ * next polling interval. Called with the cdma lock held, so the frequency
+ * update itself is deferred to a worker.
+ */
+
+void nvhost_scale_job_queued(struct platform_device *pdev, u32 words)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+
+	if (!profile)
+		return;
+
+	atomic_add(words, &profile->queue_hint.words);
+	if (atomic_inc_return(&profile->queue_hint.jobs) == 1 &&
+	    pdata->power_manager)
+		schedule_work(&profile->queue_work);
+}
+
+void nvhost_scale_job_done(struct platform_device *pdev, u32 words)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+
+	if (!profile)
+		return;
+
+	atomic_dec_if_positive(&profile->queue_hint.jobs);
+	if (atomic_sub_return(words, &profile->queue_hint.words) < 0)
+		atomic_set(&profile->queue_hint.words, 0);
+}
+
 /*
  * nvhost_scale_get_dev_status(dev, *stat)
  *
@@ -337,6 +392,32 @@ static int nvhost_scale_set_high_wmark(struct device *dev,
 	return 0;
 }
 
+/*
+ * nvhost_scale_telem_sample(actmon)
+ *
+ * Telemetry callback. A powered-off engine is reported idle rather than
+ * woken up for the sample.
+ */
+
+static u32 nvhost_scale_telem_sample(void *data)
+{
+	struct host1x_actmon *actmon = data;
+	struct nvhost_device_data *pdata = platform_get_drvdata(actmon->pdev);
+	u32 load = 0;
+
+	/* normalisation needs the devfreq profile */
+	if (!pdata->power_manager)
+		return 0;
+
+	if (pm_runtime_get_if_in_use(&actmon->pdev->dev) <= 0)
+		return 0;
+
+	actmon_op().read_avg_norm(actmon, &load);
+	pm_runtime_put(&actmon->pdev->dev);
+
+	return load;
+}
+
 /*
  * nvhost_scale_init(pdev)
  */
@@ -359,6 +440,7 @@ void nvhost_scale_init(struct platform_device *pdev)
 	profile->clk = pdata->clk[0];
 	profile->dev_stat.busy = false;
 	profile->num_actmons = nvhost_get_host(pdev)->info.nb_actmons;
+	INIT_WORK(&profile->queue_work, nvhost_scale_queue_worker);
 
 	/* Create frequency table */
 	err = nvhost_scale_make_freq_table(profile);
@@ -416,6 +498,10 @@ void nvhost_scale_init(struct platform_device *pdev)
 			actmon_op().init(actmon);
 			nvhost_actmon_debug_init(actmon, pdata->debugfs);
 			actmon_op().deinit(actmon);
+
+			actmon->telem = tegra_actmon_telem_add(
+					dev_name(&pdev->dev),
+					nvhost_scale_telem_sample, actmon);
 		}
 	}
 
@@ -435,6 +521,11 @@ void nvhost_scale_init(struct platform_device *pdev)
 		profile->devfreq_profile.set_high_wmark =
 			nvhost_scale_set_high_wmark;
 
+		/* the governor picks the hint up when it starts */
+		if (nvhost_podgov_add_queue_hint(&pdev->dev,
+						 &profile->queue_hint))
+			nvhost_warn(&pdev->dev, "no queue hint for devfreq");
+
 		devfreq = devfreq_add_device(&pdev->dev,
 					&profile->devfreq_profile,
 					pdata->devfreq_governor, NULL);
@@ -454,6 +545,9 @@ void nvhost_scale_init(struct platform_device *pdev)
 	return;
 err_get_actmon_regs:
 err_allocate_actmon:
+	for (i = 0; i < profile->num_actmons; i++)
+		if (profile->actmon[i])
+			tegra_actmon_telem_remove(profile->actmon[i]->telem);
 	kfree(profile->actmon);
 err_allocate_actmons:
 	nvhost_module_idle(nvhost_get_host(pdev)->dev);
@@ -482,12 +576,23 @@ void nvhost_scale_deinit(struct platform_device *pdev)
 	/* Remove devfreq from acm client list */
 	nvhost_module_remove_client(pdev, pdata->power_manager);
 
+	cancel_work_sync(&profile->queue_work);
 	if (pdata->power_manager)
 		devfreq_remove_device(pdata->power_manager);
+	nvhost_podgov_remove_queue_hint(&pdev->dev);
 
 	if (pdata->actmon_enabled)
 		device_remove_file(&pdev->dev, &dev_attr_load);
 
+	if (profile->actmon) {
+		int i;
+
+		for (i = 0; i < profile->num_actmons; i++)
+			if (profile->actmon[i])
+				tegra_actmon_telem_remove(
+						profile->actmon[i]->telem);
+	}
+
 	kfree(profile->devfreq_profile.freq_table);
 	kfree(profile->actmon);
 	kfree(profile);
@@ -48,6 +48,9 @@ struct nvhost_device_profile {
 	void				*private_data;
 	struct notifier_block		qos_notify_block;
 	int				num_actmons;
+
+	struct nvhost_queue_hint	queue_hint;
+	struct work_struct		queue_work;
 };
 
 #if defined(CONFIG_TEGRA_GRHOST_SCALE)
@@ -62,6 +65,10 @@ void nvhost_scale_deinit(struct platform_device *);
 void nvhost_scale_notify_busy(struct platform_device *);
 void nvhost_scale_notify_idle(struct platform_device *);
 
+/* call when a job enters and leaves the channel's sync queue */
+void nvhost_scale_job_queued(struct platform_device *, u32 words);
+void nvhost_scale_job_done(struct platform_device *, u32 words);
+
 int nvhost_scale_hw_init(struct platform_device *);
 void nvhost_scale_hw_deinit(struct platform_device *);
 
@@ -72,6 +79,10 @@ static inline void nvhost_scale_init(struct platform_device *d) { }
 static inline void nvhost_scale_deinit(struct platform_device *d) { }
 static inline void nvhost_scale_notify_busy(struct platform_device *d) { }
 static inline void nvhost_scale_notify_idle(struct platform_device *d) { }
+static inline void nvhost_scale_job_queued(struct platform_device *d,
+					   u32 words) { }
+static inline void nvhost_scale_job_done(struct platform_device *d,
+					 u32 words) { }
 static inline int nvhost_scale_hw_init(struct platform_device *d)
 {
 	return 0;
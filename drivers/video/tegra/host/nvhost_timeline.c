@@ -0,0 +1,435 @@
+/*
+ * NVHOST Job Timeline
+ *
+ * Copyright (c) 2020, NVIDIA Corporation.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/platform_device.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/nvhost.h>
+
+#include <asm/arch_timer.h>
+
+#include "nvhost_timeline.h"
+
+#define NVHOST_TIMELINE_NAME_LEN	16
+#define NVHOST_TIMELINE_MAX_ENGINES	32
+#define NVHOST_TIMELINE_MAX_EVENTS	(1 << 16)
+
+struct nvhost_timeline_event {
+	u64 timestamp;
+	u64 duration;
+	u32 syncpt_id;
+	u32 syncpt_thresh;
+	u32 fence_id;
+	u32 fence_thresh;
+	u32 pid;
+	u32 type;
+	char name[NVHOST_TIMELINE_NAME_LEN];
+};
+
+struct nvhost_timeline_ring {
+	spinlock_t lock;
+	struct nvhost_timeline_event *events;
+	u32 size;
+	u32 head;
+	u32 count;
+};
+
+/* Events of all CPUs merged and sorted by time, for one reader */
+struct nvhost_timeline_snapshot {
+	u32 freq;
+	u32 num_engines;
+	char engines[NVHOST_TIMELINE_MAX_ENGINES][NVHOST_TIMELINE_NAME_LEN];
+	u32 num_events;
+	struct nvhost_timeline_event events[];
+};
+
+static DEFINE_PER_CPU(struct nvhost_timeline_ring, nvhost_timeline_rings);
+static DEFINE_MUTEX(nvhost_timeline_lock);
+static u32 nvhost_timeline_size;
+
+void nvhost_timeline_record(struct platform_device *pdev,
+			    enum nvhost_timeline_type type,
+			    u32 syncpt_id, u32 syncpt_thresh,
+			    u32 fence_id, u32 fence_thresh,
+			    u64 timestamp, u64 duration)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_timeline_ring *ring;
+	struct nvhost_timeline_event *ev;
+	unsigned long flags;
+
+	if (!READ_ONCE(nvhost_timeline_size))
+		return;
+
+	local_irq_save(flags);
+	ring = this_cpu_ptr(&nvhost_timeline_rings);
+	spin_lock(&ring->lock);
+
+	if (!ring->events)
+		goto out;
+
+	ev = &ring->events[ring->head];
+	ev->timestamp = timestamp;
+	ev->duration = duration;
+	ev->syncpt_id = syncpt_id;
+	ev->syncpt_thresh = syncpt_thresh;
+	ev->fence_id = fence_id;
+	ev->fence_thresh = fence_thresh;
+	ev->pid = type == NVHOST_TIMELINE_SUBMIT ? current->tgid : 0;
+	ev->type = type;
+	strlcpy(ev->name, pdata->devfs_name ? pdata->devfs_name :
+		dev_name(&pdev->dev), sizeof(ev->name));
+
+	ring->head = (ring->head + 1) % ring->size;
+	if (ring->count < ring->size)
+		ring->count++;
+
+out:
+	spin_unlock(&ring->lock);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(nvhost_timeline_record);
+
+/*
+ * Replace the rings of all CPUs with empty rings of size events. A size of
+ * 0 frees the rings and stops the recording.
+ */
+static int nvhost_timeline_resize(u32 size)
+{
+	struct nvhost_timeline_event *events, *old;
+	struct nvhost_timeline_ring *ring;
+	unsigned long flags;
+	int err = 0;
+	int cpu;
+
+	mutex_lock(&nvhost_timeline_lock);
+
+	WRITE_ONCE(nvhost_timeline_size, size);
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&nvhost_timeline_rings, cpu);
+
+		events = NULL;
+		if (size) {
+			events = vzalloc_node(size * sizeof(*events),
+					      cpu_to_node(cpu));
+			if (!events)
+				err = -ENOMEM;
+		}
+
+		spin_lock_irqsave(&ring->lock, flags);
+		old = ring->events;
+		ring->events = events;
+		ring->size = events ? size : 0;
+		ring->head = 0;
+		ring->count = 0;
+		spin_unlock_irqrestore(&ring->lock, flags);
+
+		vfree(old);
+	}
+
+	mutex_unlock(&nvhost_timeline_lock);
+
+	return err;
+}
+
+static int nvhost_timeline_cmp(const void *a, const void *b)
+{
+	const struct nvhost_timeline_event *ea = a, *eb = b;
+
+	if (ea->timestamp < eb->timestamp)
+		return -1;
+
+	return ea->timestamp > eb->timestamp;
+}
+
+static struct nvhost_timeline_snapshot *nvhost_timeline_snapshot(void)
+{
+	struct nvhost_timeline_snapshot *snap;
+	struct nvhost_timeline_ring *ring;
+	struct nvhost_timeline_event *ev;
+	unsigned long flags;
+	u32 i, j, total = 0;
+	int cpu;
+
+	mutex_lock(&nvhost_timeline_lock);
+
+	for_each_possible_cpu(cpu)
+		total += per_cpu_ptr(&nvhost_timeline_rings, cpu)->size;
+
+	snap = vzalloc(sizeof(*snap) + total * sizeof(*ev));
+	if (!snap)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&nvhost_timeline_rings, cpu);
+
+		spin_lock_irqsave(&ring->lock, flags);
+		for (i = 0; i < ring->count; i++) {
+			j = (ring->head + ring->size - ring->count + i) %
+				ring->size;
+			snap->events[snap->num_events++] = ring->events[j];
+		}
+		spin_unlock_irqrestore(&ring->lock, flags);
+	}
+
+out:
+	mutex_unlock(&nvhost_timeline_lock);
+
+	if (!snap)
+		return NULL;
+
+	sort(snap->events, snap->num_events, sizeof(*ev),
+	     nvhost_timeline_cmp, NULL);
+
+	/* Give each engine its own track */
+	for (i = 0; i < snap->num_events; i++) {
+		ev = &snap->events[i];
+
+		for (j = 0; j < snap->num_engines; j++)
+			if (!strcmp(snap->engines[j], ev->name))
+				break;
+
+		if (j == snap->num_engines &&
+		    snap->num_engines < NVHOST_TIMELINE_MAX_ENGINES)
+			strlcpy(snap->engines[snap->num_engines++], ev->name,
+				NVHOST_TIMELINE_NAME_LEN);
+	}
+
+	snap->freq = arch_timer_get_cntfrq();
+	if (!snap->freq)
+		snap->freq = NSEC_PER_SEC;
+
+	return snap;
+}
+
+static u32 nvhost_timeline_tid(struct nvhost_timeline_snapshot *snap,
+			       struct nvhost_timeline_event *ev)
+{
+	u32 i;
+
+	for (i = 0; i < snap->num_engines; i++)
+		if (!strcmp(snap->engines[i], ev->name))
+			return i + 1;
+
+	return 0;
+}
+
+/* Trace event timestamps are in microseconds */
+static void nvhost_timeline_print_us(struct seq_file *s, u32 freq, u64 ticks)
+{
+	u64 ns, us;
+	u32 rem;
+
+	ns = div_u64_rem(ticks, freq, &rem) * NSEC_PER_SEC;
+	ns += div_u64((u64)rem * NSEC_PER_SEC, freq);
+	us = div_u64_rem(ns, 1000, &rem);
+
+	seq_printf(s, "%llu.%03u", us, rem);
+}
+
+static void nvhost_timeline_show_event(struct seq_file *s,
+				       struct nvhost_timeline_snapshot *snap,
+				       struct nvhost_timeline_event *ev)
+{
+	u32 tid = nvhost_timeline_tid(snap, ev);
+	u64 flow = ((u64)ev->fence_id << 32) | ev->fence_thresh;
+
+	switch (ev->type) {
+	case NVHOST_TIMELINE_SUBMIT:
+		seq_puts(s, "{\"name\":\"submit\",\"ph\":\"i\",\"s\":\"t\"");
+		break;
+	case NVHOST_TIMELINE_EXEC:
+		seq_printf(s, "{\"name\":\"%u:%u\",\"ph\":\"X\",\"dur\":",
+			   ev->syncpt_id, ev->syncpt_thresh);
+		nvhost_timeline_print_us(s, snap->freq, ev->duration);
+		break;
+	case NVHOST_TIMELINE_WAIT:
+		/* Arrow from the signal of the fence to its waiter */
+		seq_puts(s, "{\"name\":\"fence\",\"ph\":\"f\",\"bp\":\"e\"");
+		seq_printf(s, ",\"id\":%llu,\"ts\":", flow);
+		nvhost_timeline_print_us(s, snap->freq, ev->timestamp);
+		seq_printf(s, ",\"pid\":1,\"tid\":%u},\n", tid);
+		seq_puts(s, "{\"name\":\"wait\",\"ph\":\"i\",\"s\":\"t\"");
+		break;
+	case NVHOST_TIMELINE_SIGNAL:
+		seq_puts(s, "{\"name\":\"fence\",\"ph\":\"s\"");
+		seq_printf(s, ",\"id\":%llu,\"ts\":", flow);
+		nvhost_timeline_print_us(s, snap->freq, ev->timestamp);
+		seq_printf(s, ",\"pid\":1,\"tid\":%u},\n", tid);
+		seq_puts(s, "{\"name\":\"signal\",\"ph\":\"i\",\"s\":\"t\"");
+		break;
+	}
+
+	seq_puts(s, ",\"ts\":");
+	nvhost_timeline_print_us(s, snap->freq, ev->timestamp);
+	seq_printf(s, ",\"pid\":1,\"tid\":%u,\"args\":{\"syncpt\":%u,"
+		   "\"thresh\":%u", tid, ev->syncpt_id, ev->syncpt_thresh);
+
+	if (ev->type == NVHOST_TIMELINE_SUBMIT)
+		seq_printf(s, ",\"pid\":%u", ev->pid);
+	if (ev->type == NVHOST_TIMELINE_WAIT ||
+	    ev->type == NVHOST_TIMELINE_SIGNAL)
+		seq_printf(s, ",\"fence_syncpt\":%u,\"fence_thresh\":%u",
+			   ev->fence_id, ev->fence_thresh);
+
+	seq_puts(s, "}}");
+}
+
+/*
+ * Output items: the header, one track name per engine, the events and
+ * the footer. The iterator is the item index plus one.
+ */
+static void *nvhost_timeline_seq_start(struct seq_file *s, loff_t *pos)
+{
+	struct nvhost_timeline_snapshot *snap = s->private;
+
+	if (*pos > 1 + snap->num_engines + snap->num_events)
+		return NULL;
+
+	return (void *)(uintptr_t)(*pos + 1);
+}
+
+static void *nvhost_timeline_seq_next(struct seq_file *s, void *v,
+				      loff_t *pos)
+{
+	++*pos;
+
+	return nvhost_timeline_seq_start(s, pos);
+}
+
+static void nvhost_timeline_seq_stop(struct seq_file *s, void *v)
+{
+}
+
+static int nvhost_timeline_seq_show(struct seq_file *s, void *v)
+{
+	struct nvhost_timeline_snapshot *snap = s->private;
+	u32 i = (uintptr_t)v - 1;
+
+	if (i == 0) {
+		seq_puts(s, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+			 "\"args\":{\"name\":\"nvhost\"}}");
+		return 0;
+	}
+
+	i--;
+	if (i < snap->num_engines) {
+		seq_printf(s, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+			   "\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			   i + 1, snap->engines[i]);
+		return 0;
+	}
+
+	i -= snap->num_engines;
+	if (i < snap->num_events) {
+		seq_puts(s, ",\n");
+		nvhost_timeline_show_event(s, snap, &snap->events[i]);
+		return 0;
+	}
+
+	seq_puts(s, "\n]}\n");
+	return 0;
+}
+
+static const struct seq_operations nvhost_timeline_seq_ops = {
+	.start = nvhost_timeline_seq_start,
+	.next = nvhost_timeline_seq_next,
+	.stop = nvhost_timeline_seq_stop,
+	.show = nvhost_timeline_seq_show,
+};
+
+static int nvhost_timeline_open(struct inode *inode, struct file *file)
+{
+	struct nvhost_timeline_snapshot *snap;
+	int err;
+
+	snap = nvhost_timeline_snapshot();
+	if (!snap)
+		return -ENOMEM;
+
+	err = seq_open(file, &nvhost_timeline_seq_ops);
+	if (err) {
+		vfree(snap);
+		return err;
+	}
+
+	((struct seq_file *)file->private_data)->private = snap;
+
+	return 0;
+}
+
+static int nvhost_timeline_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *s = file->private_data;
+
+	vfree(s->private);
+
+	return seq_release(inode, file);
+}
+
+static const struct file_operations nvhost_timeline_fops = {
+	.open		= nvhost_timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= nvhost_timeline_release,
+};
+
+static int nvhost_timeline_events_get(void *data, u64 *val)
+{
+	*val = READ_ONCE(nvhost_timeline_size);
+
+	return 0;
+}
+
+static int nvhost_timeline_events_set(void *data, u64 val)
+{
+	if (val > NVHOST_TIMELINE_MAX_EVENTS)
+		return -EINVAL;
+
+	return nvhost_timeline_resize(val);
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(nvhost_timeline_events_fops,
+			nvhost_timeline_events_get,
+			nvhost_timeline_events_set, "%llu\n");
+
+void nvhost_timeline_debug_init(struct dentry *de)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(&nvhost_timeline_rings, cpu)->lock);
+
+	debugfs_create_file("timeline", S_IRUGO, de, NULL,
+			    &nvhost_timeline_fops);
+	debugfs_create_file("timeline_events", S_IRUGO | S_IWUSR, de, NULL,
+			    &nvhost_timeline_events_fops);
+}
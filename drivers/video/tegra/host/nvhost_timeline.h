@@ -0,0 +1,49 @@
+/*
+ * NVHOST Job Timeline Header
+ *
+ * Copyright (c) 2020, NVIDIA Corporation.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_TIMELINE_H__
+#define __NVHOST_TIMELINE_H__
+
+#include <linux/types.h>
+
+struct dentry;
+struct platform_device;
+
+/*
+ * The timeline records job events of all engines into per-CPU rings,
+ * keyed by the job syncpoint id and threshold. Timestamps are in TSC
+ * ticks, the unit the engines already report. The rings are allocated
+ * and the recording enabled by writing the per-CPU ring size to
+ * tegra_host/timeline_events; tegra_host/timeline returns the events
+ * of all CPUs in the Chrome trace event format.
+ */
+enum nvhost_timeline_type {
+	NVHOST_TIMELINE_SUBMIT,		/* job handed to the engine */
+	NVHOST_TIMELINE_EXEC,		/* job ran from timestamp for duration */
+	NVHOST_TIMELINE_WAIT,		/* job waits for fence_id/fence_thresh */
+	NVHOST_TIMELINE_SIGNAL,		/* fence_id reached fence_thresh */
+};
+
+void nvhost_timeline_record(struct platform_device *pdev,
+			    enum nvhost_timeline_type type,
+			    u32 syncpt_id, u32 syncpt_thresh,
+			    u32 fence_id, u32 fence_thresh,
+			    u64 timestamp, u64 duration);
+void nvhost_timeline_debug_init(struct dentry *de);
+
+#endif
@@ -49,9 +49,10 @@ struct pva_version_info {
 #define MAX_PVA_QUEUE_COUNT 8
 
 /**
- * Maximum task count that a queue can support
+ * Maximum task count that a queue can support, enough for several
+ * PVA_MAX_TASKS batches in flight
  */
-#define MAX_PVA_TASK_COUNT	16
+#define MAX_PVA_TASK_COUNT	32
 
 /**
  * Minium PVA frequency (10MHz)
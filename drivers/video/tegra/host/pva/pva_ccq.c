@@ -38,6 +38,10 @@ static int pva_ccq_wait(struct pva *pva, int timeout)
 	/*
 	 * Wait until there is free room in the CCQ. Otherwise the writes
 	 * could stall the CPU. Ignore the timeout in simulation.
+	 *
+	 * Returns the number of commands that can be written before the
+	 * status needs to be checked again. A command takes two writes, so
+	 * the estimate errs on the low side.
 	 */
 
 	while (time_before(jiffies, end_jiffies) ||
@@ -45,7 +49,7 @@ static int pva_ccq_wait(struct pva *pva, int timeout)
 		u32 val = host1x_readl(pva->pdev, cfg_ccq_status2_r());
 
 		if (val <= MAX_CCQ_ELEMENTS)
-			return 0;
+			return (MAX_CCQ_ELEMENTS - val) / 2 + 1;
 
 		usleep_range(5, 10);
 	}
@@ -69,10 +73,51 @@ int pva_ccq_send(struct pva *pva, u64 cmd)
 
 	mutex_unlock(&pva->ccq_mutex);
 
+	return 0;
+
+err_wait_ccq:
+	mutex_unlock(&pva->ccq_mutex);
+	pva_abort(pva);
+
 	return err;
+}
+
+/*
+ * Push several commands under one lock, polling the CCQ status only when
+ * the room seen by the previous poll has been used up. On failure, sent
+ * tells how many commands made it to the CCQ before the timeout.
+ */
+int pva_ccq_send_batch(struct pva *pva, const u64 *cmds, u32 count,
+		       u32 *sent)
+{
+	int room = 0;
+	int err = 0;
+	u32 i;
+
+	mutex_lock(&pva->ccq_mutex);
+
+	for (i = 0; i < count; i++, room--) {
+		if (room == 0) {
+			room = pva_ccq_wait(pva, 100);
+			if (room < 0) {
+				err = room;
+				goto err_wait_ccq;
+			}
+		}
+
+		host1x_writel(pva->pdev, cfg_ccq_r(), (u32)(cmds[i] >> 32));
+		host1x_writel(pva->pdev, cfg_ccq_r(),
+			      (u32)(cmds[i] & 0xffffffff));
+	}
+
+	mutex_unlock(&pva->ccq_mutex);
+	*sent = count;
+
+	return 0;
 
 err_wait_ccq:
 	mutex_unlock(&pva->ccq_mutex);
+	*sent = i;
 	pva_abort(pva);
 
 	return err;
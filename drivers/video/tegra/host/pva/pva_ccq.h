@@ -26,5 +26,7 @@
 struct platform_device;
 
 int pva_ccq_send(struct pva *pva, u64 cmd);
+int pva_ccq_send_batch(struct pva *pva, const u64 *cmds, u32 count,
+		       u32 *sent);
 
 #endif
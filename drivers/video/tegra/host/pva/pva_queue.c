@@ -210,76 +210,53 @@ static void pva_task_get_memsize(size_t *dma_size, size_t *kmem_size)
 
 static void pva_task_unpin_mem(struct pva_submit_task *task)
 {
-	int i;
-	int j;
+	u32 i;
 
-#define UNPIN_MEMORY(dst_name)						\
-	do {								\
-		if ((((dst_name).dmabuf) != NULL) &&			\
-				((dst_name).dma_addr != 0)) {		\
-			nvhost_buffer_submit_unpin(task->buffers,	\
-				&((dst_name).dmabuf), 1);		\
-			dma_buf_put((dst_name).dmabuf);			\
-		}							\
-	} while (0)
+	if (task->pinned)
+		nvhost_buffer_submit_unpin(task->buffers, task->pin_dmabufs,
+					   task->num_pin_bufs);
 
-	for (i = 0; i < task->num_input_surfaces; i++) {
-		UNPIN_MEMORY(task->input_surfaces_ext[i]);
-		UNPIN_MEMORY(task->input_surface_rois_ext[i]);
-	}
-
-
-	for (i = 0; i < task->num_output_surfaces; i++) {
-		UNPIN_MEMORY(task->output_surfaces_ext[i]);
-		UNPIN_MEMORY(task->output_surface_rois_ext[i]);
-	}
+	for (i = 0; i < task->num_pin_bufs; i++)
+		dma_buf_put(task->pin_dmabufs[i]);
 
-	for (i = 0; i < task->num_prefences; i++) {
-		if ((task->prefences[i].type == NVDEV_FENCE_TYPE_SEMAPHORE)
-			&& task->prefences[i].semaphore_handle)
-			UNPIN_MEMORY(task->prefences_sema_ext[i]);
-	}
-
-	for (i = 0; i < PVA_MAX_FENCE_TYPES; i++) {
-		for (j = 0; j < task->num_pvafences[i]; j++) {
-			struct nvpva_fence *fence = &task->pvafences[i][j];
+	task->num_pin_bufs = 0;
+	task->num_pin_ext = 0;
+	task->pinned = false;
+}
 
-			if ((fence->fence.type == NVDEV_FENCE_TYPE_SEMAPHORE)
-			    && fence->fence.semaphore_handle) {
-				UNPIN_MEMORY(task->pvafences_sema_ext[i][j]);
-			}
-		}
-		for (j = 0; j < task->num_pva_ts_buffers[i]; j++) {
-			struct nvpva_fence *fence = &task->pvafences[i][j];
+/*
+ * Add a buffer to the task pin list. A handle that the task uses several
+ * times, e.g. for a surface and its ROI, is only looked up once.
+ */
+static int pva_task_add_pin(struct pva_submit_task *task,
+			    struct pva_parameter_ext *ext, u32 fd)
+{
+	struct dma_buf *dmabuf;
+	u32 i;
 
-			if (fence->ts_buf_ptr.handle) {
-				UNPIN_MEMORY(task->pva_ts_buffers_ext[i][j]);
-			}
-		}
-	}
+	if (!fd)
+		return -EFAULT;
 
-	for (i = 0; i < task->num_input_task_status; i++) {
-		if (task->input_task_status[i].handle) {
-			UNPIN_MEMORY(task->input_task_status_ext[i]);
-		}
-	}
+	for (i = 0; i < task->num_pin_bufs; i++)
+		if (task->pin_fds[i] == fd)
+			break;
 
-	for (i = 0; i < task->num_output_task_status; i++) {
-		if (task->output_task_status[i].handle) {
-			UNPIN_MEMORY(task->output_task_status_ext[i]);
-		}
-	}
+	if (i == task->num_pin_bufs) {
+		dmabuf = dma_buf_get(fd);
+		if (IS_ERR_OR_NULL(dmabuf))
+			return -EFAULT;
 
-	for (i = 0; i < task->num_pointers; i++) {
-		if (task->pointers[i].handle) {
-			UNPIN_MEMORY(task->pointers_ext[i]);
-		}
+		task->pin_fds[i] = fd;
+		task->pin_dmabufs[i] = dmabuf;
+		task->num_pin_bufs++;
 	}
 
-	UNPIN_MEMORY(task->input_scalars_ext);
-	UNPIN_MEMORY(task->output_scalars_ext);
+	ext->dmabuf = task->pin_dmabufs[i];
+	task->pin_ext[task->num_pin_ext] = ext;
+	task->pin_index[task->num_pin_ext] = i;
+	task->num_pin_ext++;
 
-#undef UNPIN_MEMORY
+	return 0;
 }
 
 static int pva_task_pin_mem(struct pva_submit_task *task)
@@ -292,23 +269,7 @@ static int pva_task_pin_mem(struct pva_submit_task *task)
 
 #define PIN_MEMORY(dst_name, dmabuf_fd)					\
 	do {								\
-		if (!(dmabuf_fd)) {					\
-			err = -EFAULT;					\
-			goto err_map_handle;				\
-		}							\
-									\
-		((dst_name).dmabuf) = dma_buf_get(dmabuf_fd);		\
-		if (IS_ERR_OR_NULL((dst_name).dmabuf)) {		\
-			(dst_name).dmabuf = NULL;			\
-			err = -EFAULT;					\
-			goto err_map_handle;				\
-		}							\
-									\
-		err = nvhost_buffer_submit_pin(task->buffers,		\
-				&(dst_name).dmabuf, 1,			\
-				&(dst_name).dma_addr,			\
-				&(dst_name).size,			\
-				&(dst_name).heap);			\
+		err = pva_task_add_pin(task, &(dst_name), dmabuf_fd);	\
 		if (err < 0)						\
 			goto err_map_handle;				\
 	} while (0)
@@ -430,6 +391,24 @@ static int pva_task_pin_mem(struct pva_submit_task *task)
 
 #undef PIN_MEMORY
 
+	/* Look up all the mappings under one lock of the buffer list */
+	err = nvhost_buffer_submit_pin(task->buffers, task->pin_dmabufs,
+				       task->num_pin_bufs, task->pin_addrs,
+				       task->pin_sizes, task->pin_heaps);
+	if (err < 0)
+		goto err_map_handle;
+
+	task->pinned = true;
+
+	for (i = 0; i < task->num_pin_ext; i++) {
+		struct pva_parameter_ext *ext = task->pin_ext[i];
+		u16 index = task->pin_index[i];
+
+		ext->dma_addr = task->pin_addrs[index];
+		ext->size = task->pin_sizes[index];
+		ext->heap = task->pin_heaps[index];
+	}
+
 	return 0;
 
 err_map_handle:
@@ -1584,6 +1563,47 @@ err_submit:
 	return err;
 }
 
+/*
+ * Account a task that the engine has accepted and link it to the queue.
+ * The caller registers the completion notifier afterwards.
+ */
+static void pva_task_submit_done(struct pva_submit_task *task, u32 thresh,
+				 u64 timestamp)
+{
+	struct nvhost_queue *queue = task->queue;
+
+	/* Record task prefences */
+	nvhost_eventlib_log_fences(task->pva->pdev,
+				   queue->syncpt_id,
+				   thresh,
+				   task->prefences,
+				   task->num_prefences,
+				   NVDEV_FENCE_KIND_PRE,
+				   timestamp);
+
+	nvhost_eventlib_log_submit(task->pva->pdev,
+				   queue->syncpt_id,
+				   thresh,
+				   timestamp);
+
+	task->syncpt_thresh = thresh;
+
+	nvhost_dbg_info("Postfence id=%u, value=%u",
+			queue->syncpt_id, thresh);
+
+	/* Going to be linked so obtain the reference */
+	kref_get(&task->ref);
+
+	/*
+	 * Tasks in the queue list can be modified by the interrupt handler.
+	 * Adding the task into the list must be the last step before
+	 * registering the interrupt handler.
+	 */
+	mutex_lock(&queue->list_lock);
+	list_add_tail(&task->node, &queue->tasklist);
+	mutex_unlock(&queue->list_lock);
+}
+
 static int pva_task_submit(struct pva_submit_task *task,
 			   u32 *task_thresh)
 {
@@ -1631,39 +1651,10 @@ static int pva_task_submit(struct pva_submit_task *task,
 	if (err < 0)
 		goto err_submit;
 
-	/* Record task prefences */
-	nvhost_eventlib_log_fences(task->pva->pdev,
-				   queue->syncpt_id,
-				   thresh,
-				   task->prefences,
-				   task->num_prefences,
-				   NVDEV_FENCE_KIND_PRE,
-				   timestamp);
-
-	nvhost_eventlib_log_submit(task->pva->pdev,
-				   queue->syncpt_id,
-				   thresh,
-				   timestamp);
-
-	task->syncpt_thresh = thresh;
-
-	nvhost_dbg_info("Postfence id=%u, value=%u",
-			queue->syncpt_id, thresh);
+	pva_task_submit_done(task, thresh, timestamp);
 
 	*task_thresh = thresh;
 
-	/* Going to be linked so obtain the reference */
-	kref_get(&task->ref);
-
-	/*
-	 * Tasks in the queue list can be modified by the interrupt handler.
-	 * Adding the task into the list must be the last step before
-	 * registering the interrupt handler.
-	 */
-	mutex_lock(&queue->list_lock);
-	list_add_tail(&task->node, &queue->tasklist);
-	mutex_unlock(&queue->list_lock);
-
 	/*
 	 * Register the interrupt handler. This must be done after adding
 	 * the tasks into the queue since otherwise we may miss the completion
@@ -1682,12 +1673,124 @@ err_module_busy:
 	return err;
 }
 
+/*
+ * Submit all the tasks of a request with a single CCQ push.
+ *
+ * pva_task_write() derives GoS values from the current syncpoint max, so
+ * each task is written right after the thresholds of the previous ones
+ * have been reserved. A single completion notifier at the last threshold
+ * covers the whole batch since pva_queue_update() reaps every expired
+ * task of the queue.
+ *
+ * Failing to pin a task fails the request before anything reaches the
+ * engine. If the CCQ times out, PVA is aborted and the tasks that were
+ * already pushed stay linked so that the abort handler cleans them up.
+ */
+static int pva_queue_submit_batch(struct nvhost_queue *queue,
+				  struct pva_submit_tasks *task_header)
+{
+	struct pva *pva = task_header->tasks[0]->pva;
+	struct platform_device *host1x_pdev =
+			to_platform_device(pva->pdev->dev.parent);
+	u64 fifo_cmds[PVA_MAX_TASKS];
+	struct pva_submit_task *task;
+	u32 num_tasks = task_header->num_tasks;
+	u32 old_maxval;
+	u32 sent = 0;
+	u64 timestamp;
+	int err = 0;
+	u32 i;
+
+	for (i = 0; i < num_tasks; i++) {
+		task = task_header->tasks[i];
+		task->fence_num = 0;
+
+		/* First, dump the task that we are submitting */
+		pva_task_dump(task);
+
+		/* Pin job memory */
+		err = pva_task_pin_mem(task);
+		if (err < 0)
+			goto err_prepare;
+
+		/*
+		 * Get a reference of the queue and turn on the hardware,
+		 * both are dropped when the task completes
+		 */
+		nvhost_queue_get(queue);
+		err = nvhost_module_busy(pva->pdev);
+		if (err < 0) {
+			nvhost_queue_put(queue);
+			pva_task_unpin_mem(task);
+			goto err_prepare;
+		}
+	}
+
+	old_maxval = nvhost_syncpt_read_maxval(host1x_pdev, queue->syncpt_id);
+
+	for (i = 0; i < num_tasks; i++) {
+		task = task_header->tasks[i];
+
+		pva_task_write(task, false);
+
+		nvhost_dbg_info("Submitting task %p (0x%llx)", task,
+				(u64)task->dma_addr);
+
+		task_header->task_thresh[i] =
+			nvhost_syncpt_incr_max_ext(host1x_pdev,
+						   queue->syncpt_id,
+						   task->fence_num);
+		fifo_cmds[i] = pva_fifo_submit(queue->id, task->dma_addr,
+					       PVA_FIFO_INT_ON_ERR);
+	}
+
+	timestamp = arch_counter_get_cntvct();
+
+	err = pva_ccq_send_batch(pva, fifo_cmds, num_tasks, &sent);
+	if (err < 0) {
+		nvhost_warn(&pva->pdev->dev,
+			    "Failed to submit tasks %u..%u: %d",
+			    sent, num_tasks - 1, err);
+		nvhost_syncpt_set_maxval(host1x_pdev, queue->syncpt_id,
+				sent ? task_header->task_thresh[sent - 1] :
+				old_maxval);
+	}
+
+	for (i = 0; i < sent; i++)
+		pva_task_submit_done(task_header->tasks[i],
+				     task_header->task_thresh[i], timestamp);
+
+	if (sent)
+		WARN_ON(nvhost_intr_register_notifier(host1x_pdev,
+				queue->syncpt_id,
+				task_header->task_thresh[sent - 1],
+				pva_queue_update, queue));
+
+	i = num_tasks;
+
+err_prepare:
+	/* Release the tasks that did not reach the engine */
+	while (i-- > sent) {
+		task = task_header->tasks[i];
+
+		pva_task_unpin_mem(task);
+		nvhost_module_idle(pva->pdev);
+		nvhost_queue_put(queue);
+	}
+
+	return err;
+}
+
 static int pva_queue_submit(struct nvhost_queue *queue, void *args)
 {
 	struct pva_submit_tasks *task_header = args;
 	int err = 0;
 	int i;
 
+	if (task_header->num_tasks > 1 &&
+	    task_header->tasks[0]->pva->submit_mode == PVA_SUBMIT_MODE_MMIO_CCQ)
+		return pva_queue_submit_batch(queue, task_header);
+
 	for (i = 0; i < task_header->num_tasks; i++) {
 		struct pva_submit_task *task = task_header->tasks[i];
 		u32 *thresh = &task_header->task_thresh[i];
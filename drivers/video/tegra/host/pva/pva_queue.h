@@ -38,6 +38,16 @@ struct pva_parameter_ext {
 	enum nvhost_buffers_heap heap;
 };
 
+/* Upper bound of the buffers a task can reference */
+#define PVA_MAX_PIN_BUFFERS (2 * PVA_MAX_INPUT_SURFACES +		\
+			     2 * PVA_MAX_OUTPUT_SURFACES +		\
+			     PVA_MAX_PREFENCES +			\
+			     2 * PVA_MAX_FENCE_TYPES *			\
+				PVA_MAX_FENCES_PER_TYPE +		\
+			     PVA_MAX_INPUT_STATUS +			\
+			     PVA_MAX_OUTPUT_STATUS +			\
+			     PVA_MAX_POINTERS + 2)
+
 /**
  * @brief	Describe a task for PVA
  *
@@ -70,6 +80,17 @@ struct pva_parameter_ext {
  * output_scalars		Information for output scalars
  * input_task_status		Input status structure
  * output_task_status		Output status structure
+ * pin_fds			Distinct buffer handles used by the task
+ * pin_dmabufs			dma_bufs of pin_fds
+ * pin_addrs			Addresses of pin_dmabufs
+ * pin_sizes			Sizes of pin_dmabufs
+ * pin_heaps			Heaps of pin_dmabufs
+ * num_pin_bufs			Number of entries in pin_fds and pin_dmabufs
+ * pin_ext			Parameters to fill in once the buffers are
+ *				pinned...
+ * pin_index			...and the pin_dmabufs entry of each one
+ * num_pin_ext			Number of entries in pin_ext and pin_index
+ * pinned			pin_dmabufs hold a submit pin
  *
  */
 struct pva_submit_task {
@@ -136,6 +157,18 @@ struct pva_submit_task {
 	struct pva_parameter_ext pointers_ext[PVA_MAX_POINTERS];
 	struct pva_parameter_ext pva_ts_buffers_ext[PVA_MAX_FENCE_TYPES]
 		[PVA_MAX_FENCES_PER_TYPE];
+
+	/* Buffers pinned for the task, see pva_task_pin_mem() */
+	u32 pin_fds[PVA_MAX_PIN_BUFFERS];
+	struct dma_buf *pin_dmabufs[PVA_MAX_PIN_BUFFERS];
+	dma_addr_t pin_addrs[PVA_MAX_PIN_BUFFERS];
+	size_t pin_sizes[PVA_MAX_PIN_BUFFERS];
+	enum nvhost_buffers_heap pin_heaps[PVA_MAX_PIN_BUFFERS];
+	u32 num_pin_bufs;
+	struct pva_parameter_ext *pin_ext[PVA_MAX_PIN_BUFFERS];
+	u16 pin_index[PVA_MAX_PIN_BUFFERS];
+	u32 num_pin_ext;
+	bool pinned;
 };
 
 struct pva_submit_tasks {
@@ -53,6 +53,29 @@ enum nvdev_fence_kind;
 struct nvdev_fence;
 struct sync_pt;
 
+/*
+ * Work queued on an engine's channel but not yet completed. nvhost scaling
+ * registers it with the pod governor for the scaled device, so that the
+ * governor can react to a burst before it shows up as busy time.
+ */
+struct nvhost_queue_hint {
+	atomic_t jobs;		/* jobs in the cdma sync queue */
+	atomic_t words;		/* gather words of those jobs */
+};
+
+#if IS_REACHABLE(CONFIG_DEVFREQ_GOV_POD_SCALING)
+int nvhost_podgov_add_queue_hint(struct device *dev,
+				 struct nvhost_queue_hint *hint);
+void nvhost_podgov_remove_queue_hint(struct device *dev);
+#else
+static inline int nvhost_podgov_add_queue_hint(struct device *dev,
+					       struct nvhost_queue_hint *hint)
+{
+	return 0;
+}
+static inline void nvhost_podgov_remove_queue_hint(struct device *dev) { }
+#endif
+
 #define NVHOST_MODULE_MAX_CLOCKS		8
 #define NVHOST_MODULE_MAX_SYNCPTS		16
 #define NVHOST_MODULE_MAX_WAITBASES		3
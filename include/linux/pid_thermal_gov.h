@@ -32,6 +32,13 @@ struct pid_thermal_gov_params {
 
 	unsigned long up_compensation;
 	unsigned long down_compensation;
+
+	/*
+	 * Share one throttling budget between all cooling devices of a trip,
+	 * instead of driving each one from the same error. Devices with a
+	 * lower contribution (weight) are throttled first.
+	 */
+	bool budget;
 };
 
 #endif
@@ -67,6 +67,7 @@ enum actmon_state {
 };
 struct actmon_dev;
 struct actmon_drv_data;
+struct actmon_telem_src;
 struct dev_reg_ops {
 	void (*set_init_avg)(u32 value, void __iomem *base);
 	void (*set_avg_up_wm)(u32 value, void __iomem *base);
@@ -139,6 +140,7 @@ struct actmon_dev {
 	spinlock_t lock;
 	struct notifier_block rate_change_nb;
 	struct kobj_attribute avgact_attr;
+	struct actmon_telem_src *telem;
 };
 
 struct actmon_reg_ops {
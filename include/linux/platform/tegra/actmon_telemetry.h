@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020, NVIDIA Corporation. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef ACTMON_TELEMETRY_H
+#define ACTMON_TELEMETRY_H
+
+#include <linux/types.h>
+
+struct actmon_telem_src;
+
+/*
+ * sample() is called from a kthread at the telemetry sampling rate and
+ * returns the current load in 1/10 of %. It may sleep, but must not wake
+ * up the monitored unit just to read it.
+ */
+typedef u32 (*actmon_telem_sample_t)(void *data);
+
+#if defined(CONFIG_TEGRA_ACTMON_TELEMETRY)
+struct actmon_telem_src *tegra_actmon_telem_add(const char *name,
+		actmon_telem_sample_t sample, void *data);
+void tegra_actmon_telem_remove(struct actmon_telem_src *src);
+#else
+static inline struct actmon_telem_src *tegra_actmon_telem_add(
+		const char *name, actmon_telem_sample_t sample, void *data)
+{
+	return NULL;
+}
+
+static inline void tegra_actmon_telem_remove(struct actmon_telem_src *src)
+{
+}
+#endif
+#endif /* ACTMON_TELEMETRY_H */
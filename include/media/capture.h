@@ -30,6 +30,14 @@
 
 struct tegra_vi_channel;
 
+/**
+ * vi_capture_status_cb - capture status indication handler
+ *
+ * Called from the capture IVC worker for each CAPTURE_STATUS_IND, after
+ * the request descriptor has been synced for the CPU.
+ */
+typedef void (*vi_capture_status_cb)(void *priv, uint32_t buffer_index);
+
 struct vi_capture {
 	uint16_t channel_id;
 	struct device *rtcpu_dev;
@@ -65,6 +73,9 @@ struct vi_capture {
 	struct capture_common_unpins **unpins_list;
 
 	uint64_t vi_channel_mask;
+
+	vi_capture_status_cb status_cb;
+	void *status_cb_priv;
 };
 
 struct vi_capture_setup {
@@ -145,6 +156,8 @@ int vi_capture_request(struct tegra_vi_channel *chan,
 		struct vi_capture_req *req);
 int vi_capture_status(struct tegra_vi_channel *chan,
 		int32_t timeout_ms);
+int vi_capture_set_status_callback(struct tegra_vi_channel *chan,
+		vi_capture_status_cb status_cb, void *priv);
 int vi_capture_set_compand(struct tegra_vi_channel *chan,
 		struct vi_capture_compand *compand);
 long vi_capture_ioctl(struct file *file, void *fh,
@@ -109,6 +109,22 @@ struct tegra_vi_graph_entity {
 	struct v4l2_subdev *subdev;
 };
 
+/**
+ * struct tegra_channel_latency - sensor SOF to buffer done latency
+ * @frames: number of frames accounted
+ * @last_ns: latency of the most recent frame
+ * @min_ns: smallest latency seen since streaming started
+ * @max_ns: largest latency seen since streaming started
+ * @total_ns: sum of all latencies, for averaging
+ */
+struct tegra_channel_latency {
+	u64 frames;
+	u64 last_ns;
+	u64 min_ns;
+	u64 max_ns;
+	u64 total_ns;
+};
+
 /**
  * struct tegra_channel - Tegra video channel
  * @list: list entry in a composite device dmas list
@@ -205,6 +221,10 @@ struct tegra_channel {
 	spinlock_t dequeue_lock;
 	struct work_struct status_work;
 	struct work_struct error_work;
+	struct delayed_work capture_timeout_work;
+	struct mutex capture_submit_lock;
+	bool capture_submit_enabled;
+	struct tegra_channel_latency capture_latency;
 
 	void __iomem *csibase[TEGRA_CSI_BLOCKS];
 	unsigned int stride_align;
@@ -414,6 +434,7 @@ struct tegra_vi_fops {
 			bool use_prio, unsigned int cmd, void *arg);
 	int (*vi_mfi_work)(struct tegra_mc_vi *vi, int port);
 	void (*vi_stride_align)(unsigned int *bpl);
+	void (*vi_buffer_queued)(struct tegra_channel *chan);
 };
 
 struct tegra_csi_fops {
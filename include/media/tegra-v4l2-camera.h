@@ -54,6 +54,7 @@
 #define TEGRA_CAMERA_CID_SENSOR_DV_TIMINGS         (TEGRA_CAMERA_CID_BASE+108)
 #define TEGRA_CAMERA_CID_LOW_LATENCY         (TEGRA_CAMERA_CID_BASE+109)
 #define TEGRA_CAMERA_CID_VI_PREFERRED_STRIDE (TEGRA_CAMERA_CID_BASE+110)
+#define TEGRA_CAMERA_CID_VI_CAPTURE_LATENCY  (TEGRA_CAMERA_CID_BASE+111)
 
 /**
  * This is temporary with the current v4l2 infrastructure
@@ -175,4 +176,17 @@ struct sensor_mode_properties {
 	(sizeof(struct sensor_blob) / sizeof(__u32))
 #define SENSOR_CTRL_BLOB_SIZE \
 	(sizeof(struct sensor_blob) / sizeof(__u32))
+
+/*
+ * Layout of TEGRA_CAMERA_CID_VI_CAPTURE_LATENCY: sensor SOF to buffer
+ * done latency in microseconds, accumulated since the last stream on.
+ */
+enum {
+	VI_CAPTURE_LATENCY_FRAMES,
+	VI_CAPTURE_LATENCY_LAST_US,
+	VI_CAPTURE_LATENCY_MIN_US,
+	VI_CAPTURE_LATENCY_MAX_US,
+	VI_CAPTURE_LATENCY_AVG_US,
+	VI_CAPTURE_LATENCY_CID_SIZE,
+};
 #endif /* __TEGRA_V4L2_CAMERA__ */
@@ -175,6 +175,33 @@ TRACE_EVENT(podgov_idle,
 	TP_printk("name=%s, idleness=%lu", dev_name(__entry->dev), __entry->idleness)
 );
 
+TRACE_EVENT(podgov_queue_boost,
+	TP_PROTO(struct device *dev, int jobs, int words,
+		unsigned long old_freq, unsigned long new_freq),
+
+	TP_ARGS(dev, jobs, words, old_freq, new_freq),
+
+	TP_STRUCT__entry(
+		__field(struct device *, dev)
+		__field(int, jobs)
+		__field(int, words)
+		__field(unsigned long, old_freq)
+		__field(unsigned long, new_freq)
+	),
+
+	TP_fast_assign(
+		__entry->dev = dev;
+		__entry->jobs = jobs;
+		__entry->words = words;
+		__entry->old_freq = old_freq;
+		__entry->new_freq = new_freq;
+	),
+
+	TP_printk("name=%s, jobs=%d, words=%d, old_freq=%lu, new_freq=%lu",
+		dev_name(__entry->dev), __entry->jobs, __entry->words,
+		__entry->old_freq, __entry->new_freq)
+);
+
 TRACE_EVENT(podgov_load,
 	TP_PROTO(struct device *dev, unsigned long load),
 
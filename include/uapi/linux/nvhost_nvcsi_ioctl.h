@@ -82,8 +82,21 @@
 #define NVCSI_PHY_NUM_BRICKS		4
 #define NVHOST_NVCSI_IOCTL_MAGIC 'N'
 
+/*
+ * Deskew setup with the link rate, which lets the driver restore the
+ * calibration result of an earlier stream of the same lanes and rate
+ * rather than calibrating again.
+ */
+struct nvhost_nvcsi_deskew_setup_args {
+	__u32 lanes;		/* lane bitmap as above */
+	__u32 reserved;
+	__u64 rate;		/* link rate in Hz, 0 if unknown */
+};
+
 #define NVHOST_NVCSI_IOCTL_DESKEW_SETUP	_IOW(NVHOST_NVCSI_IOCTL_MAGIC, 1, long)
 #define NVHOST_NVCSI_IOCTL_DESKEW_APPLY	_IOW(NVHOST_NVCSI_IOCTL_MAGIC, 2, long)
 #define NVHOST_NVCSI_IOCTL_PROD_APPLY	_IOW(NVHOST_NVCSI_IOCTL_MAGIC, 3, long)
+#define NVHOST_NVCSI_IOCTL_DESKEW_SETUP_RATE \
+	_IOW(NVHOST_NVCSI_IOCTL_MAGIC, 4, struct nvhost_nvcsi_deskew_setup_args)
 
 #endif
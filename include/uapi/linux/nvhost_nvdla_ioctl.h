@@ -75,16 +75,41 @@ struct nvdla_pin_unpin_args {
  * @flags		flags for task submit, like atomic
  * @version		version of task structure
  *
+ * With NVDLA_SUBMIT_FLAGS_SINGLE_KICK the task descriptors are chained and
+ * the engine is kicked once for the whole list instead of once per task.
+ * The flag is rejected with -EINVAL in channel submit mode.
+ *
  */
 struct nvdla_submit_args {
 	__u64 tasks;
 	__u16 num_tasks;
 #define MAX_TASKS_PER_SUBMIT		16
 #define NVDLA_SUBMIT_FLAGS_ATOMIC	(1 << 0)
+#define NVDLA_SUBMIT_FLAGS_SINGLE_KICK	(1 << 1)
 	__u16 flags;
 	__u32 version;
 };
 
+/**
+ * struct nvdla_template_args structure for task template (un)registration
+ *
+ * @task		pointer to struct nvdla_ioctl_submit_task, of which
+ *			only num_addresses and address_list are used
+ * @id			template id, returned by register, passed to
+ *			unregister
+ * @reserved		reserved for future use
+ *
+ * A template pins the address list of a task once. Tasks submitted with
+ * NVDLA_TASK_FLAGS_TEMPLATE reuse it and only pass the entries that differ,
+ * as a list of struct nvdla_mem_patch.
+ *
+ */
+struct nvdla_template_args {
+	__u64 task;
+	__u32 id;
+	__u32 reserved;
+};
+
 /**
  * struct nvdla_get_fw_ver_args strcture
  *
@@ -119,6 +144,22 @@ struct nvdla_mem_handle {
 	__u32 offset;
 };
 
+/**
+ * struct nvdla_mem_patch structure for template address list updates
+ *
+ * @index		index in the template address list to replace
+ * @handle		handle to buffer allocated in userspace
+ * @offset		offset in buffer
+ * @reserved		reserved for future use
+ *
+ */
+struct nvdla_mem_patch {
+	__u32 index;
+	__u32 handle;
+	__u32 offset;
+	__u32 reserved;
+};
+
 /**
  * struct nvdla_ioctl_submit_task structure for single task information
  *
@@ -130,7 +171,7 @@ struct nvdla_mem_handle {
  * @num_sof_timestamps   	number of sof timestamp
  * @num_eof_timestamps   	number of eof timestamp
  * @flags			flags for bitwise task info embeddeing
- * @reserved			reserved for future use
+ * @template_id			template launched with NVDLA_TASK_FLAGS_TEMPLATE
  * @prefences			pointer to pre-fence struct table
  * @postfences			pointer to post-fence struct table
  * @input_task_status		pointer to input task status struct table
@@ -139,7 +180,9 @@ struct nvdla_mem_handle {
  * @sof_timestamps   		pointer to sof timestamp handle list
  * @eof_timestamps   		pointer to eof timestamp handle list
  * @num_addresses		total number of addressed passed in structure
- * @address_list		pointer to address list
+ * @address_list		pointer to address list, or to a list of
+ *				struct nvdla_mem_patch with
+ *				NVDLA_TASK_FLAGS_TEMPLATE
  * @timeout			task timeout
  *
  */
@@ -154,8 +197,9 @@ struct nvdla_ioctl_submit_task {
 	__u8 reserved0[1];
 #define NVDLA_MAX_BUFFERS_PER_TASK (6144)
 	__u32 num_addresses;
+#define NVDLA_TASK_FLAGS_TEMPLATE	(1 << 0)
 	__u16 flags;
-	__u16 reserved1;
+	__u16 template_id;
 
 	__u64 prefences;
 	__u64 postfences;
@@ -239,8 +283,12 @@ struct nvdla_status_notify {
 	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 7, struct nvdla_get_q_status_args)
 #define NVDLA_IOCTL_EMU_TASK_SUBMIT \
 	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 8, struct nvdla_submit_args)
+#define NVDLA_IOCTL_REGISTER_TEMPLATE \
+	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 9, struct nvdla_template_args)
+#define NVDLA_IOCTL_UNREGISTER_TEMPLATE \
+	_IOW(NVHOST_NVDLA_IOCTL_MAGIC, 10, struct nvdla_template_args)
 #define NVDLA_IOCTL_LAST		\
-		_IOC_NR(NVDLA_IOCTL_EMU_TASK_SUBMIT)
+		_IOC_NR(NVDLA_IOCTL_UNREGISTER_TEMPLATE)
 
 #define NVDLA_IOCTL_MAX_ARG_SIZE  \
 		sizeof(struct nvdla_pin_unpin_args)
@@ -200,7 +200,7 @@ struct nvpva_fence {
 	 struct nvdev_fence fence;
 };
 
-#define PVA_MAX_TASKS			1
+#define PVA_MAX_TASKS			8
 #define PVA_MAX_PREFENCES		8
 #define PVA_MAX_POSTFENCES		8
 #define PVA_MAX_FENCE_TYPES		7
@@ -267,11 +267,13 @@ struct pva_ioctl_submit_task {
  *
  * @tasks: Pointer to a list of tasks structures
  * @flags: Flags for the given tasks
- * @num_tasks: Number of tasks in the list
+ * @num_tasks: Number of tasks in the list, up to PVA_MAX_TASKS
  * @version: Version of the task structure.
  *
  * This ioctl is used for submitting tasks to PVA. The given structures
- * are modified to include information about post-fences.
+ * are modified to include information about post-fences. The tasks
+ * of one call are handed to PVA with a single command queue push when
+ * the submit mode allows it.
  *
  */
 struct pva_ioctl_submit_args {
@@ -0,0 +1,67 @@
+/*
+ * tegra_actmon_telemetry.h
+ *
+ * Layout of the activity monitor telemetry page exported by
+ * /dev/actmon_telemetry
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef __TEGRA_ACTMON_TELEMETRY_H
+#define __TEGRA_ACTMON_TELEMETRY_H
+
+#include <linux/types.h>
+
+/*
+ * The device is mapped read-only, one page at offset 0. Sampling runs only
+ * while at least one file descriptor is open.
+ *
+ * The page starts with struct actmon_telem_header, followed by
+ * nr_slots entries of struct actmon_telem_source, src_size bytes apart.
+ * Unused slots have an empty name. Each slot is updated under its own
+ * sequence counter: a reader copies the slot when seq is even and retries
+ * if seq changed meanwhile.
+ *
+ * Loads are in 1/10 of % of the monitored unit's current capacity.
+ */
+
+#define ACTMON_TELEM_MAGIC		0x4d544341	/* "ACTM" */
+#define ACTMON_TELEM_VERSION		1
+
+#define ACTMON_TELEM_NAME_LEN		16
+#define ACTMON_TELEM_HIST_BUCKETS	16
+#define ACTMON_TELEM_LOAD_MAX		1000
+
+struct actmon_telem_header {
+	__u32 magic;
+	__u32 version;
+	__u32 hdr_size;
+	__u32 src_size;
+	__u32 nr_slots;
+	__u32 period_us;	/* sampling period */
+	__u32 generation;	/* bumped when a source is added/removed */
+	__u32 reserved[9];
+};
+
+struct actmon_telem_source {
+	__u32 seq;
+	char name[ACTMON_TELEM_NAME_LEN];
+	__u32 load;		/* last sample */
+	__u32 load_avg;		/* moving average, 1/8 weight per sample */
+	__u32 load_max;		/* highest sample since the slot was added */
+	__u64 samples;
+	__u64 timestamp_ns;	/* CLOCK_MONOTONIC time of the last sample */
+	/* bucket i counts samples in [i, i + 1) * LOAD_MAX / HIST_BUCKETS */
+	__u32 hist[ACTMON_TELEM_HIST_BUCKETS];
+};
+
+#endif
@@ -20,8 +20,8 @@
 #include <linux/ioctl.h>
 #include <linux/types.h>
 
-#define QUADD_SAMPLES_VERSION	48
-#define QUADD_IO_VERSION	28
+#define QUADD_SAMPLES_VERSION	50
+#define QUADD_IO_VERSION	30
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -47,6 +47,8 @@
 #define QUADD_IO_VERSION_EXTABLES_PID		26
 #define QUADD_IO_VERSION_SAMPLING_CNTRL		27
 #define QUADD_IO_VERSION_UNCORE_EVENTS		28
+#define QUADD_IO_VERSION_PACKED_CALLCHAIN	29
+#define QUADD_IO_VERSION_CALLCHAIN_REF		30
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG	17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES	18
@@ -78,8 +80,10 @@
 #define QUADD_SAMPLE_VERSION_PCLK_SEND_CHANGES	46
 #define QUADD_SAMPLE_VERSION_COMM_SAMPLES	47
 #define QUADD_SAMPLE_VERSION_UNCORE_EVENTS	48
+#define QUADD_SAMPLE_VERSION_PACKED_CALLCHAIN	49
+#define QUADD_SAMPLE_VERSION_CALLCHAIN_REF	50
 
-#define QUADD_MMAP_HEADER_VERSION	1
+#define QUADD_MMAP_HEADER_VERSION	2
 
 #define QUADD_MAX_COUNTERS	32
 #define QUADD_MAX_PROCESS	64
@@ -252,6 +256,23 @@ enum {
 #define QUADD_SAMPLE_FLAG_URCS		(1 << 7)
 #define QUADD_SAMPLE_FLAG_IP64		(1 << 8)
 #define QUADD_SAMPLE_FLAG_UNCORE	(1 << 9)
+#define QUADD_SAMPLE_FLAG_CC_PACKED	(1 << 10)
+#define QUADD_SAMPLE_FLAG_CC_DEF	(1 << 11)
+#define QUADD_SAMPLE_FLAG_CC_REF	(1 << 12)
+
+/*
+ * QUADD_SAMPLE_FLAG_CC_PACKED: the callchain ips are not stored as an
+ * array of 32/64-bit values. Instead the sample carries a __u32 byte
+ * count followed by that many bytes of LEB128 varints, padded with
+ * zeroes to a multiple of 4 bytes. Each varint is the zigzag-encoded
+ * difference between an ip and the previous one (the first ip is
+ * relative to 0). callchain_nr and the unwind types are unchanged.
+ *
+ * QUADD_SAMPLE_FLAG_CC_DEF: the unwind types are followed by a __u32
+ * stack id. Later samples in the same ring buffer with the same stack
+ * have QUADD_SAMPLE_FLAG_CC_REF set and carry only this __u32 id in
+ * place of the ips and the unwind types; callchain_nr is still set.
+ */
 
 struct quadd_sample_data {
 	__u64 ip;
@@ -466,6 +487,8 @@ enum {
 #define QUADD_PARAM_EXTRA_TRACE_TREE		(1 << 14)
 #define QUADD_PARAM_EXTRA_SAMPLING_TIMER	(1 << 15)
 #define QUADD_PARAM_EXTRA_SAMPLING_SCHED_OUT	(1 << 16)
+#define QUADD_PARAM_EXTRA_PACKED_CALLCHAIN	(1 << 17)
+#define QUADD_PARAM_EXTRA_CALLCHAIN_REF		(1 << 18)
 
 enum {
 	QUADD_EVENT_TYPE_RAW			= 0,
@@ -547,6 +570,8 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_CPU_MASK		(1 << 10)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR	(1 << 11)
 #define QUADD_COMM_CAP_EXTRA_CPUFREQ		(1 << 12)
+#define QUADD_COMM_CAP_EXTRA_PACKED_CALLCHAIN	(1 << 13)
+#define QUADD_COMM_CAP_EXTRA_CALLCHAIN_REF	(1 << 14)
 
 struct quadd_comm_cap {
 	__u32	pmu:1,
@@ -668,8 +693,9 @@ struct quadd_ring_buffer_hdr {
 
 	__u32 max_fill_count;
 	__u32 skipped_samples;
+	__u32 skipped_bytes;
 
-	__u32 reserved[4];	/* reserved fields for future extensions */
+	__u32 reserved[3];	/* reserved fields for future extensions */
 } __aligned(8);
 
 #pragma pack(pop)
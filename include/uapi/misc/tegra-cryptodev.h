@@ -188,6 +188,34 @@ struct tegra_crypt_req_32 {
 		_IOWR(0x98, 121, struct tegra_crypt_req_32)
 #endif
 
+#define TEGRA_CRYPTO_MAX_BATCH_REQS	256
+
+/* a pointer to this struct needs to be passed to:
+ * TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ
+ *
+ * reqs points to an array of nreqs independent AES requests. The
+ * completion status of reqs[i] (0 or a negative errno) is written to
+ * status[i]; a failing request does not stop the rest of the batch.
+ */
+struct tegra_crypt_batch_req {
+	struct tegra_crypt_req *reqs;
+	int *status;
+	unsigned int nreqs;
+};
+#define TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ	\
+		_IOWR(0x98, 111, struct tegra_crypt_batch_req)
+
+#ifdef CONFIG_COMPAT
+/* reqs points to an array of struct tegra_crypt_req_32 */
+struct tegra_crypt_batch_req_32 {
+	__u32 reqs;
+	__u32 status;
+	unsigned int nreqs;
+};
+#define TEGRA_CRYPTO_IOCTL_PROCESS_BATCH_REQ_32	\
+		_IOWR(0x98, 126, struct tegra_crypt_batch_req_32)
+#endif
+
 /* pointer to this struct should be passed to:
  * TEGRA_CRYPTO_IOCTL_SET_SEED
  * TEGRA_CRYPTO_IOCTL_GET_RANDOM
@@ -173,6 +173,11 @@
 /*Passthrough condition for running 4K HDMI*/
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_YUVBYPASS	(1 << 0)
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_VRR_MODE	(1 << 1)
+/*
+ * Replace the previous flip on the same windows if it has not been
+ * programmed yet, instead of queueing behind it.
+ */
+#define TEGRA_DC_EXT_FLIP_HEAD_FLAG_LATE_LATCH	(1 << 2)
 /* Flag for HDR_DATA handling */
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_ENABLE	(1 << 0)
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_DATA_UPDATED (1 << 1)
@@ -1380,6 +1385,25 @@ struct tegra_dc_ext_scanline_info {
 #define TEGRA_DC_EXT_CRC_GET \
 	_IOWR('D', 0x28, struct tegra_dc_ext_crc_arg)
 
+/* Open a per-frame CRC stream. The kernel returns a file descriptor in
+ * arg.fd that can be mmap()ed read-only (arg.size bytes from offset 0) and
+ * poll()ed. On every frame end interrupt the CRCs enabled through
+ * TEGRA_DC_EXT_CRC_ENABLE are appended to the ring described by struct
+ * tegra_dc_ext_crc_stream_header, whether or not a flip was latched in that
+ * frame, so no frames are missed and no IOCTL is needed per frame. Closing
+ * the file descriptor stops the stream. Only one stream per head can be
+ * open at a time.
+ *
+ * Returns
+ * -EINVAL   if arg.magic is wrongly programmed or arg.reserved is not 0
+ * -ENODEV   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE
+ * -EPERM    Same conditions as mentioned for TEGRA_DC_EXT_CRC_DISABLE
+ * -EBUSY    if a stream is already open on this head
+ * -ENOMEM   if the ring could not be allocated
+ */
+#define TEGRA_DC_EXT_CRC_STREAM \
+	_IOWR('D', 0x29, struct tegra_dc_ext_crc_stream_arg)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -1667,6 +1691,86 @@ struct tegra_dc_ext_crc_arg {
 	__u8 reserved[32]; /* unused - must be 0 */
 } __attribute__((__packed__));
 
+#define TEGRA_DC_EXT_CRC_STREAM_MAGIC		0x53435243 /* 'CRCS' */
+#define TEGRA_DC_EXT_CRC_STREAM_VERSION		1
+#define TEGRA_DC_EXT_CRC_STREAM_MAX_ENTRIES	4096
+
+#define TEGRA_DC_EXT_CRC_STREAM_VALID_RG	(1 << 0)
+#define TEGRA_DC_EXT_CRC_STREAM_VALID_COMP	(1 << 1)
+#define TEGRA_DC_EXT_CRC_STREAM_VALID_OR	(1 << 2)
+/* Bit (TEGRA_DC_EXT_CRC_STREAM_VALID_REGION_SHIFT + id) for region id */
+#define TEGRA_DC_EXT_CRC_STREAM_VALID_REGION_SHIFT	8
+
+/*
+ * tegra_dc_ext_crc_stream_entry - CRCs of a single frame
+ * @seq          - Index of the entry in the stream, starting at 0. It is
+ *                 written last, see tegra_dc_ext_crc_stream_header
+ * @timestamp_ns - CLOCK_MONOTONIC time of the frame end interrupt
+ * @flip_id      - ID of the most recent flip latched in this frame, as
+ *                 returned by TEGRA_DC_EXT_FLIP4, or 0 if the frame repeats
+ *                 the previous one
+ * @frame_cnt    - HW frame counter of the frame
+ * @valid        - TEGRA_DC_EXT_CRC_STREAM_VALID_* bits for the CRCs below
+ * @rg/comp/out  - RG, COMP and OR CRCs
+ * @regional     - Regional CRCs, indexed by region id
+ */
+struct tegra_dc_ext_crc_stream_entry {
+	__u64 seq;
+	__u64 timestamp_ns;
+	__u64 flip_id;
+	__u32 frame_cnt;
+	__u32 valid;
+	__u32 rg;
+	__u32 comp;
+	__u32 out;
+	__u32 regional[TEGRA_DC_EXT_MAX_REGIONS];
+};
+
+/*
+ * tegra_dc_ext_crc_stream_header - Start of the mmap()ed CRC stream
+ * @magic       - TEGRA_DC_EXT_CRC_STREAM_MAGIC
+ * @version     - TEGRA_DC_EXT_CRC_STREAM_VERSION
+ * @hdr_size    - Offset of the first entry
+ * @entry_size  - sizeof(struct tegra_dc_ext_crc_stream_entry)
+ * @num_entries - Number of entries in the ring, a power of two
+ * @head        - Number of entries written so far. Entry n lives at index
+ *                n & (num_entries - 1), so entries older than
+ *                head - num_entries have been overwritten
+ * @dropped     - Frames whose CRCs could not be read back from the HW
+ *
+ * To read entry n, read its seq, then the entry, then seq again. The entry
+ * is consistent if both reads of seq return n. poll() reports POLLIN once
+ * new entries have been written since the previous POLLIN.
+ */
+struct tegra_dc_ext_crc_stream_header {
+	__u32 magic;
+	__u32 version;
+	__u32 hdr_size;
+	__u32 entry_size;
+	__u32 num_entries;
+	__u32 reserved0;
+	__u64 head;
+	__u64 dropped;
+};
+
+/*
+ * tegra_dc_ext_crc_stream_arg - The argument to CRC_STREAM IOCTL
+ * @magic       - Magic bytes 'TCRC'
+ * @num_entries - Ring size requested, rounded up to a power of two and
+ *                limited to TEGRA_DC_EXT_CRC_STREAM_MAX_ENTRIES. 0 picks the
+ *                default of one second worth of frames at 240 Hz
+ * @fd          - Returned stream file descriptor
+ * @size        - Returned size of the mapping
+ * @reserved    - Easier way to extend the data structure
+ */
+struct tegra_dc_ext_crc_stream_arg {
+	__u8 magic[4];
+	__u32 num_entries;
+	__s32 fd;
+	__u32 size;
+	__u8 reserved[32]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
 #define TEGRA_DC_EXT_CONTROL_GET_NUM_OUTPUTS \
 	_IOR('C', 0x00, __u32)
 #define TEGRA_DC_EXT_CONTROL_GET_OUTPUT_PROPERTIES \
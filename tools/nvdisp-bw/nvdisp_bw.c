@@ -0,0 +1,312 @@
+/*
+ * nvdisp_bw - evaluate nvdisplay ISO bandwidth, EMC floor and hubclk for a
+ * set of heads and windows, using the kernel's nvdisp_bw_calc.c. The
+ * window-level model in there is only built for this tool.
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Build:
+ *	cc -O2 -I../../drivers/video/tegra/dc/nvdisp -o nvdisp_bw nvdisp_bw.c \
+ *		../../drivers/video/tegra/dc/nvdisp/nvdisp_bw_calc.c
+ *
+ * Example Usage:
+ *	nvdisp_bw [options] <config>	evaluate a configuration
+ *	nvdisp_bw -B 1000000		benchmark random configurations
+ *
+ * The configuration is read line by line, '#' starts a comment:
+ *	head <pclk kHz>
+ *	win <in_w> <in_h> <out_w> <out_h> <bpp> [out_y]
+ *	expect <iso_bw KB/s> <total_bw KB/s> <emc Hz> <hubclk Hz>
+ *
+ * Each win belongs to the last head. With expect lines the configuration
+ * becomes a regression case: the result is compared and the exit status
+ * is non-zero on mismatch. The cases in tests/ use the default parameters:
+ *	for f in tests/[a-z]*.cfg; do ./nvdisp_bw $f > /dev/null || echo $f; done
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nvdisp_bw_calc.h"
+
+#define MAX_HEADS	4
+
+struct bw_setup {
+	struct nvdisp_bw_head heads[MAX_HEADS];
+	struct nvdisp_bw_win wins[MAX_HEADS][NVDISP_BW_MAX_WINS];
+	int num_heads;
+	struct nvdisp_bandwidth_config expect;
+	int has_expect;
+};
+
+static struct nvdisp_bw_params params = {
+	.catchup_permille = 1100,
+	.dram_bytes_per_clk = 32,
+	.dram_efficiency_pct = 70,
+	.hub_pixels_per_clk = 2,
+	.hubclk_margin_pct = 10,
+};
+
+static uint32_t total_iso_bw;
+static uint64_t max_dram_hz;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] <config>\n"
+		"       %s [options] -B <count>\n"
+		"  -c <permille>  ISO bw per 1000 KB/s used (catchup) [%u]\n"
+		"  -d <bytes>     DRAM bytes per EMC clock [%u]\n"
+		"  -e <pct>       DRAM efficiency [%u]\n"
+		"  -p <pixels>    hub pixels per clock [%u]\n"
+		"  -m <pct>       hubclk margin [%u]\n"
+		"  -t <KB/s>      total ISO bw, check the result fits\n"
+		"  -x <Hz>        max EMC rate, check the result fits\n"
+		"  -B <count>     evaluate <count> random configurations\n",
+		prog, prog, params.catchup_permille,
+		params.dram_bytes_per_clk, params.dram_efficiency_pct,
+		params.hub_pixels_per_clk, params.hubclk_margin_pct);
+}
+
+static int parse_setup(FILE *f, struct bw_setup *s)
+{
+	char line[256];
+	int lineno = 0;
+
+	memset(s, 0, sizeof(*s));
+
+	while (fgets(line, sizeof(line), f)) {
+		struct nvdisp_bw_head *head;
+		struct nvdisp_bw_win *win;
+		char *p = strchr(line, '#');
+		char kw[16];
+		int n;
+
+		lineno++;
+		if (p)
+			*p = '\0';
+		if (sscanf(line, "%15s", kw) != 1)
+			continue;
+
+		if (!strcmp(kw, "head")) {
+			if (s->num_heads == MAX_HEADS)
+				goto err;
+			head = &s->heads[s->num_heads];
+			if (sscanf(line, "%*s %u", &head->pclk_khz) != 1)
+				goto err;
+			head->wins = s->wins[s->num_heads];
+			s->num_heads++;
+		} else if (!strcmp(kw, "win")) {
+			if (!s->num_heads)
+				goto err;
+			head = &s->heads[s->num_heads - 1];
+			if (head->num_wins == NVDISP_BW_MAX_WINS)
+				goto err;
+			win = &s->wins[s->num_heads - 1][head->num_wins];
+			n = sscanf(line, "%*s %u %u %u %u %u %u",
+				   &win->in_w, &win->in_h, &win->out_w,
+				   &win->out_h, &win->bpp, &win->out_y);
+			if (n < 5)
+				goto err;
+			head->num_wins++;
+		} else if (!strcmp(kw, "expect")) {
+			if (sscanf(line, "%*s %u %u %u %u",
+				   &s->expect.iso_bw, &s->expect.total_bw,
+				   &s->expect.emc_la_floor,
+				   &s->expect.hubclk) != 4)
+				goto err;
+			s->has_expect = 1;
+		} else {
+			goto err;
+		}
+	}
+
+	return 0;
+err:
+	fprintf(stderr, "config line %d: invalid\n", lineno);
+	return -EINVAL;
+}
+
+static int check_fits(const struct nvdisp_bandwidth_config *cfg)
+{
+	if (!total_iso_bw && !max_dram_hz)
+		return 0;
+
+	return nvdisp_bw_check_limits(cfg,
+			total_iso_bw ? total_iso_bw : UINT32_MAX,
+			cfg->emc_la_floor,
+			max_dram_hz ? max_dram_hz : UINT64_MAX);
+}
+
+static int evaluate(struct bw_setup *s)
+{
+	struct nvdisp_bandwidth_config cfg;
+	int ret;
+
+	ret = nvdisp_bw_calc_config(s->heads, s->num_heads, &params, &cfg);
+	if (ret) {
+		fprintf(stderr, "invalid configuration: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	printf("iso_bw       %10u KB/s\n", cfg.iso_bw);
+	printf("total_bw     %10u KB/s\n", cfg.total_bw);
+	printf("emc_la_floor %10u Hz\n", cfg.emc_la_floor);
+	printf("hubclk       %10u Hz\n", cfg.hubclk);
+	printf("la_bw        %10u MB/s\n", nvdisp_bw_to_la_mbps(cfg.total_bw));
+
+	if (check_fits(&cfg)) {
+		printf("does not fit the platform limits\n");
+		ret = 1;
+	}
+
+	if (s->has_expect && memcmp(&cfg, &s->expect, sizeof(cfg))) {
+		printf("MISMATCH: expected %u %u %u %u\n", s->expect.iso_bw,
+		       s->expect.total_bw, s->expect.emc_la_floor,
+		       s->expect.hubclk);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+static void random_setup(struct bw_setup *s)
+{
+	static const uint32_t pclks[] = { 148500, 297000, 594000 };
+	static const uint32_t bpps[] = { 12, 16, 32, 64 };
+	uint32_t j;
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	s->num_heads = 1 + rand() % MAX_HEADS;
+
+	for (i = 0; i < s->num_heads; i++) {
+		struct nvdisp_bw_head *head = &s->heads[i];
+
+		head->pclk_khz = pclks[rand() % 3];
+		head->num_wins = 1 + rand() % 6;
+		head->wins = s->wins[i];
+
+		for (j = 0; j < head->num_wins; j++) {
+			struct nvdisp_bw_win *win = &s->wins[i][j];
+
+			win->in_w = 64 + rand() % 4032;
+			win->in_h = 64 + rand() % 2096;
+			win->out_w = 64 + rand() % 3776;
+			win->out_h = 64 + rand() % 2096;
+			win->out_y = rand() % 2160;
+			win->bpp = bpps[rand() % 4];
+		}
+	}
+}
+
+static int benchmark(unsigned long count)
+{
+	struct bw_setup *setups;
+	struct nvdisp_bandwidth_config cfg;
+	struct timespec start, end;
+	unsigned long i, fits = 0, n = 1024;
+	double secs;
+
+	setups = calloc(n, sizeof(*setups));
+	if (!setups)
+		return -ENOMEM;
+
+	srand(1);
+	for (i = 0; i < n; i++)
+		random_setup(&setups[i]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		struct bw_setup *s = &setups[i % n];
+
+		if (nvdisp_bw_calc_config(s->heads, s->num_heads, &params,
+					  &cfg))
+			continue;
+		if (!check_fits(&cfg))
+			fits++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%lu configurations in %.3f s (%.0f/s), %lu fit\n",
+	       count, secs, secs > 0 ? count / secs : 0.0, fits);
+
+	free(setups);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long bench = 0;
+	struct bw_setup setup;
+	FILE *f;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "c:d:e:p:m:t:x:B:h")) != -1) {
+		switch (c) {
+		case 'c':
+			params.catchup_permille = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			params.dram_bytes_per_clk = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			params.dram_efficiency_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			params.hub_pixels_per_clk = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			params.hubclk_margin_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			total_iso_bw = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			max_dram_hz = strtoull(optarg, NULL, 0);
+			break;
+		case 'B':
+			bench = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (bench)
+		return benchmark(bench) ? 1 : 0;
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!strcmp(argv[optind], "-"))
+		f = stdin;
+	else
+		f = fopen(argv[optind], "r");
+	if (!f) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	ret = parse_setup(f, &setup);
+	if (f != stdin)
+		fclose(f);
+	if (ret)
+		return 1;
+
+	return evaluate(&setup) ? 1 : 0;
+}
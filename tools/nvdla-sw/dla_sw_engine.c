@@ -0,0 +1,443 @@
+/*
+ * dla_sw_engine - software stand-in for the DLA falcon firmware.
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#include <string.h>
+
+#include "dla_sw_engine.h"
+
+/* dla_sw_action() results, errors are ERR(code) */
+#define DLA_SW_NEXT	0
+#define DLA_SW_BLOCK	1
+#define DLA_SW_END	2
+
+void *dla_sw_ptr(struct dla_sw_engine *eng, uint64_t addr, uint64_t len)
+{
+	if (addr < eng->mem_iova || len > eng->mem_size ||
+			addr - eng->mem_iova > eng->mem_size - len)
+		return NULL;
+
+	return eng->mem + (addr - eng->mem_iova);
+}
+
+static int dla_sw_syncpt(struct dla_sw_engine *eng, uint64_t addr,
+			 uint32_t **val)
+{
+	uint64_t off;
+
+	if (!eng->syncpt_stride || addr < eng->syncpt_iova)
+		return 0;
+
+	off = addr - eng->syncpt_iova;
+	if (off % eng->syncpt_stride ||
+			off / eng->syncpt_stride >= eng->num_syncpts)
+		return 0;
+
+	*val = &eng->syncpt[off / eng->syncpt_stride];
+	return 1;
+}
+
+int dla_sw_set_gos(struct dla_sw_engine *eng,
+		   const struct dla_region_gos *region)
+{
+	uint16_t i;
+
+	if (region->region != DLA_REGION_GOS ||
+			region->num_grids > MAX_NUM_GRIDS)
+		return DLA_ERR_INVALID_REGION;
+
+	for (i = 0; i < region->num_grids; i++) {
+		eng->gos[i] = dla_sw_ptr(eng, region->address[i],
+					 region->grid_size * sizeof(uint32_t));
+		if (!eng->gos[i])
+			return DLA_ERR_INVALID_REGION;
+	}
+
+	eng->num_grids = region->num_grids;
+	eng->grid_size = region->grid_size;
+	return DLA_ERR_NONE;
+}
+
+/* Sequence numbers wrap, a is newer than b when it is ahead by < 2^15 */
+static int dla_sw_seq_after(uint16_t a, uint16_t b)
+{
+	return (int16_t)(a - b) > 0;
+}
+
+static int dla_sw_cond(uint32_t cur, uint32_t val, int ge)
+{
+	return ge ? (int32_t)(cur - val) >= 0 : cur == val;
+}
+
+static int dla_sw_sem(struct dla_sw_engine *eng, uint8_t op,
+		      const struct dla_action_semaphore *sem)
+{
+	uint32_t *val;
+	uint64_t *ts;
+
+	if (!dla_sw_syncpt(eng, sem->address, &val)) {
+		val = dla_sw_ptr(eng, sem->address, sizeof(*val));
+		if (!val)
+			return ERR(INVALID_FALC_DMA);
+	} else if (op == ACTION_WRITE_SEM || op == ACTION_WRITE_TS_SEM) {
+		/* a release on the shim is an increment, value is ignored */
+		(*val)++;
+		return DLA_SW_NEXT;
+	}
+
+	switch (op) {
+	case ACTION_SEM_EQ:
+	case ACTION_SEM_GE:
+		if (dla_sw_cond(*val, sem->value, op == ACTION_SEM_GE))
+			return DLA_SW_NEXT;
+		return DLA_SW_BLOCK;
+	case ACTION_WRITE_TS_SEM:
+		/* payload, padding, then the release timestamp */
+		ts = dla_sw_ptr(eng, sem->address + 8, sizeof(*ts));
+		if (!ts)
+			return ERR(INVALID_FALC_DMA);
+		*ts = eng->now_ns;
+		/* fall through */
+	default:
+		*val = sem->value;
+		return DLA_SW_NEXT;
+	}
+}
+
+static int dla_sw_gos(struct dla_sw_engine *eng, uint8_t op,
+		      const struct dla_action_gos *gos)
+{
+	uint32_t *val;
+
+	if (gos->index >= eng->num_grids || gos->offset >= eng->grid_size)
+		return ERR(INVALID_REGION);
+	val = &eng->gos[gos->index][gos->offset];
+
+	if (op == ACTION_WRITE_GOS) {
+		*val = gos->value;
+		return DLA_SW_NEXT;
+	}
+
+	if (dla_sw_cond(*val, gos->value, op == ACTION_GOS_GE))
+		return DLA_SW_NEXT;
+	return DLA_SW_BLOCK;
+}
+
+static int dla_sw_task_status(struct dla_sw_engine *eng,
+			      struct dla_sw_queue *q, uint8_t op,
+			      const struct dla_action_task_status *action)
+{
+	struct dla_task_status_notifier *notifier;
+
+	notifier = dla_sw_ptr(eng, action->address, sizeof(*notifier));
+	if (!notifier)
+		return ERR(INVALID_FALC_DMA);
+
+	if (op == ACTION_TASK_STATUS_EQ) {
+		if (notifier->status_task != action->status)
+			return ERR(TASK_STATUS_MISMATCH);
+		return DLA_SW_NEXT;
+	}
+
+	/* a failed task reports its error instead of the requested status */
+	notifier->timestamp = eng->now_ns;
+	notifier->status_engine = (eng->now_ns - q->start_ns) / 1000;
+	notifier->subframe = 0;
+	notifier->status_task = q->status ? q->status : action->status;
+	return DLA_SW_NEXT;
+}
+
+static int dla_sw_action(struct dla_sw_engine *eng, struct dla_sw_queue *q,
+			 const uint8_t *p, uint32_t avail, uint32_t *len)
+{
+	int bad = q->state == DLA_SW_PREACTIONS ?
+			ERR(INVALID_PREACTION) : ERR(INVALID_POSTACTION);
+	uint8_t op;
+
+	if (!avail)
+		return bad;
+	op = *p++;
+	avail--;
+
+	switch (op) {
+	case ACTION_TERMINATE:
+		*len = 1;
+		return DLA_SW_END;
+	case ACTION_SEM_EQ:
+	case ACTION_SEM_GE:
+	case ACTION_WRITE_SEM:
+	case ACTION_WRITE_TS_SEM: {
+		struct dla_action_semaphore sem;
+
+		if (avail < sizeof(sem))
+			return bad;
+		memcpy(&sem, p, sizeof(sem));
+		*len = 1 + sizeof(sem);
+		return dla_sw_sem(eng, op, &sem);
+	}
+	case ACTION_GOS_EQ:
+	case ACTION_GOS_GE:
+	case ACTION_WRITE_GOS: {
+		struct dla_action_gos gos;
+
+		if (avail < sizeof(gos))
+			return bad;
+		memcpy(&gos, p, sizeof(gos));
+		*len = 1 + sizeof(gos);
+		return dla_sw_gos(eng, op, &gos);
+	}
+	case ACTION_TASK_STATUS_EQ:
+	case ACTION_WRITE_TASK_STATUS: {
+		struct dla_action_task_status status;
+
+		if (avail < sizeof(status))
+			return bad;
+		memcpy(&status, p, sizeof(status));
+		*len = 1 + sizeof(status);
+		return dla_sw_task_status(eng, q, op, &status);
+	}
+	case ACTION_WRITE_TIMESTAMP: {
+		struct dla_action_timestamp ts;
+		uint64_t *val;
+
+		if (avail < sizeof(ts))
+			return bad;
+		memcpy(&ts, p, sizeof(ts));
+		*len = 1 + sizeof(ts);
+		val = dla_sw_ptr(eng, ts.address, sizeof(*val));
+		if (!val)
+			return ERR(INVALID_FALC_DMA);
+		*val = eng->now_ns;
+		return DLA_SW_NEXT;
+	}
+	default:
+		return bad;
+	}
+}
+
+/* Point the queue at the action list whose head is at list_off */
+static int dla_sw_load_list(struct dla_sw_queue *q,
+			    struct dla_task_descriptor *d, uint16_t list_off)
+{
+	struct dla_action_list list;
+
+	if ((uint32_t)list_off + sizeof(list) > d->size)
+		return ERR(INVALID_TASK);
+	memcpy(&list, (uint8_t *)d + list_off, sizeof(list));
+	if ((uint32_t)list.offset + list.size > d->size)
+		return ERR(INVALID_TASK);
+
+	q->pc = list.offset;
+	q->end = list.offset + list.size;
+	return 0;
+}
+
+/* What stands in for compute: every buffer must be reachable */
+static int dla_sw_check_addresses(struct dla_sw_engine *eng,
+				  struct dla_task_descriptor *d)
+{
+	uint64_t *list;
+	uint16_t i;
+
+	if (!d->num_addresses)
+		return 0;
+
+	list = dla_sw_ptr(eng, d->address_list,
+			  d->num_addresses * sizeof(*list));
+	if (!list)
+		return ERR(INVALID_FALC_DMA);
+
+	for (i = 0; i < d->num_addresses; i++)
+		if (!dla_sw_ptr(eng, list[i], 1))
+			return ERR(INVALID_FALC_DMA);
+
+	return 0;
+}
+
+static struct dla_task_descriptor *dla_sw_desc(struct dla_sw_engine *eng,
+					       uint64_t desc)
+{
+	struct dla_task_descriptor *d;
+
+	d = dla_sw_ptr(eng, desc, sizeof(*d));
+	if (!d || d->size < sizeof(*d) || !dla_sw_ptr(eng, desc, d->size))
+		return NULL;
+
+	return d;
+}
+
+static int dla_sw_start(struct dla_sw_engine *eng, struct dla_sw_queue *q,
+			uint64_t desc)
+{
+	struct dla_task_descriptor *d = dla_sw_desc(eng, desc);
+	int err;
+
+	if (!d)
+		return DLA_ERR_INVALID_FALC_DMA;
+	if (d->version != DLA_DESCRIPTOR_VERSION)
+		return DLA_ERR_INVALID_DESC_VER;
+	if (d->engine_id != DLA_ENGINE_ID)
+		return DLA_ERR_INVALID_ENGINE_ID;
+
+	q->desc = desc;
+	q->status = DLA_ERR_NONE;
+	q->start_ns = eng->now_ns;
+	q->waiting = 0;
+	q->state = DLA_SW_PREACTIONS;
+	q->seen = 1;
+	q->last_sequence = d->sequence;
+
+	err = dla_sw_load_list(q, d, d->preactions);
+	if (err) {
+		q->status = -err;
+		q->pc = q->end = 0;
+	}
+
+	return DLA_ERR_NONE;
+}
+
+static void dla_sw_finish(struct dla_sw_engine *eng, struct dla_sw_queue *q,
+			  struct dla_task_descriptor *d)
+{
+	struct dla_task_descriptor *next;
+
+	d->status = q->status;
+	eng->stats.tasks++;
+	if (q->status)
+		eng->stats.errors++;
+	q->state = DLA_SW_IDLE;
+
+	/* follow the chain, stopping at anything not queued after us */
+	if (!d->next)
+		return;
+	next = dla_sw_desc(eng, d->next);
+	if (!next || !dla_sw_seq_after(next->sequence, d->sequence))
+		return;
+
+	dla_sw_start(eng, q, d->next);
+}
+
+static void dla_sw_busy(struct dla_sw_engine *eng, uint32_t ns)
+{
+	eng->now_ns += ns;
+	eng->stats.busy_ns += ns;
+}
+
+/* Run a queue until its current task blocks or completes */
+static int dla_sw_step(struct dla_sw_engine *eng, struct dla_sw_queue *q)
+{
+	struct dla_task_descriptor *d;
+	uint32_t len;
+	int progress = 0;
+	int ret;
+
+	while (q->state != DLA_SW_IDLE) {
+		d = dla_sw_desc(eng, q->desc);
+		if (!d) {
+			q->state = DLA_SW_IDLE;
+			eng->stats.errors++;
+			return 1;
+		}
+
+		ret = DLA_SW_END;
+		if (!q->status || q->state == DLA_SW_POSTACTIONS)
+			ret = dla_sw_action(eng, q, (uint8_t *)d + q->pc,
+					    q->end - q->pc, &len);
+		if (ret == DLA_SW_BLOCK) {
+			if (!q->waiting)
+				eng->stats.blocked++;
+			q->waiting = 1;
+			return progress;
+		}
+
+		progress = 1;
+		q->waiting = 0;
+		if (ret == DLA_SW_NEXT) {
+			q->pc += len;
+			dla_sw_busy(eng, eng->action_ns);
+			eng->stats.actions++;
+			continue;
+		}
+
+		/* end of list or failure, keep the first error */
+		if (ret < 0 && !q->status)
+			q->status = -ret;
+
+		if (q->state == DLA_SW_PREACTIONS) {
+			if (!q->status)
+				q->status = -dla_sw_check_addresses(eng, d);
+			/* execution time reported is from here on */
+			q->start_ns = eng->now_ns;
+			if (!q->status)
+				dla_sw_busy(eng, eng->task_ns);
+
+			/* postactions run even for failed tasks */
+			q->state = DLA_SW_POSTACTIONS;
+			ret = dla_sw_load_list(q, d, d->postactions);
+			if (ret) {
+				q->status = -ret;
+				dla_sw_finish(eng, q, d);
+				return progress;
+			}
+			continue;
+		}
+
+		dla_sw_finish(eng, q, d);
+		return progress;
+	}
+
+	return progress;
+}
+
+/* DLA_CMD_SUBMIT_TASK */
+int dla_sw_submit(struct dla_sw_engine *eng, uint64_t desc)
+{
+	struct dla_task_descriptor *d = dla_sw_desc(eng, desc);
+	struct dla_sw_queue *q;
+
+	eng->stats.kicks++;
+
+	if (!d)
+		return DLA_ERR_INVALID_FALC_DMA;
+	if (d->queue_id >= DLA_SW_MAX_QUEUES)
+		return DLA_ERR_INVALID_QUEUE;
+
+	/*
+	 * Tasks chained behind a running or already taken one are reached
+	 * through next, the kick is only needed when the queue ran dry.
+	 */
+	q = &eng->queues[d->queue_id];
+	if (q->state != DLA_SW_IDLE ||
+			(q->seen && !dla_sw_seq_after(d->sequence,
+						      q->last_sequence)))
+		return DLA_ERR_NONE;
+
+	return dla_sw_start(eng, q, desc);
+}
+
+/* Run all queues round robin until none can progress, return tasks done */
+int dla_sw_run(struct dla_sw_engine *eng)
+{
+	uint64_t tasks = eng->stats.tasks;
+	int progress;
+	uint32_t i;
+
+	do {
+		progress = 0;
+		for (i = 0; i < DLA_SW_MAX_QUEUES; i++) {
+			struct dla_sw_queue *q;
+
+			q = &eng->queues[(eng->rr + i) % DLA_SW_MAX_QUEUES];
+			progress |= dla_sw_step(eng, q);
+		}
+		eng->rr = (eng->rr + 1) % DLA_SW_MAX_QUEUES;
+	} while (progress);
+
+	return eng->stats.tasks - tasks;
+}
@@ -0,0 +1,93 @@
+/*
+ * dla_sw_engine - software stand-in for the DLA falcon firmware.
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#ifndef _DLA_SW_ENGINE_H_
+#define _DLA_SW_ENGINE_H_
+
+#include <stdint.h>
+
+#include "dla_os_interface.h"
+
+/*
+ * Executes task descriptors in the layout written by nvdla_fill_task_desc():
+ * the pre-action list, the address list, the post-action list, then the
+ * task chained through next. Compute is not modelled, a task takes task_ns
+ * and each action action_ns of virtual time, which is what timestamps and
+ * status notifiers report.
+ *
+ * Engine addresses are translated through a single flat memory arena.
+ * Semaphore actions on the syncpoint shim, as returned by
+ * nvhost_syncpt_address(), act on the simulated syncpoint values instead:
+ * a release increments the syncpoint, an acquire compares with it.
+ */
+
+#define DLA_SW_MAX_QUEUES	16
+
+enum dla_sw_queue_state {
+	DLA_SW_IDLE,
+	DLA_SW_PREACTIONS,
+	DLA_SW_POSTACTIONS,
+};
+
+struct dla_sw_queue {
+	enum dla_sw_queue_state state;
+	uint64_t desc;		/* engine address of the current task */
+	uint32_t pc;		/* offset of the next action in the task */
+	uint32_t end;		/* end of the current action list */
+	uint16_t status;	/* DLA_ERR_* of the current task */
+	uint64_t start_ns;
+	int waiting;		/* blocked on a wait action */
+	int seen;
+	uint16_t last_sequence;	/* of the last task taken from this queue */
+};
+
+struct dla_sw_stats {
+	uint64_t kicks;
+	uint64_t tasks;
+	uint64_t actions;
+	uint64_t blocked;	/* wait actions found unmet at first */
+	uint64_t errors;	/* tasks failed with a DLA_ERR_* status */
+	uint64_t busy_ns;
+};
+
+struct dla_sw_engine {
+	/* memory the engine can reach, at engine address mem_iova */
+	uint8_t *mem;
+	uint64_t mem_iova;
+	uint64_t mem_size;
+
+	/* syncpoint shim, syncpoint id at syncpt_iova + id * syncpt_stride */
+	uint64_t syncpt_iova;
+	uint32_t syncpt_stride;
+	uint32_t num_syncpts;
+	uint32_t *syncpt;
+
+	/* GoS grids of u32 entries, see DLA_CMD_SET_REGIONS */
+	uint32_t *gos[MAX_NUM_GRIDS];
+	uint16_t num_grids;
+	uint16_t grid_size;
+
+	/* timing model */
+	uint64_t now_ns;
+	uint32_t task_ns;
+	uint32_t action_ns;
+
+	struct dla_sw_queue queues[DLA_SW_MAX_QUEUES];
+	uint32_t rr;
+	struct dla_sw_stats stats;
+};
+
+void *dla_sw_ptr(struct dla_sw_engine *eng, uint64_t addr, uint64_t len);
+int dla_sw_set_gos(struct dla_sw_engine *eng,
+		   const struct dla_region_gos *region);
+int dla_sw_submit(struct dla_sw_engine *eng, uint64_t desc);
+int dla_sw_run(struct dla_sw_engine *eng);
+
+#endif /* _DLA_SW_ENGINE_H_ */
@@ -0,0 +1,526 @@
+/*
+ * nvdla_sw - drive the DLA queue, fence and GoS protocol against a software
+ * engine, to benchmark and stress it without DLA silicon.
+ *
+ * Copyright (c) 2020, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Build:
+ *	cc -O2 -I../../drivers/video/tegra/host/nvdla -o nvdla_sw \
+ *		nvdla_sw.c dla_sw_engine.c
+ *
+ * Example Usage:
+ *	nvdla_sw -q 4 -n 100000 -b 8 -d -g	chained queues waiting on GoS
+ *	nvdla_sw -q 8 -n 10000 -d -s 1		randomized stress run
+ *
+ * Each queue has a syncpoint and a ring of task descriptors built the way
+ * nvdla_fill_task_desc() builds them, with the encoders of dla_actions.h:
+ * optional wait on the last task of another queue (GoS or syncpoint shim),
+ * SOF timestamp, profiling status notifier, GoS update and syncpoint
+ * release. Tasks are queued like nvdla_queue_submit_op() does, chained
+ * through next, and kicked one by one or by batches. Completions are reaped
+ * like nvdla_queue_update() does, then all results are checked.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dla_actions.h"
+#include "dla_sw_engine.h"
+
+#define ARENA_IOVA	0x80000000ULL
+#define SYNCPT_IOVA	0x10000000ULL
+#define SYNCPT_STRIDE	0x1000
+#define NUM_SYNCPTS	64
+#define QUEUE_DEPTH	32	/* MAX_NVDLA_TASK_COUNT */
+#define DESC_SIZE	4096
+#define BUF_SIZE	4096
+#define MAX_ADDRESSES	256
+#define MAX_ACTIONS	256	/* bytes per action list */
+
+struct sw_queue {
+	uint32_t id;
+	uint32_t syncpt_id;
+	uint32_t max;		/* syncpoint max, one increment per task */
+	uint16_t sequence;
+	uint64_t desc[QUEUE_DEPTH];
+	uint64_t sof[QUEUE_DEPTH];
+	uint64_t last_desc;	/* last queued task, 0 when none */
+	uint32_t submitted;
+	uint32_t completed;
+
+	/* per task results, checked at the end */
+	int32_t *dep_q;
+	uint32_t *dep_k;
+	uint64_t *submit_ns;
+	uint64_t *sof_ns;
+	uint64_t *done_ns;
+	uint16_t *status;
+};
+
+static struct dla_sw_engine eng;
+static struct sw_queue *queues;
+static uint64_t arena_used;
+static uint64_t buffers;
+
+static unsigned int num_queues = 1;
+static unsigned int num_tasks = 10000;
+static unsigned int batch = 1;
+static unsigned int num_addresses = 8;
+static int use_deps;
+static int use_gos;
+static unsigned int seed;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -q <queues>    queues, one syncpoint each [%u]\n"
+		"  -n <tasks>     tasks per queue [%u]\n"
+		"  -b <tasks>     max tasks chained per kick [%u]\n"
+		"  -a <count>     addresses per task [%u]\n"
+		"  -d             wait on the last task of the previous queue\n"
+		"  -g             wait through GoS instead of the syncpoint shim\n"
+		"  -t <ns>        virtual time per task [%u]\n"
+		"  -c <ns>        virtual time per action [%u]\n"
+		"  -s <seed>      randomize order, batches and dependencies\n",
+		prog, num_queues, num_tasks, batch, num_addresses,
+		eng.task_ns, eng.action_ns);
+}
+
+static uint64_t arena_alloc(uint64_t size, uint64_t align)
+{
+	uint64_t iova;
+
+	arena_used = (arena_used + align - 1) & ~(align - 1);
+	if (arena_used + size > eng.mem_size) {
+		fprintf(stderr, "arena exhausted\n");
+		exit(1);
+	}
+
+	iova = eng.mem_iova + arena_used;
+	arena_used += size;
+	return iova;
+}
+
+static int setup(void)
+{
+	struct dla_region_gos gos = { 0 };
+	unsigned int i, j;
+
+	eng.mem_size = (uint64_t)num_queues * QUEUE_DEPTH *
+			(DESC_SIZE + 256) + MAX_ADDRESSES * BUF_SIZE +
+			NUM_SYNCPTS * sizeof(uint32_t) + 65536;
+	eng.mem = calloc(1, eng.mem_size);
+	eng.mem_iova = ARENA_IOVA;
+	eng.syncpt = calloc(NUM_SYNCPTS, sizeof(*eng.syncpt));
+	eng.syncpt_iova = SYNCPT_IOVA;
+	eng.syncpt_stride = SYNCPT_STRIDE;
+	eng.num_syncpts = NUM_SYNCPTS;
+	queues = calloc(num_queues, sizeof(*queues));
+	if (!eng.mem || !eng.syncpt || !queues)
+		return -ENOMEM;
+
+	/* one grid backing all syncpoints, offset is the syncpoint id */
+	gos.region = DLA_REGION_GOS;
+	gos.num_grids = 1;
+	gos.grid_size = NUM_SYNCPTS;
+	gos.address[0] = arena_alloc(NUM_SYNCPTS * sizeof(uint32_t), 256);
+	if (dla_sw_set_gos(&eng, &gos))
+		return -EINVAL;
+
+	buffers = arena_alloc((uint64_t)num_addresses * BUF_SIZE, 256);
+
+	for (i = 0; i < num_queues; i++) {
+		struct sw_queue *q = &queues[i];
+
+		q->id = i;
+		q->syncpt_id = i + 1;
+		for (j = 0; j < QUEUE_DEPTH; j++) {
+			q->desc[j] = arena_alloc(DESC_SIZE, 256);
+			q->sof[j] = arena_alloc(sizeof(uint64_t), 8);
+		}
+
+		q->dep_q = calloc(num_tasks, sizeof(*q->dep_q));
+		q->dep_k = calloc(num_tasks, sizeof(*q->dep_k));
+		q->submit_ns = calloc(num_tasks, sizeof(*q->submit_ns));
+		q->sof_ns = calloc(num_tasks, sizeof(*q->sof_ns));
+		q->done_ns = calloc(num_tasks, sizeof(*q->done_ns));
+		q->status = calloc(num_tasks, sizeof(*q->status));
+		if (!q->dep_q || !q->dep_k || !q->submit_ns || !q->sof_ns ||
+				!q->done_ns || !q->status)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static inline void *ptr(uint64_t iova)
+{
+	return dla_sw_ptr(&eng, iova, 1);
+}
+
+static inline uint64_t syncpt_address(uint32_t id)
+{
+	return SYNCPT_IOVA + (uint64_t)id * SYNCPT_STRIDE;
+}
+
+static inline uint64_t notifier_offset(void)
+{
+	return DESC_SIZE - 256;
+}
+
+/* Pick the task this one waits for, -1 when none */
+static int pick_dep(struct sw_queue *q, uint32_t *dep_k)
+{
+	struct sw_queue *dq;
+
+	if (!use_deps || num_queues < 2)
+		return -1;
+
+	if (seed)
+		dq = &queues[rand() % num_queues];
+	else
+		dq = &queues[(q->id + num_queues - 1) % num_queues];
+
+	if (dq == q || !dq->submitted)
+		return -1;
+
+	*dep_k = dq->submitted - 1;
+	return dq->id;
+}
+
+/* Build task k of q in its descriptor slot, see nvdla_fill_task_desc() */
+static uint64_t build_task(struct sw_queue *q, uint32_t k)
+{
+	uint32_t slot = k % QUEUE_DEPTH;
+	uint64_t iova = q->desc[slot];
+	struct dla_task_descriptor *desc = ptr(iova);
+	struct dla_action_list *list;
+	uint8_t *next, *start;
+	uint32_t fence_counter = 0, dep_k = 0;
+	uint16_t list_of, addr_of;
+	unsigned int i;
+	int dep;
+
+	memset(desc, 0, DESC_SIZE);
+	desc->version = DLA_DESCRIPTOR_VERSION;
+	desc->engine_id = DLA_ENGINE_ID;
+	desc->size = DESC_SIZE;
+	desc->sequence = ++q->sequence;
+	desc->num_preactions = 1;
+	desc->num_postactions = 1;
+	desc->queue_id = q->id;
+	desc->preactions = sizeof(struct dla_task_descriptor);
+	desc->postactions = desc->preactions + sizeof(struct dla_action_list);
+
+	/* preactions: dependency wait, then SOF timestamp */
+	list_of = desc->postactions + sizeof(struct dla_action_list);
+	start = next = (uint8_t *)desc + list_of;
+
+	dep = pick_dep(q, &dep_k);
+	q->dep_q[k] = dep;
+	q->dep_k[k] = dep_k;
+	if (dep >= 0) {
+		/* one increment per task, task k signals k + 1 */
+		if (use_gos)
+			next = add_gos_action(next, ACTION_GOS_GE, 0,
+					queues[dep].syncpt_id, dep_k + 1);
+		else
+			next = add_fence_action(next, ACTION_SEM_GE,
+					syncpt_address(queues[dep].syncpt_id),
+					dep_k + 1);
+	}
+	next = add_timestamp_action(next, ACTION_WRITE_TIMESTAMP,
+				    q->sof[slot]);
+	next = add_opcode(next, ACTION_TERMINATE);
+
+	list = (struct dla_action_list *)((uint8_t *)desc + desc->preactions);
+	list->offset = list_of;
+	list->size = next - start;
+
+	/* postactions: profiling notifier, GoS update, syncpoint release */
+	list_of += MAX_ACTIONS;
+	start = next = (uint8_t *)desc + list_of;
+
+	next = add_status_action(next, ACTION_WRITE_TASK_STATUS,
+				 iova + notifier_offset(), 0);
+	if (use_gos)
+		next = add_gos_action(next, ACTION_WRITE_GOS, 0, q->syncpt_id,
+				      q->max + fence_counter + 1);
+	next = add_fence_action(next, ACTION_WRITE_SEM,
+				syncpt_address(q->syncpt_id), 1);
+	fence_counter++;
+	next = add_opcode(next, ACTION_TERMINATE);
+
+	list = (struct dla_action_list *)((uint8_t *)desc + desc->postactions);
+	list->offset = list_of;
+	list->size = next - start;
+
+	/* address list, 256 aligned */
+	addr_of = (list_of + MAX_ACTIONS + 255) & ~255;
+	desc->address_list = iova + addr_of;
+	desc->num_addresses = num_addresses;
+	next = (uint8_t *)desc + addr_of;
+	for (i = 0; i < num_addresses; i++)
+		next = add_address(next, buffers + i * BUF_SIZE);
+
+	q->max += fence_counter;
+	return iova;
+}
+
+/* Queue up to n tasks of q and kick the engine once for them */
+static int submit(struct sw_queue *q, unsigned int n)
+{
+	uint64_t first = 0;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < n; i++) {
+		uint32_t k = q->submitted;
+		uint64_t iova;
+
+		if (k == num_tasks || k - q->completed == QUEUE_DEPTH)
+			break;
+
+		iova = build_task(q, k);
+		q->submit_ns[k] = eng.now_ns;
+
+		/* update last task desc's next */
+		if (q->last_desc) {
+			struct dla_task_descriptor *last = ptr(q->last_desc);
+
+			last->next = iova;
+		}
+		q->last_desc = iova;
+		q->submitted++;
+
+		if (!first)
+			first = iova;
+	}
+
+	if (!first)
+		return 0;
+
+	err = dla_sw_submit(&eng, first);
+	if (err) {
+		fprintf(stderr, "queue %u: submit failed %d\n", q->id, err);
+		return -EIO;
+	}
+
+	return i;
+}
+
+/* Reap completed tasks in order, see nvdla_queue_update() */
+static int reap(struct sw_queue *q)
+{
+	int done = 0;
+
+	while (q->completed < q->submitted) {
+		uint32_t k = q->completed;
+		uint32_t slot = k % QUEUE_DEPTH;
+		struct dla_task_descriptor *desc = ptr(q->desc[slot]);
+		struct dla_task_status_notifier *notifier;
+
+		if ((int32_t)(eng.syncpt[q->syncpt_id] - (k + 1)) < 0)
+			break;
+
+		notifier = ptr(q->desc[slot] + notifier_offset());
+		q->done_ns[k] = notifier->timestamp;
+		q->sof_ns[k] = *(uint64_t *)ptr(q->sof[slot]);
+		q->status[k] = notifier->status_task ? notifier->status_task :
+				desc->status;
+
+		if (q->last_desc == q->desc[slot])
+			q->last_desc = 0;
+		q->completed++;
+		done++;
+	}
+
+	return done;
+}
+
+static int verify(void)
+{
+	unsigned int i, k;
+	int bad = 0;
+
+	for (i = 0; i < num_queues; i++) {
+		struct sw_queue *q = &queues[i];
+
+		if (eng.syncpt[q->syncpt_id] != q->max) {
+			printf("queue %u: syncpt %u != max %u\n", i,
+			       eng.syncpt[q->syncpt_id], q->max);
+			bad++;
+		}
+
+		for (k = 0; k < num_tasks; k++) {
+			if (q->status[k]) {
+				printf("queue %u task %u: status %u\n", i, k,
+				       q->status[k]);
+				bad++;
+			}
+			if (k && q->sof_ns[k] < q->done_ns[k - 1]) {
+				printf("queue %u task %u: started before the previous task completed\n",
+				       i, k);
+				bad++;
+			}
+			if (q->dep_q[k] >= 0 && q->sof_ns[k] <
+				    queues[q->dep_q[k]].done_ns[q->dep_k[k]]) {
+				printf("queue %u task %u: started before queue %d task %u completed\n",
+				       i, k, q->dep_q[k], q->dep_k[k]);
+				bad++;
+			}
+		}
+	}
+
+	return bad;
+}
+
+static void report(double secs)
+{
+	uint64_t total = (uint64_t)num_queues * num_tasks;
+	uint64_t latency = 0;
+	unsigned int i, k;
+
+	for (i = 0; i < num_queues; i++)
+		for (k = 0; k < num_tasks; k++)
+			latency += queues[i].done_ns[k] - queues[i].submit_ns[k];
+
+	printf("tasks    %" PRIu64 " in %" PRIu64 " kicks (%.2f tasks/kick)\n",
+	       total, eng.stats.kicks,
+	       eng.stats.kicks ? (double)total / eng.stats.kicks : 0.0);
+	printf("host     %.3f s, %.0f tasks/s\n", secs,
+	       secs > 0 ? total / secs : 0.0);
+	printf("engine   %.1f actions/task, %" PRIu64 " unmet waits, %" PRIu64
+	       " errors\n", (double)eng.stats.actions / total,
+	       eng.stats.blocked, eng.stats.errors);
+	printf("virtual  %.3f ms busy, avg submit to completion %.3f us\n",
+	       eng.stats.busy_ns / 1e6, latency / 1e3 / total);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int order[DLA_SW_MAX_QUEUES];
+	struct timespec start, end;
+	uint64_t remaining;
+	unsigned int i;
+	int c, ret;
+
+	eng.task_ns = 100000;
+	eng.action_ns = 200;
+
+	while ((c = getopt(argc, argv, "q:n:b:a:dgt:c:s:h")) != -1) {
+		switch (c) {
+		case 'q':
+			num_queues = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			num_tasks = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			num_addresses = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			use_deps = 1;
+			break;
+		case 'g':
+			use_gos = 1;
+			break;
+		case 't':
+			eng.task_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			eng.action_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!num_queues || num_queues > DLA_SW_MAX_QUEUES ||
+			num_queues >= NUM_SYNCPTS || !num_tasks || !batch ||
+			batch > QUEUE_DEPTH || num_addresses > MAX_ADDRESSES) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (setup()) {
+		fprintf(stderr, "setup failed\n");
+		return 1;
+	}
+	srand(seed);
+	for (i = 0; i < num_queues; i++)
+		order[i] = i;
+
+	remaining = (uint64_t)num_queues * num_tasks;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (remaining) {
+		int progress = 0;
+
+		/* every queue gets its turn, in random order when stressing */
+		for (i = 0; seed && i < num_queues; i++) {
+			unsigned int j = i + rand() % (num_queues - i);
+			unsigned int tmp = order[i];
+
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		for (i = 0; i < num_queues; i++) {
+			struct sw_queue *q = &queues[order[i]];
+			unsigned int n = batch;
+
+			if (seed)
+				n = 1 + rand() % batch;
+
+			ret = submit(q, n);
+			if (ret < 0)
+				return 1;
+			progress |= ret;
+
+			/* let the engine catch up at random points */
+			if (seed && !(rand() % 4))
+				progress |= dla_sw_run(&eng);
+		}
+
+		progress |= dla_sw_run(&eng);
+
+		for (i = 0; i < num_queues; i++) {
+			ret = reap(&queues[i]);
+			remaining -= ret;
+			progress |= ret;
+		}
+
+		if (!progress) {
+			fprintf(stderr, "stalled with %" PRIu64 " tasks left\n",
+				remaining);
+			return 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	report((end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	ret = verify();
+	if (ret)
+		printf("%d check(s) failed\n", ret);
+
+	return ret ? 1 : 0;
+}